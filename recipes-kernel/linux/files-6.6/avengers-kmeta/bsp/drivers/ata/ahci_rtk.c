@@ -28,6 +28,15 @@
 #define SRAM_SHARE		BIT(0)
 #define CLEAR_ERR		BIT(2)
 
+/* command completion coalescing, AHCI 1.3 section 3.1.10 */
+#define HOST_CCC_CTL		0x14
+#define HOST_CCC_PORTS		0x18
+#define CCC_TV(x)		(((x) & 0xffff) << 16)
+#define CCC_CC(x)		(((x) & 0xff) << 8)
+#define CCC_INT(x)		(((x) >> 3) & 0x1f)
+#define CCC_EN			BIT(0)
+#define CCC_TV_DEFAULT		1
+
 enum host_state {
 	INITIAL = 0,
 	SUSPEND,
@@ -48,6 +57,14 @@ struct rtk_ahci_priv {
 
 	enum host_state state;
 	unsigned int hostinit;
+
+	/* ccc_cc == 0 leaves coalescing off */
+	unsigned int ccc_cc;
+	unsigned int ccc_tv;
+	u32 ccc_irq;
+
+	u64 port_irqs[RTK_SATA_MAX_PORT];
+	u64 ccc_irqs;
 };
 
 static const struct ata_port_info ahci_port_info = {
@@ -61,6 +78,237 @@ static struct scsi_host_template ahci_platform_sht = {
 	AHCI_SHT(DRV_NAME),
 };
 
+/*
+ * With CCC on, completions on the implemented ports stop raising their own
+ * IS bit and are reported together on the CCC bit once ccc_cc commands have
+ * completed or ccc_tv ms have passed. Errors still interrupt right away.
+ * CC and TV may only be changed while CCC is disabled.
+ */
+static void rtk_ahci_ccc_apply(struct ahci_host_priv *hpriv)
+{
+	struct rtk_ahci_priv *priv = hpriv->plat_data;
+	void __iomem *mmio = hpriv->mmio;
+	u32 ctl;
+
+	if (!(hpriv->cap & HOST_CAP_CCC))
+		return;
+
+	ctl = readl(mmio + HOST_CCC_CTL);
+	writel(ctl & ~CCC_EN, mmio + HOST_CCC_CTL);
+	priv->ccc_irq = 0;
+
+	if (!priv->ccc_cc)
+		return;
+
+	writel(hpriv->port_map, mmio + HOST_CCC_PORTS);
+	ctl = CCC_TV(priv->ccc_tv) | CCC_CC(priv->ccc_cc);
+	writel(ctl, mmio + HOST_CCC_CTL);
+	writel(ctl | CCC_EN, mmio + HOST_CCC_CTL);
+
+	priv->ccc_irq = BIT(CCC_INT(readl(mmio + HOST_CCC_CTL)));
+}
+
+/*
+ * Reprogram CCC on a running host, called with host->lock held. Commands may
+ * be in flight, and a completion coalesced under the old setting loses its
+ * CCC interrupt when CCC_EN drops, so reap the ports once by hand.
+ */
+static void rtk_ahci_ccc_update(struct ata_host *host)
+{
+	struct ahci_host_priv *hpriv = host->private_data;
+
+	rtk_ahci_ccc_apply(hpriv);
+	ahci_handle_port_intr(host, hpriv->port_map);
+}
+
+static irqreturn_t rtk_ahci_irq_intr(int irq, void *dev_instance)
+{
+	struct ata_host *host = dev_instance;
+	struct ahci_host_priv *hpriv = host->private_data;
+	struct rtk_ahci_priv *priv = hpriv->plat_data;
+	void __iomem *mmio = hpriv->mmio;
+	u32 irq_stat, irq_masked;
+	unsigned int handled;
+	int i;
+
+	irq_stat = readl(mmio + HOST_IRQ_STAT);
+	if (!irq_stat)
+		return IRQ_NONE;
+
+	irq_masked = irq_stat & hpriv->port_map;
+
+	spin_lock(&host->lock);
+
+	for (i = 0; i < RTK_SATA_MAX_PORT; i++)
+		if (irq_masked & BIT(i))
+			priv->port_irqs[i]++;
+
+	/* one CCC interrupt stands for completions on every coalesced port */
+	if (irq_stat & priv->ccc_irq) {
+		priv->ccc_irqs++;
+		irq_masked |= hpriv->port_map;
+	}
+
+	handled = ahci_handle_port_intr(host, irq_masked);
+
+	/* HOST_IRQ_STAT is write-1-to-clear, so clear after the ports */
+	writel(irq_stat, mmio + HOST_IRQ_STAT);
+
+	spin_unlock(&host->lock);
+
+	return IRQ_RETVAL(handled || (irq_stat & priv->ccc_irq));
+}
+
+static struct ahci_host_priv *rtk_ahci_attr_hpriv(struct device *dev)
+{
+	struct ata_host *host = dev_get_drvdata(dev);
+
+	return host ? host->private_data : NULL;
+}
+
+static ssize_t ccc_completions_store(struct device *dev,
+				     struct device_attribute *attr,
+				     const char *buf, size_t count)
+{
+	struct ahci_host_priv *hpriv = rtk_ahci_attr_hpriv(dev);
+	struct ata_host *host = dev_get_drvdata(dev);
+	struct rtk_ahci_priv *priv;
+	unsigned long flags;
+	u32 val;
+	int ret;
+
+	if (!hpriv)
+		return -ENODEV;
+	if (!(hpriv->cap & HOST_CAP_CCC))
+		return -EOPNOTSUPP;
+
+	ret = kstrtou32(buf, 10, &val);
+	if (ret)
+		return ret;
+	if (val > 0xff)
+		return -EINVAL;
+
+	priv = hpriv->plat_data;
+	spin_lock_irqsave(&host->lock, flags);
+	priv->ccc_cc = val;
+	rtk_ahci_ccc_update(host);
+	spin_unlock_irqrestore(&host->lock, flags);
+
+	return count;
+}
+
+static ssize_t ccc_completions_show(struct device *dev,
+				    struct device_attribute *attr, char *buf)
+{
+	struct ahci_host_priv *hpriv = rtk_ahci_attr_hpriv(dev);
+	struct rtk_ahci_priv *priv;
+
+	if (!hpriv)
+		return -ENODEV;
+
+	priv = hpriv->plat_data;
+	return snprintf(buf, PAGE_SIZE, "%u\n", priv->ccc_cc);
+}
+static DEVICE_ATTR_RW(ccc_completions);
+
+static ssize_t ccc_timeout_ms_store(struct device *dev,
+				    struct device_attribute *attr,
+				    const char *buf, size_t count)
+{
+	struct ahci_host_priv *hpriv = rtk_ahci_attr_hpriv(dev);
+	struct ata_host *host = dev_get_drvdata(dev);
+	struct rtk_ahci_priv *priv;
+	unsigned long flags;
+	u32 val;
+	int ret;
+
+	if (!hpriv)
+		return -ENODEV;
+	if (!(hpriv->cap & HOST_CAP_CCC))
+		return -EOPNOTSUPP;
+
+	ret = kstrtou32(buf, 10, &val);
+	if (ret)
+		return ret;
+	if (!val || val > 0xffff)
+		return -EINVAL;
+
+	priv = hpriv->plat_data;
+	spin_lock_irqsave(&host->lock, flags);
+	priv->ccc_tv = val;
+	rtk_ahci_ccc_update(host);
+	spin_unlock_irqrestore(&host->lock, flags);
+
+	return count;
+}
+
+static ssize_t ccc_timeout_ms_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	struct ahci_host_priv *hpriv = rtk_ahci_attr_hpriv(dev);
+	struct rtk_ahci_priv *priv;
+
+	if (!hpriv)
+		return -ENODEV;
+
+	priv = hpriv->plat_data;
+	return snprintf(buf, PAGE_SIZE, "%u\n", priv->ccc_tv);
+}
+static DEVICE_ATTR_RW(ccc_timeout_ms);
+
+static ssize_t ccc_interrupts_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	struct ahci_host_priv *hpriv = rtk_ahci_attr_hpriv(dev);
+	struct rtk_ahci_priv *priv;
+
+	if (!hpriv)
+		return -ENODEV;
+
+	priv = hpriv->plat_data;
+	return snprintf(buf, PAGE_SIZE, "%llu\n", priv->ccc_irqs);
+}
+static DEVICE_ATTR_RO(ccc_interrupts);
+
+static ssize_t port_interrupts_show(struct device *dev,
+				    struct device_attribute *attr, char *buf)
+{
+	struct ahci_host_priv *hpriv = rtk_ahci_attr_hpriv(dev);
+	struct rtk_ahci_priv *priv;
+	int len = 0;
+	int i;
+
+	if (!hpriv)
+		return -ENODEV;
+
+	priv = hpriv->plat_data;
+	for (i = 0; i < hpriv->nports; i++)
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%s%llu",
+				 i ? " " : "", priv->port_irqs[i]);
+	len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+
+	return len;
+}
+static DEVICE_ATTR_RO(port_interrupts);
+
+static struct attribute *rtk_ahci_attrs[] = {
+	&dev_attr_ccc_completions.attr,
+	&dev_attr_ccc_timeout_ms.attr,
+	&dev_attr_ccc_interrupts.attr,
+	&dev_attr_port_interrupts.attr,
+	NULL
+};
+
+static const struct attribute_group rtk_ahci_attr_group = {
+	.name = "rtk_ahci",
+	.attrs = rtk_ahci_attrs,
+};
+
+static const struct attribute_group *rtk_ahci_groups[] = {
+	&rtk_ahci_attr_group,
+	NULL
+};
+
 static void rtk_sata_init(struct ahci_host_priv *hpriv, unsigned int port)
 {
 	struct rtk_ahci_priv *priv = hpriv->plat_data;
@@ -108,6 +356,7 @@ static void rtk_sata_host_ctrl(struct work_struct *work)
 	case INITIAL:
 		ahci_platform_init_host(pdev, priv->hpriv, &ahci_port_info,
 					&ahci_platform_sht);
+		rtk_ahci_ccc_apply(priv->hpriv);
 		priv->state = RUNNING;
 		break;
 	case RUNNING:
@@ -160,7 +409,9 @@ static int rtk_ahci_probe(struct platform_device *pdev)
 		return -ENODEV;
 	}
 	hpriv->plat_data = priv;
+	hpriv->irq_handler = rtk_ahci_irq_intr;
 	priv->hpriv = hpriv;
+	priv->ccc_tv = CCC_TV_DEFAULT;
 
 	priv->ports = devm_kcalloc(dev, hpriv->nports, sizeof(*priv->ports), GFP_KERNEL);
 	if (!priv->ports)
@@ -209,6 +460,7 @@ static int rtk_ahci_probe(struct platform_device *pdev)
 	if (priv->hostinit) {
 		ahci_platform_init_host(pdev, hpriv, &ahci_port_info,
 					&ahci_platform_sht);
+		rtk_ahci_ccc_apply(hpriv);
 		priv->state = RUNNING;
 	}
 
@@ -288,6 +540,9 @@ static int rtk_ahci_resume(struct device *dev)
 	if (rc)
 		return rc;
 
+	/* the controller reset on resume cleared CCC */
+	rtk_ahci_ccc_apply(hpriv);
+
 	/* We resumed so update PM runtime state */
 	pm_runtime_disable(dev);
 	pm_runtime_set_active(dev);
@@ -330,6 +585,7 @@ static struct platform_driver rtk_ahci_driver = {
 		.name = DRV_NAME,
 		.of_match_table = rtk_ahci_of_match,
 		.pm = DEV_PM_OPS,
+		.dev_groups = rtk_ahci_groups,
 	},
 };
 module_platform_driver(rtk_ahci_driver);
@@ -0,0 +1,476 @@
+// SPDX-License-Identifier: (GPL-2.0-or-later OR BSD-2-Clause)
+/*
+ * Software model of the Realtek MCP
+ *
+ * Registers an RTK_MCP platform device whose registers and descriptor ring
+ * are emulated in software, so that rtk-mcp can be bound and exercised by
+ * the crypto self-tests and tcrypt on a host without the hardware.
+ * Descriptors and buffers are reached through the DMA addresses the driver
+ * hands out, which only works with direct mapped, coherent DMA; the model
+ * refuses to load otherwise.
+ */
+
+#include <asm/unaligned.h>
+#include <crypto/aes.h>
+#include <crypto/algapi.h>
+#include <crypto/des.h>
+#include <crypto/hash.h>
+#include <crypto/sha1.h>
+#include <crypto/sha2.h>
+#include <linux/dma-direct.h>
+#include <linux/dma-map-ops.h>
+#include <linux/module.h>
+#include <linux/platform_device.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+
+#include "rtk-mcp.h"
+
+#define MODEL_REG_SIZE		0x200
+#define MODEL_KEY_SEL(x)	(((x) >> 12) & 0x3)
+
+struct rtk_mcp_model {
+	struct platform_device *pdev;
+	struct rtk_mcp_platform_data pdata;
+	spinlock_t lock;
+	u32 regs[MODEL_REG_SIZE / 4];
+	struct work_struct work;
+	struct crypto_shash *sha1;
+	struct crypto_shash *sha256;
+	struct crypto_shash *sha512;
+};
+
+struct rtk_mcp_model_key {
+	bool des;
+	union {
+		struct crypto_aes_ctx aes;
+		struct des_ctx des_ctx;
+	};
+};
+
+static struct rtk_mcp_model *model;
+
+static void *rtk_mcp_model_virt(struct rtk_mcp_model *m, u32 addr)
+{
+	return phys_to_virt(dma_to_phys(&m->pdev->dev, addr));
+}
+
+/* descriptor words hold the bytes most significant first */
+static void rtk_mcp_model_words(u8 *out, const u32 *words, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		put_unaligned_be32(words[i], out + i * 4);
+}
+
+static void rtk_mcp_model_block(const struct rtk_mcp_model_key *key, bool enc,
+				u8 *out, const u8 *in)
+{
+	if (key->des) {
+		if (enc)
+			des_encrypt(&key->des_ctx, out, in);
+		else
+			des_decrypt(&key->des_ctx, out, in);
+	} else {
+		if (enc)
+			aes_encrypt(&key->aes, out, in);
+		else
+			aes_decrypt(&key->aes, out, in);
+	}
+}
+
+static int rtk_mcp_model_cipher(struct rtk_mcp_model *m, const struct rtk_mcp_op *op,
+				const u8 *src, u8 *dst)
+{
+	bool enc = op->flags & MCP_ENC(1);
+	u8 raw[AES_KEYSIZE_256];
+	u8 iv[AES_BLOCK_SIZE];
+	u8 tmp[AES_BLOCK_SIZE];
+	struct rtk_mcp_model_key key = { 0 };
+	unsigned int keylen, bsize, off;
+	int ret = 0;
+
+	switch (MCP_MODE(op->flags)) {
+	case MCP_ALGO_DES:
+		keylen = DES_KEY_SIZE;
+		bsize = DES_BLOCK_SIZE;
+		key.des = true;
+		break;
+	case MCP_ALGO_AES:
+		keylen = AES_KEYSIZE_128;
+		bsize = AES_BLOCK_SIZE;
+		break;
+	case MCP_ALGO_AES_192:
+		keylen = AES_KEYSIZE_192;
+		bsize = AES_BLOCK_SIZE;
+		break;
+	default:
+		keylen = AES_KEYSIZE_256;
+		bsize = AES_BLOCK_SIZE;
+		break;
+	}
+
+	if (op->len % bsize)
+		return -EINVAL;
+
+	switch (MODEL_KEY_SEL(op->flags)) {
+	case MCP_KEY_SEL_DESC:
+		if (keylen > sizeof(op->key))
+			return -EINVAL;
+		rtk_mcp_model_words(raw, op->key, keylen / 4);
+		break;
+	case MCP_KEY_SEL_DDR:
+		memcpy(raw, rtk_mcp_model_virt(m, op->key[0]), keylen);
+		break;
+	default:
+		/* no OTP or CW keys in the model */
+		return -EOPNOTSUPP;
+	}
+
+	rtk_mcp_model_words(iv, op->iv, ARRAY_SIZE(op->iv));
+
+	if (key.des) {
+		ret = des_expand_key(&key.des_ctx, raw, keylen);
+		if (ret == -ENOKEY)
+			ret = 0;
+	} else {
+		ret = aes_expandkey(&key.aes, raw, keylen);
+	}
+	if (ret)
+		goto out;
+
+	for (off = 0; off < op->len; off += bsize) {
+		const u8 *in = src + off;
+		u8 *out = dst + off;
+
+		switch (MCP_GET_BCM(op->flags)) {
+		case MCP_BCM_ECB:
+			rtk_mcp_model_block(&key, enc, out, in);
+			break;
+		case MCP_BCM_CBC:
+			if (enc) {
+				crypto_xor_cpy(tmp, in, iv, bsize);
+				rtk_mcp_model_block(&key, true, out, tmp);
+				memcpy(iv, out, bsize);
+			} else {
+				memcpy(tmp, in, bsize);
+				rtk_mcp_model_block(&key, false, out, in);
+				crypto_xor(out, iv, bsize);
+				memcpy(iv, tmp, bsize);
+			}
+			break;
+		case MCP_BCM_CTR:
+			rtk_mcp_model_block(&key, true, tmp, iv);
+			crypto_xor_cpy(out, in, tmp, bsize);
+			crypto_inc(iv, bsize);
+			break;
+		default:
+			ret = -EOPNOTSUPP;
+			goto out;
+		}
+	}
+
+out:
+	memzero_explicit(&key, sizeof(key));
+	memzero_explicit(raw, sizeof(raw));
+
+	return ret;
+}
+
+/*
+ * The engine hashes whole blocks from the state in the descriptor, with
+ * auto padding disabled, and writes the new state out big endian.
+ */
+static int rtk_mcp_model_sha(struct rtk_mcp_model *m, const struct rtk_mcp_op *op,
+			     const u8 *src, u8 *dst)
+{
+	union {
+		struct sha1_state sha1;
+		struct sha256_state sha256;
+		struct sha512_state sha512;
+	} st = { 0 };
+	struct crypto_shash *tfm;
+	unsigned int bsize;
+	const u8 *p;
+	int i, ret;
+
+	switch (MCP_MODE(op->flags)) {
+	case MCP_ALGO_SHA_1:
+		tfm = m->sha1;
+		bsize = SHA1_BLOCK_SIZE;
+		for (i = 0; i < SHA1_DIGEST_SIZE/4; i++)
+			st.sha1.state[i] = op->key[i];
+		break;
+	case MCP_ALGO_SHA_256:
+		tfm = m->sha256;
+		bsize = SHA256_BLOCK_SIZE;
+		for (i = 0; i < ARRAY_SIZE(op->key); i++)
+			st.sha256.state[i] = op->key[i];
+		st.sha256.state[6] = op->iv[0];
+		st.sha256.state[7] = op->iv[1];
+		break;
+	default:
+		if (MODEL_KEY_SEL(op->flags) != MCP_KEY_SEL_DDR)
+			return -EOPNOTSUPP;
+		tfm = m->sha512;
+		bsize = SHA512_BLOCK_SIZE;
+		p = rtk_mcp_model_virt(m, op->key[0]);
+		for (i = 0; i < SHA512_DIGEST_SIZE/8; i++)
+			st.sha512.state[i] = get_unaligned_be64(p + i * 8);
+		break;
+	}
+
+	if (op->len % bsize)
+		return -EINVAL;
+
+	{
+		SHASH_DESC_ON_STACK(desc, tfm);
+
+		desc->tfm = tfm;
+		ret = crypto_shash_import(desc, &st) ?:
+		      crypto_shash_update(desc, src, op->len) ?:
+		      crypto_shash_export(desc, &st);
+		shash_desc_zero(desc);
+	}
+	if (ret)
+		return ret;
+
+	switch (MCP_MODE(op->flags)) {
+	case MCP_ALGO_SHA_1:
+		for (i = 0; i < SHA1_DIGEST_SIZE/4; i++)
+			put_unaligned_be32(st.sha1.state[i], dst + i * 4);
+		break;
+	case MCP_ALGO_SHA_256:
+		for (i = 0; i < SHA256_DIGEST_SIZE/4; i++)
+			put_unaligned_be32(st.sha256.state[i], dst + i * 4);
+		break;
+	default:
+		for (i = 0; i < SHA512_DIGEST_SIZE/8; i++)
+			put_unaligned_be64(st.sha512.state[i], dst + i * 8);
+		break;
+	}
+
+	return 0;
+}
+
+static int rtk_mcp_model_exec(struct rtk_mcp_model *m, const struct rtk_mcp_op *op)
+{
+	const u8 *src;
+	u8 *dst;
+
+	if (!op->len)
+		return 0;
+
+	src = rtk_mcp_model_virt(m, op->src);
+	dst = rtk_mcp_model_virt(m, op->dst);
+
+	switch (MCP_MODE(op->flags)) {
+	case MCP_ALGO_SHA_1:
+	case MCP_ALGO_SHA_256:
+	case MCP_ALGO_SHA_512:
+		return rtk_mcp_model_sha(m, op, src, dst);
+	case MCP_ALGO_DES:
+	case MCP_ALGO_AES:
+	case MCP_ALGO_AES_192:
+	case MCP_ALGO_AES_256:
+		return rtk_mcp_model_cipher(m, op, src, dst);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+/* runs the ring from rdptr to wrptr, like the engine does after go */
+static void rtk_mcp_model_work(struct work_struct *work)
+{
+	struct rtk_mcp_model *m = container_of(work, struct rtk_mcp_model, work);
+	struct device *dev = &m->pdev->dev;
+	u32 base, limit, rd, wr;
+	struct rtk_mcp_op op;
+	u32 status = MCP_RING_EMPTY;
+	int ret;
+
+	spin_lock_irq(&m->lock);
+	base = m->regs[MCP_BASE / 4];
+	limit = m->regs[MCP_LIMIT / 4];
+	rd = m->regs[MCP_RDPTR / 4];
+	wr = m->regs[MCP_WRPTR / 4];
+	spin_unlock_irq(&m->lock);
+
+	while (rd != wr) {
+		if (rd < base || rd + sizeof(op) > limit) {
+			dev_err(dev, "rdptr %08x outside ring %08x-%08x\n", rd, base, limit);
+			status = MCP_ERROR;
+			break;
+		}
+
+		memcpy(&op, rtk_mcp_model_virt(m, rd), sizeof(op));
+
+		ret = rtk_mcp_model_exec(m, &op);
+		if (ret) {
+			dev_err(dev, "descriptor %08x (flags %08x) failed: %d\n", rd, op.flags, ret);
+			status = MCP_ERROR;
+			break;
+		}
+
+		rd += sizeof(op);
+		if (rd + sizeof(op) > limit)
+			rd = base;
+	}
+
+	spin_lock_irq(&m->lock);
+	m->regs[MCP_RDPTR / 4] = rd;
+	m->regs[MCP_STATUS / 4] |= status;
+	m->regs[MCP_CTRL / 4] &= ~MCP_GO;
+	spin_unlock_irq(&m->lock);
+}
+
+/* bit 0 of the control and status registers says whether to set or clear */
+static u32 rtk_mcp_model_write_data(u32 old, u32 val)
+{
+	if (val & MCP_WRITE_DATA_1)
+		return old | (val & ~MCP_WRITE_DATA_1);
+
+	return old & ~val;
+}
+
+static u32 rtk_mcp_model_read(void *priv, unsigned int reg)
+{
+	struct rtk_mcp_model *m = priv;
+	unsigned long flags;
+	u32 val;
+
+	if (reg >= MODEL_REG_SIZE)
+		return 0;
+
+	spin_lock_irqsave(&m->lock, flags);
+	val = m->regs[reg / 4];
+	spin_unlock_irqrestore(&m->lock, flags);
+
+	return val;
+}
+
+static void rtk_mcp_model_write(void *priv, unsigned int reg, u32 val)
+{
+	struct rtk_mcp_model *m = priv;
+	unsigned long flags;
+	bool go = false;
+
+	if (reg >= MODEL_REG_SIZE)
+		return;
+
+	spin_lock_irqsave(&m->lock, flags);
+
+	switch (reg) {
+	case MCP_CTRL:
+		val = rtk_mcp_model_write_data(m->regs[reg / 4], val);
+		/* clear completes at once */
+		val &= ~MCP_CLEAR;
+		go = (val & MCP_GO) && !(m->regs[reg / 4] & MCP_GO);
+		break;
+	case MCP_STATUS:
+	case MCP_EN:
+		val = rtk_mcp_model_write_data(m->regs[reg / 4], val);
+		break;
+	}
+
+	m->regs[reg / 4] = val;
+
+	spin_unlock_irqrestore(&m->lock, flags);
+
+	if (go)
+		queue_work(system_unbound_wq, &m->work);
+}
+
+static int __init rtk_mcp_model_init(void)
+{
+	struct rtk_mcp_model *m;
+	int ret;
+
+	m = kzalloc(sizeof(*m), GFP_KERNEL);
+	if (!m)
+		return -ENOMEM;
+
+	spin_lock_init(&m->lock);
+	INIT_WORK(&m->work, rtk_mcp_model_work);
+
+	/* the exported state of the generic drivers is the plain sha*_state */
+	m->sha1 = crypto_alloc_shash("sha1-generic", 0, 0);
+	m->sha256 = crypto_alloc_shash("sha256-generic", 0, 0);
+	m->sha512 = crypto_alloc_shash("sha512-generic", 0, 0);
+	if (IS_ERR(m->sha1) || IS_ERR(m->sha256) || IS_ERR(m->sha512)) {
+		ret = -ENOENT;
+		goto err_free;
+	}
+
+	m->pdata.read = rtk_mcp_model_read;
+	m->pdata.write = rtk_mcp_model_write;
+	m->pdata.priv = m;
+
+	/* the driver may bind from platform_device_add(), set pdev up first */
+	m->pdev = platform_device_alloc("RTK_MCP", PLATFORM_DEVID_NONE);
+	if (!m->pdev) {
+		ret = -ENOMEM;
+		goto err_free;
+	}
+
+	ret = platform_device_add_data(m->pdev, &m->pdata, sizeof(m->pdata));
+	if (ret)
+		goto err_put;
+
+	ret = dma_coerce_mask_and_coherent(&m->pdev->dev, DMA_BIT_MASK(32));
+	if (ret)
+		goto err_put;
+
+	/*
+	 * rtk_mcp_model_virt() turns DMA addresses back into linear map
+	 * addresses: an IOMMU or dma_map_ops would hand out addresses that are
+	 * not physical, and on a non-coherent device the driver's coherent
+	 * buffers are uncached aliases the model would not see through.
+	 */
+	if (get_dma_ops(&m->pdev->dev) || !dev_is_dma_coherent(&m->pdev->dev)) {
+		dev_err(&m->pdev->dev, "needs direct mapped, coherent DMA\n");
+		ret = -ENODEV;
+		goto err_put;
+	}
+
+	model = m;
+
+	ret = platform_device_add(m->pdev);
+	if (ret)
+		goto err_put;
+
+	return 0;
+
+err_put:
+	model = NULL;
+	platform_device_put(m->pdev);
+err_free:
+	if (!IS_ERR_OR_NULL(m->sha512))
+		crypto_free_shash(m->sha512);
+	if (!IS_ERR_OR_NULL(m->sha256))
+		crypto_free_shash(m->sha256);
+	if (!IS_ERR_OR_NULL(m->sha1))
+		crypto_free_shash(m->sha1);
+	kfree(m);
+	return ret;
+}
+module_init(rtk_mcp_model_init);
+
+static void __exit rtk_mcp_model_exit(void)
+{
+	struct rtk_mcp_model *m = model;
+
+	platform_device_unregister(m->pdev);
+	cancel_work_sync(&m->work);
+
+	crypto_free_shash(m->sha512);
+	crypto_free_shash(m->sha256);
+	crypto_free_shash(m->sha1);
+	kfree(m);
+}
+module_exit(rtk_mcp_model_exit);
+
+MODULE_DESCRIPTION("Realtek MCP software model");
+MODULE_LICENSE("GPL");
@@ -7,32 +7,117 @@
 #include <crypto/aes.h>
 #include <crypto/algapi.h>
 #include <crypto/des.h>
+#include <crypto/engine.h>
+#include <crypto/internal/hash.h>
 #include <crypto/internal/skcipher.h>
+#include <crypto/scatterwalk.h>
 #include <crypto/sha1_base.h>
 #include <crypto/sha256_base.h>
 #include <crypto/sha512_base.h>
 #include <crypto/skcipher.h>
+#include <linux/completion.h>
 #include <linux/crypto.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/dma-mapping.h>
+#include <linux/interrupt.h>
 #include <linux/io.h>
+#include <linux/iopoll.h>
 #include <linux/kernel.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/of_address.h>
 #include <linux/of_platform.h>
 #include <linux/platform_device.h>
-#include <linux/spinlock.h>
+#include <linux/scatterlist.h>
+#include <linux/seq_file.h>
 #include <linux/sys_soc.h>
 
 #include "rtk-mcp.h"
 
+#define MCP_TIMEOUT_US		(4 * USEC_PER_SEC)
+#define MCP_DMA_ALIGN		16
+
+struct rtk_mcp_ctx {
+	u32 flags;
+	u32 key[6];
+	u32 key_256[AES_KEYSIZE_256/4];
+};
+
+struct rtk_mcp_reqctx {
+	u32 mode;
+};
+
+struct rtk_mcp_hash_ctx {
+	struct crypto_shash *fallback;
+	unsigned int fallback_len;
+};
+
+#define RTK_MCP_HASH_UPDATE	BIT(0)
+#define RTK_MCP_HASH_FINAL	BIT(1)
+
+struct rtk_mcp_hash_reqctx {
+	u32 op;
+	char hw[sizeof(struct shash_desc) + sizeof(struct sha512_state)] CRYPTO_MINALIGN_ATTR;
+	/* must be last, the fallback's descsize follows */
+	struct shash_desc fallback;
+};
+
+struct rtk_mcp_ahash_alg {
+	struct ahash_engine_alg alg;
+	int (*hw_init)(struct shash_desc *desc);
+	int (*hw_update)(struct shash_desc *desc, const u8 *data, unsigned int len);
+	int (*hw_final)(struct shash_desc *desc, u8 *out);
+};
+
+struct rtk_mcp_sg_cursor {
+	struct scatterlist *sg;
+	int nents;
+	unsigned int off;
+};
+
 /* Static structures */
-static u32 aes_256_key[AES_KEYSIZE_256/4];
 struct platform_device *mcp_pdev;
 static void __iomem *mcp_iobase;
-static spinlock_t lock;
+static const struct rtk_mcp_platform_data *mcp_pdata;
+static DEFINE_MUTEX(mcp_lock);
 static int chip_id;
 
+static struct crypto_engine *mcp_engine;
+static struct rtk_mcp_op *mcp_ring;
+static dma_addr_t mcp_ring_dma;
+static int mcp_irq;
+static DECLARE_COMPLETION(mcp_done);
+
+/* only used from the crypto engine kthread */
+static struct rtk_mcp_op mcp_batch[MCP_DESC_ENTRY_COUNT];
+static struct dentry *mcp_debugfs;
+static u64 mcp_sg_requests;
+static u64 mcp_bounce_requests;
+static u8 *mcp_hash_out;
+static dma_addr_t mcp_hash_dma;
+static int mcp_hash_err;
+
+static unsigned int hash_fallback_len = 512;
+module_param(hash_fallback_len, uint, 0644);
+MODULE_PARM_DESC(hash_fallback_len, "Hash requests shorter than this many bytes run on the CPU");
+
+static u32 mcp_read(unsigned int reg)
+{
+	if (mcp_pdata)
+		return mcp_pdata->read(mcp_pdata->priv, reg);
+
+	return ioread32(mcp_iobase + reg);
+}
+
+static void mcp_write(u32 val, unsigned int reg)
+{
+	if (mcp_pdata)
+		mcp_pdata->write(mcp_pdata->priv, reg, val);
+	else
+		iowrite32(val, mcp_iobase + reg);
+}
+
 static void setup_chip_id(void)
 {
 	const struct soc_device_attribute *match = NULL;
@@ -49,130 +134,151 @@ static void setup_chip_id(void)
 		chip_id = (unsigned long)match->data;
 }
 
-static unsigned int rtk_mcp_crypt(struct rtk_mcp_op *op)
+static irqreturn_t rtk_mcp_irq(int irq, void *dev_id)
 {
-	struct rtk_mcp_op *p_desc_vptr;
-	int counter2 = 0x3ff << 2;
-	dma_addr_t p_desc_ptr;
-	unsigned long iflags;
-	int counter1 = 30;
-	u32 status;
-	int ret;
+	u32 status = mcp_read(MCP_STATUS);
 
-	if (op->len == 0)
-		return 0;
+	if (!(status & MCP_INT_MASK))
+		return IRQ_NONE;
+
+	/* mask until the next command, the status is checked by the waiter */
+	mcp_write(0xfe, MCP_EN);
+	complete(&mcp_done);
 
-	/* Start the critical section */
-	spin_lock_irqsave(&lock, iflags);
+	return IRQ_HANDLED;
+}
 
-	p_desc_vptr = dma_alloc_coherent(&mcp_pdev->dev,
-					 sizeof(struct rtk_mcp_op),
-					 &p_desc_ptr,
-					 GFP_ATOMIC|GFP_DMA);
+static int rtk_mcp_wait(void)
+{
+	u32 status;
 
-	if (!p_desc_vptr) {
-		pr_err("%s dmalloc error !\n", __func__);
-		spin_unlock_irqrestore(&lock, iflags);
+	if (mcp_irq > 0) {
+		if (!wait_for_completion_timeout(&mcp_done, usecs_to_jiffies(MCP_TIMEOUT_US)))
+			return -ETIMEDOUT;
 		return 0;
 	}
 
-	p_desc_vptr->flags = op->flags;
-	memcpy(p_desc_vptr->key, op->key, sizeof(p_desc_vptr->key));
-	memcpy(p_desc_vptr->iv, op->iv, sizeof(p_desc_vptr->iv));
-	p_desc_vptr->src = op->src;
-	p_desc_vptr->dst = op->dst;
-	p_desc_vptr->len = op->len;
+	return read_poll_timeout(mcp_read, status,
+				 (status & MCP_INT_MASK) ||
+				 !(mcp_read(MCP_CTRL) & MCP_GO),
+				 10, MCP_TIMEOUT_US, false, MCP_STATUS);
+}
 
-	iowrite32(p_desc_ptr, mcp_iobase + MCP_BASE);
-	iowrite32(p_desc_ptr + sizeof(struct rtk_mcp_op) + sizeof(struct rtk_mcp_op), mcp_iobase + MCP_LIMIT);
-	iowrite32(p_desc_ptr, mcp_iobase + MCP_RDPTR);
-	iowrite32(p_desc_ptr + sizeof(struct rtk_mcp_op), mcp_iobase + MCP_WRPTR);
+/*
+ * Run @count descriptors through the preallocated ring and sleep until the
+ * engine drains it. Only called from the crypto engine kthread: ciphers
+ * and hashes are both queued there, a shash update may run in atomic
+ * context and must never get here.
+ */
+static int rtk_mcp_run(const struct rtk_mcp_op *ops, int count)
+{
+	size_t size = count * sizeof(*ops);
+	int counter = 30;
+	u32 status;
+	int ret;
+
+	might_sleep();
+
+	if (count <= 0 || count > MCP_DESC_ENTRY_COUNT)
+		return -EINVAL;
+
+	mutex_lock(&mcp_lock);
 
-	iowrite32(0x0, mcp_iobase + MCP_DES_COUNT);
-	iowrite32(MCP_CLEAR | MCP_WRITE_DATA_1, mcp_iobase + MCP_CTRL);
+	memcpy(mcp_ring, ops, size);
+	/* descriptors must be visible before the engine fetches them */
+	wmb();
+
+	mcp_write(mcp_ring_dma, MCP_BASE);
+	mcp_write(mcp_ring_dma + size + sizeof(*ops), MCP_LIMIT);
+	mcp_write(mcp_ring_dma, MCP_RDPTR);
+	mcp_write(mcp_ring_dma + size, MCP_WRPTR);
+
+	mcp_write(0x0, MCP_DES_COUNT);
+	mcp_write(MCP_CLEAR | MCP_WRITE_DATA_1, MCP_CTRL);
 
 	do {
-		status = ioread32(mcp_iobase + MCP_CTRL);
+		status = mcp_read(MCP_CTRL);
 		cpu_relax();
-	} while ((status & MCP_CLEAR) && --counter1);
+	} while ((status & MCP_CLEAR) && --counter);
 
 	if (status & MCP_CLEAR) {
 		/* write 0 to unset clear bit*/
-		iowrite32(MCP_CLEAR, mcp_iobase + MCP_CTRL);
+		mcp_write(MCP_CLEAR, MCP_CTRL);
 	}
 
-	iowrite32(0xfe, mcp_iobase + MCP_EN);
-	iowrite32(0xfe, mcp_iobase + MCP_STATUS);
+	mcp_write(0xfe, MCP_EN);
+	mcp_write(0xfe, MCP_STATUS);
 
-	iowrite32(MCP_GO | MCP_WRITE_DATA_1, mcp_iobase + MCP_CTRL);
+	if (mcp_irq > 0) {
+		reinit_completion(&mcp_done);
+		mcp_write(MCP_INT_MASK | MCP_WRITE_DATA_1, MCP_EN);
+	}
 
-	do {
-		status = ioread32(mcp_iobase + MCP_CTRL);
-		if (!(status & MCP_GO)) {
-			pr_err("ctrl break\n");
-			break;
-		}
-		status = ioread32(mcp_iobase + MCP_STATUS);
-		if (status & 0x6) {
-			pr_err("status break\n");
-			break;
-		}
-		/* will set as msleep afte test from probe*/
-		mdelay(1);
-	} while (--counter2);
+	mcp_write(MCP_GO | MCP_WRITE_DATA_1, MCP_CTRL);
 
+	ret = rtk_mcp_wait();
+
+	mcp_write(0xfe, MCP_EN);
+
+	status = mcp_read(MCP_STATUS);
 	if (chip_id == CHIP_ID_RTD1295 || chip_id == CHIP_ID_RTD1395)
-		ret = (ioread32(mcp_iobase + MCP_STATUS) & ~(MCP_RING_EMPTY | MCP_COMPARE)) ? -1 : 0;
+		status &= ~(MCP_RING_EMPTY | MCP_COMPARE);
 	else
-		ret = (ioread32(mcp_iobase + MCP_STATUS) & ~(MCP_RING_EMPTY | MCP_COMPARE | MCP_KL_DONE | MCP_K_KL_DONE)) ? -1 : 0;
-
-	if (ret < 0) {
-		pr_err("do mcp command failed, (MCP_Status %08x)\n", ioread32(mcp_iobase + MCP_STATUS));
+		status &= ~(MCP_RING_EMPTY | MCP_COMPARE | MCP_KL_DONE | MCP_K_KL_DONE);
 
-		ret = 0;
-		goto error;
+	if (ret || status) {
+		pr_err("do mcp command failed, (MCP_Status %08x)\n", mcp_read(MCP_STATUS));
+		if (!ret)
+			ret = -EIO;
 	}
 
-	iowrite32(MCP_GO, mcp_iobase + MCP_CTRL);
-	iowrite32(0xfe, mcp_iobase + MCP_STATUS);
+	mcp_write(MCP_GO, MCP_CTRL);
+	mcp_write(0xfe, MCP_STATUS);
 
-	ret = op->len;
-error:
-
-	dma_free_coherent(&mcp_pdev->dev, sizeof(struct rtk_mcp_op), (void *)p_desc_vptr, p_desc_ptr);
-	spin_unlock_irqrestore(&lock, iflags);
+	mutex_unlock(&mcp_lock);
 
 	return ret;
 }
 
+static unsigned int rtk_mcp_crypt(struct rtk_mcp_op *op)
+{
+	if (op->len == 0)
+		return 0;
+
+	return rtk_mcp_run(op, 1) ? 0 : op->len;
+}
+
 static int rtk_setkey_blk(struct crypto_skcipher *tfm, const u8 *key, unsigned int len)
 {
-	struct rtk_mcp_op *op = crypto_skcipher_ctx(tfm);
+	struct rtk_mcp_ctx *ctx = crypto_skcipher_ctx(tfm);
 	int i;
 
 	if (key == NULL) {
-		op->flags = MCP_KEY_SEL(MCP_KEY_SEL_OTP);
+		ctx->flags = MCP_KEY_SEL(MCP_KEY_SEL_OTP);
 		return 0;
 	}
 
 	if (len == AES_KEYSIZE_256) {
 		/* special handling */
 		for (i = 0; i < len/4; i++)
-			aes_256_key[i] = *((const u32 *)key + i);
+			ctx->key_256[i] = *((const u32 *)key + i);
 
-		for (i = 0; i < sizeof(op->key)/4; i++)
-			op->key[i] = 0;
+		for (i = 0; i < sizeof(ctx->key)/4; i++)
+			ctx->key[i] = 0;
 
-		op->flags = MCP_ALGO_AES_256 | MCP_KEY_SEL(MCP_KEY_SEL_DDR);
+		ctx->flags = MCP_ALGO_AES_256 | MCP_KEY_SEL(MCP_KEY_SEL_DDR);
 	} else {
+		if (len != AES_KEYSIZE_128 && len != AES_KEYSIZE_192)
+			return -EINVAL;
+
 		for (i = 0; i < len/4; i++)
-			op->key[i] = cpu_to_be32(*((const u32 *)key + i));
+			ctx->key[i] = cpu_to_be32(*((const u32 *)key + i));
 
 		if (len == AES_KEYSIZE_128)
-			op->flags = MCP_ALGO_AES;
+			ctx->flags = MCP_ALGO_AES;
 
 		if (len == AES_KEYSIZE_192)
-			op->flags = MCP_ALGO_AES_192;
+			ctx->flags = MCP_ALGO_AES_192;
 	}
 
 	return 0;
@@ -180,36 +286,28 @@ static int rtk_setkey_blk(struct crypto_skcipher *tfm, const u8 *key, unsigned i
 
 static void rtk_sha1_transform(struct sha1_state *sctx, u8 *src, int blocks)
 {
-	unsigned char *dma_vaddr;
-	struct rtk_mcp_op *op;
-	dma_addr_t dma_paddr;
-	int i, ret;
-
-	op = kzalloc(sizeof(*op), GFP_KERNEL);
-	if (!op)
-		return;
+	struct device *dev = &mcp_pdev->dev;
+	struct rtk_mcp_op op = { 0 };
+	int i;
 
-	op->flags = MCP_ALGO_SHA_1;
-	op->src = dma_map_single(&mcp_pdev->dev, src, blocks * SHA1_BLOCK_SIZE, DMA_TO_DEVICE);
-	dma_vaddr = dma_alloc_coherent(&mcp_pdev->dev, SHA1_DIGEST_SIZE, &dma_paddr, GFP_ATOMIC|GFP_DMA);
-	op->dst = dma_paddr;
+	op.flags = MCP_ALGO_SHA_1;
+	op.src = dma_map_single(dev, src, blocks * SHA1_BLOCK_SIZE, DMA_TO_DEVICE);
+	op.dst = mcp_hash_dma;
 
 	for (i = 0; i < SHA1_DIGEST_SIZE/4; i++)
-		op->key[i] = (*((const u32 *)sctx->state + i));
+		op.key[i] = (*((const u32 *)sctx->state + i));
 
-	op->len = blocks * SHA1_BLOCK_SIZE;
+	op.len = blocks * SHA1_BLOCK_SIZE;
 
 	/* disable auto padding */
-	iowrite32(0x800, mcp_iobase + MCP_CTRL1);
-	ret = rtk_mcp_crypt(op);
-
-	for (i = 0; i < SHA1_DIGEST_SIZE/4; i++)
-		sctx->state[i] = cpu_to_be32(*((const u32 *)dma_vaddr + i));
+	mcp_write(0x800, MCP_CTRL1);
+	if (!rtk_mcp_crypt(&op))
+		mcp_hash_err = -EIO;
 
-	dma_free_coherent(&mcp_pdev->dev, SHA1_DIGEST_SIZE, (void *)dma_vaddr, dma_paddr);
-	dma_unmap_single(&mcp_pdev->dev, op->src, blocks * SHA1_BLOCK_SIZE, DMA_TO_DEVICE);
+	dma_unmap_single(dev, op.src, blocks * SHA1_BLOCK_SIZE, DMA_TO_DEVICE);
 
-	kfree(op);
+	for (i = 0; i < SHA1_DIGEST_SIZE/4; i++)
+		sctx->state[i] = cpu_to_be32(*((const u32 *)mcp_hash_out + i));
 }
 
 static int rtk_sha1_update(struct shash_desc *desc, const u8 *data, unsigned int len)
@@ -223,64 +321,33 @@ static int rtk_sha1_final(struct shash_desc *desc, u8 *out)
 	return sha1_base_finish(desc, out);
 }
 
-static int rtk_sha1_finup(struct shash_desc *desc, const u8 *data,
-			unsigned int len, u8 *hash)
-{
-	sha1_base_do_update(desc, data, len, (sha1_block_fn *)rtk_sha1_transform);
-	return rtk_sha1_final(desc, hash);
-}
-
-static struct shash_alg rtk_sha1_alg = {
-	.digestsize	= SHA1_DIGEST_SIZE,
-	.init		= sha1_base_init,
-	.update		= rtk_sha1_update,
-	.final		= rtk_sha1_final,
-	.finup		= rtk_sha1_finup,
-	.descsize	= sizeof(struct sha1_state),
-	.base = {
-		.cra_name		= "sha1",
-		.cra_driver_name	= "__driver_sha1-rtk",
-		.cra_flags		= CRYPTO_ALG_TYPE_SHASH,
-		.cra_blocksize		= SHA1_BLOCK_SIZE,
-		.cra_module		= THIS_MODULE,
-	}
-};
-
 static void rtk_sha256_transform(struct sha256_state *sctx, u8 *src, int blocks)
 {
-	unsigned char *dma_vaddr;
-	struct rtk_mcp_op *op;
-	dma_addr_t dma_paddr;
-	int i, ret;
-
-	op = kzalloc(sizeof(*op), GFP_KERNEL);
-	if (!op)
-		return;
+	struct device *dev = &mcp_pdev->dev;
+	struct rtk_mcp_op op = { 0 };
+	int i;
 
-	op->flags = MCP_ALGO_SHA_256;
-	op->src = dma_map_single(&mcp_pdev->dev, src, blocks * SHA256_BLOCK_SIZE, DMA_TO_DEVICE);
-	dma_vaddr = dma_alloc_coherent(&mcp_pdev->dev, SHA256_DIGEST_SIZE, &dma_paddr, GFP_ATOMIC|GFP_DMA);
-	op->dst = dma_paddr;
+	op.flags = MCP_ALGO_SHA_256;
+	op.src = dma_map_single(dev, src, blocks * SHA256_BLOCK_SIZE, DMA_TO_DEVICE);
+	op.dst = mcp_hash_dma;
 
-	for (i = 0; i < sizeof(op->key)/4; i++)
-		op->key[i] = (*((const u32 *)sctx->state + i));
+	for (i = 0; i < sizeof(op.key)/4; i++)
+		op.key[i] = (*((const u32 *)sctx->state + i));
 
-	op->iv[0] = (*((const u32 *)sctx->state + sizeof(op->key)/4));
-	op->iv[1] = (*((const u32 *)sctx->state + sizeof(op->key)/4 + 1));
+	op.iv[0] = (*((const u32 *)sctx->state + sizeof(op.key)/4));
+	op.iv[1] = (*((const u32 *)sctx->state + sizeof(op.key)/4 + 1));
 
-	op->len = blocks * SHA256_BLOCK_SIZE;
+	op.len = blocks * SHA256_BLOCK_SIZE;
 
 	/* disable auto padding */
-	iowrite32(0x800, mcp_iobase + MCP_CTRL1);
-	ret = rtk_mcp_crypt(op);
-
-	for (i = 0; i < SHA256_DIGEST_SIZE/4; i++)
-		sctx->state[i] = cpu_to_be32(*((const u32 *)dma_vaddr + i));
+	mcp_write(0x800, MCP_CTRL1);
+	if (!rtk_mcp_crypt(&op))
+		mcp_hash_err = -EIO;
 
-	dma_free_coherent(&mcp_pdev->dev, SHA256_DIGEST_SIZE, (void *)dma_vaddr, dma_paddr);
-	dma_unmap_single(&mcp_pdev->dev, op->src, blocks * SHA256_BLOCK_SIZE, DMA_TO_DEVICE);
+	dma_unmap_single(dev, op.src, blocks * SHA256_BLOCK_SIZE, DMA_TO_DEVICE);
 
-	kfree(op);
+	for (i = 0; i < SHA256_DIGEST_SIZE/4; i++)
+		sctx->state[i] = cpu_to_be32(*((const u32 *)mcp_hash_out + i));
 }
 
 static int rtk_sha256_update(struct shash_desc *desc, const u8 *data,
@@ -295,63 +362,32 @@ static int rtk_sha256_final(struct shash_desc *desc, u8 *out)
 	return sha256_base_finish(desc, out);
 }
 
-static int rtk_sha256_finup(struct shash_desc *desc, const u8 *data, unsigned int len, u8 *hash)
-{
-	sha256_base_do_update(desc, data, len, (sha256_block_fn *)rtk_sha256_transform);
-	return rtk_sha256_final(desc, hash);
-}
-
-static struct shash_alg rtk_sha256_alg = {
-	.digestsize	= SHA256_DIGEST_SIZE,
-	.init		= sha256_base_init,
-	.update		= rtk_sha256_update,
-	.final		= rtk_sha256_final,
-	.finup		= rtk_sha256_finup,
-	.descsize	= sizeof(struct sha256_state),
-	.base = {
-		.cra_name		= "sha256",
-		.cra_driver_name	= "__driver_sha256-rtk",
-		.cra_flags		= CRYPTO_ALG_TYPE_SHASH,
-		.cra_blocksize		= SHA256_BLOCK_SIZE,
-		.cra_module		= THIS_MODULE,
-	}
-};
-
 static void rtk_sha512_transform(struct sha512_state *sctx, u8 *src, int blocks)
 {
-	unsigned char *dma_vaddr;
-	struct rtk_mcp_op *op;
-	dma_addr_t dma_paddr;
-	int i, ret;
+	struct device *dev = &mcp_pdev->dev;
+	struct rtk_mcp_op op = { 0 };
+	int i;
 
-	op = kzalloc(sizeof(*op), GFP_KERNEL);
-	if (!op)
-		return;
-
-	op->flags = MCP_ALGO_SHA_512 | MCP_KEY_SEL(MCP_KEY_SEL_DDR);
-	op->src = dma_map_single(&mcp_pdev->dev, src, blocks * SHA512_BLOCK_SIZE, DMA_TO_DEVICE);
-	dma_vaddr = dma_alloc_coherent(&mcp_pdev->dev, SHA512_DIGEST_SIZE, &dma_paddr, GFP_ATOMIC|GFP_DMA);
-	op->dst = dma_paddr;
+	op.flags = MCP_ALGO_SHA_512 | MCP_KEY_SEL(MCP_KEY_SEL_DDR);
+	op.src = dma_map_single(dev, src, blocks * SHA512_BLOCK_SIZE, DMA_TO_DEVICE);
+	op.dst = mcp_hash_dma;
 
 	for (i = 0; i < SHA512_DIGEST_SIZE/8; i++)
 		sctx->state[i] = cpu_to_be64(sctx->state[i]);
 
-	op->key[0] = dma_map_single(&mcp_pdev->dev, sctx->state, SHA512_DIGEST_SIZE, DMA_TO_DEVICE);
-	op->len = blocks * SHA512_BLOCK_SIZE;
+	op.key[0] = dma_map_single(dev, sctx->state, SHA512_DIGEST_SIZE, DMA_TO_DEVICE);
+	op.len = blocks * SHA512_BLOCK_SIZE;
 
 	/* disable auto padding */
-	iowrite32(0x800, mcp_iobase + MCP_CTRL1);
-	ret = rtk_mcp_crypt(op);
+	mcp_write(0x800, MCP_CTRL1);
+	if (!rtk_mcp_crypt(&op))
+		mcp_hash_err = -EIO;
 
-	dma_unmap_single(&mcp_pdev->dev, op->key[0], SHA512_DIGEST_SIZE, DMA_TO_DEVICE);
-	dma_unmap_single(&mcp_pdev->dev, op->src, blocks * SHA512_BLOCK_SIZE, DMA_TO_DEVICE);
+	dma_unmap_single(dev, op.key[0], SHA512_DIGEST_SIZE, DMA_TO_DEVICE);
+	dma_unmap_single(dev, op.src, blocks * SHA512_BLOCK_SIZE, DMA_TO_DEVICE);
 
 	for (i = 0; i < SHA512_DIGEST_SIZE/8; i++)
-		sctx->state[i] = cpu_to_be64(*((const u64 *)dma_vaddr + i));
-
-	dma_free_coherent(&mcp_pdev->dev, SHA512_DIGEST_SIZE, (void *)dma_vaddr, dma_paddr);
-
-	kfree(op);
+		sctx->state[i] = cpu_to_be64(*((const u64 *)mcp_hash_out + i));
 }
 
 static int rtk_sha512_update(struct shash_desc *desc, const u8 *data, unsigned int len)
@@ -365,436 +401,897 @@ static int rtk_sha512_final(struct shash_desc *desc, u8 *out)
 	return sha512_base_finish(desc, out);
 }
 
-static int rtk_sha512_finup(struct shash_desc *desc, const u8 *data, unsigned int len, u8 *hash)
+static struct rtk_mcp_ahash_alg *to_rtk_mcp_ahash_alg(struct crypto_ahash *tfm)
 {
-	sha512_base_do_update(desc, data, len, (sha512_block_fn *)rtk_sha512_transform);
-	return rtk_sha512_final(desc, hash);
+	return container_of(crypto_ahash_tfm(tfm)->__crt_alg,
+			    struct rtk_mcp_ahash_alg, alg.base.halg.base);
 }
 
-static struct shash_alg rtk_sha512_alg = {
-	.digestsize	= SHA512_DIGEST_SIZE,
-	.init		= sha512_base_init,
-	.update		= rtk_sha512_update,
-	.final		= rtk_sha512_final,
-	.finup		= rtk_sha512_finup,
-	.descsize	= sizeof(struct sha512_state),
-	.base = {
-		.cra_name		= "sha512",
-		.cra_driver_name	= "__driver_sha512-rtk",
-		.cra_flags		= CRYPTO_ALG_TYPE_SHASH,
-		.cra_blocksize		= SHA512_BLOCK_SIZE,
-		.cra_module		= THIS_MODULE,
-	}
-};
-
-static int rtk_des_setkey_blk(struct crypto_skcipher *tfm, const u8 *key, unsigned int len)
+/*
+ * The hardware state is kept in a shash_desc shaped buffer so that the
+ * sha*_base helpers can drive it; its context is the generic sha*_state,
+ * which is also the export format shared with the CPU fallback. The
+ * fallback tfm stands in for the shash so that sha*_base_finish() sees
+ * the right digest size (e.g. sha224 vs sha256).
+ */
+static struct shash_desc *rtk_mcp_hw_desc(struct ahash_request *req)
 {
-	struct rtk_mcp_op *op = crypto_skcipher_ctx(tfm);
-	int i;
+	struct rtk_mcp_hash_ctx *ctx = crypto_ahash_ctx(crypto_ahash_reqtfm(req));
+	struct rtk_mcp_hash_reqctx *rctx = ahash_request_ctx(req);
+	struct shash_desc *hw = (struct shash_desc *)rctx->hw;
 
-	if (key == NULL) {
-		op->flags = MCP_KEY_SEL(MCP_KEY_SEL_OTP);
-		return 0;
+	hw->tfm = ctx->fallback;
+
+	return hw;
+}
+
+static int rtk_mcp_hash_init_tfm(struct crypto_ahash *tfm)
+{
+	struct rtk_mcp_hash_ctx *ctx = crypto_ahash_ctx(tfm);
+	const char *name = crypto_tfm_alg_name(crypto_ahash_tfm(tfm));
+
+	ctx->fallback = crypto_alloc_shash(name, 0, CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback))
+		return PTR_ERR(ctx->fallback);
+
+	/*
+	 * The hardware state is handed to the fallback and exported as a
+	 * plain sha*_state. An accelerated fallback may keep a different
+	 * state; use the generic one then, which always matches.
+	 */
+	if (crypto_shash_statesize(ctx->fallback) != crypto_ahash_statesize(tfm)) {
+		char generic[CRYPTO_MAX_ALG_NAME];
+
+		crypto_free_shash(ctx->fallback);
+		snprintf(generic, sizeof(generic), "%s-generic", name);
+		ctx->fallback = crypto_alloc_shash(generic, 0, 0);
+		if (IS_ERR(ctx->fallback))
+			return PTR_ERR(ctx->fallback);
+		if (crypto_shash_statesize(ctx->fallback) != crypto_ahash_statesize(tfm)) {
+			crypto_free_shash(ctx->fallback);
+			return -EINVAL;
+		}
 	}
 
-	op->flags = 0;
+	ctx->fallback_len = READ_ONCE(hash_fallback_len);
 
-	for (i = 0; i < len/4; i++)
-		op->key[i] = cpu_to_be32(*((const u32 *)key + i));
+	crypto_ahash_set_reqsize(tfm, sizeof(struct rtk_mcp_hash_reqctx) +
+				 crypto_shash_descsize(ctx->fallback));
 
 	return 0;
 }
 
-static int rtk_des_ecb_decrypt(struct skcipher_request *req)
+static void rtk_mcp_hash_exit_tfm(struct crypto_ahash *tfm)
 {
-	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(req);
-	struct rtk_mcp_op *op = crypto_skcipher_ctx(tfm);
-	struct skcipher_walk walk;
-	unsigned char *dma_vaddr;
-	dma_addr_t dma_paddr;
-	unsigned int nbytes;
-	int i, err, ret;
+	struct rtk_mcp_hash_ctx *ctx = crypto_ahash_ctx(tfm);
 
-	err = skcipher_walk_virt(&walk, req, false);
-
-	for (i = 0; i < sizeof(op->iv)/4; i++)
-		op->iv[i] = cpu_to_be32(*((const u32 *)walk.iv + i));
+	crypto_free_shash(ctx->fallback);
+}
 
-	while ((nbytes = walk.nbytes) != 0) {
-		op->len = nbytes - (nbytes % DES_BLOCK_SIZE);
-		op->src = dma_map_single(&mcp_pdev->dev, walk.src.virt.addr, op->len, DMA_TO_DEVICE);
-		dma_vaddr = dma_alloc_coherent(&mcp_pdev->dev, op->len, &dma_paddr, GFP_ATOMIC|GFP_DMA);
-		op->dst = dma_paddr;
-		op->flags = DES_ECB_DEC;
+static int rtk_mcp_hash_init(struct ahash_request *req)
+{
+	struct rtk_mcp_ahash_alg *alg = to_rtk_mcp_ahash_alg(crypto_ahash_reqtfm(req));
+	struct rtk_mcp_hash_reqctx *rctx = ahash_request_ctx(req);
 
-		ret = rtk_mcp_crypt(op);
-		nbytes -= ret;
+	rctx->op = 0;
 
-		err = skcipher_walk_done(&walk, nbytes);
+	return alg->hw_init(rtk_mcp_hw_desc(req));
+}
 
-		memcpy(walk.dst.virt.addr, dma_vaddr, op->len);
-		dma_free_coherent(&mcp_pdev->dev, op->len, (void *)dma_vaddr, dma_paddr);
-		dma_unmap_single(&mcp_pdev->dev, op->src, op->len, DMA_TO_DEVICE);
+static int rtk_mcp_hash_cpu(struct ahash_request *req)
+{
+	struct rtk_mcp_hash_ctx *ctx = crypto_ahash_ctx(crypto_ahash_reqtfm(req));
+	struct rtk_mcp_hash_reqctx *rctx = ahash_request_ctx(req);
+	struct shash_desc *hw = rtk_mcp_hw_desc(req);
+	struct shash_desc *desc = &rctx->fallback;
+	int err;
+
+	desc->tfm = ctx->fallback;
+
+	err = crypto_shash_import(desc, shash_desc_ctx(hw));
+	if (err)
+		return err;
+
+	switch (rctx->op) {
+	case RTK_MCP_HASH_UPDATE:
+		err = shash_ahash_update(req, desc);
+		if (!err)
+			err = crypto_shash_export(desc, shash_desc_ctx(hw));
+		return err;
+	case RTK_MCP_HASH_FINAL:
+		return crypto_shash_final(desc, req->result);
+	default:
+		return shash_ahash_finup(req, desc);
 	}
+}
 
-	return err;
+static int rtk_mcp_hash_queue(struct ahash_request *req, u32 op)
+{
+	struct crypto_ahash *tfm = crypto_ahash_reqtfm(req);
+	struct rtk_mcp_hash_ctx *ctx = crypto_ahash_ctx(tfm);
+	struct rtk_mcp_hash_reqctx *rctx = ahash_request_ctx(req);
+	unsigned int len = 0;
+
+	rctx->op = op;
+
+	if (op & RTK_MCP_HASH_UPDATE)
+		len += req->nbytes;
+	/* final pads and hashes the buffered tail, one or two blocks */
+	if (op & RTK_MCP_HASH_FINAL)
+		len += crypto_ahash_blocksize(tfm);
+
+	/* the engine round trip costs more than hashing a short request here */
+	if (len < ctx->fallback_len)
+		return rtk_mcp_hash_cpu(req);
+
+	return crypto_transfer_hash_request_to_engine(mcp_engine, req);
 }
 
-static int rtk_des_ecb_encrypt(struct skcipher_request *req)
+static int rtk_mcp_hash_update(struct ahash_request *req)
 {
-	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(req);
-	struct rtk_mcp_op *op = crypto_skcipher_ctx(tfm);
-	struct skcipher_walk walk;
-	unsigned char *dma_vaddr;
-	dma_addr_t dma_paddr;
-	unsigned int nbytes;
-	int i, err, ret;
+	return rtk_mcp_hash_queue(req, RTK_MCP_HASH_UPDATE);
+}
 
-	err = skcipher_walk_virt(&walk, req, false);
+static int rtk_mcp_hash_final(struct ahash_request *req)
+{
+	return rtk_mcp_hash_queue(req, RTK_MCP_HASH_FINAL);
+}
 
-	for (i = 0; i < sizeof(op->iv)/4; i++)
-		op->iv[i] = cpu_to_be32(*((const u32 *)walk.iv + i));
+static int rtk_mcp_hash_finup(struct ahash_request *req)
+{
+	return rtk_mcp_hash_queue(req, RTK_MCP_HASH_UPDATE | RTK_MCP_HASH_FINAL);
+}
 
-	while ((nbytes = walk.nbytes) != 0) {
-		op->len = nbytes - (nbytes % DES_BLOCK_SIZE);
-		op->src = dma_map_single(&mcp_pdev->dev, walk.src.virt.addr, op->len, DMA_TO_DEVICE);
-		dma_vaddr = dma_alloc_coherent(&mcp_pdev->dev, op->len, &dma_paddr, GFP_ATOMIC|GFP_DMA);
-		op->dst = dma_paddr;
-		op->flags = DES_ECB_ENC;
+static int rtk_mcp_hash_digest(struct ahash_request *req)
+{
+	return rtk_mcp_hash_init(req) ?: rtk_mcp_hash_finup(req);
+}
 
-		ret = rtk_mcp_crypt(op);
-		nbytes -= ret;
+static int rtk_mcp_hash_export(struct ahash_request *req, void *out)
+{
+	memcpy(out, shash_desc_ctx(rtk_mcp_hw_desc(req)),
+	       crypto_ahash_statesize(crypto_ahash_reqtfm(req)));
 
-		err = skcipher_walk_done(&walk, nbytes);
+	return 0;
+}
+
+static int rtk_mcp_hash_import(struct ahash_request *req, const void *in)
+{
+	struct rtk_mcp_hash_reqctx *rctx = ahash_request_ctx(req);
 
-		memcpy(walk.dst.virt.addr, dma_vaddr, op->len);
-		dma_free_coherent(&mcp_pdev->dev, op->len, (void *)dma_vaddr, dma_paddr);
-		dma_unmap_single(&mcp_pdev->dev, op->src, op->len, DMA_TO_DEVICE);
+	rctx->op = 0;
+	memcpy(shash_desc_ctx(rtk_mcp_hw_desc(req)), in,
+	       crypto_ahash_statesize(crypto_ahash_reqtfm(req)));
+
+	return 0;
+}
+
+static int rtk_mcp_hash_do_one(struct crypto_engine *engine, void *areq)
+{
+	struct ahash_request *req = container_of(areq, struct ahash_request, base);
+	struct rtk_mcp_ahash_alg *alg = to_rtk_mcp_ahash_alg(crypto_ahash_reqtfm(req));
+	struct rtk_mcp_hash_reqctx *rctx = ahash_request_ctx(req);
+	struct shash_desc *hw = rtk_mcp_hw_desc(req);
+	struct crypto_hash_walk walk;
+	int nbytes, err = 0;
+
+	mcp_hash_err = 0;
+
+	if (rctx->op & RTK_MCP_HASH_UPDATE) {
+		for (nbytes = crypto_hash_walk_first(req, &walk); nbytes > 0;
+		     nbytes = crypto_hash_walk_done(&walk, 0))
+			alg->hw_update(hw, walk.data, nbytes);
+		err = nbytes;
 	}
 
-	return err;
+	if (!err && (rctx->op & RTK_MCP_HASH_FINAL))
+		err = alg->hw_final(hw, req->result);
+
+	if (!err)
+		err = mcp_hash_err;
+
+	crypto_finalize_hash_request(engine, req, err);
+
+	return 0;
 }
 
-static struct skcipher_alg rtk_des_ecb_alg = {
-	.base.cra_name = "ecb(des)",
-	.base.cra_driver_name = "__drive-ecb_des-rtk",
-	.base.cra_priority = 400,
-	.base.cra_flags = CRYPTO_ALG_ASYNC,
-	.base.cra_blocksize = DES_BLOCK_SIZE,
-	.base.cra_ctxsize = sizeof(struct rtk_mcp_op),
-	.base.cra_alignmask = 15,
-	.base.cra_module = THIS_MODULE,
-
-	.setkey = rtk_des_setkey_blk,
-	.decrypt = rtk_des_ecb_decrypt,
-	.encrypt = rtk_des_ecb_encrypt,
-	.min_keysize = DES_KEY_SIZE,
-	.max_keysize = DES_KEY_SIZE,
-	.ivsize = DES_BLOCK_SIZE,
+static struct rtk_mcp_ahash_alg rtk_sha1_alg = {
+	.alg.base = {
+		.init		= rtk_mcp_hash_init,
+		.update		= rtk_mcp_hash_update,
+		.final		= rtk_mcp_hash_final,
+		.finup		= rtk_mcp_hash_finup,
+		.digest		= rtk_mcp_hash_digest,
+		.export		= rtk_mcp_hash_export,
+		.import		= rtk_mcp_hash_import,
+		.init_tfm	= rtk_mcp_hash_init_tfm,
+		.exit_tfm	= rtk_mcp_hash_exit_tfm,
+		.halg = {
+			.digestsize	= SHA1_DIGEST_SIZE,
+			.statesize	= sizeof(struct sha1_state),
+			.base = {
+				.cra_name		= "sha1",
+				.cra_driver_name	= "__driver_sha1-rtk",
+				.cra_priority		= 400,
+				.cra_flags		= CRYPTO_ALG_ASYNC | CRYPTO_ALG_NEED_FALLBACK,
+				.cra_blocksize		= SHA1_BLOCK_SIZE,
+				.cra_ctxsize		= sizeof(struct rtk_mcp_hash_ctx),
+				.cra_module		= THIS_MODULE,
+			}
+		}
+	},
+	.alg.op.do_one_request = rtk_mcp_hash_do_one,
+	.hw_init	= sha1_base_init,
+	.hw_update	= rtk_sha1_update,
+	.hw_final	= rtk_sha1_final,
 };
 
-static int rtk_ctr_decrypt(struct skcipher_request *req)
+static struct rtk_mcp_ahash_alg rtk_sha256_alg = {
+	.alg.base = {
+		.init		= rtk_mcp_hash_init,
+		.update		= rtk_mcp_hash_update,
+		.final		= rtk_mcp_hash_final,
+		.finup		= rtk_mcp_hash_finup,
+		.digest		= rtk_mcp_hash_digest,
+		.export		= rtk_mcp_hash_export,
+		.import		= rtk_mcp_hash_import,
+		.init_tfm	= rtk_mcp_hash_init_tfm,
+		.exit_tfm	= rtk_mcp_hash_exit_tfm,
+		.halg = {
+			.digestsize	= SHA256_DIGEST_SIZE,
+			.statesize	= sizeof(struct sha256_state),
+			.base = {
+				.cra_name		= "sha256",
+				.cra_driver_name	= "__driver_sha256-rtk",
+				.cra_priority		= 400,
+				.cra_flags		= CRYPTO_ALG_ASYNC | CRYPTO_ALG_NEED_FALLBACK,
+				.cra_blocksize		= SHA256_BLOCK_SIZE,
+				.cra_ctxsize		= sizeof(struct rtk_mcp_hash_ctx),
+				.cra_module		= THIS_MODULE,
+			}
+		}
+	},
+	.alg.op.do_one_request = rtk_mcp_hash_do_one,
+	.hw_init	= sha256_base_init,
+	.hw_update	= rtk_sha256_update,
+	.hw_final	= rtk_sha256_final,
+};
+
+static struct rtk_mcp_ahash_alg rtk_sha512_alg = {
+	.alg.base = {
+		.init		= rtk_mcp_hash_init,
+		.update		= rtk_mcp_hash_update,
+		.final		= rtk_mcp_hash_final,
+		.finup		= rtk_mcp_hash_finup,
+		.digest		= rtk_mcp_hash_digest,
+		.export		= rtk_mcp_hash_export,
+		.import		= rtk_mcp_hash_import,
+		.init_tfm	= rtk_mcp_hash_init_tfm,
+		.exit_tfm	= rtk_mcp_hash_exit_tfm,
+		.halg = {
+			.digestsize	= SHA512_DIGEST_SIZE,
+			.statesize	= sizeof(struct sha512_state),
+			.base = {
+				.cra_name		= "sha512",
+				.cra_driver_name	= "__driver_sha512-rtk",
+				.cra_priority		= 400,
+				.cra_flags		= CRYPTO_ALG_ASYNC | CRYPTO_ALG_NEED_FALLBACK,
+				.cra_blocksize		= SHA512_BLOCK_SIZE,
+				.cra_ctxsize		= sizeof(struct rtk_mcp_hash_ctx),
+				.cra_module		= THIS_MODULE,
+			}
+		}
+	},
+	.alg.op.do_one_request = rtk_mcp_hash_do_one,
+	.hw_init	= sha512_base_init,
+	.hw_update	= rtk_sha512_update,
+	.hw_final	= rtk_sha512_final,
+};
+
+static struct rtk_mcp_ahash_alg *rtk_mcp_ahash_algs[] = {
+	&rtk_sha1_alg,
+	&rtk_sha256_alg,
+	&rtk_sha512_alg,
+};
+
+static const unsigned int rtk_mcp_speed_sizes[] = { 16, 64, 256, 1024, 4096, 8192 };
+
+static s64 rtk_mcp_hash_time(struct crypto_ahash *tfm, struct scatterlist *sg,
+			     unsigned int len, unsigned int iters)
 {
-	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(req);
-	struct rtk_mcp_op *op = crypto_skcipher_ctx(tfm);
-	struct skcipher_walk walk;
-	unsigned char *dma_vaddr;
-	dma_addr_t dma_paddr;
-	unsigned int nbytes;
-	int i, err, ret;
+	u8 out[SHA512_DIGEST_SIZE];
+	struct ahash_request *req;
+	DECLARE_CRYPTO_WAIT(wait);
+	ktime_t start;
+	int i, ret = 0;
 
-	err = skcipher_walk_virt(&walk, req, false);
+	req = ahash_request_alloc(tfm, GFP_KERNEL);
+	if (!req)
+		return -ENOMEM;
 
-	for (i = 0; i < sizeof(op->iv)/4; i++)
-		op->iv[i] = cpu_to_be32(*((const u32 *)walk.iv + i));
+	ahash_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+				   crypto_req_done, &wait);
+	ahash_request_set_crypt(req, sg, out, len);
 
-	while ((nbytes = walk.nbytes) != 0) {
-		op->len = nbytes - (nbytes % AES_BLOCK_SIZE);
-		op->src = dma_map_single(&mcp_pdev->dev, walk.src.virt.addr, op->len, DMA_TO_DEVICE);
-		dma_vaddr = dma_alloc_coherent(&mcp_pdev->dev, op->len, &dma_paddr, GFP_ATOMIC|GFP_DMA);
-		op->dst = dma_paddr;
+	start = ktime_get();
+	for (i = 0; i < iters && !ret; i++)
+		ret = crypto_wait_req(crypto_ahash_digest(req), &wait);
 
-		if (MCP_MODE(op->flags) == MCP_ALGO_AES_256)
-			op->key[0] = dma_map_single(&mcp_pdev->dev, aes_256_key, AES_KEYSIZE_256, DMA_TO_DEVICE);
+	ahash_request_free(req);
+
+	return ret ? ret : ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static void rtk_mcp_hash_speed_one(struct seq_file *s, struct rtk_mcp_ahash_alg *alg,
+				   struct scatterlist *sg, void *buf)
+{
+	struct crypto_alg *base = &alg->alg.base.halg.base;
+	struct crypto_ahash *cpu, *mcp;
+	struct rtk_mcp_hash_ctx *ctx;
+	unsigned int len, iters;
+	s64 cpu_ns, mcp_ns;
+	int i;
+
+	/* a synchronous tfm is the CPU implementation the fallback uses */
+	cpu = crypto_alloc_ahash(base->cra_name, 0, CRYPTO_ALG_ASYNC);
+	if (IS_ERR(cpu)) {
+		seq_printf(s, "%s: no cpu implementation\n", base->cra_name);
+		return;
+	}
+
+	mcp = crypto_alloc_ahash(base->cra_driver_name, 0, 0);
+	if (IS_ERR(mcp)) {
+		seq_printf(s, "%s: %s unavailable\n", base->cra_name, base->cra_driver_name);
+		crypto_free_ahash(cpu);
+		return;
+	}
 
-		op->flags |= AES_CTR_DEC;
+	/* always go through the engine so the crossover point is visible */
+	ctx = crypto_ahash_ctx(mcp);
+	ctx->fallback_len = 0;
 
-		ret = rtk_mcp_crypt(op);
-		nbytes -= ret;
+	seq_printf(s, "%s: cpu %s, mcp %s\n", base->cra_name,
+		   crypto_ahash_driver_name(cpu), crypto_ahash_driver_name(mcp));
 
-		if (MCP_MODE(op->flags) == MCP_ALGO_AES_256)
-			dma_unmap_single(&mcp_pdev->dev, op->key[0], AES_KEYSIZE_256, DMA_TO_DEVICE);
+	for (i = 0; i < ARRAY_SIZE(rtk_mcp_speed_sizes); i++) {
+		len = rtk_mcp_speed_sizes[i];
+		iters = max(SZ_256K / len, 16U);
 
-		err = skcipher_walk_done(&walk, nbytes);
+		sg_init_one(sg, buf, len);
+		cpu_ns = rtk_mcp_hash_time(cpu, sg, len, iters);
+		mcp_ns = rtk_mcp_hash_time(mcp, sg, len, iters);
+		if (cpu_ns <= 0 || mcp_ns <= 0) {
+			seq_printf(s, "%6u bytes: failed (%lld/%lld)\n", len, cpu_ns, mcp_ns);
+			break;
+		}
 
-		memcpy(walk.dst.virt.addr, dma_vaddr, op->len);
-		dma_free_coherent(&mcp_pdev->dev, op->len, (void *)dma_vaddr, dma_paddr);
-		dma_unmap_single(&mcp_pdev->dev, op->src, op->len, DMA_TO_DEVICE);
+		seq_printf(s, "%6u bytes: cpu %8lld ns/op %6llu MB/s, mcp %8lld ns/op %6llu MB/s\n",
+			   len, div_s64(cpu_ns, iters),
+			   div64_u64((u64)len * iters * 1000, cpu_ns),
+			   div_s64(mcp_ns, iters),
+			   div64_u64((u64)len * iters * 1000, mcp_ns));
 	}
 
-	return err;
+	crypto_free_ahash(mcp);
+	crypto_free_ahash(cpu);
 }
 
-static int rtk_ctr_encrypt(struct skcipher_request *req)
+/* tcrypt style digest speed of the CPU against the engine, per request size */
+static int rtk_mcp_hash_speed_show(struct seq_file *s, void *unused)
 {
-	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(req);
-	struct rtk_mcp_op *op = crypto_skcipher_ctx(tfm);
-	struct skcipher_walk walk;
-	unsigned char *dma_vaddr;
-	dma_addr_t dma_paddr;
-	unsigned int nbytes;
-	int i, err, ret;
+	struct scatterlist sg;
+	void *buf;
+	int i;
 
-	err = skcipher_walk_virt(&walk, req, false);
+	buf = kmalloc(rtk_mcp_speed_sizes[ARRAY_SIZE(rtk_mcp_speed_sizes) - 1], GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
 
-	for (i = 0; i < sizeof(op->iv)/4; i++)
-		op->iv[i] = cpu_to_be32(*((const u32 *)walk.iv + i));
+	memset(buf, 0x5a, rtk_mcp_speed_sizes[ARRAY_SIZE(rtk_mcp_speed_sizes) - 1]);
 
-	while ((nbytes = walk.nbytes) != 0) {
-		op->len = nbytes - (nbytes % AES_BLOCK_SIZE);
-		op->src = dma_map_single(&mcp_pdev->dev, walk.src.virt.addr, op->len, DMA_TO_DEVICE);
-		dma_vaddr = dma_alloc_coherent(&mcp_pdev->dev, op->len, &dma_paddr, GFP_ATOMIC|GFP_DMA);
-		op->dst = dma_paddr;
+	for (i = 0; i < ARRAY_SIZE(rtk_mcp_ahash_algs); i++)
+		rtk_mcp_hash_speed_one(s, rtk_mcp_ahash_algs[i], &sg, buf);
 
-		if (MCP_MODE(op->flags) == MCP_ALGO_AES_256)
-			op->key[0] = dma_map_single(&mcp_pdev->dev, aes_256_key, AES_KEYSIZE_256, DMA_TO_DEVICE);
+	seq_printf(s, "hash_fallback_len: %u\n", READ_ONCE(hash_fallback_len));
 
-		op->flags |= AES_CTR_ENC;
+	kfree(buf);
 
-		ret = rtk_mcp_crypt(op);
-		nbytes -= ret;
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(rtk_mcp_hash_speed);
 
-		if (MCP_MODE(op->flags) == MCP_ALGO_AES_256)
-			dma_unmap_single(&mcp_pdev->dev, op->key[0], AES_KEYSIZE_256, DMA_TO_DEVICE);
+static int rtk_des_setkey_blk(struct crypto_skcipher *tfm, const u8 *key, unsigned int len)
+{
+	struct rtk_mcp_ctx *ctx = crypto_skcipher_ctx(tfm);
+	int i;
 
-		err = skcipher_walk_done(&walk, nbytes);
+	if (key == NULL) {
+		ctx->flags = MCP_KEY_SEL(MCP_KEY_SEL_OTP);
+		return 0;
+	}
+
+	ctx->flags = 0;
+
+	for (i = 0; i < len/4; i++)
+		ctx->key[i] = cpu_to_be32(*((const u32 *)key + i));
 
-		memcpy(walk.dst.virt.addr, dma_vaddr, op->len);
-		dma_free_coherent(&mcp_pdev->dev, op->len, (void *)dma_vaddr, dma_paddr);
-		dma_unmap_single(&mcp_pdev->dev, op->src, op->len, DMA_TO_DEVICE);
+	return 0;
+}
+
+/* advance a big endian 128-bit counter by @blocks */
+static void rtk_mcp_ctr_add(u8 *ctr, u32 blocks)
+{
+	int i;
+
+	for (i = AES_BLOCK_SIZE - 1; i >= 0 && blocks; i--) {
+		blocks += ctr[i];
+		ctr[i] = blocks & 0xff;
+		blocks >>= 8;
 	}
+}
 
-	return err;
+static bool rtk_mcp_sg_aligned(struct scatterlist *src, struct scatterlist *dst,
+			       unsigned int len, unsigned int bsize)
+{
+	unsigned int soff = 0, doff = 0;
+	unsigned int n;
+
+	while (len) {
+		if (!src || !dst)
+			return false;
+
+		n = min3(src->length - soff, dst->length - doff, len);
+		if (!n || n % bsize ||
+		    !IS_ALIGNED(src->offset + soff, MCP_DMA_ALIGN) ||
+		    !IS_ALIGNED(dst->offset + doff, MCP_DMA_ALIGN))
+			return false;
+
+		len -= n;
+		soff += n;
+		doff += n;
+
+		if (soff == src->length) {
+			src = sg_next(src);
+			soff = 0;
+		}
+		if (doff == dst->length) {
+			dst = sg_next(dst);
+			doff = 0;
+		}
+	}
+
+	return true;
 }
 
-static struct skcipher_alg rtk_aes_ctr_alg = {
-	.base.cra_name = "ctr(aes)",
-	.base.cra_driver_name = "__driver_ctr-aes-rtk",
-	.base.cra_priority = 400,
-	.base.cra_flags = CRYPTO_ALG_ASYNC,
-	.base.cra_blocksize = AES_BLOCK_SIZE,
-	.base.cra_ctxsize = sizeof(struct rtk_mcp_op),
-	.base.cra_alignmask = 15,
-	.base.cra_module = THIS_MODULE,
-
-	.setkey = rtk_setkey_blk,
-	.decrypt = rtk_ctr_decrypt,
-	.encrypt = rtk_ctr_encrypt,
-	.min_keysize = AES_MIN_KEY_SIZE,
-	.max_keysize = AES_MAX_KEY_SIZE,
-	.ivsize = AES_BLOCK_SIZE,
-};
+static void rtk_mcp_cursor_init(struct rtk_mcp_sg_cursor *cur,
+				struct scatterlist *sg, int nents)
+{
+	cur->sg = sg;
+	cur->nents = nents;
+	cur->off = 0;
+}
 
-static int rtk_cbc_decrypt(struct skcipher_request *req)
+static dma_addr_t rtk_mcp_cursor_addr(struct rtk_mcp_sg_cursor *cur)
+{
+	return sg_dma_address(cur->sg) + cur->off;
+}
+
+static unsigned int rtk_mcp_cursor_len(struct rtk_mcp_sg_cursor *cur)
+{
+	return sg_dma_len(cur->sg) - cur->off;
+}
+
+static void rtk_mcp_cursor_advance(struct rtk_mcp_sg_cursor *cur, unsigned int n)
+{
+	cur->off += n;
+	while (cur->nents > 1 && cur->off >= sg_dma_len(cur->sg)) {
+		cur->off -= sg_dma_len(cur->sg);
+		cur->sg = sg_next(cur->sg);
+		cur->nents--;
+	}
+}
+
+/*
+ * Fetch the last ciphertext block of a cbc encryption run while the
+ * destination is still mapped. The DMA API only syncs a list as it was
+ * mapped, so the whole of it is handed to the CPU and back; no run is in
+ * flight at this point.
+ */
+static void rtk_mcp_cbc_read_iv(struct device *dev, struct scatterlist *sgl,
+				int nents, unsigned int off,
+				enum dma_data_direction dir, u8 *iv)
+{
+	dma_sync_sg_for_cpu(dev, sgl, nents, dir);
+	scatterwalk_map_and_copy(iv, sgl, off, AES_BLOCK_SIZE, 0);
+	dma_sync_sg_for_device(dev, sgl, nents, dir);
+}
+
+/*
+ * Map the request scatterlists and hand the engine one descriptor per
+ * contiguous piece, up to a full ring per run. The caller has checked that
+ * every piece is aligned and a whole number of blocks.
+ */
+static int rtk_mcp_skcipher_sg(struct skcipher_request *req)
 {
 	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(req);
-	struct rtk_mcp_op *op = crypto_skcipher_ctx(tfm);
-	struct skcipher_walk walk;
-	unsigned char *dma_vaddr;
-	dma_addr_t dma_paddr;
-	unsigned int nbytes;
-	int i, err, ret;
+	struct rtk_mcp_ctx *ctx = crypto_skcipher_ctx(tfm);
+	struct rtk_mcp_reqctx *rctx = skcipher_request_ctx(req);
+	unsigned int bsize = crypto_skcipher_blocksize(tfm);
+	bool aes_256 = MCP_MODE(ctx->flags) == MCP_ALGO_AES_256;
+	u32 bcm = MCP_GET_BCM(rctx->mode);
+	bool enc = rctx->mode & MCP_ENC(1);
+	bool inplace = req->src == req->dst;
+	enum dma_data_direction src_dir = inplace ? DMA_BIDIRECTIONAL : DMA_TO_DEVICE;
+	enum dma_data_direction dst_dir = inplace ? DMA_BIDIRECTIONAL : DMA_FROM_DEVICE;
+	bool cbc_dec = bcm == MCP_BCM_CBC && !enc;
+	bool cbc_enc = bcm == MCP_BCM_CBC && enc;
+	struct device *dev = &mcp_pdev->dev;
+	struct rtk_mcp_sg_cursor src, dst;
+	int src_nents, dst_nents;
+	int src_mapped, dst_mapped = 0;
+	dma_addr_t key_dma = 0;
+	unsigned int pos = 0, n;
+	u8 iv[AES_BLOCK_SIZE];
+	struct rtk_mcp_op *op;
+	int count = 0;
+	int i, ret = 0;
 
-	err = skcipher_walk_virt(&walk, req, false);
+	src_nents = sg_nents_for_len(req->src, req->cryptlen);
+	dst_nents = sg_nents_for_len(req->dst, req->cryptlen);
+	if (src_nents < 0 || dst_nents < 0)
+		return -EINVAL;
 
-	for (i = 0; i < sizeof(op->iv)/4; i++)
-		op->iv[i] = cpu_to_be32(*((const u32 *)walk.iv + i));
+	src_mapped = dma_map_sg(dev, req->src, src_nents, src_dir);
+	if (inplace)
+		dst_mapped = src_mapped;
+	else if (src_mapped)
+		dst_mapped = dma_map_sg(dev, req->dst, dst_nents, dst_dir);
+	if (!src_mapped || !dst_mapped) {
+		ret = -ENOMEM;
+		goto unmap;
+	}
 
-	while ((nbytes = walk.nbytes) != 0) {
-		op->len = nbytes - (nbytes % AES_BLOCK_SIZE);
-		op->src = dma_map_single(&mcp_pdev->dev, walk.src.virt.addr, op->len, DMA_TO_DEVICE);
-		dma_vaddr = dma_alloc_coherent(&mcp_pdev->dev, op->len, &dma_paddr, GFP_ATOMIC|GFP_DMA);
-		op->dst = dma_paddr;
+	if (aes_256) {
+		key_dma = dma_map_single(dev, ctx->key_256, AES_KEYSIZE_256, DMA_TO_DEVICE);
+		if (dma_mapping_error(dev, key_dma)) {
+			ret = -ENOMEM;
+			goto unmap;
+		}
+	}
 
-		if (MCP_MODE(op->flags) == MCP_ALGO_AES_256)
-			op->key[0] = dma_map_single(&mcp_pdev->dev, aes_256_key, AES_KEYSIZE_256, DMA_TO_DEVICE);
+	if (bcm != MCP_BCM_ECB)
+		memcpy(iv, req->iv, AES_BLOCK_SIZE);
+
+	rtk_mcp_cursor_init(&src, req->src, src_mapped);
+	rtk_mcp_cursor_init(&dst, req->dst, dst_mapped);
+
+	while (pos < req->cryptlen) {
+		n = min3(rtk_mcp_cursor_len(&src), rtk_mcp_cursor_len(&dst),
+			 req->cryptlen - pos);
+
+		/*
+		 * cbc decryption takes the next iv from the source before the
+		 * run that may overwrite it, so the source is handed to the
+		 * CPU while a batch is built.
+		 */
+		if (cbc_dec && !count)
+			dma_sync_sg_for_cpu(dev, req->src, src_nents, src_dir);
+
+		op = &mcp_batch[count++];
+		memset(op, 0, sizeof(*op));
+		op->flags = ctx->flags | rctx->mode;
+		memcpy(op->key, ctx->key, sizeof(op->key));
+		if (aes_256)
+			op->key[0] = key_dma;
+		if (bcm != MCP_BCM_ECB) {
+			for (i = 0; i < sizeof(op->iv)/4; i++)
+				op->iv[i] = cpu_to_be32(*((const u32 *)iv + i));
+		}
+		op->src = rtk_mcp_cursor_addr(&src);
+		op->dst = rtk_mcp_cursor_addr(&dst);
+		op->len = n;
+
+		/* the iv of the next piece is known up front except for cbc encryption */
+		if (bcm == MCP_BCM_CTR)
+			rtk_mcp_ctr_add(iv, n / bsize);
+		else if (cbc_dec)
+			scatterwalk_map_and_copy(iv, req->src, pos + n - bsize, bsize, 0);
 
-		op->flags |= AES_CBC_DEC;
+		pos += n;
+		rtk_mcp_cursor_advance(&src, n);
+		rtk_mcp_cursor_advance(&dst, n);
 
-		ret = rtk_mcp_crypt(op);
-		nbytes -= ret;
+		if (count < MCP_DESC_ENTRY_COUNT && pos < req->cryptlen && !cbc_enc)
+			continue;
 
-		if (MCP_MODE(op->flags) == MCP_ALGO_AES_256)
-			dma_unmap_single(&mcp_pdev->dev, op->key[0], AES_KEYSIZE_256, DMA_TO_DEVICE);
+		if (cbc_dec)
+			dma_sync_sg_for_device(dev, req->src, src_nents, src_dir);
 
-		err = skcipher_walk_done(&walk, nbytes);
+		ret = rtk_mcp_run(mcp_batch, count);
+		count = 0;
+		if (ret)
+			break;
 
-		memcpy(walk.dst.virt.addr, dma_vaddr, op->len);
-		dma_free_coherent(&mcp_pdev->dev, op->len, (void *)dma_vaddr, dma_paddr);
-		dma_unmap_single(&mcp_pdev->dev, op->src, op->len, DMA_TO_DEVICE);
+		/* the last block of the request is read once it is unmapped */
+		if (cbc_enc && pos < req->cryptlen)
+			rtk_mcp_cbc_read_iv(dev, req->dst, dst_nents, pos - bsize, dst_dir, iv);
 	}
 
-	return err;
+	if (aes_256)
+		dma_unmap_single(dev, key_dma, AES_KEYSIZE_256, DMA_TO_DEVICE);
+
+unmap:
+	if (!inplace && dst_mapped)
+		dma_unmap_sg(dev, req->dst, dst_nents, dst_dir);
+	if (src_mapped)
+		dma_unmap_sg(dev, req->src, src_nents, src_dir);
+
+	if (!ret && cbc_enc)
+		scatterwalk_map_and_copy(iv, req->dst, req->cryptlen - bsize, bsize, 0);
+	if (!ret && bcm != MCP_BCM_ECB)
+		memcpy(req->iv, iv, crypto_skcipher_ivsize(tfm));
+
+	return ret;
 }
 
-static int rtk_cbc_encrypt(struct skcipher_request *req)
+/*
+ * Copy through a coherent buffer, for requests the engine cannot address
+ * directly. A walk step never spans more than a page, so one buffer of that
+ * size is allocated per request and reused by every step.
+ */
+static int rtk_mcp_skcipher_bounce(struct skcipher_request *req)
 {
 	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(req);
-	struct rtk_mcp_op *op = crypto_skcipher_ctx(tfm);
+	struct rtk_mcp_ctx *ctx = crypto_skcipher_ctx(tfm);
+	struct rtk_mcp_reqctx *rctx = skcipher_request_ctx(req);
+	unsigned int bsize = crypto_skcipher_blocksize(tfm);
+	bool aes_256 = MCP_MODE(ctx->flags) == MCP_ALGO_AES_256;
+	u32 bcm = MCP_GET_BCM(rctx->mode);
+	bool enc = rctx->mode & MCP_ENC(1);
+	struct device *dev = &mcp_pdev->dev;
+	unsigned int buf_len = min_t(unsigned int, req->cryptlen, PAGE_SIZE);
+	u8 next_iv[AES_BLOCK_SIZE];
 	struct skcipher_walk walk;
 	unsigned char *dma_vaddr;
+	unsigned int nbytes, len;
+	dma_addr_t key_dma = 0;
+	struct rtk_mcp_op op;
 	dma_addr_t dma_paddr;
-	unsigned int nbytes;
 	int i, err, ret;
 
 	err = skcipher_walk_virt(&walk, req, false);
-
-	for (i = 0; i < sizeof(op->iv)/4; i++)
-		op->iv[i] = cpu_to_be32(*((const u32 *)walk.iv + i));
+	if (err)
+		return err;
+
+	dma_vaddr = dma_alloc_coherent(dev, buf_len, &dma_paddr, GFP_KERNEL);
+	if (!dma_vaddr)
+		return skcipher_walk_done(&walk, -ENOMEM);
+
+	if (aes_256) {
+		key_dma = dma_map_single(dev, ctx->key_256, AES_KEYSIZE_256, DMA_TO_DEVICE);
+		if (dma_mapping_error(dev, key_dma)) {
+			err = skcipher_walk_done(&walk, -ENOMEM);
+			goto free_buf;
+		}
+	}
 
 	while ((nbytes = walk.nbytes) != 0) {
+		len = min(nbytes, buf_len);
+		len -= len % bsize;
+
+		memset(&op, 0, sizeof(op));
+		op.flags = ctx->flags | rctx->mode;
+		memcpy(op.key, ctx->key, sizeof(op.key));
+		if (aes_256)
+			op.key[0] = key_dma;
+		if (bcm != MCP_BCM_ECB) {
+			for (i = 0; i < sizeof(op.iv)/4; i++)
+				op.iv[i] = cpu_to_be32(*((const u32 *)walk.iv + i));
+		}
 
-		op->len = nbytes - (nbytes % AES_BLOCK_SIZE);
-		op->src = dma_map_single(&mcp_pdev->dev, walk.src.virt.addr, op->len, DMA_TO_DEVICE);
-		dma_vaddr = dma_alloc_coherent(&mcp_pdev->dev, op->len, &dma_paddr, GFP_ATOMIC|GFP_DMA);
-		op->dst = dma_paddr;
+		op.src = dma_map_single(dev, walk.src.virt.addr, len, DMA_TO_DEVICE);
+		if (dma_mapping_error(dev, op.src)) {
+			err = skcipher_walk_done(&walk, -ENOMEM);
+			break;
+		}
+		op.dst = dma_paddr;
+		op.len = len;
 
-		if (MCP_MODE(op->flags) == MCP_ALGO_AES_256)
-			op->key[0] = dma_map_single(&mcp_pdev->dev, aes_256_key, AES_KEYSIZE_256, DMA_TO_DEVICE);
+		/* an in-place decrypt overwrites the block the next iv comes from */
+		if (bcm == MCP_BCM_CBC && !enc)
+			memcpy(next_iv, walk.src.virt.addr + len - bsize, bsize);
 
-		op->flags |= AES_CBC_ENC;
+		ret = rtk_mcp_run(&op, 1);
 
-		ret = rtk_mcp_crypt(op);
-		nbytes -= ret;
+		dma_unmap_single(dev, op.src, len, DMA_TO_DEVICE);
 
-		if (MCP_MODE(op->flags) == MCP_ALGO_AES_256)
-			dma_unmap_single(&mcp_pdev->dev, op->key[0], AES_KEYSIZE_256, DMA_TO_DEVICE);
+		if (ret) {
+			err = skcipher_walk_done(&walk, ret);
+			break;
+		}
+
+		memcpy(walk.dst.virt.addr, dma_vaddr, len);
 
-		err = skcipher_walk_done(&walk, nbytes);
+		if (bcm == MCP_BCM_CBC)
+			memcpy(walk.iv, enc ? dma_vaddr + len - bsize : next_iv, bsize);
+		else if (bcm == MCP_BCM_CTR)
+			rtk_mcp_ctr_add(walk.iv, len / bsize);
 
-		memcpy(walk.dst.virt.addr, dma_vaddr, op->len);
-		dma_free_coherent(&mcp_pdev->dev, op->len, (void *)dma_vaddr, dma_paddr);
-		dma_unmap_single(&mcp_pdev->dev, op->src, op->len, DMA_TO_DEVICE);
+		err = skcipher_walk_done(&walk, nbytes - len);
 	}
 
+	if (aes_256)
+		dma_unmap_single(dev, key_dma, AES_KEYSIZE_256, DMA_TO_DEVICE);
+free_buf:
+	dma_free_coherent(dev, buf_len, (void *)dma_vaddr, dma_paddr);
+
 	return err;
 }
 
-static struct skcipher_alg rtk_aes_cbc_alg = {
-	.base.cra_name = "cbc(aes)",
-	.base.cra_driver_name = "__driver_cbc-aes-rtk",
-	.base.cra_priority = 400,
-	.base.cra_flags = CRYPTO_ALG_ASYNC,
-	.base.cra_blocksize = AES_BLOCK_SIZE,
-	.base.cra_ctxsize = sizeof(struct rtk_mcp_op),
-	.base.cra_alignmask = 15,
-	.base.cra_module = THIS_MODULE,
-
-	.setkey = rtk_setkey_blk,
-	.decrypt = rtk_cbc_decrypt,
-	.encrypt = rtk_cbc_encrypt,
-	.min_keysize = AES_MIN_KEY_SIZE,
-	.max_keysize = AES_MAX_KEY_SIZE,
-	.ivsize = AES_BLOCK_SIZE,
-};
-
-static int rtk_ecb_decrypt(struct skcipher_request *req)
+static int rtk_mcp_skcipher_do_one(struct crypto_engine *engine, void *areq)
 {
+	struct skcipher_request *req = container_of(areq, struct skcipher_request, base);
 	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(req);
-	struct rtk_mcp_op *op = crypto_skcipher_ctx(tfm);
-	struct skcipher_walk walk;
-	unsigned char *dma_vaddr;
-	dma_addr_t dma_paddr;
-	unsigned int nbytes;
-	int err, ret;
+	int err;
 
-	err = skcipher_walk_virt(&walk, req, false);
+	if (rtk_mcp_sg_aligned(req->src, req->dst, req->cryptlen,
+			       crypto_skcipher_blocksize(tfm))) {
+		mcp_sg_requests++;
+		err = rtk_mcp_skcipher_sg(req);
+	} else {
+		mcp_bounce_requests++;
+		err = rtk_mcp_skcipher_bounce(req);
+	}
 
-	memcpy(op->iv, walk.iv, sizeof(op->iv));
+	crypto_finalize_skcipher_request(engine, req, err);
 
-	while ((nbytes = walk.nbytes) != 0) {
-		op->len = nbytes - (nbytes % AES_BLOCK_SIZE);
-		op->src = dma_map_single(&mcp_pdev->dev, walk.src.virt.addr, op->len, DMA_TO_DEVICE);
-		dma_vaddr = dma_alloc_coherent(&mcp_pdev->dev, op->len, &dma_paddr, GFP_ATOMIC|GFP_DMA);
-		op->dst = dma_paddr;
+	return 0;
+}
 
-		if (MCP_MODE(op->flags) == MCP_ALGO_AES_256)
-			op->key[0] = dma_map_single(&mcp_pdev->dev, aes_256_key, AES_KEYSIZE_256, DMA_TO_DEVICE);
+static int rtk_mcp_skcipher_queue(struct skcipher_request *req, u32 mode)
+{
+	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(req);
+	struct rtk_mcp_reqctx *rctx = skcipher_request_ctx(req);
 
-		op->flags |= AES_ECB_DEC;
+	if (!req->cryptlen)
+		return 0;
 
-		ret = rtk_mcp_crypt(op);
-		nbytes -= ret;
+	if (!IS_ALIGNED(req->cryptlen, crypto_skcipher_blocksize(tfm)))
+		return -EINVAL;
 
-		if (MCP_MODE(op->flags) == MCP_ALGO_AES_256)
-			dma_unmap_single(&mcp_pdev->dev, op->key[0], AES_KEYSIZE_256, DMA_TO_DEVICE);
+	rctx->mode = mode;
 
-		err = skcipher_walk_done(&walk, nbytes);
+	return crypto_transfer_skcipher_request_to_engine(mcp_engine, req);
+}
 
-		memcpy(walk.dst.virt.addr, dma_vaddr, op->len);
-		dma_free_coherent(&mcp_pdev->dev, op->len, (void *)dma_vaddr, dma_paddr);
-		dma_unmap_single(&mcp_pdev->dev, op->src, op->len, DMA_TO_DEVICE);
-	}
+static int rtk_mcp_skcipher_init(struct crypto_skcipher *tfm)
+{
+	crypto_skcipher_set_reqsize(tfm, sizeof(struct rtk_mcp_reqctx));
 
-	return err;
+	return 0;
 }
 
-static int rtk_ecb_encrypt(struct skcipher_request *req)
+static int rtk_des_ecb_decrypt(struct skcipher_request *req)
 {
-	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(req);
-	struct rtk_mcp_op *op = crypto_skcipher_ctx(tfm);
-	struct skcipher_walk walk;
-	unsigned char *dma_vaddr;
-	dma_addr_t dma_paddr;
-	unsigned int nbytes;
-	int err, ret;
+	return rtk_mcp_skcipher_queue(req, DES_ECB_DEC);
+}
 
-	err = skcipher_walk_virt(&walk, req, false);
+static int rtk_des_ecb_encrypt(struct skcipher_request *req)
+{
+	return rtk_mcp_skcipher_queue(req, DES_ECB_ENC);
+}
 
-	memcpy(op->iv, walk.iv, sizeof(op->iv));
+static struct skcipher_engine_alg rtk_des_ecb_alg = {
+	.base.base.cra_name = "ecb(des)",
+	.base.base.cra_driver_name = "__drive-ecb_des-rtk",
+	.base.base.cra_priority = 400,
+	.base.base.cra_flags = CRYPTO_ALG_ASYNC,
+	.base.base.cra_blocksize = DES_BLOCK_SIZE,
+	.base.base.cra_ctxsize = sizeof(struct rtk_mcp_ctx),
+	.base.base.cra_alignmask = 15,
+	.base.base.cra_module = THIS_MODULE,
+
+	.base.init = rtk_mcp_skcipher_init,
+	.base.setkey = rtk_des_setkey_blk,
+	.base.decrypt = rtk_des_ecb_decrypt,
+	.base.encrypt = rtk_des_ecb_encrypt,
+	.base.min_keysize = DES_KEY_SIZE,
+	.base.max_keysize = DES_KEY_SIZE,
+	.base.ivsize = DES_BLOCK_SIZE,
+
+	.op.do_one_request = rtk_mcp_skcipher_do_one,
+};
 
-	while ((nbytes = walk.nbytes) != 0) {
-		op->len = nbytes - (nbytes % AES_BLOCK_SIZE);
-		op->src = dma_map_single(&mcp_pdev->dev, walk.src.virt.addr, op->len, DMA_TO_DEVICE);
-		dma_vaddr = dma_alloc_coherent(&mcp_pdev->dev, op->len, &dma_paddr, GFP_ATOMIC|GFP_DMA);
-		op->dst = dma_paddr;
+static int rtk_ctr_decrypt(struct skcipher_request *req)
+{
+	return rtk_mcp_skcipher_queue(req, AES_CTR_DEC);
+}
 
-		if (MCP_MODE(op->flags) == MCP_ALGO_AES_256)
-			op->key[0] = dma_map_single(&mcp_pdev->dev, aes_256_key, AES_KEYSIZE_256, DMA_TO_DEVICE);
+static int rtk_ctr_encrypt(struct skcipher_request *req)
+{
+	return rtk_mcp_skcipher_queue(req, AES_CTR_ENC);
+}
 
-		op->flags |= AES_ECB_ENC;
+static struct skcipher_engine_alg rtk_aes_ctr_alg = {
+	.base.base.cra_name = "ctr(aes)",
+	.base.base.cra_driver_name = "__driver_ctr-aes-rtk",
+	.base.base.cra_priority = 400,
+	.base.base.cra_flags = CRYPTO_ALG_ASYNC,
+	.base.base.cra_blocksize = AES_BLOCK_SIZE,
+	.base.base.cra_ctxsize = sizeof(struct rtk_mcp_ctx),
+	.base.base.cra_alignmask = 15,
+	.base.base.cra_module = THIS_MODULE,
+
+	.base.init = rtk_mcp_skcipher_init,
+	.base.setkey = rtk_setkey_blk,
+	.base.decrypt = rtk_ctr_decrypt,
+	.base.encrypt = rtk_ctr_encrypt,
+	.base.min_keysize = AES_MIN_KEY_SIZE,
+	.base.max_keysize = AES_MAX_KEY_SIZE,
+	.base.ivsize = AES_BLOCK_SIZE,
+
+	.op.do_one_request = rtk_mcp_skcipher_do_one,
+};
 
-		ret = rtk_mcp_crypt(op);
-		nbytes -= ret;
+static int rtk_cbc_decrypt(struct skcipher_request *req)
+{
+	return rtk_mcp_skcipher_queue(req, AES_CBC_DEC);
+}
 
-		if (MCP_MODE(op->flags) == MCP_ALGO_AES_256)
-			dma_unmap_single(&mcp_pdev->dev, op->key[0], AES_KEYSIZE_256, DMA_TO_DEVICE);
+static int rtk_cbc_encrypt(struct skcipher_request *req)
+{
+	return rtk_mcp_skcipher_queue(req, AES_CBC_ENC);
+}
 
-		err = skcipher_walk_done(&walk, nbytes);
+static struct skcipher_engine_alg rtk_aes_cbc_alg = {
+	.base.base.cra_name = "cbc(aes)",
+	.base.base.cra_driver_name = "__driver_cbc-aes-rtk",
+	.base.base.cra_priority = 400,
+	.base.base.cra_flags = CRYPTO_ALG_ASYNC,
+	.base.base.cra_blocksize = AES_BLOCK_SIZE,
+	.base.base.cra_ctxsize = sizeof(struct rtk_mcp_ctx),
+	.base.base.cra_alignmask = 15,
+	.base.base.cra_module = THIS_MODULE,
+
+	.base.init = rtk_mcp_skcipher_init,
+	.base.setkey = rtk_setkey_blk,
+	.base.decrypt = rtk_cbc_decrypt,
+	.base.encrypt = rtk_cbc_encrypt,
+	.base.min_keysize = AES_MIN_KEY_SIZE,
+	.base.max_keysize = AES_MAX_KEY_SIZE,
+	.base.ivsize = AES_BLOCK_SIZE,
+
+	.op.do_one_request = rtk_mcp_skcipher_do_one,
+};
 
-		memcpy(walk.dst.virt.addr, dma_vaddr, op->len);
-		dma_free_coherent(&mcp_pdev->dev, op->len, (void *)dma_vaddr, dma_paddr);
-		dma_unmap_single(&mcp_pdev->dev, op->src, op->len, DMA_TO_DEVICE);
-	}
+static int rtk_ecb_decrypt(struct skcipher_request *req)
+{
+	return rtk_mcp_skcipher_queue(req, AES_ECB_DEC);
+}
 
-	return err;
+static int rtk_ecb_encrypt(struct skcipher_request *req)
+{
+	return rtk_mcp_skcipher_queue(req, AES_ECB_ENC);
 }
 
-static struct skcipher_alg rtk_aes_ecb_alg = {
-	.base.cra_name = "ecb(aes)",
-	.base.cra_driver_name = "__driver_ecb-aes-rtk",
-	.base.cra_priority = 400,
-	.base.cra_flags = CRYPTO_ALG_ASYNC,
-	.base.cra_blocksize = AES_BLOCK_SIZE,
-	.base.cra_ctxsize = sizeof(struct rtk_mcp_op),
-	.base.cra_alignmask = 15,
-	.base.cra_module = THIS_MODULE,
-
-	.setkey = rtk_setkey_blk,
-	.decrypt = rtk_ecb_decrypt,
-	.encrypt = rtk_ecb_encrypt,
-	.min_keysize = AES_MIN_KEY_SIZE,
-	.max_keysize = AES_MAX_KEY_SIZE,
+static struct skcipher_engine_alg rtk_aes_ecb_alg = {
+	.base.base.cra_name = "ecb(aes)",
+	.base.base.cra_driver_name = "__driver_ecb-aes-rtk",
+	.base.base.cra_priority = 400,
+	.base.base.cra_flags = CRYPTO_ALG_ASYNC,
+	.base.base.cra_blocksize = AES_BLOCK_SIZE,
+	.base.base.cra_ctxsize = sizeof(struct rtk_mcp_ctx),
+	.base.base.cra_alignmask = 15,
+	.base.base.cra_module = THIS_MODULE,
+
+	.base.init = rtk_mcp_skcipher_init,
+	.base.setkey = rtk_setkey_blk,
+	.base.decrypt = rtk_ecb_decrypt,
+	.base.encrypt = rtk_ecb_encrypt,
+	.base.min_keysize = AES_MIN_KEY_SIZE,
+	.base.max_keysize = AES_MAX_KEY_SIZE,
+
+	.op.do_one_request = rtk_mcp_skcipher_do_one,
 };
 
 #if 0
@@ -849,25 +1346,25 @@ static void rtk_mcp_aes128_ecb_encrypt_test(struct platform_device *pdev)
 static int rtk_mcp_phy_init(void)
 {
 	/* dessert go bit */
-	iowrite32(MCP_GO, mcp_iobase + MCP_CTRL);
+	mcp_write(MCP_GO, MCP_CTRL);
 
 	/* disable all interrupts */
-	iowrite32(0xfe, mcp_iobase + MCP_EN);
+	mcp_write(0xfe, MCP_EN);
 
 	/* clear interrupts status */
-	iowrite32(0xfe, mcp_iobase + MCP_STATUS);
-	iowrite32(0, mcp_iobase + MCP_BASE);
-	iowrite32(0, mcp_iobase + MCP_LIMIT);
-	iowrite32(0, mcp_iobase + MCP_RDPTR);
-	iowrite32(0, mcp_iobase + MCP_WRPTR);
+	mcp_write(0xfe, MCP_STATUS);
+	mcp_write(0, MCP_BASE);
+	mcp_write(0, MCP_LIMIT);
+	mcp_write(0, MCP_RDPTR);
+	mcp_write(0, MCP_WRPTR);
 
 	if (chip_id == CHIP_ID_RTD1395) {
 		unsigned int cur_value;
 
 		/* auto power management */
-		cur_value = ioread32(mcp_iobase + PWM_CTRL);
+		cur_value = mcp_read(PWM_CTRL);
 		cur_value |= (1 << 22) | (1 << 23) | (1 << 24) | (1 << 25) | (1 << 27) | (1 << 28);
-		iowrite32(cur_value, mcp_iobase + PWM_CTRL);
+		mcp_write(cur_value, PWM_CTRL);
 	}
 
 	return 0;
@@ -879,54 +1376,124 @@ static int rtk_mcp_probe(struct platform_device *pdev)
 
 	setup_chip_id();
 
-	spin_lock_init(&lock);
 	mcp_pdev = pdev;
 
-	mcp_iobase = of_iomap(pdev->dev.of_node, 0);
-	if (!mcp_iobase) {
-		dev_err(&pdev->dev, "no mcp address\n");
-		return -EINVAL;
+	mcp_pdata = dev_get_platdata(&pdev->dev);
+	if (!mcp_pdata) {
+		mcp_iobase = of_iomap(pdev->dev.of_node, 0);
+		if (!mcp_iobase) {
+			dev_err(&pdev->dev, "no mcp address\n");
+			return -EINVAL;
+		}
 	}
 
 	rtk_mcp_phy_init();
 
-	ret = crypto_register_skciphers(&rtk_aes_ecb_alg, sizeof(rtk_aes_ecb_alg));
+	/* one spare entry so that a full ring still has wrptr below limit */
+	mcp_ring = dmam_alloc_coherent(&pdev->dev,
+				       (MCP_DESC_ENTRY_COUNT + 1) * sizeof(struct rtk_mcp_op),
+				       &mcp_ring_dma, GFP_KERNEL);
+	if (!mcp_ring) {
+		ret = -ENOMEM;
+		goto err_unmap;
+	}
+
+	mcp_hash_out = dmam_alloc_coherent(&pdev->dev, SHA512_DIGEST_SIZE,
+					   &mcp_hash_dma, GFP_KERNEL);
+	if (!mcp_hash_out) {
+		ret = -ENOMEM;
+		goto err_unmap;
+	}
+
+	mcp_irq = platform_get_irq_optional(pdev, 0);
+	if (mcp_irq > 0) {
+		ret = devm_request_irq(&pdev->dev, mcp_irq, rtk_mcp_irq, 0,
+				       dev_name(&pdev->dev), NULL);
+		if (ret)
+			goto err_unmap;
+	} else {
+		mcp_irq = 0;
+		dev_info(&pdev->dev, "no interrupt, polling for completion\n");
+	}
+
+	mcp_engine = crypto_engine_alloc_init(&pdev->dev, true);
+	if (!mcp_engine) {
+		ret = -ENOMEM;
+		goto err_unmap;
+	}
+
+	ret = crypto_engine_start(mcp_engine);
+	if (ret)
+		goto err_engine;
+
+	ret = crypto_engine_register_skcipher(&rtk_aes_ecb_alg);
 	if (ret)
-		goto err;
-	ret = crypto_register_skciphers(&rtk_aes_cbc_alg, sizeof(rtk_aes_cbc_alg));
+		goto err_engine;
+	ret = crypto_engine_register_skcipher(&rtk_aes_cbc_alg);
 	if (ret)
-		goto err;
-	ret = crypto_register_skciphers(&rtk_aes_ctr_alg, sizeof(rtk_aes_ctr_alg));
+		goto err_aes_ecb;
+	ret = crypto_engine_register_skcipher(&rtk_aes_ctr_alg);
 	if (ret)
-		goto err;
-	ret = crypto_register_shash(&rtk_sha256_alg);
+		goto err_aes_cbc;
+	ret = crypto_engine_register_ahash(&rtk_sha256_alg.alg);
 	if (ret)
-		goto err;
-	ret = crypto_register_shash(&rtk_sha512_alg);
+		goto err_aes_ctr;
+	ret = crypto_engine_register_ahash(&rtk_sha512_alg.alg);
 	if (ret)
-		goto err;
-	ret = crypto_register_shash(&rtk_sha1_alg);
+		goto err_sha256;
+	ret = crypto_engine_register_ahash(&rtk_sha1_alg.alg);
 	if (ret)
-		goto err;
-	ret = crypto_register_skciphers(&rtk_des_ecb_alg, sizeof(rtk_des_ecb_alg));
+		goto err_sha512;
+	ret = crypto_engine_register_skcipher(&rtk_des_ecb_alg);
 	if (ret)
-		goto err;
+		goto err_sha1;
 
 	platform_set_drvdata(pdev, mcp_pdev);
 
+	mcp_debugfs = debugfs_create_dir("rtk-mcp", NULL);
+	debugfs_create_u64("sg_requests", 0444, mcp_debugfs, &mcp_sg_requests);
+	debugfs_create_u64("bounce_requests", 0444, mcp_debugfs, &mcp_bounce_requests);
+	debugfs_create_file("hash_speed", 0400, mcp_debugfs, NULL, &rtk_mcp_hash_speed_fops);
+
 	dev_notice(&pdev->dev, "MCP engine enabled\n");
 	return 0;
-err:
+
+err_sha1:
+	crypto_engine_unregister_ahash(&rtk_sha1_alg.alg);
+err_sha512:
+	crypto_engine_unregister_ahash(&rtk_sha512_alg.alg);
+err_sha256:
+	crypto_engine_unregister_ahash(&rtk_sha256_alg.alg);
+err_aes_ctr:
+	crypto_engine_unregister_skcipher(&rtk_aes_ctr_alg);
+err_aes_cbc:
+	crypto_engine_unregister_skcipher(&rtk_aes_cbc_alg);
+err_aes_ecb:
+	crypto_engine_unregister_skcipher(&rtk_aes_ecb_alg);
+err_engine:
+	crypto_engine_exit(mcp_engine);
+err_unmap:
+	if (mcp_iobase)
+		iounmap(mcp_iobase);
 	dev_err(&pdev->dev, "MCP initialization failed\n");
 	return ret;
 }
 
 static int rtk_mcp_remove(struct platform_device *dev)
 {
-	crypto_unregister_skciphers(&rtk_aes_ecb_alg, sizeof(rtk_aes_ecb_alg));
-	crypto_unregister_skciphers(&rtk_aes_cbc_alg, sizeof(rtk_aes_cbc_alg));
-	crypto_unregister_skciphers(&rtk_aes_ctr_alg, sizeof(rtk_aes_ctr_alg));
-	crypto_unregister_skciphers(&rtk_des_ecb_alg, sizeof(rtk_des_ecb_alg));
+	debugfs_remove_recursive(mcp_debugfs);
+
+	crypto_engine_unregister_skcipher(&rtk_des_ecb_alg);
+	crypto_engine_unregister_ahash(&rtk_sha1_alg.alg);
+	crypto_engine_unregister_ahash(&rtk_sha512_alg.alg);
+	crypto_engine_unregister_ahash(&rtk_sha256_alg.alg);
+	crypto_engine_unregister_skcipher(&rtk_aes_ctr_alg);
+	crypto_engine_unregister_skcipher(&rtk_aes_cbc_alg);
+	crypto_engine_unregister_skcipher(&rtk_aes_ecb_alg);
+
+	crypto_engine_exit(mcp_engine);
+	if (mcp_iobase)
+		iounmap(mcp_iobase);
 
 	return 0;
 }
@@ -23,6 +23,8 @@
 #define MCP_DES_COUNT		0x134
 #define MCP_DES_COMPARE		0x138
 
+#define MCP_DESC_ENTRY_COUNT	64
+
 /* MCP Ini_Key Registers */
 #define MCP_DES_INI_KEY		0x11C
 #define MCP_AES_INI_KEY		0x124
@@ -52,6 +54,9 @@
 #define MCP_ERROR		(0x01 << 2)
 #define MCP_COMPARE		(0x01 << 3)
 
+/* for register MCP_EN use */
+#define MCP_INT_MASK		(MCP_RING_EMPTY | MCP_ERROR)
+
 #define MCP_KL_DONE		(0x01 << 20)
 #define MCP_K_KL_DONE		(0x01 << 13)
 
@@ -79,6 +84,8 @@
 #define MCP_BCM_CTR		0x2
 #define MCP_RC4			0x3
 
+#define MCP_GET_BCM(x)		(((x) >> 6) & 0xf)
+
 /* flag 0:decrypt 1:encrypt */
 #define MCP_ENC(x)		(((x) & 0x1) << 5)
 
@@ -113,6 +120,16 @@ struct rtk_mcp_op {
 	u32 len;
 };
 
+/*
+ * Register accessors for an MCP that is not memory mapped, such as the
+ * software model in rtk-mcp-model.c. Passed as platform data.
+ */
+struct rtk_mcp_platform_data {
+	u32 (*read)(void *priv, unsigned int reg);
+	void (*write)(void *priv, unsigned int reg, u32 val);
+	void *priv;
+};
+
 #define CHIP_ID_RTD1295		0x1295
 #define CHIP_ID_RTD1395		0x1395
 #define CHIP_ID_RTD1619		0x1619
@@ -363,12 +363,15 @@ static void rtk_crtc_atomic_flush(struct drm_crtc *crtc,
 				struct drm_atomic_state *old_crtc_state)
 {
 	struct rtk_drm_crtc *rtk_crtc = to_rtk_crtc(crtc);
-	// struct rtk_rpc_info *rpc_info = rtk_crtc->rpc_info;
+	struct rtk_rpc_info *rpc_info = rtk_crtc->rpc_info;
 	struct drm_device *drm = crtc->dev;
 	unsigned long flags;
 
 	DRM_DEBUG_DRIVER("%d\n", __LINE__);
 
+	/* collect the posted plane RPCs of this commit */
+	rtk_rpc_batch_end(rpc_info);
+
 	spin_lock_irqsave(&drm->event_lock, flags);
 	if (rtk_crtc->event) {
 		rtk_crtc->pending_needs_vblank = true;
@@ -388,6 +391,9 @@ static void rtk_crtc_atomic_begin(struct drm_crtc *crtc,
 	if (rtk_crtc->event && state->base.event)
 		DRM_ERROR("new event while there is still a pending event\n");
 
+	/* plane updates of this commit go out as one RPC batch */
+	rtk_rpc_batch_begin(rtk_crtc->rpc_info);
+
 	if (state->base.event) {
 		WARN_ON(drm_crtc_vblank_get(crtc) != 0);
 		rtk_crtc->event = state->base.event;
@@ -464,7 +470,7 @@ irqreturn_t rtk_crtc_isr(int irq, void *dev_id)
 		rtk_crtc->present_time_en = 0;
 	}
 
-	rtk_drm_vowb_isr(rtk_crtc->crtc.dev);
+	rtk_drm_vowb_isr(crtc->dev, crtc);
 
 	return IRQ_HANDLED;
 }
@@ -28,6 +28,7 @@
 #include <linux/component.h>
 #include <linux/of.h>
 #include <linux/platform_device.h>
+#include <linux/workqueue.h>
 
 #ifdef CONFIG_CHROME_PLATFORMS
 #include <linux/of_reserved_mem.h>
@@ -207,6 +208,13 @@ static int rtk_drm_bind(struct device *dev)
 
 	rtk_drm_mode_config_init(drm);
 
+	/* commits on the same CRTC are ordered by wait_for_dependencies() */
+	priv->commit_wq = alloc_workqueue("rtk_drm_commit", WQ_HIGHPRI | WQ_UNBOUND, 0);
+	if (!priv->commit_wq) {
+		ret = -ENOMEM;
+		goto err_free_drm;
+	}
+
 	ret = component_bind_all(dev, drm);
 	if (ret)
 		goto err_bind_device;
@@ -230,6 +238,7 @@ err_vblank_init:
 	drm_kms_helper_poll_fini(drm);
 	component_unbind_all(dev, drm);
 err_bind_device:
+	destroy_workqueue(priv->commit_wq);
 err_free_drm:
 	dev_set_drvdata(dev, NULL);
 	drm_dev_put(drm);
@@ -239,10 +248,13 @@ err_free_drm:
 static void rtk_drm_unbind(struct device *dev)
 {
 	struct drm_device *drm = dev_get_drvdata(dev);
+	struct rtk_drm_private *priv = drm->dev_private;
 
 	drm_dev_unregister(drm);
 	drm_kms_helper_poll_fini(drm);
+	flush_workqueue(priv->commit_wq);
 	component_unbind_all(dev, drm);
+	destroy_workqueue(priv->commit_wq);
 	dev_set_drvdata(dev, NULL);
 	drm_dev_put(drm);
 }
@@ -173,6 +173,9 @@ struct rtk_drm_private {
 	unsigned int max_pluggable_connectors;
 
 	struct rtk_drm_vowb *vowb;
+
+	/* runs the tail of nonblocking commits, in order per CRTC */
+	struct workqueue_struct *commit_wq;
 };
 
 extern unsigned int rtk_drm_recovery;
@@ -22,6 +22,7 @@
 #include "rtk_drm_gem.h"
 #include "rtk_drm_drv.h"
 #include "rtk_hdmi.h"
+#include "rtk_drm_vowb.h"
 
 #define to_rtk_drm_fb(x) container_of(x, struct rtk_drm_fb, fb)
 
@@ -213,13 +214,20 @@ static void rtk_drm_atomic_commit_tail(struct drm_atomic_state *state)
 
 	drm_atomic_helper_commit_modeset_enables(dev, state);
 
+	rtk_drm_vowb_atomic_commit(state);
+
 	drm_atomic_helper_commit_planes(dev, state, DRM_PLANE_COMMIT_ACTIVE_ONLY);
 
 	drm_atomic_helper_fake_vblank(state);
 
 	drm_atomic_helper_commit_hw_done(state);
 
-	drm_atomic_helper_wait_for_vblanks(dev, state);
+	/*
+	 * The CRTC event is sent from the VO feedback interrupt once the
+	 * firmware has consumed the queued context, so flip_done is the real
+	 * completion; no need to also wait for a vblank count to move.
+	 */
+	drm_atomic_helper_wait_for_flip_done(dev, state);
 
 	drm_atomic_helper_cleanup_planes(dev, state);
 
@@ -236,6 +244,91 @@ static void rtk_drm_atomic_commit_tail(struct drm_atomic_state *state)
 	}
 }
 
+static void rtk_drm_commit_tail(struct drm_atomic_state *state)
+{
+	struct drm_device *dev = state->dev;
+
+	drm_atomic_helper_wait_for_fences(dev, state, false);
+
+	drm_atomic_helper_wait_for_dependencies(state);
+
+	rtk_drm_atomic_commit_tail(state);
+
+	drm_atomic_helper_commit_cleanup_done(state);
+
+	drm_atomic_state_put(state);
+}
+
+static void rtk_drm_commit_work(struct work_struct *work)
+{
+	struct drm_atomic_state *state = container_of(work,
+						      struct drm_atomic_state,
+						      commit_work);
+
+	rtk_drm_commit_tail(state);
+}
+
+/*
+ * Same flow as drm_atomic_helper_commit(), except that nonblocking commits
+ * run on the driver's high priority workqueue, so a compositor's flips are
+ * not queued behind unrelated unbound work. The queue is not ordered:
+ * commits on different CRTCs run in parallel, and a commit waits for the
+ * earlier ones on its own CRTCs in drm_atomic_helper_wait_for_dependencies().
+ * The ioctl returns once the new state is swapped in; in-fences, the plane
+ * programming and the wait for the firmware are all done by the worker.
+ */
+static int rtk_drm_atomic_commit(struct drm_device *dev,
+				 struct drm_atomic_state *state,
+				 bool nonblock)
+{
+	struct rtk_drm_private *priv = dev->dev_private;
+	int ret;
+
+	if (state->async_update) {
+		ret = drm_atomic_helper_prepare_planes(dev, state);
+		if (ret)
+			return ret;
+
+		drm_atomic_helper_async_commit(dev, state);
+		drm_atomic_helper_cleanup_planes(dev, state);
+
+		return 0;
+	}
+
+	ret = drm_atomic_helper_setup_commit(state, nonblock);
+	if (ret)
+		return ret;
+
+	INIT_WORK(&state->commit_work, rtk_drm_commit_work);
+
+	ret = drm_atomic_helper_prepare_planes(dev, state);
+	if (ret)
+		return ret;
+
+	if (!nonblock) {
+		ret = drm_atomic_helper_wait_for_fences(dev, state, true);
+		if (ret)
+			goto err;
+	}
+
+	ret = drm_atomic_helper_swap_state(state, true);
+	if (ret)
+		goto err;
+
+	drm_atomic_state_get(state);
+
+	if (nonblock)
+		queue_work(priv->commit_wq, &state->commit_work);
+	else
+		rtk_drm_commit_tail(state);
+
+	return 0;
+
+err:
+	drm_atomic_helper_cleanup_planes(dev, state);
+	return ret;
+}
+
 static struct drm_mode_config_helper_funcs rtk_drm_mode_config_helpers = {
 	.atomic_commit_tail = rtk_drm_atomic_commit_tail,
 };
@@ -245,7 +338,7 @@ static const struct drm_mode_config_funcs rtk_drm_mode_config_funcs = {
 	.get_format_info = rtk_drm_get_format_info,
 	.output_poll_changed = rtk_drm_output_poll_changed,
 	.atomic_check = drm_atomic_helper_check,
-	.atomic_commit = drm_atomic_helper_commit,
+	.atomic_commit = rtk_drm_atomic_commit,
 };
 
 void rtk_drm_mode_config_init(struct drm_device *dev)
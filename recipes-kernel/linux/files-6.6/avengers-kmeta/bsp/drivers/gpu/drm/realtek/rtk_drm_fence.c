@@ -197,7 +197,8 @@ int rtk_drm_fence_create(struct rtk_drm_fence *rtk_fence, s32 __user *out_fence_
 		goto create_error;
 	}
 
-	dma_fence_init(fence->fence, &rtk_drm_fence_ops, &rtk_fence->fence_lock, 0, 0);
+	dma_fence_init(fence->fence, &rtk_drm_fence_ops, &rtk_fence->fence_lock,
+		       rtk_fence->context, ++rtk_fence->seqno);
 
 	fence->fd = get_unused_fd_flags(O_CLOEXEC);
 	if (fence->fd < 0) {
@@ -260,6 +261,12 @@ int rtk_drm_fence_init(struct rtk_drm_plane *rtk_plane)
 	spin_lock_init(&rtk_fence->fence_lock);
 	spin_lock_init(&rtk_fence->idx_lock);
 
+	/*
+	 * Each plane is its own timeline, so sync_file merges in the
+	 * compositor keep fences of different planes apart.
+	 */
+	rtk_fence->context = dma_fence_context_alloc(1);
+
 	drm_flip_work_init(&rtk_fence->fence_signal_work, "fence_signal",
 			   fence_signal_worker);
 	INIT_LIST_HEAD(&rtk_fence->pending);
@@ -37,6 +37,10 @@ struct rtk_drm_fence {
 	struct list_head drop_list;
 
 	unsigned int idx;
+
+	/* out-fence timeline of the plane */
+	u64 context;
+	u64 seqno;
 };
 
 #endif
@@ -280,6 +280,8 @@ static int write_cmd_to_ringbuffer(struct rtk_drm_plane *rtk_plane, void *cmd)
 		write += size;
 		write = write < limit ? write : write - (limit - base);
 
+		/* the command must be visible before the new write pointer */
+		wmb();
 		rbHeader->writePtr = ipcReadULONG((u8 *)&write, type);
 
 		DRM_DEBUG_DRIVER("r:0x%x w:0x%x size:%u base:0x%x limit:0x%x\n",
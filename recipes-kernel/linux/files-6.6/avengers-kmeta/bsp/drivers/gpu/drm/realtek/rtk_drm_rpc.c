@@ -78,26 +78,46 @@ bool is_audio_heap(unsigned int dumb_flags)
 	return false;
 }
 
+/*
+ * The RPC arena and the inband ring buffers come from dma_alloc_coherent(),
+ * i.e. normal memory, so plain accesses are enough here. Only the big
+ * endian (ACPU) peer needs the words swapped.
+ */
 unsigned int ipcReadULONG(u8 *src, unsigned int type)
 {
-	if (type)
-		return readl(src);
-	else
-		return __be32_to_cpu(readl(src));
+	u32 val = READ_ONCE(*(u32 *)src);
+
+	return type ? val : __be32_to_cpu(val);
 }
 
 void ipcCopyMemory(void *p_des, void *p_src, unsigned long len, unsigned int type)
 {
-	unsigned char *des = (unsigned char *)p_des;
-	unsigned char *src = (unsigned char *)p_src;
-	int i;
+	u32 *des = p_des;
+	const u32 *src = p_src;
+	unsigned long i;
 
-	for (i = 0; i < len; i += 4) {
-		if (type)
-			writel(readl(&src[i]), &des[i]);
-		else
-			writel(__cpu_to_be32(readl(&src[i])), &des[i]);
+	if (type) {
+		memcpy(p_des, p_src, len);
+		return;
 	}
+
+	for (i = 0; i < DIV_ROUND_UP(len, 4); i++)
+		des[i] = __cpu_to_be32(src[i]);
+}
+
+static inline void rtk_rpc_lock(struct rtk_rpc_info *rpc_info)
+{
+	mutex_lock(&rpc_info->lock);
+}
+
+static inline void rtk_rpc_unlock(struct rtk_rpc_info *rpc_info)
+{
+	mutex_unlock(&rpc_info->lock);
+}
+
+static inline bool rtk_rpc_in_batch(struct rtk_rpc_info *rpc_info)
+{
+	return READ_ONCE(rpc_info->batch_owner) == current;
 }
 
 void rpc_send_interrupt(struct rtk_rpc_info *rpc_info)
@@ -264,16 +284,12 @@ int drm_ept_init(struct rtk_krpc_ept_info *krpc_ept_info)
 	return ret;
 }
 
-static char *prepare_rpc_data(struct rtk_krpc_ept_info *krpc_ept_info, uint32_t command, uint32_t param1, uint32_t param2, int *len)
+#define RPC_MSG_SIZE (sizeof(struct rpc_struct) + 3 * sizeof(uint32_t))
+
+static int prepare_rpc_data(struct rtk_krpc_ept_info *krpc_ept_info, char *buf, uint32_t command, uint32_t param1, uint32_t param2)
 {
 	struct rpc_struct *rpc;
 	uint32_t *tmp;
-	char *buf;
-
-	*len = sizeof(struct rpc_struct) + 3 * sizeof(uint32_t);
-	buf = kmalloc(sizeof(struct rpc_struct) + 3 * sizeof(uint32_t), GFP_KERNEL);
-	if (!buf)
-		return ERR_PTR(-ENOMEM);
 
 	rpc = (struct rpc_struct *)buf;
 	rpc->programID = KERNELID;
@@ -289,50 +305,183 @@ static char *prepare_rpc_data(struct rtk_krpc_ept_info *krpc_ept_info, uint32_t
 	*(tmp+1) = param1;
 	*(tmp+2) = param2;
 
-	return buf;
+	return RPC_MSG_SIZE;
 }
 
-int drm_send_rpc(struct device *dev, struct rtk_krpc_ept_info *krpc_ept_info, char *buf, int len, uint32_t *retval)
+static int __drm_send_rpc(struct device *dev, struct rtk_krpc_ept_info *krpc_ept_info, char *buf, int len, uint32_t *retval)
 {
 	int ret = 0;
 
-	mutex_lock(&krpc_ept_info->send_mutex);
-
 	krpc_ept_info->retval = retval;
 	ret = rtk_send_rpc(krpc_ept_info, buf, len);
 	if (ret < 0) {
 		pr_err("[%s] send rpc failed\n", krpc_ept_info->name);
-		mutex_unlock(&krpc_ept_info->send_mutex);
 		return ret;
 	}
 	if (!wait_for_completion_timeout(&krpc_ept_info->ack, RPC_TIMEOUT)) {
 		dev_err(dev, "kernel rpc timeout: %s...\n", krpc_ept_info->name);
 		rtk_krpc_dump_ringbuf_info(krpc_ept_info);
-		mutex_unlock(&krpc_ept_info->send_mutex);
 		return -EINVAL;
 	}
-	mutex_unlock(&krpc_ept_info->send_mutex);
 
 	return 0;
 }
 
+int drm_send_rpc(struct device *dev, struct rtk_krpc_ept_info *krpc_ept_info, char *buf, int len, uint32_t *retval)
+{
+	int ret;
+
+	mutex_lock(&krpc_ept_info->send_mutex);
+	ret = __drm_send_rpc(dev, krpc_ept_info, buf, len, retval);
+	mutex_unlock(&krpc_ept_info->send_mutex);
+
+	return ret;
+}
+
+/*
+ * Collect the reply of the posted RPC still in flight, if any. Replies on
+ * the endpoint are not matched to requests, so this runs under send_mutex
+ * before anything else goes out.
+ */
+static void __rpc_reap_posted(struct rtk_rpc_info *rpc_info)
+{
+	struct rtk_krpc_ept_info *krpc_ept_info = rpc_info->krpc_ept_info;
+	uint32_t result;
+
+	lockdep_assert_held(&krpc_ept_info->send_mutex);
+
+	if (!rpc_info->posted)
+		return;
+
+	rpc_info->posted = false;
+
+	if (!wait_for_completion_timeout(&krpc_ept_info->ack, RPC_TIMEOUT)) {
+		dev_err(rpc_info->dev, "kernel rpc timeout: %s (posted cmd %u)...\n",
+			krpc_ept_info->name, rpc_info->posted_cmd);
+		rtk_krpc_dump_ringbuf_info(krpc_ept_info);
+	} else {
+		result = rpc_info->posted_result->result;
+		if (rpc_info->krpc_vo_opt == RPC_AUDIO)
+			result = ntohl(result);
+
+		if (result != S_OK || rpc_info->posted_ret != S_OK)
+			dev_err(rpc_info->dev, "posted rpc %u failed\n",
+				rpc_info->posted_cmd);
+	}
+}
+
+static void rpc_reap_posted(struct rtk_rpc_info *rpc_info)
+{
+	struct rtk_krpc_ept_info *krpc_ept_info = rpc_info->krpc_ept_info;
+
+	if (IS_ERR_OR_NULL(krpc_ept_info))
+		return;
+
+	mutex_lock(&krpc_ept_info->send_mutex);
+	__rpc_reap_posted(rpc_info);
+	mutex_unlock(&krpc_ept_info->send_mutex);
+}
+
 static int send_rpc(struct rtk_rpc_info *rpc_info, uint32_t command, uint32_t param1, uint32_t param2, uint32_t *retval)
 {
-	int ret = 0;
-	char *buf;
+	struct rtk_krpc_ept_info *krpc_ept_info = rpc_info->krpc_ept_info;
+	u32 buf[RPC_MSG_SIZE / sizeof(u32)];
 	int len;
+	int ret;
 
-	if (!IS_ERR_OR_NULL(rpc_info->krpc_ept_info)) {
-		buf = prepare_rpc_data(rpc_info->krpc_ept_info, command, param1, param2, &len);
-		if (!IS_ERR(buf)) {
-			ret = drm_send_rpc(rpc_info->dev, rpc_info->krpc_ept_info, buf, len, retval);
-			kfree(buf);
-		}
-	}
+	if (IS_ERR_OR_NULL(krpc_ept_info))
+		return 0;
+
+	len = prepare_rpc_data(krpc_ept_info, (char *)buf, command, param1, param2);
+
+	mutex_lock(&krpc_ept_info->send_mutex);
+	__rpc_reap_posted(rpc_info);
+	ret = __drm_send_rpc(rpc_info->dev, krpc_ept_info, (char *)buf, len, retval);
+	mutex_unlock(&krpc_ept_info->send_mutex);
 
 	return ret;
 }
 
+/*
+ * Send an RPC whose result the caller does not need without waiting for
+ * the reply. Only used inside a batch: the reply is collected before the
+ * next RPC goes out on the endpoint, whoever sends it, or when the batch
+ * ends, and a failure is only logged. The arguments stay in the current
+ * arena slot while the next call fills the other one. send_mutex is not
+ * held while the reply is outstanding; rpc_info->posted tracks it.
+ */
+static int send_rpc_posted(struct rtk_rpc_info *rpc_info, uint32_t command, unsigned int offset)
+{
+	struct rtk_krpc_ept_info *krpc_ept_info = rpc_info->krpc_ept_info;
+	u32 buf[RPC_MSG_SIZE / sizeof(u32)];
+	int len;
+	int ret;
+
+	if (IS_ERR_OR_NULL(krpc_ept_info))
+		return 0;
+
+	len = prepare_rpc_data(krpc_ept_info, (char *)buf, command,
+			       rpc_info->paddr, rpc_info->paddr + offset);
+
+	mutex_lock(&krpc_ept_info->send_mutex);
+
+	__rpc_reap_posted(rpc_info);
+
+	krpc_ept_info->retval = &rpc_info->posted_ret;
+	ret = rtk_send_rpc(krpc_ept_info, (char *)buf, len);
+	if (ret < 0) {
+		pr_err("[%s] send rpc failed\n", krpc_ept_info->name);
+		mutex_unlock(&krpc_ept_info->send_mutex);
+		return ret;
+	}
+
+	rpc_info->posted = true;
+	rpc_info->posted_cmd = command;
+	rpc_info->posted_result = (struct rpc_result *)((unsigned char *)rpc_info->vaddr + offset);
+
+	mutex_unlock(&krpc_ept_info->send_mutex);
+
+	rpc_info->slot = (rpc_info->slot + 1) % RPC_ARENA_SLOTS;
+	rpc_info->vaddr = rpc_info->arena_vaddr + rpc_info->slot * RPC_CMD_BUFFER_SIZE;
+	rpc_info->paddr = rpc_info->arena_paddr + rpc_info->slot * RPC_CMD_BUFFER_SIZE;
+
+	return 0;
+}
+
+/**
+ * rtk_rpc_batch_begin() - Start collecting the RPCs of one atomic commit
+ * @rpc_info: RPC channel of the CRTC being committed
+ *
+ * Until the matching rtk_rpc_batch_end(), RPCs of the calling task whose
+ * result it does not need are posted instead of waited on. Other tasks
+ * keep sending on @rpc_info in between, only a second batch waits for
+ * this one. Batches nest, so CRTCs sharing a channel can each open one.
+ */
+void rtk_rpc_batch_begin(struct rtk_rpc_info *rpc_info)
+{
+	if (rtk_rpc_in_batch(rpc_info)) {
+		rpc_info->batch_depth++;
+		return;
+	}
+
+	mutex_lock(&rpc_info->batch_lock);
+	WRITE_ONCE(rpc_info->batch_owner, current);
+	rpc_info->batch_depth = 1;
+}
+
+void rtk_rpc_batch_end(struct rtk_rpc_info *rpc_info)
+{
+	if (WARN_ON(!rtk_rpc_in_batch(rpc_info)))
+		return;
+
+	if (--rpc_info->batch_depth)
+		return;
+
+	rpc_reap_posted(rpc_info);
+	WRITE_ONCE(rpc_info->batch_owner, NULL);
+	mutex_unlock(&rpc_info->batch_lock);
+}
+
 int rpc_destroy_video_agent(struct rtk_rpc_info *rpc_info, u32 pinId)
 {
 	struct rpc_create_video_agent *rpc = NULL;
@@ -341,13 +490,13 @@ int rpc_destroy_video_agent(struct rtk_rpc_info *rpc_info, u32 pinId)
 	int ret = -1;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_create_video_agent *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(rpc->instance), RPC_ALIGN_SZ);
 	retval = (struct rpc_result *)((unsigned char *)rpc + offset);
 
-	memset_io(rpc, 0, sizeof(*rpc));
+	memset(rpc, 0, sizeof(*rpc));
 
 	opt = rpc_info->krpc_vo_opt;
 
@@ -369,7 +518,7 @@ int rpc_destroy_video_agent(struct rtk_rpc_info *rpc_info, u32 pinId)
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -381,13 +530,13 @@ int rpc_create_video_agent(struct rtk_rpc_info *rpc_info, u32 *videoId, u32 pinI
 	int ret = -1;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_create_video_agent *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(rpc->instance), RPC_ALIGN_SZ);
 	retval = (struct rpc_result *)((unsigned char *)rpc + offset);
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	opt = rpc_info->krpc_vo_opt;
 
@@ -416,7 +565,7 @@ int rpc_create_video_agent(struct rtk_rpc_info *rpc_info, u32 *videoId, u32 pinI
 	*videoId = retval->data;
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -429,13 +578,13 @@ int rpc_video_display(struct rtk_rpc_info *rpc_info,
 	int ret = -1;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_vo_filter_display *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*argp), RPC_ALIGN_SZ);
 	retval = (struct rpc_result *)((unsigned char *)rpc + offset);
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	opt = rpc_info->krpc_vo_opt;
 
@@ -459,7 +608,7 @@ int rpc_video_display(struct rtk_rpc_info *rpc_info,
 		goto exit;
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -472,13 +621,13 @@ int rpc_video_config_disp_win(struct rtk_rpc_info *rpc_info,
 	int ret = -1;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_config_disp_win *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*argp), RPC_ALIGN_SZ);
 	retval = (struct rpc_result *)((unsigned char *)rpc + offset);
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	opt = rpc_info->krpc_vo_opt;
 
@@ -500,6 +649,16 @@ int rpc_video_config_disp_win(struct rtk_rpc_info *rpc_info,
 		rpc->borderColor.isRGB = htons(argp->borderColor.isRGB);
 		rpc->enBorder = argp->enBorder;
 	}
+
+	if (rtk_rpc_in_batch(rpc_info)) {
+		if (send_rpc_posted(rpc_info,
+				ENUM_VIDEO_KERNEL_RPC_CONFIGUREDISPLAYWINDOW,
+				offset))
+			goto exit;
+		ret = 0;
+		goto exit;
+	}
+
 	if (send_rpc(rpc_info,
 			     ENUM_VIDEO_KERNEL_RPC_CONFIGUREDISPLAYWINDOW,
 			     rpc_info->paddr, rpc_info->paddr + offset,
@@ -513,7 +672,7 @@ int rpc_video_config_disp_win(struct rtk_rpc_info *rpc_info,
 		goto exit;
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -527,13 +686,13 @@ int rpc_video_query_dis_win(struct rtk_rpc_info *rpc_info,
 	int ret = -1;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	i_rpc = (struct rpc_query_disp_win_in *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*argp_in), RPC_ALIGN_SZ);
 	o_rpc = (struct rpc_query_disp_win_out *)((unsigned char *)i_rpc + offset);
 
-	memset_io(i_rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(i_rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	opt = rpc_info->krpc_vo_opt;
 
@@ -569,7 +728,7 @@ int rpc_video_query_dis_win(struct rtk_rpc_info *rpc_info,
 	}
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -582,13 +741,13 @@ int rpc_video_config_graphic(struct rtk_rpc_info *rpc_info,
 	int ret = -1;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_config_graphic_canvas *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*argp), RPC_ALIGN_SZ);
 	retval = (struct rpc_result *)((unsigned char *)rpc + offset);
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	opt = rpc_info->krpc_vo_opt;
 
@@ -622,7 +781,7 @@ int rpc_video_config_graphic(struct rtk_rpc_info *rpc_info,
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -635,13 +794,13 @@ int rpc_video_set_refclock(struct rtk_rpc_info *rpc_info,
 	int ret = -1;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_refclock *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*argp), RPC_ALIGN_SZ);
 	retval = (struct rpc_result *)((unsigned char *)rpc + offset);
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	opt = rpc_info->krpc_vo_opt;
 
@@ -664,7 +823,7 @@ int rpc_video_set_refclock(struct rtk_rpc_info *rpc_info,
 		goto exit;
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -677,13 +836,13 @@ int rpc_video_init_ringbuffer(struct rtk_rpc_info *rpc_info,
 	int ret = -1;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_ringbuffer *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*argp), RPC_ALIGN_SZ);
 	retval = (struct rpc_result *)((unsigned char *)rpc + offset);
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	opt = rpc_info->krpc_vo_opt;
 
@@ -708,7 +867,7 @@ int rpc_video_init_ringbuffer(struct rtk_rpc_info *rpc_info,
 		goto exit;
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -721,13 +880,13 @@ int rpc_video_run_cmd(struct rtk_rpc_info *rpc_info, unsigned int instance,
 	int ret = -1;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (unsigned int *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(unsigned int), RPC_ALIGN_SZ);
 	retval = (struct rpc_result *)((unsigned char *)rpc + offset);
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	opt = rpc_info->krpc_vo_opt;
 
@@ -748,7 +907,7 @@ int rpc_video_run_cmd(struct rtk_rpc_info *rpc_info, unsigned int instance,
 		goto exit;
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -786,14 +945,14 @@ int rpc_video_set_q_param(struct rtk_rpc_info *rpc_info,
 	int opt;
 	uint32_t type;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_set_q_param *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
 	opt = rpc_info->krpc_vo_opt;
 	type = (opt != RPC_AUDIO) ? 1:0;
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	ipcCopyMemory((unsigned char *)rpc, (unsigned char *)arg,
 			sizeof(struct rpc_set_q_param), type);
@@ -809,7 +968,7 @@ int rpc_video_set_q_param(struct rtk_rpc_info *rpc_info,
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -822,14 +981,14 @@ int rpc_video_config_channel_lowdelay(struct rtk_rpc_info *rpc_info, struct rpc_
 	int opt;
 	uint32_t type;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_config_channel_lowdelay *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
 	opt = rpc_info->krpc_vo_opt;
 	type = (opt != RPC_AUDIO) ? 1:0;
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	ipcCopyMemory((unsigned char *)rpc, (unsigned char *)arg,
 			sizeof(struct rpc_config_channel_lowdelay), type);
@@ -845,7 +1004,7 @@ int rpc_video_config_channel_lowdelay(struct rtk_rpc_info *rpc_info, struct rpc_
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 
 }
@@ -859,14 +1018,14 @@ int rpc_video_privateinfo_param(struct rtk_rpc_info *rpc_info, struct rpc_privat
 	int opt;
 	uint32_t type;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_privateinfo_param *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
 	opt = rpc_info->krpc_vo_opt;
 	type = (opt != RPC_AUDIO) ? 1:0;
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	ipcCopyMemory((unsigned char *)rpc, (unsigned char *)arg,
 			sizeof(struct rpc_privateinfo_param), type);
@@ -882,7 +1041,7 @@ int rpc_video_privateinfo_param(struct rtk_rpc_info *rpc_info, struct rpc_privat
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 
 }
@@ -897,14 +1056,14 @@ int rpc_video_query_disp_win_new(struct rtk_rpc_info *rpc_info,
 	int ret = -1;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	i_rpc = (struct rpc_query_disp_win_in *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*argp_in), RPC_ALIGN_SZ);
 	o_rpc = (struct rpc_query_disp_win_out_new *)((unsigned char *)i_rpc + offset);
 	opt = rpc_info->krpc_vo_opt;
 
-	memset_io(i_rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(i_rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	if (opt != RPC_AUDIO)
 		i_rpc->plane = argp_in->plane;
@@ -961,7 +1120,7 @@ int rpc_video_query_disp_win_new(struct rtk_rpc_info *rpc_info,
 	}
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -974,14 +1133,14 @@ int rpc_video_set_speed(struct rtk_rpc_info *rpc_info, struct rpc_set_speed *arg
 	int opt;
 	uint32_t type;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_set_speed *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
 	opt = rpc_info->krpc_vo_opt;
 	type = (opt != RPC_AUDIO) ? 1:0;
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	ipcCopyMemory((unsigned char *)rpc, (unsigned char *)arg,
 			sizeof(struct rpc_set_speed), type);
@@ -997,7 +1156,7 @@ int rpc_video_set_speed(struct rtk_rpc_info *rpc_info, struct rpc_set_speed *arg
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -1010,13 +1169,13 @@ int rpc_video_set_background(struct rtk_rpc_info *rpc_info,
 	int ret = -1;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_set_background *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
 	opt = rpc_info->krpc_vo_opt;
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	if (opt != RPC_AUDIO) {
 		memcpy(rpc, arg, sizeof(*arg));
@@ -1039,7 +1198,7 @@ int rpc_video_set_background(struct rtk_rpc_info *rpc_info,
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -1052,14 +1211,14 @@ int rpc_video_keep_curpic(struct rtk_rpc_info *rpc_info, struct rpc_keep_curpic
 	int opt;
 	uint32_t type;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_keep_curpic *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
 	opt = rpc_info->krpc_vo_opt;
 	type = (opt != RPC_AUDIO) ? 1:0;
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	ipcCopyMemory((unsigned char *)rpc, (unsigned char *)arg,
 			sizeof(struct rpc_keep_curpic), type);
@@ -1075,7 +1234,7 @@ int rpc_video_keep_curpic(struct rtk_rpc_info *rpc_info, struct rpc_keep_curpic
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -1088,14 +1247,14 @@ int rpc_video_keep_curpic_fw(struct rtk_rpc_info *rpc_info, struct rpc_keep_curp
 	int opt;
 	uint32_t type;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_keep_curpic *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
 	opt = rpc_info->krpc_vo_opt;
 	type = (opt != RPC_AUDIO) ? 1:0;
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	ipcCopyMemory((unsigned char *)rpc, (unsigned char *)arg,
 			sizeof(struct rpc_keep_curpic), type);
@@ -1111,7 +1270,7 @@ int rpc_video_keep_curpic_fw(struct rtk_rpc_info *rpc_info, struct rpc_keep_curp
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -1124,14 +1283,14 @@ int rpc_video_keep_curpic_svp(struct rtk_rpc_info *rpc_info, struct rpc_keep_cur
 	int opt;
 	uint32_t type;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_keep_curpic_svp *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
 	opt = rpc_info->krpc_vo_opt;
 	type = (opt != RPC_AUDIO) ? 1:0;
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	ipcCopyMemory((unsigned char *)rpc, (unsigned char *)arg,
 			sizeof(struct rpc_keep_curpic_svp), type);
@@ -1147,7 +1306,7 @@ int rpc_video_keep_curpic_svp(struct rtk_rpc_info *rpc_info, struct rpc_keep_cur
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -1160,14 +1319,14 @@ int rpc_video_set_deintflag(struct rtk_rpc_info *rpc_info, struct rpc_set_deintf
 	int opt;
 	uint32_t type;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_set_deintflag *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
 	opt = rpc_info->krpc_vo_opt;
 	type = (opt != RPC_AUDIO) ? 1:0;
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	ipcCopyMemory((unsigned char *)rpc, (unsigned char *)arg,
 			sizeof(struct rpc_set_deintflag), type);
@@ -1183,7 +1342,7 @@ int rpc_video_set_deintflag(struct rtk_rpc_info *rpc_info, struct rpc_set_deintf
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -1195,13 +1354,13 @@ int rpc_video_create_graphic_win(struct rtk_rpc_info *rpc_info, struct rpc_creat
 	int ret = -1;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_create_graphic_win *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
 	opt = rpc_info->krpc_vo_opt;
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	if (opt != RPC_AUDIO) {
 		memcpy(rpc, arg, sizeof(*arg));
@@ -1228,7 +1387,7 @@ int rpc_video_create_graphic_win(struct rtk_rpc_info *rpc_info, struct rpc_creat
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -1241,13 +1400,13 @@ int rpc_video_draw_graphic_win(struct rtk_rpc_info *rpc_info, struct rpc_draw_gr
 	int i;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_draw_graphic_win *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
 	opt = rpc_info->krpc_vo_opt;
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	if (opt != RPC_AUDIO) {
 		memcpy(rpc, arg, sizeof(*arg));
@@ -1279,7 +1438,7 @@ int rpc_video_draw_graphic_win(struct rtk_rpc_info *rpc_info, struct rpc_draw_gr
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -1291,13 +1450,13 @@ int rpc_video_modify_graphic_win(struct rtk_rpc_info *rpc_info, struct rpc_modif
 	int ret = -1, i;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_modify_graphic_win *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
 	opt = rpc_info->krpc_vo_opt;
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	if (opt != RPC_AUDIO) {
 		memcpy(rpc, arg, sizeof(*arg));
@@ -1338,7 +1497,7 @@ int rpc_video_modify_graphic_win(struct rtk_rpc_info *rpc_info, struct rpc_modif
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -1350,13 +1509,13 @@ int rpc_video_delete_graphic_win(struct rtk_rpc_info *rpc_info, struct rpc_delet
 	int ret = -1;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_delete_graphic_win *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
 	opt = rpc_info->krpc_vo_opt;
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	if (opt != RPC_AUDIO) {
 		memcpy(rpc, arg, sizeof(*arg));
@@ -1377,7 +1536,7 @@ int rpc_video_delete_graphic_win(struct rtk_rpc_info *rpc_info, struct rpc_delet
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -1389,13 +1548,13 @@ int rpc_video_config_osd_palette(struct rtk_rpc_info *rpc_info, struct rpc_confi
 	int ret = -1;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_config_osd_palette *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
 	opt = rpc_info->krpc_vo_opt;
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	if (opt != RPC_AUDIO) {
 		memcpy(rpc, arg, sizeof(*arg));
@@ -1415,7 +1574,7 @@ int rpc_video_config_osd_palette(struct rtk_rpc_info *rpc_info, struct rpc_confi
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -1427,13 +1586,13 @@ int rpc_video_config_plane_mixer(struct rtk_rpc_info *rpc_info, struct rpc_confi
 	int ret = -1, i;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_config_plane_mixer *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
 	opt = rpc_info->krpc_vo_opt;
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	if (opt != RPC_AUDIO) {
 		memcpy(rpc, arg, sizeof(*arg));
@@ -1462,7 +1621,7 @@ int rpc_video_config_plane_mixer(struct rtk_rpc_info *rpc_info, struct rpc_confi
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -1475,14 +1634,14 @@ int rpc_video_set_sdrflag(struct rtk_rpc_info *rpc_info, struct rpc_set_sdrflag
 	int opt;
 	uint32_t type;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_set_sdrflag *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
 	opt = rpc_info->krpc_vo_opt;
 	type = (opt != RPC_AUDIO) ? 1:0;
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	ipcCopyMemory((unsigned char *)rpc, (unsigned char *)arg,
 			sizeof(struct rpc_set_sdrflag), type);
@@ -1498,7 +1657,7 @@ int rpc_video_set_sdrflag(struct rtk_rpc_info *rpc_info, struct rpc_set_sdrflag
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -1513,13 +1672,13 @@ int rpc_video_set_display_ratio(struct rtk_rpc_info *rpc_info, u32 ratio)
 	if (ratio == 0 || ratio > 100)
 		return -EINVAL;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	i_rpc = (struct rpc_privateinfo_param *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(struct rpc_privateinfo_param), RPC_ALIGN_SZ);
 	opt = rpc_info->krpc_vo_opt;
 
-	memset_io(i_rpc, 0, sizeof(*i_rpc));
+	memset(i_rpc, 0, sizeof(*i_rpc));
 
 	if (opt != RPC_AUDIO) {
 		i_rpc->instanceId = 0;
@@ -1536,7 +1695,7 @@ int rpc_video_set_display_ratio(struct rtk_rpc_info *rpc_info, u32 ratio)
 			rpc_info->paddr, rpc_info->paddr + offset,
 			&rpc_ret);
 
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 
 	return ret;
 }
@@ -1553,18 +1712,18 @@ int rpc_set_spd_infoframe(struct rtk_rpc_info *rpc_info,
 	int ret;
 	int opt;
 
-	memset_io(vendor, 0, sizeof(vendor));
-	memset_io(product, 0, sizeof(product));
+	memset(vendor, 0, sizeof(vendor));
+	memset(product, 0, sizeof(product));
 	memcpy(vendor, vendor_str, min(sizeof(vendor), strlen(vendor_str)));
 	memcpy(product, product_str, min(sizeof(product), strlen(product_str)));
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	i_rpc = (struct rpc_privateinfo_param *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(struct rpc_privateinfo_param), RPC_ALIGN_SZ);
 	opt = rpc_info->krpc_vo_opt;
 
-	memset_io(i_rpc, 0, sizeof(*i_rpc));
+	memset(i_rpc, 0, sizeof(*i_rpc));
 
 	if (opt != RPC_AUDIO) {
 		i_rpc->instanceId = 0;
@@ -1601,7 +1760,7 @@ int rpc_set_spd_infoframe(struct rtk_rpc_info *rpc_info,
 			rpc_info->paddr, rpc_info->paddr + offset,
 			&rpc_ret);
 
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 
 	return ret;
 }
@@ -1615,13 +1774,13 @@ int rpc_set_infoframe(struct rtk_rpc_info *rpc_info, unsigned int flag,
 	int ret;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	i_rpc = (struct rpc_privateinfo_param *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(struct rpc_privateinfo_param), RPC_ALIGN_SZ);
 	opt = rpc_info->krpc_vo_opt;
 
-	memset_io(i_rpc, 0, sizeof(*i_rpc));
+	memset(i_rpc, 0, sizeof(*i_rpc));
 
 	if (opt != RPC_AUDIO) {
 		i_rpc->instanceId = 0;
@@ -1642,7 +1801,7 @@ int rpc_set_infoframe(struct rtk_rpc_info *rpc_info, unsigned int flag,
 			rpc_info->paddr, rpc_info->paddr + offset,
 			&rpc_ret);
 
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 
 	return ret;
 }
@@ -1657,13 +1816,13 @@ int rpc_send_edid_raw_data(struct rtk_rpc_info *rpc_info,
 	unsigned long edid_offset;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_vout_edid_raw_data *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(struct rpc_vout_edid_raw_data), RPC_ALIGN_SZ);
 	opt = rpc_info->krpc_vo_opt;
 	edid_offset = offset * 2;
-	memset_io(rpc, 0, sizeof(*rpc));
+	memset(rpc, 0, sizeof(*rpc));
 
 	memcpy(rpc_info->vaddr + edid_offset, edid_data, edid_size);
 
@@ -1683,7 +1842,7 @@ int rpc_send_edid_raw_data(struct rtk_rpc_info *rpc_info,
 		goto exit;
 
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -1695,7 +1854,7 @@ int rpc_set_hdmi_audio_onoff(struct rtk_rpc_info *rpc_info_ao,
 	uint32_t rpc_ret;
 	int ret;
 
-	mutex_lock(&rpc_info_ao->lock);
+	rtk_rpc_lock(rpc_info_ao);
 
 	if (rpc_info_ao->ao_in_hifi == NULL) {
 		ret = -ENXIO;
@@ -1705,7 +1864,7 @@ int rpc_set_hdmi_audio_onoff(struct rtk_rpc_info *rpc_info_ao,
 	rpc = (struct rpc_audio_ctrl_data *)rpc_info_ao->vaddr;
 	offset = ALIGN(sizeof(struct rpc_audio_ctrl_data), RPC_ALIGN_SZ);
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	if (*rpc_info_ao->ao_in_hifi) {
 		rpc->version = arg->version;
@@ -1730,7 +1889,7 @@ int rpc_set_hdmi_audio_onoff(struct rtk_rpc_info *rpc_info_ao,
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info_ao->lock);
+	rtk_rpc_unlock(rpc_info_ao);
 	return ret;
 }
 
@@ -1742,7 +1901,7 @@ int rpc_send_hdmi_freq(struct rtk_rpc_info *rpc_info_ao,
 	uint32_t rpc_ret;
 	int ret;
 
-	mutex_lock(&rpc_info_ao->lock);
+	rtk_rpc_lock(rpc_info_ao);
 
 	if (rpc_info_ao->ao_in_hifi == NULL) {
 		ret = -ENXIO;
@@ -1752,7 +1911,7 @@ int rpc_send_hdmi_freq(struct rtk_rpc_info *rpc_info_ao,
 	rpc = (struct rpc_audio_hdmi_freq *)rpc_info_ao->vaddr;
 	offset = ALIGN(sizeof(struct rpc_audio_hdmi_freq), RPC_ALIGN_SZ);
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	if (*rpc_info_ao->ao_in_hifi) {
 		rpc->tmds_freq = arg->tmds_freq;
@@ -1764,7 +1923,7 @@ int rpc_send_hdmi_freq(struct rtk_rpc_info *rpc_info_ao,
 			rpc_info_ao->paddr, rpc_info_ao->paddr + offset,
 			&rpc_ret);
 exit:
-	mutex_unlock(&rpc_info_ao->lock);
+	rtk_rpc_unlock(rpc_info_ao);
 	return ret;
 }
 
@@ -1777,7 +1936,7 @@ int rpc_set_vrr(struct rtk_rpc_info *rpc_info,
 	int ret = -EIO, i;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_vout_hdmi_vrr *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
@@ -1800,7 +1959,7 @@ int rpc_set_vrr(struct rtk_rpc_info *rpc_info,
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -1814,7 +1973,7 @@ int rpc_query_out_interface(struct rtk_rpc_info *rpc_info,
 	int ret = -EIO;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	i_rpc = (struct rpc_set_display_out_interface *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
@@ -1846,7 +2005,7 @@ int rpc_query_out_interface(struct rtk_rpc_info *rpc_info,
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -1859,7 +2018,7 @@ int rpc_set_out_interface(struct rtk_rpc_info *rpc_info,
 	int ret = -EIO;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_set_display_out_interface *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
@@ -1888,7 +2047,7 @@ int rpc_set_out_interface(struct rtk_rpc_info *rpc_info,
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -1901,7 +2060,7 @@ int rpc_hw_init_out_interface(struct rtk_rpc_info *rpc_info,
 	int ret = -EIO;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_hw_init_display_out_interface *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
@@ -1958,7 +2117,7 @@ int rpc_hw_init_out_interface(struct rtk_rpc_info *rpc_info,
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -1972,7 +2131,7 @@ int rpc_query_out_interface_timing(struct rtk_rpc_info *rpc_info,
 	int ret = -EIO;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	i_rpc = (struct rpc_query_display_out_interface_timing *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
@@ -2020,7 +2179,7 @@ int rpc_query_out_interface_timing(struct rtk_rpc_info *rpc_info,
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -2034,7 +2193,7 @@ int rpc_query_display_panel_usage(struct rtk_rpc_info *rpc_info,
 	int ret = -EIO;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	i_rpc = (struct rpc_query_display_panel_usage *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
@@ -2062,7 +2221,7 @@ int rpc_query_display_panel_usage(struct rtk_rpc_info *rpc_info,
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -2076,7 +2235,7 @@ int rpc_query_panel_usage_pos(struct rtk_rpc_info *rpc_info,
 	int ret = -EIO;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	i_rpc = (struct rpc_query_panel_usage_pos *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
@@ -2106,7 +2265,7 @@ int rpc_query_panel_usage_pos(struct rtk_rpc_info *rpc_info,
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -2120,7 +2279,7 @@ int rpc_query_panel_cluster_size(struct rtk_rpc_info *rpc_info,
 	int ret = -EIO;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	i_rpc = (struct rpc_query_panel_cluster_size *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*arg), RPC_ALIGN_SZ);
@@ -2144,7 +2303,7 @@ int rpc_query_panel_cluster_size(struct rtk_rpc_info *rpc_info,
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -2158,13 +2317,13 @@ int rpc_query_mixer_by_plane(struct rtk_rpc_info *rpc_info,
 	int ret = -1;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	i_rpc = (struct rpc_query_mixer_by_plane_in *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(*argp_in), RPC_ALIGN_SZ);
 	o_rpc = (struct rpc_query_mixer_by_plane_out *)((unsigned char *)i_rpc + offset);
 
-	memset_io(i_rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(i_rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	opt = rpc_info->krpc_vo_opt;
 
@@ -2193,7 +2352,7 @@ int rpc_query_mixer_by_plane(struct rtk_rpc_info *rpc_info,
 	}
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -2207,7 +2366,7 @@ int rpc_query_tv_system(struct rtk_rpc_info *rpc_info,
 	int ret = -EIO, i;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	if (rpc_info->hdmi_new_mac == NULL) {
 		ret = -ENXIO;
@@ -2253,7 +2412,7 @@ int rpc_query_tv_system(struct rtk_rpc_info *rpc_info,
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -2266,7 +2425,7 @@ int rpc_set_tv_system(struct rtk_rpc_info *rpc_info,
 	int ret = -EIO, i;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	if (rpc_info->hdmi_new_mac == NULL) {
 		ret = -ENXIO;
@@ -2312,7 +2471,7 @@ int rpc_set_tv_system(struct rtk_rpc_info *rpc_info,
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -2326,7 +2485,7 @@ int rpc_get_display_format(struct rtk_rpc_info *rpc_info,
 	int ret;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	if (rpc_info->hdmi_new_mac == NULL) {
 		ret = -ENXIO;
@@ -2379,7 +2538,7 @@ int rpc_get_display_format(struct rtk_rpc_info *rpc_info,
 
 	ret = 0;
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 
 }
@@ -2393,7 +2552,7 @@ int rpc_set_display_format(struct rtk_rpc_info *rpc_info,
 	int ret;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	if (rpc_info->hdmi_new_mac == NULL) {
 		ret = -ENXIO;
@@ -2409,7 +2568,7 @@ int rpc_set_display_format(struct rtk_rpc_info *rpc_info,
 	offset = ALIGN(sizeof(struct rpc_config_tv_system), RPC_ALIGN_SZ);
 	opt = rpc_info->krpc_vo_opt;
 
-	memset_io(i_rpc, 0, sizeof(*i_rpc));
+	memset(i_rpc, 0, sizeof(*i_rpc));
 
 	if (opt != RPC_AUDIO) {
 		memcpy(i_rpc, output_fmt, sizeof(*output_fmt));
@@ -2448,7 +2607,7 @@ int rpc_set_display_format(struct rtk_rpc_info *rpc_info,
 	ret = 0;
 
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -2460,7 +2619,7 @@ int rpc_set_hdmi_audio_mute(struct rtk_rpc_info *rpc_info_ao,
 	unsigned int rpc_ret;
 	int ret;
 
-	mutex_lock(&rpc_info_ao->lock);
+	rtk_rpc_lock(rpc_info_ao);
 
 	if (rpc_info_ao->ao_in_hifi == NULL) {
 		ret = -ENXIO;
@@ -2470,7 +2629,7 @@ int rpc_set_hdmi_audio_mute(struct rtk_rpc_info *rpc_info_ao,
 	i_rpc = (struct rpc_audio_mute_info *)rpc_info_ao->vaddr;
 	offset = ALIGN(sizeof(struct rpc_audio_mute_info), RPC_ALIGN_SZ);
 
-	memset_io(i_rpc, 0, sizeof(*i_rpc));
+	memset(i_rpc, 0, sizeof(*i_rpc));
 
 	if (*rpc_info_ao->ao_in_hifi) {
 		i_rpc->instanceID = mute_info->instanceID;
@@ -2491,7 +2650,7 @@ int rpc_set_hdmi_audio_mute(struct rtk_rpc_info *rpc_info_ao,
 	ret = 0;
 
 exit:
-	mutex_unlock(&rpc_info_ao->lock);
+	rtk_rpc_unlock(rpc_info_ao);
 	return ret;
 }
 
@@ -2505,14 +2664,14 @@ int rpc_set_cvbs_auto_detection(struct rtk_rpc_info *rpc_info,
 	int ret;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	i_rpc = (struct rpc_privateinfo_param *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(struct rpc_privateinfo_param), RPC_ALIGN_SZ);
 	o_rpc = (struct rpc_privateinfo_returnval *)((unsigned long)i_rpc + offset);
 	opt = rpc_info->krpc_vo_opt;
 
-	memset_io(i_rpc, 0, sizeof(*i_rpc));
+	memset(i_rpc, 0, sizeof(*i_rpc));
 
 	if (opt != RPC_AUDIO) {
 		i_rpc->instanceId = 0;
@@ -2529,7 +2688,7 @@ int rpc_set_cvbs_auto_detection(struct rtk_rpc_info *rpc_info,
 			rpc_info->paddr, rpc_info->paddr + offset,
 			&rpc_ret);
 
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 
 	return ret;
 }
@@ -2544,14 +2703,14 @@ int rpc_get_cvbs_format(struct rtk_rpc_info *rpc_info,
 	int ret;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	i_rpc = (struct rpc_privateinfo_param *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(struct rpc_privateinfo_param), RPC_ALIGN_SZ);
 	o_rpc = (struct rpc_privateinfo_returnval *)((unsigned long)i_rpc + offset);
 	opt = rpc_info->krpc_vo_opt;
 
-	memset_io(i_rpc, 0, sizeof(*i_rpc));
+	memset(i_rpc, 0, sizeof(*i_rpc));
 
 	if (opt != RPC_AUDIO) {
 		i_rpc->instanceId = 0;
@@ -2575,7 +2734,7 @@ int rpc_get_cvbs_format(struct rtk_rpc_info *rpc_info,
 		*p_cvbs_fmt = htonl(o_rpc->privateInfo[0]);
 
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -2588,13 +2747,13 @@ int rpc_set_cvbs_format(struct rtk_rpc_info *rpc_info,
 	int ret;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	i_rpc = (struct rpc_privateinfo_param *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(struct rpc_privateinfo_param), RPC_ALIGN_SZ);
 	opt = rpc_info->krpc_vo_opt;
 
-	memset_io(i_rpc, 0, sizeof(*i_rpc));
+	memset(i_rpc, 0, sizeof(*i_rpc));
 
 	if (opt != RPC_AUDIO) {
 		i_rpc->instanceId = 0;
@@ -2611,7 +2770,7 @@ int rpc_set_cvbs_format(struct rtk_rpc_info *rpc_info,
 			rpc_info->paddr, rpc_info->paddr + offset,
 			&rpc_ret);
 
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 
 	return ret;
 }
@@ -2625,13 +2784,13 @@ int rpc_set_mixer_order(struct rtk_rpc_info *rpc_info,
 	unsigned int rpc_ret;
 	int ret = 0;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	rpc = (struct rpc_disp_mixer_order *)rpc_info->vaddr;
 	offset = get_rpc_alignment_offset(sizeof(struct rpc_disp_mixer_order));
 	offset = ALIGN(offset, 128);
 
-	memset_io(rpc, 0, RPC_CMD_BUFFER_SIZE);
+	memset(rpc, 0, RPC_CMD_BUFFER_SIZE);
 
 	memcpy((unsigned char *)rpc, (unsigned char *)arg,
            sizeof(struct rpc_disp_mixer_order));
@@ -2650,7 +2809,7 @@ int rpc_set_mixer_order(struct rtk_rpc_info *rpc_info,
 	}
 
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -2663,7 +2822,7 @@ int rpc_get_mixer_order(struct rtk_rpc_info *rpc_info,
 	unsigned int rpc_ret;
 	int ret = 0;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	i_rpc = (struct rpc_disp_mixer_order *)rpc_info->vaddr;
 	offset = get_rpc_alignment_offset(sizeof(struct rpc_disp_mixer_order));
@@ -2698,7 +2857,7 @@ int rpc_get_mixer_order(struct rtk_rpc_info *rpc_info,
 	mixer_order->osd4 = o_rpc->osd4;
 
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 #endif
@@ -2712,14 +2871,14 @@ int rpc_get_cvbs_connection_status(struct rtk_rpc_info *rpc_info,
 	int ret;
 	int opt;
 
-	mutex_lock(&rpc_info->lock);
+	rtk_rpc_lock(rpc_info);
 
 	i_rpc = (struct rpc_privateinfo_param *)rpc_info->vaddr;
 	offset = ALIGN(sizeof(struct rpc_privateinfo_param), RPC_ALIGN_SZ);
 	o_rpc = (struct rpc_privateinfo_returnval *)((unsigned long)i_rpc + offset);
 	opt = rpc_info->krpc_vo_opt;
 
-	memset_io(i_rpc, 0, sizeof(*i_rpc));
+	memset(i_rpc, 0, sizeof(*i_rpc));
 
 	if (opt != RPC_AUDIO) {
 		i_rpc->instanceId = 0;
@@ -2743,7 +2902,7 @@ int rpc_get_cvbs_connection_status(struct rtk_rpc_info *rpc_info,
 		*status = htonl(o_rpc->privateInfo[0]);
 
 exit:
-	mutex_unlock(&rpc_info->lock);
+	rtk_rpc_unlock(rpc_info);
 	return ret;
 }
 
@@ -2758,6 +2917,7 @@ int rtk_rpc_init(struct device *dev, struct rtk_rpc_info *rpc_info, int of_index
 	rpc_info->dev = dev;
 
 	mutex_init(&rpc_info->lock);
+	mutex_init(&rpc_info->batch_lock);
 
 	rpc_info->krpc_ept_info = of_krpc_ept_info_get(dev->of_node, of_index);
 	if (IS_ERR(rpc_info->krpc_ept_info)) {
@@ -2827,9 +2987,13 @@ int rtk_rpc_init(struct device *dev, struct rtk_rpc_info *rpc_info, int of_index
 	dev->coherent_dma_mask = DMA_BIT_MASK(32);
 	dev->dma_mask = (u64 *)&dev->coherent_dma_mask;
 
-	rpc_info->vaddr = dma_alloc_coherent(dev, RPC_CMD_BUFFER_SIZE,
-					&rpc_info->paddr,
+	rpc_info->arena_vaddr = dma_alloc_coherent(dev,
+					RPC_ARENA_SLOTS * RPC_CMD_BUFFER_SIZE,
+					&rpc_info->arena_paddr,
 					GFP_KERNEL | __GFP_NOWARN);
+	rpc_info->vaddr = rpc_info->arena_vaddr;
+	rpc_info->paddr = rpc_info->arena_paddr;
+	rpc_info->slot = 0;
 	if (!rpc_info->vaddr) {
 		pr_err("%s failed to allocate rpc buffer\n", __func__);
 		return -1;
@@ -14,6 +14,8 @@
 #define S_OK 0x10000000
 
 #define RPC_CMD_BUFFER_SIZE 4096
+/* one slot can be in flight as a posted RPC while the next is filled */
+#define RPC_ARENA_SLOTS 2
 
 #define DC_VO_SET_NOTIFY ((1U << 0)) /* SCPU write */
 #define DC_VO_FEEDBACK_NOTIFY ((1U << 1))
@@ -2007,8 +2009,18 @@ struct rtk_rpc_info {
 	struct dma_buf *dmabuf;
 	struct dma_buf_attachment *attach;
 #endif
-	void *vaddr;
+	void *arena_vaddr;
+	dma_addr_t arena_paddr;
+	unsigned int slot;
+	void *vaddr;		/* current arena slot */
 	dma_addr_t paddr;
+	struct mutex batch_lock;
+	struct task_struct *batch_owner;
+	int batch_depth;
+	bool posted;		/* reply outstanding, under send_mutex */
+	uint32_t posted_cmd;
+	uint32_t posted_ret;
+	struct rpc_result *posted_result;
 #ifdef CONFIG_KERN_RPC_HANDLE_COMMAND
 	struct task_struct *rpc_thread;
 	int pid;
@@ -2020,6 +2032,8 @@ unsigned int ipcReadULONG(u8 *src, unsigned int type);
 void ipcCopyMemory(void *p_des, void *p_src, unsigned long len, unsigned int type);
 
 int rtk_rpc_init(struct device *dev, struct rtk_rpc_info *rpc_info, int of_index);
+void rtk_rpc_batch_begin(struct rtk_rpc_info *rpc_info);
+void rtk_rpc_batch_end(struct rtk_rpc_info *rpc_info);
 int rpc_create_video_agent(struct rtk_rpc_info *rpc_info, unsigned int *videoId,
 			   unsigned int pinId);
 int rpc_destroy_video_agent(struct rtk_rpc_info *rpc_info, u32 pinId);
@@ -4,13 +4,21 @@
 #include <linux/dma-fence.h>
 #include <linux/platform_device.h>
 #include <linux/sync_file.h>
+#include <drm/drm_atomic.h>
+#include <drm/drm_atomic_helper.h>
 #include <drm/drm_drv.h>
 #include <drm/drm_file.h>
+#include <drm/drm_fourcc.h>
+#include <drm/drm_framebuffer.h>
 #include <drm/drm_gem.h>
 #include <drm/drm_print.h>
 #include <drm/drm_crtc.h>
+#include <drm/drm_probe_helper.h>
 #include <drm/drm_vblank.h>
+#include <drm/drm_writeback.h>
 #include "rtk_drm_drv.h"
+#include "rtk_drm_crtc.h"
+#include "rtk_drm_fb.h"
 #include "rtk_drm_gem.h"
 #include "rtk_drm_rpc.h"
 #include "rtk_drm_vowb.h"
@@ -25,6 +33,11 @@
 #define RTK_DRM_VOWB_BRINGBUFFER_SIZE      (16*1024)
 #define RTK_DRM_VOWB_REFCLOCK_SIZE         (2048)
 
+/* targetFormat bits of struct video_transcode_picture_object */
+#define RTK_DRM_VOWB_TARGET_NV21           BIT(0)
+#define RTK_DRM_VOWB_TARGET_422            BIT(1)
+#define RTK_DRM_VOWB_TARGET_MIX1           BIT(5)
+
 struct rtk_drm_vowb_fence {
 	struct dma_fence base;
 };
@@ -58,6 +71,43 @@ struct rtk_drm_vowb_func2_data {
 	struct drm_file *file_priv;
 };
 
+struct rtk_drm_vowb_wb_state {
+	struct drm_connector_state base;
+	bool continuous;
+};
+
+#define to_rtk_drm_vowb_wb_state(s) container_of(s, struct rtk_drm_vowb_wb_state, base)
+
+/* A writeback commit, waiting in wb_data.queue for the engine. */
+struct rtk_drm_vowb_wb_job {
+	struct list_head head;
+	struct video_transcode_picture_object cmd;
+	struct drm_framebuffer *fb;
+	struct drm_crtc *crtc;
+	bool continuous;
+};
+
+/*
+ * Writeback connector: captures the mixer 1 output (what the main display
+ * shows) into a framebuffer with the transcode command. Commits only queue
+ * the capture; it is started once the engine is idle and completes through
+ * the writeback out-fence.
+ */
+struct rtk_drm_vowb_wb_data {
+	struct rtk_drm_vowb_job job;
+	struct drm_writeback_connector conn;
+	struct drm_property *continuous_prop;
+	/* protected by vowb->lock */
+	struct list_head queue;
+	struct video_transcode_picture_object cmd;
+	struct drm_framebuffer *fb;
+	struct drm_framebuffer *old_fb;
+	struct drm_crtc *crtc;
+	u32 continuous : 1;
+	u32 signal : 1;
+	u32 registered : 1;
+};
+
 struct refclock_data {
 	dma_addr_t addr;
 	void *virt;
@@ -89,9 +139,11 @@ struct rtk_drm_vowb {
 
 	struct rtk_drm_vowb_func1_data func1_data;
 	struct rtk_drm_vowb_func2_data func2_data;
+	struct rtk_drm_vowb_wb_data wb_data;
 };
 
 static void rtk_drm_vowb_check_resp(struct work_struct *work);
+static void rtk_drm_vowb_wb_kick(struct rtk_drm_vowb *vowb);
 
 static int rtk_drm_alloc_refclock(struct rtk_drm_vowb *vowb)
 {
@@ -445,8 +497,11 @@ static void rtk_drm_vowb_check_resp(struct work_struct *work)
 				DRM_WARN("job %p: timedout\n", job);
 				job->status = RTK_DRM_VOWB_JOB_STATUS_TIMEOUT;
 				trace_vowb_job_update_status(job);
+				if (job->job_done_cb)
+					job->job_done_cb(vowb, job);
 				rtk_drm_vowb_clear_job(vowb);
 				rtk_drm_vowb_signal_completion(vowb, -ETIMEDOUT);
+				rtk_drm_vowb_wb_kick(vowb);
 				return;
 			}
 			goto resched;
@@ -464,14 +519,16 @@ static void rtk_drm_vowb_check_resp(struct work_struct *work)
 		}
 
 		if (job->job_id <= job_id) {
+			job->status = RTK_DRM_VOWB_JOB_STATUS_DONE;
+			trace_vowb_job_update_status(job);
+
 			if (job->job_done_cb)
 				job->job_done_cb(vowb, job);
 
-			job->status = RTK_DRM_VOWB_JOB_STATUS_DONE;
-			trace_vowb_job_update_status(job);
 			rtk_drm_vowb_clear_job(vowb);
 
 			rtk_drm_vowb_signal_completion(vowb, 0);
+			rtk_drm_vowb_wb_kick(vowb);
 			return;
 		}
 	} while (1);
@@ -481,17 +538,33 @@ resched:
 	schedule_delayed_work(&vowb->work, 1);
 }
 
-static int rtk_drm_vowb_queue_job(struct rtk_drm_vowb *vowb, struct rtk_drm_vowb_job *job,
-				  void *cmds, u32 cmds_size)
+/*
+ * Job IDs are also handed out from the vsync interrupt. Reserves @count
+ * IDs and returns the last one.
+ */
+static u64 rtk_drm_vowb_alloc_job_ids(struct rtk_drm_vowb *vowb, u32 count)
 {
 	unsigned long flags;
-	int ret = 0;
+	u64 job_id;
 
-	ret = rtk_drm_vowb_set_job(vowb, job);
-	if (ret) {
-		DRM_DEBUG("queue job %p failed (cur_job %p)\n", job, vowb->cur_job);
-		return ret;
-	}
+	spin_lock_irqsave(&vowb->lock, flags);
+	vowb->emit_job_id += count;
+	job_id = vowb->emit_job_id;
+	spin_unlock_irqrestore(&vowb->lock, flags);
+
+	return job_id;
+}
+
+static u64 rtk_drm_vowb_next_job_id(struct rtk_drm_vowb *vowb)
+{
+	return rtk_drm_vowb_alloc_job_ids(vowb, 1);
+}
+
+static int __rtk_drm_vowb_emit_job(struct rtk_drm_vowb *vowb, struct rtk_drm_vowb_job *job,
+				   u64 job_id, void *cmds, u32 cmds_size)
+{
+	unsigned long flags;
+	int ret;
 
 	spin_lock_irqsave(&vowb->tx_lock, flags);
 	ret = rtk_drm_ringbuffer_write(&vowb->tx, cmds, cmds_size);
@@ -502,7 +575,7 @@ static int rtk_drm_vowb_queue_job(struct rtk_drm_vowb *vowb, struct rtk_drm_vowb
 		return ret;
 	}
 
-	job->job_id = vowb->emit_job_id;
+	job->job_id = job_id;
 	job->time = ktime_get();
 	job->status = RTK_DRM_VOWB_JOB_STATUS_START;
 	trace_vowb_job_update_status(job);
@@ -511,6 +584,20 @@ static int rtk_drm_vowb_queue_job(struct rtk_drm_vowb *vowb, struct rtk_drm_vowb
 	return 0;
 }
 
+static int rtk_drm_vowb_queue_job(struct rtk_drm_vowb *vowb, struct rtk_drm_vowb_job *job,
+				  u64 job_id, void *cmds, u32 cmds_size)
+{
+	int ret = 0;
+
+	ret = rtk_drm_vowb_set_job(vowb, job);
+	if (ret) {
+		DRM_DEBUG("queue job %p failed (cur_job %p)\n", job, vowb->cur_job);
+		return ret;
+	}
+
+	return __rtk_drm_vowb_emit_job(vowb, job, job_id, cmds, cmds_size);
+}
+
 static void rtk_drm_vowb_wait_job_done(struct rtk_drm_vowb *vowb)
 {
 	flush_delayed_work(&vowb->work);
@@ -624,22 +711,25 @@ static int rtk_drm_vowb_func1_start_cmd(struct rtk_drm_vowb *vowb,
 					struct rtk_drm_vowb_func1_data *func1)
 {
 	struct video_transcode_picture_object *cmds;
+	u64 job_id;
 	int ret;
 
 	cmds = kcalloc(func1->num_srcs, sizeof(*cmds), GFP_KERNEL);
 	if (!cmds)
 		return -ENOMEM;
 
+	/* one ID per source; the ones of skipped sources are left unused */
+	job_id = rtk_drm_vowb_alloc_job_ids(vowb, func1->num_srcs) - func1->num_srcs;
+
 	ret = rtk_drm_vowb_func1_prepare_cmds(vowb, func1, vowb->tx.rpdev, cmds, func1->num_srcs,
-					      vowb->emit_job_id, func1->dst_id);
+					      job_id, func1->dst_id);
 	if (ret <= 0) {
 		DRM_INFO("rtk_drm_vowb_func1_prepare_cmds() returns %d\n", ret);
 		goto free_cmds;
 	}
 
-	vowb->emit_job_id += ret;
-
-	ret = rtk_drm_vowb_queue_job(vowb, &func1->job, cmds, sizeof(*cmds) * ret);
+	ret = rtk_drm_vowb_queue_job(vowb, &func1->job, job_id + ret, cmds,
+				     sizeof(*cmds) * ret);
 	if (!ret)
 		++func1->cnt_vowb;
 	trace_vowb_func1_statistics(__func__, func1->cnt_display, func1->cnt_vowb);
@@ -655,7 +745,7 @@ static void rtk_drm_vowb_func1_job_done_cb(struct rtk_drm_vowb *vowb, struct rtk
 	unsigned long flags;
 	int ret;
 
-	if (!func1->enabled)
+	if (!func1->enabled || job->status != RTK_DRM_VOWB_JOB_STATUS_DONE)
 		return;
 
 	inband_cmd_video_object(vowb->tx.rpdev, &cmd, func1, func1->addrs[func1->dst_id]);
@@ -1097,6 +1187,7 @@ int rtk_drm_vowb_run_cmd(struct drm_device *dev, void *data, struct drm_file *fi
 	struct video_transcode_picture_object cmd = {};
 	dma_addr_t addrs[11] = {};
 	unsigned long flags;
+	u64 job_id;
 	int ret;
 
 	spin_lock_irqsave(&vowb->lock, flags);
@@ -1105,10 +1196,11 @@ int rtk_drm_vowb_run_cmd(struct drm_device *dev, void *data, struct drm_file *fi
 	if (ret)
 		return ret;
 
+	job_id = rtk_drm_vowb_next_job_id(vowb);
 	func2_inband_cmd_video_transcode_picture_object(vowb->tx.rpdev, &cmd, &arg->pic, addrs,
-							++vowb->emit_job_id);
+							job_id);
 
-	ret = rtk_drm_vowb_queue_job(vowb, &func2->job, &cmd, sizeof(cmd));
+	ret = rtk_drm_vowb_queue_job(vowb, &func2->job, job_id, &cmd, sizeof(cmd));
 	if (!ret)
 		arg->job_id = func2->job.job_id;
 
@@ -1134,13 +1226,504 @@ int rtk_drm_vowb_check_cmd(struct drm_device *dev, void *data, struct drm_file *
 	return ret;
 }
 
-void rtk_drm_vowb_isr(struct drm_device *dev)
+static const u32 rtk_drm_vowb_wb_formats[] = {
+	DRM_FORMAT_NV12,
+	DRM_FORMAT_NV21,
+	DRM_FORMAT_NV16,
+	DRM_FORMAT_NV61,
+};
+
+static inline struct rtk_drm_vowb *
+wb_conn_to_vowb(struct drm_connector *connector)
+{
+	struct drm_writeback_connector *wb_conn = drm_connector_to_writeback(connector);
+
+	return container_of(wb_conn, struct rtk_drm_vowb, wb_data.conn);
+}
+
+static u32 rtk_drm_vowb_wb_target_format(u32 format)
+{
+	switch (format) {
+	case DRM_FORMAT_NV21:
+		return RTK_DRM_VOWB_TARGET_NV21;
+	case DRM_FORMAT_NV16:
+		return RTK_DRM_VOWB_TARGET_422;
+	case DRM_FORMAT_NV61:
+		return RTK_DRM_VOWB_TARGET_422 | RTK_DRM_VOWB_TARGET_NV21;
+	default:
+		return 0;
+	}
+}
+
+static void inband_cmd_video_writeback_mix1_object(struct rpmsg_device *rpdev,
+						   struct video_transcode_picture_object *cmd,
+						   const struct drm_display_mode *mode,
+						   struct drm_framebuffer *fb)
+{
+	struct rtk_gem_object *rtk_gem[2];
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		struct drm_gem_object *gem = rtk_fb_get_gem_obj(fb, i);
+
+		if (!gem)
+			gem = rtk_fb_get_gem_obj(fb, 0);
+		rtk_gem[i] = to_rtk_gem_obj(gem);
+	}
+
+	memset(cmd, 0, sizeof(*cmd));
+	cmd->header.size  = cpu_to_rpmsg32(rpdev, sizeof(*cmd));
+	cmd->header.type  = cpu_to_rpmsg32(rpdev, VIDEO_TRANSCODE_INBAND_CMD_TYPE_PICTURE_OBJECT);
+	cmd->version      = cpu_to_rpmsg32(rpdev, 0x54524134);
+
+	/* the source is the mixer 1 output, not a buffer */
+	cmd->mode         = cpu_to_rpmsg32(rpdev, CONSECUTIVE_FRAME);
+	cmd->width        = cpu_to_rpmsg32(rpdev, mode->hdisplay);
+	cmd->height       = cpu_to_rpmsg32(rpdev, mode->vdisplay);
+	cmd->lumaOffTblAddr   = cpu_to_rpmsg32(rpdev, 0xffffffff);
+	cmd->chromaOffTblAddr = cpu_to_rpmsg32(rpdev, 0xffffffff);
+
+	cmd->wb_y_addr    = cpu_to_rpmsg32(rpdev, rtk_gem[0]->paddr + fb->offsets[0]);
+	cmd->wb_c_addr    = cpu_to_rpmsg32(rpdev, rtk_gem[1]->paddr + fb->offsets[1]);
+	cmd->wb_w         = cpu_to_rpmsg32(rpdev, fb->width);
+	cmd->wb_h         = cpu_to_rpmsg32(rpdev, fb->height);
+	cmd->wb_pitch     = cpu_to_rpmsg32(rpdev, fb->pitches[0]);
+	cmd->targetFormat = cpu_to_rpmsg32(rpdev, RTK_DRM_VOWB_TARGET_MIX1 |
+					   rtk_drm_vowb_wb_target_format(fb->format->format));
+
+	cmd->contrast     = cpu_to_rpmsg32(rpdev, 32);
+	cmd->brightness   = cpu_to_rpmsg32(rpdev, 32);
+	cmd->hue          = cpu_to_rpmsg32(rpdev, 32);
+	cmd->saturation   = cpu_to_rpmsg32(rpdev, 32);
+}
+
+static void rtk_drm_vowb_wb_job_done_cb(struct rtk_drm_vowb *vowb, struct rtk_drm_vowb_job *job)
+{
+	struct rtk_drm_vowb_wb_data *wb = container_of(job, struct rtk_drm_vowb_wb_data, job);
+
+	if (!wb->signal)
+		return;
+
+	wb->signal = 0;
+	drm_writeback_signal_completion(&wb->conn,
+		job->status == RTK_DRM_VOWB_JOB_STATUS_DONE ? 0 : -ETIMEDOUT);
+}
+
+/*
+ * Continuous capture: the command built by the last writeback commit is
+ * re-emitted at every vsync of the captured CRTC into the same framebuffer,
+ * only the buffer ID changes. Called from the CRTC interrupt.
+ */
+static void rtk_drm_vowb_wb_vsync_isr(struct rtk_drm_vowb *vowb, struct drm_crtc *crtc)
+{
+	struct rtk_drm_vowb_wb_data *wb = &vowb->wb_data;
+	struct rpmsg_device *rpdev = vowb->tx.rpdev;
+	struct video_transcode_picture_object cmd;
+	unsigned long flags;
+	u64 job_id;
+
+	spin_lock_irqsave(&vowb->lock, flags);
+	if (!wb->continuous || wb->crtc != crtc || vowb->cur_job) {
+		spin_unlock_irqrestore(&vowb->lock, flags);
+		return;
+	}
+	vowb->cur_job = &wb->job;
+	job_id = ++vowb->emit_job_id;
+	cmd = wb->cmd;
+	spin_unlock_irqrestore(&vowb->lock, flags);
+
+	cmd.bufferID_H = cpu_to_rpmsg32(rpdev, job_id >> 32);
+	cmd.bufferID_L = cpu_to_rpmsg32(rpdev, job_id & 0xffffffff);
+
+	__rtk_drm_vowb_emit_job(vowb, &wb->job, job_id, &cmd, sizeof(cmd));
+}
+
+/*
+ * Release the buffer of a finished continuous capture, then start the
+ * oldest queued writeback job if the engine is idle. Called after a commit
+ * queued a job and whenever a job completes.
+ */
+static void rtk_drm_vowb_wb_kick(struct rtk_drm_vowb *vowb)
+{
+	struct rtk_drm_vowb_wb_data *wb = &vowb->wb_data;
+	struct rpmsg_device *rpdev = vowb->tx.rpdev;
+	struct rtk_drm_vowb_wb_job *wb_job = NULL;
+	struct drm_framebuffer *old_fb = NULL;
+	struct video_transcode_picture_object cmd;
+	unsigned long flags;
+	u64 job_id = 0;
+	int ret;
+
+	if (!wb->registered)
+		return;
+
+	spin_lock_irqsave(&vowb->lock, flags);
+	if (vowb->cur_job != &wb->job) {
+		old_fb = wb->old_fb;
+		wb->old_fb = NULL;
+	}
+	if (!vowb->cur_job && !list_empty(&wb->queue)) {
+		wb_job = list_first_entry(&wb->queue, struct rtk_drm_vowb_wb_job, head);
+		list_del(&wb_job->head);
+		vowb->cur_job = &wb->job;
+		job_id = ++vowb->emit_job_id;
+		cmd = wb_job->cmd;
+		wb->signal = 1;
+		if (wb_job->continuous) {
+			drm_framebuffer_get(wb_job->fb);
+			wb->cmd = cmd;
+			wb->fb = wb_job->fb;
+			wb->crtc = wb_job->crtc;
+			wb->continuous = 1;
+		}
+	}
+	spin_unlock_irqrestore(&vowb->lock, flags);
+
+	if (old_fb)
+		drm_framebuffer_put(old_fb);
+	if (!wb_job)
+		return;
+
+	cmd.bufferID_H = cpu_to_rpmsg32(rpdev, job_id >> 32);
+	cmd.bufferID_L = cpu_to_rpmsg32(rpdev, job_id & 0xffffffff);
+
+	ret = __rtk_drm_vowb_emit_job(vowb, &wb->job, job_id, &cmd, sizeof(cmd));
+	if (ret) {
+		DRM_ERROR("failed to queue writeback job: %d\n", ret);
+		spin_lock_irqsave(&vowb->lock, flags);
+		wb->continuous = 0;
+		wb->crtc = NULL;
+		spin_unlock_irqrestore(&vowb->lock, flags);
+		wb->signal = 0;
+		drm_writeback_signal_completion(&wb->conn, ret);
+	}
+}
+
+/*
+ * Stop continuous capture, including that of jobs still queued. If the
+ * engine is capturing into the buffer, it is released by
+ * rtk_drm_vowb_wb_kick() once that job is done.
+ */
+static void rtk_drm_vowb_wb_stop(struct rtk_drm_vowb *vowb)
+{
+	struct rtk_drm_vowb_wb_data *wb = &vowb->wb_data;
+	struct rtk_drm_vowb_wb_job *wb_job;
+	struct drm_framebuffer *fb, *old_fb = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&vowb->lock, flags);
+	list_for_each_entry(wb_job, &wb->queue, head)
+		wb_job->continuous = false;
+	wb->continuous = 0;
+	wb->crtc = NULL;
+	fb = wb->fb;
+	wb->fb = NULL;
+	if (vowb->cur_job != &wb->job) {
+		old_fb = wb->old_fb;
+		wb->old_fb = NULL;
+	} else if (fb) {
+		/* a capture into fb started after old_fb's one was done */
+		old_fb = wb->old_fb;
+		wb->old_fb = fb;
+		fb = NULL;
+	}
+	spin_unlock_irqrestore(&vowb->lock, flags);
+
+	if (fb)
+		drm_framebuffer_put(fb);
+	if (old_fb)
+		drm_framebuffer_put(old_fb);
+}
+
+static int rtk_drm_vowb_wb_encoder_atomic_check(struct drm_encoder *encoder,
+						struct drm_crtc_state *crtc_state,
+						struct drm_connector_state *conn_state)
+{
+	struct rtk_drm_vowb *vowb = wb_conn_to_vowb(conn_state->connector);
+	struct drm_framebuffer *fb;
+	int ret;
+
+	if (!conn_state->writeback_job || !conn_state->writeback_job->fb)
+		return 0;
+
+	ret = drm_atomic_helper_check_wb_encoder_state(encoder, conn_state);
+	if (ret)
+		return ret;
+
+	/* the transcode path only scales down */
+	fb = conn_state->writeback_job->fb;
+	if (fb->width > crtc_state->mode.hdisplay ||
+	    fb->height > crtc_state->mode.vdisplay ||
+	    (fb->width & 1) || (fb->height & 1)) {
+		DRM_DEBUG_KMS("Invalid framebuffer size %ux%u for mode %ux%u\n",
+			      fb->width, fb->height,
+			      crtc_state->mode.hdisplay, crtc_state->mode.vdisplay);
+		return -EINVAL;
+	}
+
+	/* the legacy VOWB ioctls own the engine while set up */
+	if (vowb->func1_data.file_priv)
+		return -EBUSY;
+
+	return 0;
+}
+
+static const struct drm_encoder_helper_funcs rtk_drm_vowb_wb_encoder_helper_funcs = {
+	.atomic_check = rtk_drm_vowb_wb_encoder_atomic_check,
+};
+
+static int rtk_drm_vowb_wb_get_modes(struct drm_connector *connector)
+{
+	struct drm_device *dev = connector->dev;
+
+	return drm_add_modes_noedid(connector, dev->mode_config.max_width,
+				    dev->mode_config.max_height);
+}
+
+static int rtk_drm_vowb_wb_prepare_job(struct drm_writeback_connector *connector,
+				       struct drm_writeback_job *job)
+{
+	job->priv = kzalloc(sizeof(struct rtk_drm_vowb_wb_job), GFP_KERNEL);
+	return job->priv ? 0 : -ENOMEM;
+}
+
+static void rtk_drm_vowb_wb_cleanup_job(struct drm_writeback_connector *connector,
+					struct drm_writeback_job *job)
+{
+	kfree(job->priv);
+}
+
+/*
+ * Runs in the commit tail, so it must not wait for the engine: the job is
+ * queued and userspace waits on the writeback out-fence instead.
+ */
+static void rtk_drm_vowb_wb_atomic_commit(struct drm_connector *connector,
+					  struct drm_atomic_state *state)
+{
+	struct rtk_drm_vowb *vowb = wb_conn_to_vowb(connector);
+	struct rtk_drm_vowb_wb_data *wb = &vowb->wb_data;
+	struct drm_connector_state *conn_state =
+		drm_atomic_get_new_connector_state(state, connector);
+	struct rtk_drm_vowb_wb_job *wb_job = conn_state->writeback_job->priv;
+	struct drm_framebuffer *fb = conn_state->writeback_job->fb;
+	unsigned long flags;
+
+	rtk_drm_vowb_wb_stop(vowb);
+
+	inband_cmd_video_writeback_mix1_object(vowb->tx.rpdev, &wb_job->cmd,
+					       &conn_state->crtc->state->mode, fb);
+	wb_job->fb = fb;
+	wb_job->crtc = conn_state->crtc;
+	wb_job->continuous = to_rtk_drm_vowb_wb_state(conn_state)->continuous;
+
+	drm_writeback_queue_job(&wb->conn, conn_state);
+
+	spin_lock_irqsave(&vowb->lock, flags);
+	list_add_tail(&wb_job->head, &wb->queue);
+	spin_unlock_irqrestore(&vowb->lock, flags);
+
+	rtk_drm_vowb_wb_kick(vowb);
+}
+
+static const struct drm_connector_helper_funcs rtk_drm_vowb_wb_connector_helper_funcs = {
+	.get_modes = rtk_drm_vowb_wb_get_modes,
+	.atomic_commit = rtk_drm_vowb_wb_atomic_commit,
+	.prepare_writeback_job = rtk_drm_vowb_wb_prepare_job,
+	.cleanup_writeback_job = rtk_drm_vowb_wb_cleanup_job,
+};
+
+static void rtk_drm_vowb_wb_reset(struct drm_connector *connector)
+{
+	struct rtk_drm_vowb_wb_state *state;
+
+	if (connector->state) {
+		__drm_atomic_helper_connector_destroy_state(connector->state);
+		kfree(to_rtk_drm_vowb_wb_state(connector->state));
+		connector->state = NULL;
+	}
+
+	state = kzalloc(sizeof(*state), GFP_KERNEL);
+	if (state)
+		__drm_atomic_helper_connector_reset(connector, &state->base);
+}
+
+static struct drm_connector_state *
+rtk_drm_vowb_wb_duplicate_state(struct drm_connector *connector)
+{
+	struct rtk_drm_vowb_wb_state *state;
+
+	if (WARN_ON(!connector->state))
+		return NULL;
+
+	state = kzalloc(sizeof(*state), GFP_KERNEL);
+	if (!state)
+		return NULL;
+
+	__drm_atomic_helper_connector_duplicate_state(connector, &state->base);
+	state->continuous = to_rtk_drm_vowb_wb_state(connector->state)->continuous;
+
+	return &state->base;
+}
+
+static void rtk_drm_vowb_wb_destroy_state(struct drm_connector *connector,
+					  struct drm_connector_state *state)
+{
+	__drm_atomic_helper_connector_destroy_state(state);
+	kfree(to_rtk_drm_vowb_wb_state(state));
+}
+
+static int rtk_drm_vowb_wb_atomic_set_property(struct drm_connector *connector,
+					       struct drm_connector_state *state,
+					       struct drm_property *property,
+					       uint64_t val)
+{
+	struct rtk_drm_vowb *vowb = wb_conn_to_vowb(connector);
+
+	if (property == vowb->wb_data.continuous_prop) {
+		to_rtk_drm_vowb_wb_state(state)->continuous = !!val;
+		return 0;
+	}
+	return -EINVAL;
+}
+
+static int rtk_drm_vowb_wb_atomic_get_property(struct drm_connector *connector,
+					       const struct drm_connector_state *state,
+					       struct drm_property *property,
+					       uint64_t *val)
+{
+	struct rtk_drm_vowb *vowb = wb_conn_to_vowb(connector);
+
+	if (property == vowb->wb_data.continuous_prop) {
+		*val = to_rtk_drm_vowb_wb_state((struct drm_connector_state *)state)->continuous;
+		return 0;
+	}
+	return -EINVAL;
+}
+
+static const struct drm_connector_funcs rtk_drm_vowb_wb_connector_funcs = {
+	.fill_modes = drm_helper_probe_single_connector_modes,
+	.destroy = drm_connector_cleanup,
+	.reset = rtk_drm_vowb_wb_reset,
+	.atomic_duplicate_state = rtk_drm_vowb_wb_duplicate_state,
+	.atomic_destroy_state = rtk_drm_vowb_wb_destroy_state,
+	.atomic_set_property = rtk_drm_vowb_wb_atomic_set_property,
+	.atomic_get_property = rtk_drm_vowb_wb_atomic_get_property,
+};
+
+/**
+ * rtk_drm_vowb_atomic_commit() - stop continuous capture when it is turned off
+ * @state: the committed atomic state
+ *
+ * Writeback jobs are queued from the connector's atomic_commit, which only
+ * runs for commits carrying a WRITEBACK_FB_ID. Clearing the continuous
+ * property, detaching the connector or disabling the CRTC is handled here.
+ */
+void rtk_drm_vowb_atomic_commit(struct drm_atomic_state *state)
+{
+	struct rtk_drm_private *priv = state->dev->dev_private;
+	struct rtk_drm_vowb *vowb = priv->vowb;
+	struct drm_connector_state *conn_state;
+	struct drm_crtc_state *crtc_state;
+
+	if (!vowb || !vowb->wb_data.registered)
+		return;
+
+	conn_state = drm_atomic_get_new_connector_state(state, &vowb->wb_data.conn.base);
+	if (!conn_state)
+		return;
+
+	if (conn_state->writeback_job && conn_state->writeback_job->fb)
+		return;
+
+	crtc_state = conn_state->crtc ?
+		drm_atomic_get_new_crtc_state(state, conn_state->crtc) : NULL;
+
+	if (!to_rtk_drm_vowb_wb_state(conn_state)->continuous ||
+	    !conn_state->crtc || (crtc_state && !crtc_state->active))
+		rtk_drm_vowb_wb_stop(vowb);
+}
+
+static int rtk_drm_vowb_wb_init(struct drm_device *drm, struct rtk_drm_vowb *vowb)
+{
+	struct rtk_drm_vowb_wb_data *wb = &vowb->wb_data;
+	struct drm_crtc *crtc;
+	u32 possible_crtcs = 0;
+	int ret;
+
+	/* the transcode engine can only capture mixer 1 */
+	drm_for_each_crtc(crtc, drm) {
+		if (container_of(crtc, struct rtk_drm_crtc, crtc)->mixer == DISPLAY_INTERFACE_MIXER1)
+			possible_crtcs |= drm_crtc_mask(crtc);
+	}
+	if (!possible_crtcs) {
+		DRM_INFO("no CRTC on mixer 1, no writeback connector\n");
+		return 0;
+	}
+
+	wb->job.job_done_cb = rtk_drm_vowb_wb_job_done_cb;
+	INIT_LIST_HEAD(&wb->queue);
+
+	drm_connector_helper_add(&wb->conn.base, &rtk_drm_vowb_wb_connector_helper_funcs);
+
+	ret = drm_writeback_connector_init(drm, &wb->conn,
+					   &rtk_drm_vowb_wb_connector_funcs,
+					   &rtk_drm_vowb_wb_encoder_helper_funcs,
+					   rtk_drm_vowb_wb_formats,
+					   ARRAY_SIZE(rtk_drm_vowb_wb_formats),
+					   possible_crtcs);
+	if (ret) {
+		DRM_ERROR("failed to init writeback connector: %d\n", ret);
+		return ret;
+	}
+
+	wb->continuous_prop = drm_property_create_bool(drm, DRM_MODE_PROP_ATOMIC,
+						       "CONTINUOUS_CAPTURE");
+	if (wb->continuous_prop)
+		drm_object_attach_property(&wb->conn.base.base, wb->continuous_prop, 0);
+
+	wb->registered = 1;
+	return 0;
+}
+
+static void rtk_drm_vowb_wb_fini(struct rtk_drm_vowb *vowb)
+{
+	struct rtk_drm_vowb_wb_data *wb = &vowb->wb_data;
+	struct rtk_drm_vowb_wb_job *wb_job, *tmp;
+	unsigned long flags;
+	LIST_HEAD(queue);
+
+	if (!wb->registered)
+		return;
+
+	rtk_drm_vowb_wb_stop(vowb);
+
+	spin_lock_irqsave(&vowb->lock, flags);
+	list_splice_init(&wb->queue, &queue);
+	spin_unlock_irqrestore(&vowb->lock, flags);
+
+	if (!wait_event_timeout(vowb->wq, !READ_ONCE(vowb->cur_job), msecs_to_jiffies(1000)))
+		DRM_WARN("writeback still busy at unbind\n");
+
+	/* completes the out-fences in queue order; frees the jobs */
+	list_for_each_entry_safe(wb_job, tmp, &queue, head)
+		drm_writeback_signal_completion(&wb->conn, -ENODEV);
+
+	/* drops the buffer of the last continuous capture */
+	rtk_drm_vowb_wb_kick(vowb);
+
+	drm_connector_cleanup(&wb->conn.base);
+	drm_encoder_cleanup(&wb->conn.encoder);
+	wb->registered = 0;
+}
+
+void rtk_drm_vowb_isr(struct drm_device *dev, struct drm_crtc *crtc)
 {
 	struct rtk_drm_vowb *vowb = ((struct rtk_drm_private *)dev->dev_private)->vowb;
 
 	if (!vowb)
 		return;
 	rtk_drm_vowb_func1_vsync_isr(vowb);
+	rtk_drm_vowb_wb_vsync_isr(vowb, crtc);
 }
 
 int rtk_drm_vowb_reinit(struct drm_device *dev, void *data, struct drm_file *file_priv)
@@ -1218,6 +1801,9 @@ static int rtk_vowb_bind(struct device *dev, struct device *master, void *data)
 	if (ret)
 		goto destroy_agent;
 	ret = rtk_drm_vowb_setup_ringbuffer(vowb, &vowb->rx, 0x20140507);
+	if (ret)
+		goto destroy_agent;
+	ret = rtk_drm_vowb_wb_init(drm, vowb);
 	if (ret)
 		goto destroy_agent;
 
@@ -1241,6 +1827,7 @@ static void rtk_vowb_unbind(struct device *dev, struct device *master, void *dat
 	struct rtk_drm_private *priv = drm->dev_private;
 	struct rtk_drm_vowb *vowb = priv->vowb;
 
+	rtk_drm_vowb_wb_fini(vowb);
 	rtk_drm_destroy_agent(vowb);
 	rtk_drm_vowb_free_refclock(vowb);
 	rtk_drm_ringbuffer_free(&vowb->rx);
@@ -10,11 +10,14 @@ struct inode;
 struct file;
 struct drm_file;
 struct drm_device;
+struct drm_crtc;
+struct drm_atomic_state;
 
 extern struct platform_driver rtk_vowb_driver;
 
 int rtk_drm_vowb_release(struct inode *inode, struct file *filp);
-void rtk_drm_vowb_isr(struct drm_device *dev);
+void rtk_drm_vowb_isr(struct drm_device *dev, struct drm_crtc *crtc);
+void rtk_drm_vowb_atomic_commit(struct drm_atomic_state *state);
 
 int rtk_drm_vowb_setup_ioctl(struct drm_device *dev, void *data, struct drm_file *file_priv);
 int rtk_drm_vowb_teardown_ioctl(struct drm_device *dev, void *data, struct drm_file *file_priv);
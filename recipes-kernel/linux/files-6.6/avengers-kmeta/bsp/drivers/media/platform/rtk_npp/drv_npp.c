@@ -107,9 +107,13 @@ static inline struct drv_npp_ctx *file2ctx(struct file *file)
 
 static int job_ready(void *priv)
 {
-	pr_info("[drv_npp] %s\n", __func__);
+	struct drv_npp_ctx *ctx = priv;
+	const struct npp_fmt_ops_m2m *op_m2m = get_npp_fmt_ops_m2m();
+
+	if (!op_m2m)
+		return 0;
 
-	return 1;
+	return op_m2m->npp_job_ready(&ctx->fh);
 }
 
 static void job_abort(void *priv)
@@ -120,24 +124,33 @@ static void job_abort(void *priv)
 
 	if (!op_m2m)
 		return;
-	/* Will cancel the transaction in the next interrupt handler */
+	/* The running job is finished by the next interrupt or its timeout */
 	op_m2m->npp_abort(priv, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE);
 	op_m2m->npp_abort(priv, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE);
-	v4l2_m2m_job_finish(v_dev->m2m_dev, ctx->fh.m2m_ctx);
 
-	pr_info("[drv_npp] %s done\n", __func__);
+	dev_dbg(v_dev->dev, "%s done\n", __func__);
 }
 
 /* device_run() - prepares and starts the device
  *
- * This simulates all the immediate preparations required before starting
- * a device. This will be called by the framework when it decides to schedule
- * a particular instance.
+ * Programs the NPP for the next src/dst buffer pair of this instance and
+ * kicks the engine. The job is finished from the NPP interrupt path through
+ * v4l2_m2m_job_finish(). This will be called by the framework when it
+ * decides to schedule a particular instance.
  */
 
 static void device_run(void *priv)
 {
-	pr_info("[drv_npp] %s\n", __func__);
+	struct drv_npp_ctx *ctx = priv;
+	struct videc_dev *v_dev = ctx->dev;
+	const struct npp_fmt_ops_m2m *op_m2m = get_npp_fmt_ops_m2m();
+
+	if (!op_m2m) {
+		v4l2_m2m_job_finish(v_dev->m2m_dev, ctx->fh.m2m_ctx);
+		return;
+	}
+
+	op_m2m->npp_device_run(&ctx->fh);
 }
 
 /*
@@ -356,6 +369,16 @@ static int npp_s_ctrl(struct v4l2_ctrl *ctrl)
 			 ctx->params.signed_rgb_output);
 			break;
 		}
+	case RTK_V4L2_NPP_MULTI_OUTPUT_CONFIG:
+		{
+			struct rtk_npp_multi_output_params *param = ctrl->p_new.p;
+
+			memcpy(&ctx->params.multi_output, param,
+			 sizeof(struct rtk_npp_multi_output_params));
+			dev_info(ctx->dev->dev, "multi output num_outputs = %d\n",
+			 ctx->params.multi_output.num_outputs);
+			break;
+		}
 	default:
 		{
 			dev_err(ctx->dev->dev, "Invalid control, id=%d, val=%d\n",
@@ -402,6 +425,24 @@ static int npp_ctrl_type_validate(const struct v4l2_ctrl *ctrl, u32 idx,
 			union v4l2_ctrl_ptr ptr)
 #endif
 {
+	const struct rtk_npp_multi_output_params *multi;
+	unsigned int i;
+
+	if (ctrl->id != RTK_V4L2_NPP_MULTI_OUTPUT_CONFIG)
+		return 0;
+
+	multi = ptr.p_const;
+	if (multi->num_outputs > NPP_MAX_OUTPUTS)
+		return -EINVAL;
+
+	for (i = 0; i < multi->num_outputs; i++) {
+		const struct rtk_npp_output_params *o = &multi->output[i];
+
+		if (o->width < MIN_IMAGE_M2M_WIDTH || o->width > MAX_IMAGE_M2M_WIDTH ||
+		    o->height < MIN_IMAGE_M2M_HEIGHT || o->height > MAX_IMAGE_M2M_HEIGHT)
+			return -EINVAL;
+	}
+
 	return 0;
 }
 
@@ -462,15 +503,29 @@ static const struct v4l2_ctrl_config rtk_ctrl_npp_signed_rgb_output = {
 	.step = 1,
 };
 
+static const struct v4l2_ctrl_config rtk_ctrl_npp_multi_output = {
+	.ops = &npp_ctrl_ops,
+	.type_ops = &npp_type_ops,
+	.id = RTK_V4L2_NPP_MULTI_OUTPUT_CONFIG,
+	.name = "NPP multi output config",
+	.type = V4L2_CTRL_TYPE_RTK_NPP_MULTI_OUTPUT,
+	.def = 0,
+	.min = 0,
+	.max = UINT_MAX,
+	.step = 1,
+	.elem_size = sizeof(struct rtk_npp_multi_output_params),
+};
+
 int npp_ctrls_setup(struct drv_npp_ctx *ctx)
 {
 
-	v4l2_ctrl_handler_init(&ctx->ctrls, 4);
+	v4l2_ctrl_handler_init(&ctx->ctrls, 5);
 
 	v4l2_ctrl_new_custom(&ctx->ctrls, &rtk_ctrl_npp_single_rgb_plane, NULL);
 	v4l2_ctrl_new_custom(&ctx->ctrls, &rtk_ctrl_npp_svp, NULL);
 	v4l2_ctrl_new_custom(&ctx->ctrls, &rtk_ctrl_npp_mipi_csi_params, NULL);
 	v4l2_ctrl_new_custom(&ctx->ctrls, &rtk_ctrl_npp_signed_rgb_output, NULL);
+	v4l2_ctrl_new_custom(&ctx->ctrls, &rtk_ctrl_npp_multi_output, NULL);
 
 	if (ctx->ctrls.error) {
 		dev_err(ctx->dev->dev, "control initialization error(%d)\n", ctx->ctrls.error);
@@ -546,7 +601,7 @@ static int drv_npp_qbuf(struct file *file, void *priv, struct v4l2_buffer *buf)
 	struct drv_npp_ctx *ctx = file2ctx(file);
 	int ret = 0;
 
-	dev_info(v_dev->dev, "%s, index=%d type=%s memory=%s\n",
+	dev_dbg(v_dev->dev, "%s, index=%d type=%s memory=%s\n",
 	 __func__, buf->index, type_str[buf->type], mem_str[buf->memory]);
 
 	if (ctx->state == M2MSTATE) {
@@ -570,7 +625,7 @@ static int drv_npp_dqbuf(struct file *file, void *priv, struct v4l2_buffer *buf)
 	struct drv_npp_ctx *ctx = file2ctx(file);
 	int ret = 0;
 
-	dev_info(v_dev->dev, "%s, type=%s memory=%s\n",
+	dev_dbg(v_dev->dev, "%s, type=%s memory=%s\n",
 	 __func__, type_str[buf->type], mem_str[buf->memory]);
 
 	if (ctx->state == M2MSTATE) {
@@ -891,7 +946,7 @@ static int drv_npp_buf_prepare(struct vb2_buffer *vb)
 	const struct npp_fmt_ops_m2m *op_m2m = get_npp_fmt_ops_m2m();
 	const struct npp_fmt_ops_capture *op_capture = get_npp_fmt_ops_capture();
 
-	dev_info(ctx->dev->dev, "%s, index=%d type=%s memory=%s\n", __func__,
+	dev_dbg(ctx->dev->dev, "%s, index=%d type=%s memory=%s\n", __func__,
 	vb->index, type_str[vb->type], mem_str[vb->memory]);
 
 	if (V4L2_TYPE_IS_OUTPUT(vb->vb2_queue->type)) {
@@ -938,7 +993,7 @@ static void drv_npp_buf_queue(struct vb2_buffer *vb)
 	const struct npp_fmt_ops_capture *op_capture = get_npp_fmt_ops_capture();
 	int  ret;
 
-	dev_info(ctx->dev->dev, "%s, index=%d type=%s memory=%s\n", __func__,
+	dev_dbg(ctx->dev->dev, "%s, index=%d type=%s memory=%s\n", __func__,
 	vb->index, type_str[vb->type], mem_str[vb->memory]);
 
 	if (ctx->state == M2MSTATE) {
@@ -1498,7 +1553,6 @@ static int drv_npp_probe(struct platform_device *pdev)
 
 	mutex_init(&v_dev->dev_mutex_m2m);
 	mutex_init(&v_dev->dev_mutex_capture);
-	mutex_init(&v_dev->hw_mutex);
 	sema_init(&v_dev->hw_sem, 1);
 	v_dev->nppctx_activate = NULL;
 	v_dev->dev_open_cnt_capture = 0;
@@ -1646,8 +1700,12 @@ static int drv_npp_suspend(struct device *dev)
 	if (v_dev->state == M2MSTATE) {
 		spin_unlock_irqrestore(&v_dev->device_spin_lock, flags_state);
 
+		/* wait for the running m2m job and hold off new ones */
+		v4l2_m2m_suspend(v_dev->m2m_dev);
+
 		if (down_timeout(&v_dev->hw_sem, timeout)) {
 			dev_err(dev, "suspend failed, npp not finished\n");
+			v4l2_m2m_resume(v_dev->m2m_dev);
 			return -ETIMEDOUT; // timeout
 		}
 
@@ -1712,6 +1770,7 @@ static int drv_npp_resume(struct device *dev)
 		}
 
 		up(&v_dev->hw_sem);
+		v4l2_m2m_resume(v_dev->m2m_dev);
 	} else if (v_dev->state == CAPTURESTATE) {
 		spin_unlock_irqrestore(&v_dev->device_spin_lock, flags);
 		if (npp_initialize(v_dev) < 0) {
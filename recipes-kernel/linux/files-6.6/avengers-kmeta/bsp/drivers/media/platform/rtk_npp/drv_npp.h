@@ -23,9 +23,11 @@
 #define RTK_V4L2_NPP_SVP				(V4L2_CID_USER_REALTEK_BASE + 2)
 #define RTK_V4L2_MIPI_CSI_PARMS_CONFIG	(V4L2_CID_USER_REALTEK_BASE + 3)
 #define RTK_V4L2_SIGNED_RGB_OUTPUT	    (V4L2_CID_USER_REALTEK_BASE + 4)
+#define RTK_V4L2_NPP_MULTI_OUTPUT_CONFIG	(V4L2_CID_USER_REALTEK_BASE + 5)
 
 //Attentation!This value should not be included in v4l2_ctrl_type
 #define V4L2_CTRL_TYPE_RTK_NPP_MIPI_CSI_PARAM 0x9000
+#define V4L2_CTRL_TYPE_RTK_NPP_MULTI_OUTPUT 0x9001
 
 // For stark
 #define RTK_NN_CONTROL						 0x8400ff40
@@ -59,7 +61,6 @@ struct videc_dev {
 	struct v4l2_m2m_dev	*m2m_dev;
 	struct npp_ctx *nppctx_activate;
 	int irq;
-	struct mutex hw_mutex;
 	struct semaphore hw_sem;
 
 	spinlock_t device_spin_lock;
@@ -88,11 +89,34 @@ struct rtk_mipi_csi_metadata {
 	uint64_t c_data_phyaddr;
 };
 
+/* must be modified by npp */
+struct rtk_npp_output_params {
+	uint32_t width;
+	uint32_t height;
+	uint32_t crop_left;
+	uint32_t crop_top;
+	uint32_t crop_width;
+	uint32_t crop_height;
+	uint8_t single_rgb_plane;
+	uint8_t signed_rgb_output;
+	uint8_t reserved[2];
+};
+
+/*
+ * With num_outputs > 1 every m2m job scales one OUTPUT buffer into
+ * num_outputs consecutive CAPTURE buffers, output[i] describing the i-th.
+ */
+struct rtk_npp_multi_output_params {
+	uint32_t num_outputs;
+	struct rtk_npp_output_params output[NPP_MAX_OUTPUTS];
+};
+
 struct vid_params {
 	uint8_t npp_svp;
 	uint8_t single_rgb_plane;
 	struct rtk_mipi_csi_params mipi_csi_param;
 	uint8_t signed_rgb_output;
+	struct rtk_npp_multi_output_params multi_output;
 };
 
 struct drv_npp_ctx {
@@ -38,6 +38,8 @@
 #define PIC_SIZE_STEP_WIDTH 16
 #define PIC_SIZE_STEP_HEIGHT 2
 
+#define NPP_MAX_OUTPUTS (4)
+
 struct npp_buf_object {
 	struct device *dev;
 	dma_addr_t paddr;
@@ -48,6 +50,17 @@ struct npp_buf_object {
 	unsigned char ready;
 };
 
+/* one rendition of an m2m job */
+struct npp_job_output {
+	uint32_t width;
+	uint32_t height;
+	uint32_t sizeimage;
+	struct v4l2_rect crop;
+	uint8_t single_rgb_plane;
+	uint8_t signed_rgb_output;
+	struct vb2_v4l2_buffer *v4l2_buf;
+};
+
 struct npp_ctx {
 	struct mutex npp_mutex;
 	struct npp_buf_object *cap_q_buf_obj;
@@ -65,18 +78,17 @@ struct npp_ctx {
 	struct v4l2_rect rect;
 
 	struct v4l2_format out;
-	struct task_struct *thread_out, *thread_cap, *thread_run;
-	int	thread_out_interval, thread_cap_interval, thread_run_interval;
+	struct v4l2_fh *m2m_fh;
+	struct work_struct job_done_work;
+	struct delayed_work job_timeout_work;
+#ifndef ENABLE_NPP_ISR
+	struct delayed_work job_poll_work;
+#endif
 	uint32_t seq_out;
 	spinlock_t npp_spin_lock;
-	wait_queue_head_t npp_out_waitq;
-	wait_queue_head_t npp_cap_waitq;
-	wait_queue_head_t npp_run_waitq;
 	int is_cap_started, is_out_started;
 	uint32_t bufcnt_out, bufcnt_cap;
 	uint32_t memory_out;
-	bool stop_cmd;
-	int cap_retry_cnt;
 	uint64_t out_q_cnt;
 	uint64_t cap_q_cnt;
 
@@ -88,9 +100,12 @@ struct npp_ctx {
 	struct npp_buf_object *out_q_buf_obj;
 
 	bool npp_hw_finish;
+	bool job_running;
 
 	struct vb2_v4l2_buffer *out_v4l2_buf;
-	struct vb2_v4l2_buffer *cap_v4l2_buf;
+	struct npp_job_output job_out[NPP_MAX_OUTPUTS];
+	unsigned int job_num_outputs;
+	unsigned int job_cur_output;
 };
 
 struct npp_fmt {
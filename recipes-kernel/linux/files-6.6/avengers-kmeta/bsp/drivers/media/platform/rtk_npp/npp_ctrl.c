@@ -2364,6 +2364,20 @@ void NPP_Set_EngineGo(enum TARGET_SOC target_soc)
 	_NPP_Set_EngineGo(target_soc);
 }
 
+/*
+ * Func : NPP_Set_EngineStop
+ *
+ * Desc : stop NPP engine operation, mask and clear the finish interrupt
+ *
+ * Parm : target_soc: SOC board
+ *
+ * Retn : N/A
+ */
+void NPP_Set_EngineStop(enum TARGET_SOC target_soc)
+{
+	_NPP_Set_EngineStop(target_soc);
+}
+
 /*
  * Func : NPP_Close_INTEN
  *
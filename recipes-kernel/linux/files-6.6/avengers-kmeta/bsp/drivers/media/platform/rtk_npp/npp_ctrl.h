@@ -345,6 +345,7 @@ unsigned int NPP_Set_OutputDataBuffer(struct Npp_OutputBufInfo *output_buffer, e
 unsigned int NPP_Set_ColorSpaceConversion(enum TARGET_SOC target_soc);
 unsigned int NPP_Set_ScalerCoefficient(struct Npp_ImageScalingInfo *image_scaling, enum TARGET_SOC target_soc);
 void NPP_Set_EngineGo(enum TARGET_SOC target_soc);
+void NPP_Set_EngineStop(enum TARGET_SOC target_soc);
 void NPP_Close_INTEN(enum TARGET_SOC target_soc);
 void NPP_Clear_INTStatus(unsigned int int_mask, enum TARGET_SOC target_soc);
 void NPP_Get_FinishStatus(unsigned char *is_finish, enum TARGET_SOC target_soc);
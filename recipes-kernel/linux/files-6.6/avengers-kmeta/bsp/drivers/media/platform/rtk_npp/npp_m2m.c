@@ -16,7 +16,7 @@
 #include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/kernel.h>
-#include <linux/kthread.h>  // for threads
+#include <linux/workqueue.h>
 #include <linux/time.h>   // for using jiffies
 #include <media/v4l2-mem2mem.h>
 #include <media/v4l2-device.h>
@@ -46,11 +46,11 @@
 #include <linux/ktime.h>
 #endif
 
+#define NPP_M2M_JOB_TIMEOUT_MS	(500)
+#define NPP_M2M_JOB_POLL_MS	(1)
+
 static void npp_cap_buf_done(struct v4l2_fh *fh,
 struct vb2_v4l2_buffer *buf, bool eos, enum vb2_buffer_state state);
-static int npp_cap_dqbuf(void *fh, struct vb2_v4l2_buffer *v4l2_buf, uint32_t *len, uint64_t *pts);
-static int npp_out_dqbuf(struct v4l2_fh *fh, struct vb2_v4l2_buffer *v4l2_buf);
-static int npp_run(struct v4l2_fh *fh);
 
 static struct npp_fmt npp_fmt_list[2][7] = {
 
@@ -369,216 +369,6 @@ static struct npp_ctx *vq_to_npp(struct vb2_queue *q)
 	return ctx->npp_ctx;
 }
 
-static int npp_buf_done(struct v4l2_fh *fh, struct vb2_v4l2_buffer *v4l2_buf, uint32_t len,
-uint64_t pts, uint32_t sizeimage, uint32_t sequence,
-bool eos, bool no_frame)
-{
-	struct npp_ctx *ctx = fh_to_npp(fh);
-	unsigned long flags;
-
-	v4l2_buf = v4l2_m2m_dst_buf_remove(fh->m2m_ctx);
-	if (!v4l2_buf) {
-		pr_err("%s, No dst buffer to remove\n", __func__);
-		return -ENOBUFS;
-	}
-	v4l2_buf->field = V4L2_FIELD_NONE;
-	v4l2_buf->flags = V4L2_BUF_FLAG_KEYFRAME;
-	v4l2_buf->vb2_buf.timestamp = pts;
-	v4l2_buf->vb2_buf.planes[0].bytesused = len;
-	v4l2_buf->sequence = sequence++;
-	mutex_lock(&ctx->npp_mutex);
-	ctx->seq_cap = sequence;
-	mutex_unlock(&ctx->npp_mutex);
-
-	if (!no_frame)
-		vb2_set_plane_payload(&v4l2_buf->vb2_buf, 0, sizeimage);
-	else
-		vb2_set_plane_payload(&v4l2_buf->vb2_buf, 0, 0);
-
-	spin_lock_irqsave(&ctx->npp_spin_lock, flags);
-
-	npp_cap_buf_done(fh, v4l2_buf, eos, VB2_BUF_STATE_DONE);
-
-	spin_unlock_irqrestore(&ctx->npp_spin_lock, flags);
-	return 0;
-}
-
-static int threadcap(void *data)
-{
-	struct v4l2_fh *fh = (struct v4l2_fh *) data;
-	struct drv_npp_ctx *drvctx = container_of(fh, struct drv_npp_ctx, fh);
-	struct npp_ctx *nppctx = drvctx->npp_ctx;
-	uint32_t sizeimage, sequence;
-	unsigned long flags;
-	struct vb2_v4l2_buffer *v4l2_buf;
-	int ret;
-
-	while (1) {
-		ret = wait_event_interruptible_timeout(nppctx->npp_cap_waitq,
-		 v4l2_m2m_num_dst_bufs_ready(fh->m2m_ctx) || kthread_should_stop(),
-		 msecs_to_jiffies(nppctx->thread_cap_interval));
-
-		if (kthread_should_stop() || (ret == -ERESTARTSYS)) {
-			for (;;) {
-				v4l2_buf = v4l2_m2m_dst_buf_remove(fh->m2m_ctx);
-				if (v4l2_buf == NULL) {
-					pr_err("%s(), v4l2_buf = NULL, exit\n", __func__);
-					return 1;
-				}
-
-				spin_lock_irqsave(&nppctx->npp_spin_lock, flags);
-				v4l2_m2m_buf_done(v4l2_buf, VB2_BUF_STATE_ERROR);
-				spin_unlock_irqrestore(&nppctx->npp_spin_lock, flags);
-			}
-		}
-
-		if (!v4l2_m2m_num_dst_bufs_ready(fh->m2m_ctx))
-			continue;
-
-		ret = 0;
-		for (;  !ret;) {
-			uint32_t len = 0;
-			uint64_t pts = 0;
-			bool eos = 0;
-			bool no_frame = 0;
-
-			v4l2_buf = v4l2_m2m_next_dst_buf(fh->m2m_ctx);
-			if (!v4l2_buf)
-				break;
-
-			mutex_lock(&nppctx->npp_mutex);
-			sizeimage = nppctx->cap.fmt.pix_mp.plane_fmt[0].sizeimage;
-			sequence = nppctx->seq_cap;
-			mutex_unlock(&nppctx->npp_mutex);
-
-			pr_info("%s, seq_cap=%d\n", __func__, nppctx->seq_cap);
-
-			ret = npp_cap_dqbuf(fh, v4l2_buf, &len, &pts);	// add NPP hw function here
-
-			if (!ret) {
-				if (npp_buf_done(fh, v4l2_buf, len, pts,
-				 sizeimage, sequence, eos, no_frame))
-					break;
-				nppctx->cap_retry_cnt = 0;
-				continue;
-			}
-			if (ret == -EAGAIN) {
-				nppctx->cap_retry_cnt++;
-
-				if (nppctx->cap_retry_cnt > 1000) {
-					if (nppctx->stop_cmd && npp_buf_done(fh, v4l2_buf,
-						0, 0, 0, 0, 1, 1))
-						break;
-					nppctx->cap_retry_cnt = 0;
-					pr_err("%s, Capture buf full !\n", __func__);
-				}
-			}
-			usleep_range(1000, 1000);
-			break;
-		}
-	}
-
-	return 0;
-}
-
-static int threadout(void *data)
-{
-	struct v4l2_fh *fh = (struct v4l2_fh *) data;
-	struct drv_npp_ctx *drvctx = container_of(fh, struct drv_npp_ctx, fh);
-	struct npp_ctx *nppctx = drvctx->npp_ctx;
-	uint32_t sizeimage, sequence;
-	struct vb2_v4l2_buffer *v4l2_buf;
-	unsigned long flags;
-
-	while (1) {
-		int ret;
-		 ret = wait_event_interruptible_timeout(nppctx->npp_out_waitq,
-		  v4l2_m2m_num_src_bufs_ready(fh->m2m_ctx) ||
-		  kthread_should_stop(), msecs_to_jiffies(nppctx->thread_out_interval));
-
-		if (kthread_should_stop() || (ret == -ERESTARTSYS)) {
-			for (;;) {
-				v4l2_buf = v4l2_m2m_src_buf_remove(fh->m2m_ctx);
-				if (v4l2_buf == NULL) {
-					pr_err("%s(), v4l2_buf = NULL, exit\n", __func__);
-					return 1;
-				}
-
-				spin_lock_irqsave(&nppctx->npp_spin_lock, flags);
-				v4l2_m2m_buf_done(v4l2_buf, VB2_BUF_STATE_ERROR);
-				spin_unlock_irqrestore(&nppctx->npp_spin_lock, flags);
-			}
-		}
-
-		if (v4l2_m2m_num_src_bufs_ready(fh->m2m_ctx)) {
-			for (;;) {
-				v4l2_buf = v4l2_m2m_next_src_buf(fh->m2m_ctx);
-				if (!v4l2_buf)
-					break;
-
-				mutex_lock(&nppctx->npp_mutex);
-				sizeimage = nppctx->out.fmt.pix_mp.plane_fmt[0].sizeimage;
-				sequence = nppctx->seq_out;
-				mutex_unlock(&nppctx->npp_mutex);
-
-				ret = npp_out_dqbuf(fh, v4l2_buf);	// add NPP hw function here
-
-				if (!ret) {
-					v4l2_buf = v4l2_m2m_src_buf_remove(fh->m2m_ctx);
-					if (!v4l2_buf) {
-						pr_err("%s, No src buffer to remove\n", __func__);
-						break;
-					}
-
-					v4l2_buf->sequence = sequence++;
-
-					mutex_lock(&nppctx->npp_mutex);
-					nppctx->seq_out = sequence;
-					mutex_unlock(&nppctx->npp_mutex);
-
-					vb2_set_plane_payload(&v4l2_buf->vb2_buf, 0, sizeimage);
-
-					spin_lock_irqsave(&nppctx->npp_spin_lock, flags);
-					v4l2_m2m_buf_done(v4l2_buf, VB2_BUF_STATE_DONE);
-					spin_unlock_irqrestore(&nppctx->npp_spin_lock, flags);
-					continue;
-				}
-
-				break;
-			}
-		}
-	}
-
-	return  0;
-}
-
-static int threadrun(void *data)
-{
-	struct v4l2_fh *fh = (struct v4l2_fh *) data;
-	struct drv_npp_ctx *drvctx = container_of(fh, struct drv_npp_ctx, fh);
-	struct npp_ctx *nppctx = drvctx->npp_ctx;
-	int ret;
-
-	while (1) {
-		ret = wait_event_interruptible_timeout(nppctx->npp_run_waitq,
-		 kthread_should_stop(), msecs_to_jiffies(nppctx->thread_run_interval));
-
-		if (kthread_should_stop() || (ret == -ERESTARTSYS)) {
-			if (ret == -ERESTARTSYS)
-				pr_err("%s(), ret = -ERESTARTSYS, exit\n", __func__);
-			return 1;
-		}
-
-		while (1) {
-			ret = npp_run(fh);
-
-			if (ret < 0)
-				break;
-		}
-	}
-
-	return  0;
-}
 
 static int npp_enum_fmt_cap(struct v4l2_fmtdesc *f)
 {
@@ -841,82 +631,46 @@ static int npp_start_streaming(struct vb2_queue *q, uint32_t count)
 {
 	struct drv_npp_ctx *drvctx = vb2_get_drv_priv(q);
 	struct npp_ctx *nppctx = drvctx->npp_ctx;
-	struct v4l2_fh *fh = &drvctx->fh;
-	int ret = 0;
-	int out_pixelformat = nppctx->out.fmt.pix_mp.pixelformat;
-	int cap_pixelformat = nppctx->cap.fmt.pix_mp.pixelformat;
 
 	mutex_lock(&nppctx->npp_mutex);
-
-	if (!nppctx->thread_run)
-		nppctx->thread_run = kthread_run(threadrun, fh, "runthread");
-
 	if (V4L2_TYPE_IS_OUTPUT(q->type)) {
 		nppctx->seq_out = 0;
 		nppctx->memory_out = q->memory;
-		nppctx->thread_out = kthread_run(threadout, fh, "outthread %c%c%c%c",
-		((0xff&out_pixelformat)>>0), ((0xff&out_pixelformat)>>8),
-		((0xff&out_pixelformat)>>16), ((0xff&out_pixelformat)>>24));
 		nppctx->is_out_started = 1;
 	} else {
 		nppctx->seq_cap = 0;
 		nppctx->memory_cap = q->memory;
-		nppctx->thread_cap = kthread_run(threadcap, fh, "capthread %c%c%c%c",
-		((0xff&cap_pixelformat)>>0), ((0xff&cap_pixelformat)>>8),
-		((0xff&cap_pixelformat)>>16), ((0xff&cap_pixelformat)>>24));
 		nppctx->is_cap_started = 1;
 	}
 	mutex_unlock(&nppctx->npp_mutex);
 
-	return ret;
+	return 0;
 }
 
 static int npp_stop_streaming(struct vb2_queue *q)
 {
 	struct drv_npp_ctx *drvctx = vb2_get_drv_priv(q);
 	struct npp_ctx *nppctx = drvctx->npp_ctx;
-	int ret = 0;
-
-
-	if (nppctx->thread_run) {
-		wake_up_interruptible(&nppctx->npp_run_waitq);
-		kthread_stop(nppctx->thread_run);
-		nppctx->thread_run = NULL;
-	}
-
-	if (V4L2_TYPE_IS_OUTPUT(q->type)) {
-		wake_up_interruptible(&nppctx->npp_out_waitq);
-		if (nppctx->thread_out)
-			kthread_stop(nppctx->thread_out);
-	} else {
-		wake_up_interruptible(&nppctx->npp_cap_waitq);
-		if (nppctx->thread_cap)
-			kthread_stop(nppctx->thread_cap);
-	}
 
 	mutex_lock(&nppctx->npp_mutex);
-
-
 	if (V4L2_TYPE_IS_OUTPUT(q->type))
 		nppctx->is_out_started = 0;
 	else
 		nppctx->is_cap_started = 0;
-
 	mutex_unlock(&nppctx->npp_mutex);
-	return ret;
+
+	return 0;
 }
 
 static int npp_qbuf(struct v4l2_fh *fh, struct vb2_buffer *vb)
 {
 	struct npp_ctx *ctx = vq_to_npp(vb->vb2_queue);
 
-	if (V4L2_TYPE_IS_OUTPUT(vb->type)) {
+	if (V4L2_TYPE_IS_OUTPUT(vb->type))
 		ctx->out_q_cnt++;
-		wake_up_interruptible(&ctx->npp_out_waitq);
-		return 0;
-	}
-	ctx->cap_q_cnt++;
-	wake_up_interruptible(&ctx->npp_cap_waitq);
+	else
+		ctx->cap_q_cnt++;
+
 	return 0;
 }
 
@@ -963,80 +717,34 @@ void npp_cap_buf_done(struct v4l2_fh *fh, struct vb2_v4l2_buffer *buf,
 	v4l2_m2m_buf_done(buf, state);
 }
 
-int npp_cap_dqbuf(void *fh, struct vb2_v4l2_buffer *v4l2_buf, uint32_t *len, uint64_t *pts)
-{
-	struct drv_npp_ctx *drvctx = container_of(fh, struct drv_npp_ctx, fh);
-	struct npp_ctx *nppctx = drvctx->npp_ctx;
-	unsigned int cap_buf_data_size = (nppctx->cap.fmt.pix_mp.width * nppctx->cap.fmt.pix_mp.height);
-	int ret;
-
-	nppctx->cap_v4l2_buf = v4l2_buf;
-	nppctx->cap_q_buf_obj->done = 0;
-	nppctx->cap_q_buf_obj->ready = 1;
-	wake_up_interruptible(&nppctx->npp_run_waitq);
-
-	ret = wait_event_interruptible(nppctx->npp_cap_waitq, kthread_should_stop()
-	|| nppctx->cap_q_buf_obj->done);
-	if (kthread_should_stop() || (ret == -ERESTART)) {
-		if (ret == -ERESTART)
-			pr_err("%s(%d) wait event error !!!\n", __func__, __LINE__);
-		return -ERESTARTSYS;
-	}
-
-	*len = (cap_buf_data_size * 3);
-	pr_info("%s, len = %d, %d\n", __func__, *len, v4l2_buf->vb2_buf.planes[0].bytesused);
-	return 0;
-}
-
-static int npp_out_dqbuf(struct v4l2_fh *fh, struct vb2_v4l2_buffer *v4l2_buf)
+static void npp_out_copy_userptr(struct drv_npp_ctx *drvctx, struct vb2_v4l2_buffer *v4l2_buf)
 {
-	struct drv_npp_ctx *drvctx = container_of(fh, struct drv_npp_ctx, fh);
 	struct npp_ctx *nppctx = drvctx->npp_ctx;
-	int ret;
-
-	if (nppctx->memory_out == V4L2_MEMORY_USERPTR) {
-		uint8_t *out_vaddr = vb2_plane_vaddr(&v4l2_buf->vb2_buf, 0);
-		uint8_t *dst = nppctx->out_q_buf_obj->vaddr;
-		uint32_t len = v4l2_buf->vb2_buf.planes[0].bytesused;
-
-		if ((drvctx->params.mipi_csi_param.mipi_csi_input == 0) ||
-			(drvctx->params.mipi_csi_param.mipi_csi_input == 1 &&
-			 drvctx->params.mipi_csi_param.in_queue_metadata == 0))
-			memcpy(dst, out_vaddr, len);
-		if (drvctx->params.mipi_csi_param.mipi_csi_input == 1 &&
-		 drvctx->params.mipi_csi_param.in_queue_metadata == 1)
-			memcpy(dst, out_vaddr,
-			drvctx->params.mipi_csi_param.y_header_size +
-			drvctx->params.mipi_csi_param.y_data_size +
-			drvctx->params.mipi_csi_param.c_header_size +
-			drvctx->params.mipi_csi_param.c_data_size);
-	}
-
-	nppctx->out_v4l2_buf = v4l2_buf;
-	nppctx->out_q_buf_obj->done = 0;
-	nppctx->out_q_buf_obj->ready = 1;
-	pr_info("%s, done=%d, ready=%d\n", __func__, nppctx->out_q_buf_obj->done,
-	 nppctx->out_q_buf_obj->ready);
-	wake_up_interruptible(&nppctx->npp_run_waitq);
-
-	ret = wait_event_interruptible(nppctx->npp_out_waitq,
-	(kthread_should_stop() || nppctx->out_q_buf_obj->done));
-	if (kthread_should_stop() || (ret == -ERESTARTSYS)) {
-		if (ret == -ERESTARTSYS)
-			pr_err("%s(%d) wait event error !!!\n", __func__, __LINE__);
-		return -ERESTARTSYS;
-	}
-
-	return 0;
+	uint8_t *out_vaddr = vb2_plane_vaddr(&v4l2_buf->vb2_buf, 0);
+	uint8_t *dst = nppctx->out_q_buf_obj->vaddr;
+	uint32_t len = v4l2_buf->vb2_buf.planes[0].bytesused;
+
+	if ((drvctx->params.mipi_csi_param.mipi_csi_input == 0) ||
+		(drvctx->params.mipi_csi_param.mipi_csi_input == 1 &&
+		 drvctx->params.mipi_csi_param.in_queue_metadata == 0))
+		memcpy(dst, out_vaddr, len);
+	if (drvctx->params.mipi_csi_param.mipi_csi_input == 1 &&
+	 drvctx->params.mipi_csi_param.in_queue_metadata == 1)
+		memcpy(dst, out_vaddr,
+		drvctx->params.mipi_csi_param.y_header_size +
+		drvctx->params.mipi_csi_param.y_data_size +
+		drvctx->params.mipi_csi_param.c_header_size +
+		drvctx->params.mipi_csi_param.c_data_size);
 }
 
-static int npp_run(struct v4l2_fh *fh)
+/*
+ * Program the NPP registers to scale out_v4l2_buf into the output described
+ * by @o. The caller owns hw_sem.
+ */
+static int npp_hw_setup(struct drv_npp_ctx *drvctx, const struct npp_job_output *o)
 {
-	struct drv_npp_ctx *drvctx = container_of(fh, struct drv_npp_ctx, fh);
 	struct npp_ctx *nppctx = drvctx->npp_ctx;
 	struct videc_dev *v_dev = drvctx->dev;
-	int ret;
-	unsigned long flags;
 
 	__u32 pixelformat;
 	struct Npp_InputBufInfo input_buffer;
@@ -1052,24 +760,7 @@ static int npp_run(struct v4l2_fh *fh)
 	dma_addr_t src_paddr, dst_paddr;
 	uint8_t *src_vaddr;
 
-#ifndef ENABLE_NPP_ISR
-	unsigned int int_status = 0;
-#endif
-
-	if (nppctx->memory_cap == V4L2_MEMORY_USERPTR)
-		ret = wait_event_interruptible(nppctx->npp_run_waitq, kthread_should_stop()
-	|| nppctx->out_q_buf_obj->ready);
-	else
-		ret = wait_event_interruptible(nppctx->npp_run_waitq, kthread_should_stop()
-	|| (nppctx->out_q_buf_obj->ready && nppctx->cap_q_buf_obj->ready));
-
-	if (kthread_should_stop() || (ret == -ERESTARTSYS)) {
-		if (ret == -ERESTARTSYS)
-			pr_err("%s, [%p] wait event error !!!\n", __func__, nppctx);
-		return -ERESTARTSYS;
-	}
-
-	crop_rect = nppctx->rect;
+	crop_rect = o->crop;
 
 	if (nppctx->out.fmt.pix_mp.width < crop_rect.left+crop_rect.width)
 		crop_rect.width = nppctx->out.fmt.pix_mp.width-crop_rect.left;
@@ -1086,7 +777,7 @@ static int npp_run(struct v4l2_fh *fh)
 		// internal created src buffer physical address
 		dst_paddr = nppctx->cap_q_buf_obj->paddr;
 		// internal created dst buffer physical address
-		pr_info("%s, USERPTR, src_paddr = 0x%llx, dst_paddr = 0x%llx\n",
+		pr_debug("%s, USERPTR, src_paddr = 0x%llx, dst_paddr = 0x%llx\n",
 		 __func__, src_paddr, dst_paddr);
 	} else if (nppctx->memory_out == V4L2_MEMORY_MMAP) {
 		src_vaddr =
@@ -1096,9 +787,9 @@ static int npp_run(struct v4l2_fh *fh)
 		vb2_dma_contig_plane_dma_addr(&nppctx->out_v4l2_buf->vb2_buf, 0);
 		// out physical address
 		dst_paddr =
-		vb2_dma_contig_plane_dma_addr(&nppctx->cap_v4l2_buf->vb2_buf, 0);
+		vb2_dma_contig_plane_dma_addr(&o->v4l2_buf->vb2_buf, 0);
 		// cap physical address
-		pr_info("%s, MMAP, src_paddr = 0x%llx, dst_paddr = 0x%llx\n",
+		pr_debug("%s, MMAP, src_paddr = 0x%llx, dst_paddr = 0x%llx\n",
 		 __func__, src_paddr, dst_paddr);
 	} else {
 		src_vaddr =
@@ -1110,9 +801,9 @@ static int npp_run(struct v4l2_fh *fh)
 			nppctx->out_v4l2_buf->planes[0].data_offset;
 		// out physical address
 		dst_paddr =
-		vb2_dma_contig_plane_dma_addr(&nppctx->cap_v4l2_buf->vb2_buf, 0);
+		vb2_dma_contig_plane_dma_addr(&o->v4l2_buf->vb2_buf, 0);
 		// cap physical address
-		pr_info("%s, DMA, src_paddr = 0x%llx, dst_paddr = 0x%llx\n",
+		pr_debug("%s, DMA, src_paddr = 0x%llx, dst_paddr = 0x%llx\n",
 		 __func__, src_paddr, dst_paddr);
 	}
 
@@ -1168,10 +859,6 @@ static int npp_run(struct v4l2_fh *fh)
 		}
 	}
 
-	mutex_lock(&drvctx->dev->hw_mutex);
-	down(&drvctx->dev->hw_sem);
-	drvctx->dev->nppctx_activate = nppctx;
-	pr_info("%s, mutex_lock npp_ctx = %p\n", __func__, nppctx);
 
 	src_input.src_width = nppctx->out.fmt.pix_mp.width;
 	src_input.src_height = nppctx->out.fmt.pix_mp.height;
@@ -1188,7 +875,7 @@ static int npp_run(struct v4l2_fh *fh)
 	src_input.pitch = (src_input.yuv_format == NV12_UV
 	|| src_input.yuv_format == NV21_VU || src_input.yuv_format == NV16)
 	 ? (nppctx->out.fmt.pix_mp.width) : (nppctx->out.fmt.pix_mp.width * 2);
-	pr_info("%s, width(%d), height(%d), yuv_sample(%d), bit_depth(%d)\n",
+	pr_debug("%s, width(%d), height(%d), yuv_sample(%d), bit_depth(%d)\n",
 	 __func__, src_input.src_width, src_input.src_height,
 	 src_input.yuv_sample, src_input.bit_depth);
 	NPP_Set_InputImageFormat(&src_input, v_dev->target_soc);
@@ -1240,13 +927,13 @@ static int npp_run(struct v4l2_fh *fh)
 		NPP_Set_MIPICSI_InputDataBuffer(&mipi_csi_input_buf, v_dev->target_soc);
 	}
 
-	NPP_Set_OutputRGBFormat((drvctx->params.single_rgb_plane == 1)
+	NPP_Set_OutputRGBFormat((o->single_rgb_plane == 1)
 	 ? SINGLE_PLANE_RGB : THREE_PLANE_RGB, v_dev->target_soc);
 
-	tgt_output.tgt_width = nppctx->cap.fmt.pix_mp.width;
-	tgt_output.tgt_height = nppctx->cap.fmt.pix_mp.height;
+	tgt_output.tgt_width = o->width;
+	tgt_output.tgt_height = o->height;
 	tgt_output.wb_format = RGB_MODE;
-	tgt_output.rgb_level = (drvctx->params.signed_rgb_output == 1)
+	tgt_output.rgb_level = (o->signed_rgb_output == 1)
 	? NEGATIVE_LEVEL : POSITIVE_LEVEL;
 	tgt_output.rgb_format = THREE_PLANE_RGB;
 	tgt_output.rgb_bit_mode = MODE_8bit;
@@ -1254,9 +941,9 @@ static int npp_run(struct v4l2_fh *fh)
 
 	output_buffer.r_addr = (unsigned long)dst_paddr;
 	output_buffer.g_addr =
-	(unsigned long)dst_paddr + (nppctx->cap.fmt.pix_mp.width * nppctx->cap.fmt.pix_mp.height);
+	(unsigned long)dst_paddr + (o->width * o->height);
 	output_buffer.b_addr =
-	(unsigned long)dst_paddr + ((nppctx->cap.fmt.pix_mp.width * nppctx->cap.fmt.pix_mp.height) * 2);
+	(unsigned long)dst_paddr + ((o->width * o->height) * 2);
 	NPP_Set_OutputDataBuffer(&output_buffer, v_dev->target_soc);
 
 	NPP_Set_ColorSpaceConversion(v_dev->target_soc);
@@ -1265,7 +952,7 @@ static int npp_run(struct v4l2_fh *fh)
 		crop_rect.top != 0   ||
 		crop_rect.width != 0 ||
 		crop_rect.height != 0) {
-		pr_info("%s, crop win: x(%d), y(%d), w(%d), h(%d)\n",
+		pr_debug("%s, crop win: x(%d), y(%d), w(%d), h(%d)\n",
 		 __func__, crop_rect.left, crop_rect.top, crop_rect.width, crop_rect.height);
 
 		src_input.src_width = crop_rect.width;
@@ -1284,9 +971,9 @@ static int npp_run(struct v4l2_fh *fh)
 	image_scaling.crop_pos.win_h = crop_rect.height;
 	image_scaling.input_width = nppctx->out.fmt.pix_mp.width;
 	image_scaling.input_height = nppctx->out.fmt.pix_mp.height;
-	image_scaling.output_width = nppctx->cap.fmt.pix_mp.width;
-	image_scaling.output_height = nppctx->cap.fmt.pix_mp.height;
-	pr_info("%s, input(%d x %d), output(%d x %d)\n",
+	image_scaling.output_width = o->width;
+	image_scaling.output_height = o->height;
+	pr_debug("%s, input(%d x %d), output(%d x %d)\n",
 	 __func__, image_scaling.input_width, image_scaling.input_height,
 	 image_scaling.output_width, image_scaling.output_height);
 
@@ -1294,106 +981,329 @@ static int npp_run(struct v4l2_fh *fh)
 
 	NPP_Set_SecureVideoPath((unsigned char)drvctx->params.npp_svp, v_dev->target_soc);
 
+
+	return 0;
+}
+
+#ifndef ENABLE_NPP_ISR
+/*
+ * Without the NPP interrupt the finish status is polled from a delayed
+ * work, so device_run never sleeps. A pass that never finishes is still
+ * failed by npp_m2m_job_timeout_worker().
+ */
+static void npp_m2m_job_poll_worker(struct work_struct *work)
+{
+	struct npp_ctx *nppctx = container_of(to_delayed_work(work),
+					      struct npp_ctx, job_poll_work);
+	struct drv_npp_ctx *drvctx = container_of(nppctx->m2m_fh, struct drv_npp_ctx, fh);
+	struct videc_dev *v_dev = drvctx->dev;
+	unsigned int int_status = 0;
+	unsigned long flags;
+
 	spin_lock_irqsave(&nppctx->npp_spin_lock, flags);
-	nppctx->out_q_buf_obj->done = 0;
-	pr_info("%s, out_q_buf_obj->done = 0\n", __func__);
+	if (!nppctx->job_running || nppctx->npp_hw_finish) {
+		spin_unlock_irqrestore(&nppctx->npp_spin_lock, flags);
+		return;
+	}
 	spin_unlock_irqrestore(&nppctx->npp_spin_lock, flags);
 
-	NPP_Set_EngineGo(v_dev->target_soc);
+	NPP_Get_INTStatus(&int_status, v_dev->target_soc);
+	if (!int_status) {
+		schedule_delayed_work(&nppctx->job_poll_work,
+				      msecs_to_jiffies(NPP_M2M_JOB_POLL_MS));
+		return;
+	}
+
 #ifdef ENABLE_NPP_MEASURE_TIME
-	nppctx->start_time = ktime_get();
+	nppctx->end_time = ktime_get();
 #endif
+	NPP_Close_INTEN(v_dev->target_soc);
+	if ((int_status & NPP_INTST_fin_mask) != 0)
+		NPP_Clear_INTStatus(NPP_INTST_fin_mask, v_dev->target_soc);
+	if ((int_status & NPP_INTST_vi_tvve_core_mask) != 0)
+		NPP_Clear_INTStatus(NPP_INTST_vi_tvve_core_mask, v_dev->target_soc);
 
-#ifndef ENABLE_NPP_ISR
-	while (!kthread_should_stop()) {
-		int_status = 0;
-		NPP_Get_INTStatus(&int_status, v_dev->target_soc);
-
-		if (int_status) {
-#ifdef ENABLE_NPP_MEASURE_TIME
-			end_time = ktime_get();
+	spin_lock_irqsave(&nppctx->npp_spin_lock, flags);
+	if (nppctx->job_running && !nppctx->npp_hw_finish) {
+		nppctx->npp_hw_finish = true;
+		schedule_work(&nppctx->job_done_work);
+	}
+	spin_unlock_irqrestore(&nppctx->npp_spin_lock, flags);
+}
 #endif
-			NPP_Close_INTEN(v_dev->target_soc);
-			if ((int_status & NPP_INTST_fin_mask) != 0) {
-				NPP_Clear_INTStatus(NPP_INTST_fin_mask, v_dev->target_soc);
-				pr_info("polling INTST_fin\n");
-			}
-			if ((int_status & NPP_INTST_vi_tvve_core_mask) != 0) {
-				NPP_Clear_INTStatus(NPP_INTST_vi_tvve_core_mask, v_dev->target_soc);
-				pr_info("polling INTST_vi_tvve_core\n");
-			}
-
-			spin_lock_irqsave(&nppctx->npp_spin_lock, flags);
-			nppctx->npp_hw_finish = true;
-			spin_unlock_irqrestore(&nppctx->npp_spin_lock, flags);
 
-			break;
+/*
+ * Number of capture buffers consumed by one job: one per configured
+ * rendition when RTK_V4L2_NPP_MULTI_OUTPUT_CONFIG is set, otherwise one.
+ */
+static unsigned int npp_m2m_num_outputs(struct drv_npp_ctx *drvctx)
+{
+	unsigned int num = drvctx->params.multi_output.num_outputs;
+
+	return (num > 1 && num <= NPP_MAX_OUTPUTS) ? num : 1;
+}
+
+/*
+ * Take the src buffer and one dst buffer per rendition off the ready queues
+ * and describe each rendition in nppctx->job_out[].
+ */
+static int npp_m2m_prepare_outputs(struct drv_npp_ctx *drvctx)
+{
+	struct npp_ctx *nppctx = drvctx->npp_ctx;
+	struct v4l2_fh *fh = &drvctx->fh;
+	struct npp_job_output *o;
+	unsigned int i, num = npp_m2m_num_outputs(drvctx);
+	int ret = 0;
+
+	nppctx->out_v4l2_buf = v4l2_m2m_src_buf_remove(fh->m2m_ctx);
+	nppctx->job_num_outputs = 0;
+	nppctx->job_cur_output = 0;
+
+	for (i = 0; i < num; i++) {
+		o = &nppctx->job_out[i];
+		o->v4l2_buf = v4l2_m2m_dst_buf_remove(fh->m2m_ctx);
+		if (!o->v4l2_buf)
+			return -ENOBUFS;
+		nppctx->job_num_outputs++;
+
+		if (num == 1) {
+			mutex_lock(&nppctx->npp_mutex);
+			o->width = nppctx->cap.fmt.pix_mp.width;
+			o->height = nppctx->cap.fmt.pix_mp.height;
+			o->sizeimage = nppctx->cap.fmt.pix_mp.plane_fmt[0].sizeimage;
+			o->crop = nppctx->rect;
+			mutex_unlock(&nppctx->npp_mutex);
+			o->single_rgb_plane = drvctx->params.single_rgb_plane;
+			o->signed_rgb_output = drvctx->params.signed_rgb_output;
+		} else {
+			const struct rtk_npp_output_params *param =
+				&drvctx->params.multi_output.output[i];
+
+			o->width = param->width;
+			o->height = param->height;
+			o->sizeimage = param->width * param->height * 3;
+			o->crop.left = param->crop_left;
+			o->crop.top = param->crop_top;
+			o->crop.width = param->crop_width;
+			o->crop.height = param->crop_height;
+			o->single_rgb_plane = param->single_rgb_plane;
+			o->signed_rgb_output = param->signed_rgb_output;
 		}
 
-		usleep_range(500, 500);
+		if (o->sizeimage > vb2_plane_size(&o->v4l2_buf->vb2_buf, 0)) {
+			dev_err(drvctx->dev->dev, "output %u (%ux%u) does not fit buffer %d\n",
+				i, o->width, o->height, o->v4l2_buf->vb2_buf.index);
+			ret = -EINVAL;
+		}
 	}
+
+	if (!nppctx->out_v4l2_buf)
+		return -ENOBUFS;
+
+	return ret;
+}
+
+/*
+ * Claim the pass currently running on the hardware. Only one of the
+ * completion worker and the timeout worker may handle a pass.
+ */
+static bool npp_m2m_claim_job(struct npp_ctx *nppctx)
+{
+	unsigned long flags;
+	bool running;
+
+	spin_lock_irqsave(&nppctx->npp_spin_lock, flags);
+	running = nppctx->job_running;
+	nppctx->job_running = false;
+	nppctx->npp_hw_finish = false;
+	spin_unlock_irqrestore(&nppctx->npp_spin_lock, flags);
+
+	return running;
+}
+
+/*
+ * Program and start the pass for rendition job_cur_output. The source
+ * buffer stays the same for every pass of a job.
+ */
+static int npp_m2m_start_pass(struct drv_npp_ctx *drvctx)
+{
+	struct npp_ctx *nppctx = drvctx->npp_ctx;
+	struct videc_dev *v_dev = drvctx->dev;
+	unsigned long flags;
+	int ret;
+
+	ret = npp_hw_setup(drvctx, &nppctx->job_out[nppctx->job_cur_output]);
+	if (ret)
+		return ret;
+
+	spin_lock_irqsave(&nppctx->npp_spin_lock, flags);
+	nppctx->npp_hw_finish = false;
+	nppctx->job_running = true;
+	spin_unlock_irqrestore(&nppctx->npp_spin_lock, flags);
+
+	schedule_delayed_work(&nppctx->job_timeout_work,
+			      msecs_to_jiffies(NPP_M2M_JOB_TIMEOUT_MS));
+
+#ifdef ENABLE_NPP_MEASURE_TIME
+	nppctx->start_time = ktime_get();
 #endif
+	NPP_Set_EngineGo(v_dev->target_soc);
+
+#ifndef ENABLE_NPP_ISR
+	schedule_delayed_work(&nppctx->job_poll_work,
+			      msecs_to_jiffies(NPP_M2M_JOB_POLL_MS));
+#endif
+	return 0;
+}
+
+/*
+ * Return the src buffer and every dst buffer of the current job to
+ * userspace, release the hardware and let the m2m core schedule the next
+ * job. All renditions of a frame share its timestamp and sequence number.
+ */
+static void npp_m2m_job_finish(struct drv_npp_ctx *drvctx, enum vb2_buffer_state state)
+{
+	struct npp_ctx *nppctx = drvctx->npp_ctx;
+	struct videc_dev *v_dev = drvctx->dev;
+	struct v4l2_fh *fh = &drvctx->fh;
+	struct vb2_v4l2_buffer *src_buf = nppctx->out_v4l2_buf;
+	struct vb2_v4l2_buffer *dst_buf;
+	uint32_t out_sizeimage;
+	unsigned int i;
+
+	v_dev->nppctx_activate = NULL;
+	up(&v_dev->hw_sem);
 
-	ret = wait_event_interruptible(nppctx->npp_run_waitq,
-	 kthread_should_stop() || nppctx->npp_hw_finish);
+	mutex_lock(&nppctx->npp_mutex);
+	out_sizeimage = nppctx->out.fmt.pix_mp.plane_fmt[0].sizeimage;
+	mutex_unlock(&nppctx->npp_mutex);
+
+	for (i = 0; i < nppctx->job_num_outputs; i++) {
+		dst_buf = nppctx->job_out[i].v4l2_buf;
 
-	up(&drvctx->dev->hw_sem);
+		if (src_buf)
+			v4l2_m2m_buf_copy_metadata(src_buf, dst_buf, true);
+		dst_buf->field = V4L2_FIELD_NONE;
+		dst_buf->flags |= V4L2_BUF_FLAG_KEYFRAME;
+		dst_buf->sequence = nppctx->seq_cap;
+		vb2_set_plane_payload(&dst_buf->vb2_buf, 0,
+		 (state == VB2_BUF_STATE_DONE) ? nppctx->job_out[i].sizeimage : 0);
+	}
+	if (nppctx->job_num_outputs)
+		nppctx->seq_cap++;
+
+	if (src_buf) {
+		src_buf->sequence = nppctx->seq_out++;
+		vb2_set_plane_payload(&src_buf->vb2_buf, 0, out_sizeimage);
+		v4l2_m2m_buf_done(src_buf, state);
+		nppctx->out_v4l2_buf = NULL;
+	}
 
-	if (kthread_should_stop() || (ret == -ERESTARTSYS)) {
-		if (ret == -ERESTARTSYS)
-			pr_err("%s(%d) [%p] wait event error !!!\n", __func__, __LINE__, nppctx);
-		mutex_unlock(&drvctx->dev->hw_mutex);
-		return -ERESTARTSYS;
+	for (i = 0; i < nppctx->job_num_outputs; i++) {
+		npp_cap_buf_done(fh, nppctx->job_out[i].v4l2_buf, false, state);
+		nppctx->job_out[i].v4l2_buf = NULL;
 	}
+
+	nppctx->job_num_outputs = 0;
+	v4l2_m2m_job_finish(v_dev->m2m_dev, fh->m2m_ctx);
+}
+
+static void npp_m2m_copy_userptr_output(struct npp_ctx *nppctx, const struct npp_job_output *o)
+{
+	uint8_t *cap_vaddr = vb2_plane_vaddr(&o->v4l2_buf->vb2_buf, 0);
+
+	memcpy(cap_vaddr, nppctx->cap_q_buf_obj->vaddr, (o->width * o->height * 3));
+}
+
+static void npp_m2m_job_done_worker(struct work_struct *work)
+{
+	struct npp_ctx *nppctx = container_of(work, struct npp_ctx, job_done_work);
+	struct drv_npp_ctx *drvctx = container_of(nppctx->m2m_fh, struct drv_npp_ctx, fh);
+
+	if (!npp_m2m_claim_job(nppctx))
+		return;
+
+	cancel_delayed_work(&nppctx->job_timeout_work);
+
 #ifdef ENABLE_NPP_MEASURE_TIME
 	nppctx->delta_ns = ktime_to_ns(ktime_sub(nppctx->end_time, nppctx->start_time));
 	nppctx->sum_ns += nppctx->delta_ns;
 	nppctx->excution_count++;
 	pr_info("NPP Execution time: %lld us\n", nppctx->delta_ns / 1000);
 #endif
-	nppctx->npp_hw_finish = false;
-	nppctx->out_q_buf_obj->done = 1;
-	nppctx->out_q_buf_obj->ready = 0;
-	wake_up_interruptible(&nppctx->npp_out_waitq);
-
-	if (nppctx->memory_cap == V4L2_MEMORY_USERPTR) {
-		unsigned int cap_buf_data_size =
-		 (nppctx->cap.fmt.pix_mp.width * nppctx->cap.fmt.pix_mp.height);
-		unsigned char rgb_single_plane =
-		 (drvctx->params.single_rgb_plane == 1) ? 1 : 0;
-		uint8_t *cap_vaddr;
-
-		ret = wait_event_interruptible(nppctx->npp_run_waitq,
-		 kthread_should_stop() || nppctx->cap_q_buf_obj->ready);
-		if (kthread_should_stop() || (ret == -ERESTARTSYS)) {
-			if (ret == -ERESTARTSYS)
-				pr_err("%s(%d) [%p] wait event error !!!\n",
-			 __func__, __LINE__, nppctx);
-			mutex_unlock(&drvctx->dev->hw_mutex);
-			return -ERESTARTSYS;
-		}
 
-		cap_vaddr = vb2_plane_vaddr(&nppctx->cap_v4l2_buf->vb2_buf, 0);
+	if (nppctx->memory_cap == V4L2_MEMORY_USERPTR)
+		npp_m2m_copy_userptr_output(nppctx, &nppctx->job_out[nppctx->job_cur_output]);
 
-		if (rgb_single_plane == 0) {
-			memcpy(cap_vaddr,
-			 nppctx->cap_q_buf_obj->vaddr, cap_buf_data_size);
-			memcpy(cap_vaddr + cap_buf_data_size,
-			 nppctx->cap_q_buf_obj->vaddr + cap_buf_data_size, cap_buf_data_size);
-			memcpy(cap_vaddr + (cap_buf_data_size*2),
-			 nppctx->cap_q_buf_obj->vaddr + (cap_buf_data_size*2), cap_buf_data_size);
-		} else {
-			memcpy(cap_vaddr, nppctx->cap_q_buf_obj->vaddr, (cap_buf_data_size * 3));
-		}
+	/* chain the next rendition without giving up the hardware */
+	if (++nppctx->job_cur_output < nppctx->job_num_outputs) {
+		if (!npp_m2m_start_pass(drvctx))
+			return;
+		npp_m2m_job_finish(drvctx, VB2_BUF_STATE_ERROR);
+		return;
 	}
 
-	mutex_unlock(&drvctx->dev->hw_mutex);
+	npp_m2m_job_finish(drvctx, VB2_BUF_STATE_DONE);
+}
 
-	nppctx->cap_q_buf_obj->done = 1;
-	nppctx->cap_q_buf_obj->ready = 0;
-	wake_up_interruptible(&nppctx->npp_cap_waitq);
+static void npp_m2m_job_timeout_worker(struct work_struct *work)
+{
+	struct npp_ctx *nppctx = container_of(to_delayed_work(work),
+					      struct npp_ctx, job_timeout_work);
+	struct drv_npp_ctx *drvctx = container_of(nppctx->m2m_fh, struct drv_npp_ctx, fh);
 
-	return 0;
+	if (!npp_m2m_claim_job(nppctx))
+		return;
+
+	dev_err(drvctx->dev->dev, "npp m2m job timeout, npp_ctx = %p, output %u/%u\n",
+		nppctx, nppctx->job_cur_output + 1, nppctx->job_num_outputs);
+
+	/*
+	 * Stop the engine before the buffers go back, so a pass that finishes
+	 * late neither writes into them nor raises a finish interrupt that
+	 * would be taken for the next job.
+	 */
+	NPP_Set_EngineStop(drvctx->dev->target_soc);
+	NPP_Clear_INTStatus(NPP_INTST_vi_tvve_core_mask, drvctx->dev->target_soc);
+
+	npp_m2m_job_finish(drvctx, VB2_BUF_STATE_ERROR);
+}
+
+static int npp_job_ready(struct v4l2_fh *fh)
+{
+	struct drv_npp_ctx *drvctx = container_of(fh, struct drv_npp_ctx, fh);
+
+	return v4l2_m2m_num_dst_bufs_ready(fh->m2m_ctx) >= npp_m2m_num_outputs(drvctx);
+}
+
+/*
+ * Called by the m2m core once a src buffer and enough dst buffers are
+ * queued. Each rendition is one NPP pass; the passes are chained from
+ * npp_m2m_job_done_worker() when the NPP finish interrupt fires, and the
+ * job is failed from npp_m2m_job_timeout_worker() if it never does.
+ */
+static void npp_device_run(struct v4l2_fh *fh)
+{
+	struct drv_npp_ctx *drvctx = container_of(fh, struct drv_npp_ctx, fh);
+	struct npp_ctx *nppctx = drvctx->npp_ctx;
+	struct videc_dev *v_dev = drvctx->dev;
+	int ret;
+
+	down(&v_dev->hw_sem);
+	v_dev->nppctx_activate = nppctx;
+
+	ret = npp_m2m_prepare_outputs(drvctx);
+	if (ret) {
+		npp_m2m_job_finish(drvctx, VB2_BUF_STATE_ERROR);
+		return;
+	}
+
+	if (nppctx->memory_out == V4L2_MEMORY_USERPTR)
+		npp_out_copy_userptr(drvctx, nppctx->out_v4l2_buf);
+
+	ret = npp_m2m_start_pass(drvctx);
+	if (ret)
+		npp_m2m_job_finish(drvctx, VB2_BUF_STATE_ERROR);
 }
 
 #if defined(ENABLE_NPP_ISR)
@@ -1413,26 +1323,24 @@ static irqreturn_t npp_isr(int this_irq, void *dev_id)
 #ifdef ENABLE_NPP_MEASURE_TIME
 		nppctx->end_time = ktime_get();
 #endif
-		if ((int_status & NPP_INTST_fin_mask) != 0) {
+		if ((int_status & NPP_INTST_fin_mask) != 0)
 			NPP_Clear_INTStatus(NPP_INTST_fin_mask, p_this->target_soc);
-			pr_info("isr INTST_fin\n");
-		}
-		if ((int_status & NPP_INTST_vi_tvve_core_mask) != 0) {
+		if ((int_status & NPP_INTST_vi_tvve_core_mask) != 0)
 			NPP_Clear_INTStatus(NPP_INTST_vi_tvve_core_mask, p_this->target_soc);
-			pr_info("isr INTST_vi_tvve_core\n");
-		}
 
 		spin_lock_irqsave(&nppctx->npp_spin_lock, flags);
-		nppctx->npp_hw_finish = true;
+		if (nppctx->job_running && !nppctx->npp_hw_finish) {
+			nppctx->npp_hw_finish = true;
+			schedule_work(&nppctx->job_done_work);
+		}
 		spin_unlock_irqrestore(&nppctx->npp_spin_lock, flags);
-
-		wake_up_interruptible(&nppctx->npp_run_waitq);
 	}
 
 	return (int_status) ? IRQ_HANDLED : IRQ_NONE;
 }
 #endif
 
+
 static const struct npp_fmt_ops_m2m ops_m2m = {
 	.npp_enum_fmt_cap = npp_enum_fmt_cap,
 	.npp_enum_fmt_out = npp_enum_fmt_out,
@@ -1449,6 +1357,8 @@ static const struct npp_fmt_ops_m2m ops_m2m = {
 	.npp_abort = npp_abort,
 	.npp_g_crop = npp_g_crop,
 	.npp_s_crop = npp_s_crop,
+	.npp_job_ready = npp_job_ready,
+	.npp_device_run = npp_device_run,
 };
 
 const struct npp_fmt_ops_m2m *get_npp_fmt_ops_m2m(void)
@@ -1543,35 +1453,32 @@ void *npp_alloc_context_m2m(struct v4l2_fh *fh, struct videc_dev *dev)
 
 	ctx->out.type = -1;
 	ctx->cap.type = -1;
-	ctx->thread_out = NULL;
-	ctx->thread_cap = NULL;
+	ctx->m2m_fh = fh;
 	ctx->seq_out = 1;
 	ctx->seq_cap = 1;
-	ctx->thread_out_interval = 4;
-	ctx->thread_cap_interval = 4;
-	ctx->thread_run_interval = 4;
 	ctx->rect.left = 0;
 	ctx->rect.top = 0;
 	ctx->rect.width = 0;
 	ctx->rect.height = 0;
 	ctx->is_cap_started = 0;
 	ctx->is_out_started = 0;
-	ctx->cap_retry_cnt = 0;
-	ctx->stop_cmd = false;
 	ctx->out_q_cnt = 0;
 	ctx->cap_q_cnt = 0;
 	ctx->out_q_buf_obj->done = 1;
 	ctx->cap_q_buf_obj->done = 0;
 	ctx->npp_hw_finish = false;
+	ctx->job_running = false;
 #ifdef ENABLE_NPP_MEASURE_TIME
 	ctx->sum_ns = 0;
 	ctx->excution_count = 0;
 #endif
 	mutex_init(&ctx->npp_mutex);
 	spin_lock_init(&ctx->npp_spin_lock);
-	init_waitqueue_head(&ctx->npp_out_waitq);
-	init_waitqueue_head(&ctx->npp_cap_waitq);
-	init_waitqueue_head(&ctx->npp_run_waitq);
+	INIT_WORK(&ctx->job_done_work, npp_m2m_job_done_worker);
+	INIT_DELAYED_WORK(&ctx->job_timeout_work, npp_m2m_job_timeout_worker);
+#ifndef ENABLE_NPP_ISR
+	INIT_DELAYED_WORK(&ctx->job_poll_work, npp_m2m_job_poll_worker);
+#endif
 
 	// init ctx->out with default value
 	init_out_fmt(fh, &ctx->out);
@@ -1601,6 +1508,12 @@ void npp_free_context_m2m(struct videc_dev *dev, void *ctx)
 #ifndef ENABLE_NPP_FPGA_TEST
 	struct arm_smccc_res res;
 #endif
+	cancel_work_sync(&ctx_npp->job_done_work);
+	cancel_delayed_work_sync(&ctx_npp->job_timeout_work);
+#ifndef ENABLE_NPP_ISR
+	cancel_delayed_work_sync(&ctx_npp->job_poll_work);
+#endif
+
 	if (ctx_npp->out_q_buf_obj != NULL) {
 		_npp_buffer_free(ctx_npp->out_q_buf_obj);
 		dev_info(dev->dev, "free out_q_buf_obj\n");
@@ -33,6 +33,8 @@ struct npp_fmt_ops_m2m {
 	int (*npp_abort)(void *priv, int type);
 	int (*npp_g_crop)(void *fh, struct v4l2_rect *rect);
 	int (*npp_s_crop)(void *fh, struct v4l2_selection *sel);
+	int (*npp_job_ready)(struct v4l2_fh *fh);
+	void (*npp_device_run)(struct v4l2_fh *fh);
 };
 
 const struct npp_fmt_ops_m2m *get_npp_fmt_ops_m2m(void);
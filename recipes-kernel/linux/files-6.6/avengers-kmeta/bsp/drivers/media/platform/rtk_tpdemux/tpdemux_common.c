@@ -61,6 +61,11 @@
 
 #define TP_BUFFER_ALIGNMENT     (376)
 
+/* raise ring-available once this much data is pending in a ring */
+#define TP_RING_AVAIL_THRESHOLD (188*16)
+/* ring index bits 0 ~ 15 of one ring interrupt register set */
+#define TP_RING_INT_ALL_MASK    (0x0001FFFE)
+
 #define MM_BUFFER_SIZE (188*4096)
 #define ion_phys_addr_t u32
 
@@ -99,9 +104,6 @@ struct tp_buf_param {
 	ion_phys_addr_t wptr;
 };
 
-static void _tp_framer_enable(struct rtk_tp_reg *regs, unsigned char en);
-static void _tp_framer_reset_FSM(struct rtk_tp_reg *regs);
-
 static void _tp_hardware_env_setup(struct rtk_tp_reg *regs)
 {
 	if (TP_PID_FILTER_COUNT == MAX_PID_COUNT)
@@ -138,7 +140,7 @@ static void _tp_buffer_set_param(struct rtk_tp_reg *regs,
 			TP_RING_CTRL_R_W(1)   |
 			TP_RING_CTRL_IDX(idx));
 
-	write_reg32(regs->reg_TP_THRESHOLD, TP_BUFFER_ALIGNMENT);
+	write_reg32(regs->reg_TP_THRESHOLD, TP_RING_AVAIL_THRESHOLD);
 
 	mutex_unlock(&regs->buf_ctrl_mutex);
 }
@@ -302,22 +304,85 @@ static void _tp_buffer_release_data(struct filter_info *filter,
 
 	_tp_buffer_rst_ring_full(filter);
 	_tp_buffer_rst_ring_avail(filter);
+}
 
-	if (filter->is_buf_full) {
-		unsigned long buf_size;
-		unsigned long data_size;
-
-		_tp_buffer_get_status(regs, filter->ddr_q_id,
-					 &buf_size, &data_size);
-		if (data_size == 0) {
-			_tp_framer_enable(regs, 1);
-			_tp_framer_reset_FSM(regs);
-			_tp_buffer_flush(filter);
-			filter->is_buf_full = 0;
-		}
+static void __iomem *_tp_ring_int_reg(struct rtk_tp_reg *regs,
+					int page, int full, int en)
+{
+	switch (page) {
+	case 0:
+		if (en)
+			return full ? regs->reg_TP_RING_FULL_INT_EN_0 :
+				      regs->reg_TP_RING_AVAIL_INT_EN_0;
+		return full ? regs->reg_TP_RING_FULL_INT_0 :
+			      regs->reg_TP_RING_AVAIL_INT_0;
+	case 1:
+		if (en)
+			return full ? regs->reg_TP_RING_FULL_INT_EN_1 :
+				      regs->reg_TP_RING_AVAIL_INT_EN_1;
+		return full ? regs->reg_TP_RING_FULL_INT_1 :
+			      regs->reg_TP_RING_AVAIL_INT_1;
+	case 2:
+		if (en)
+			return full ? regs->reg_TP_RING_FULL_INT_EN_2 :
+				      regs->reg_TP_RING_AVAIL_INT_EN_2;
+		return full ? regs->reg_TP_RING_FULL_INT_2 :
+			      regs->reg_TP_RING_AVAIL_INT_2;
+	default:
+		if (en)
+			return full ? regs->reg_TP_RING_FULL_INT_EN_3 :
+				      regs->reg_TP_RING_AVAIL_INT_EN_3;
+		return full ? regs->reg_TP_RING_FULL_INT_3 :
+			      regs->reg_TP_RING_AVAIL_INT_3;
+	}
+}
+
+/**
+ * rtk_tp_ring_int_enable() - Mask or unmask the ring interrupts of a demux
+ * @dmx: demux whose 32 ring buffers are affected.
+ * @en: 1 to enable ring-available and ring-full interrupts, 0 to mask them.
+ *
+ * TP_0 owns ring interrupt register sets [0] and [1], TP_1 owns [2] and [3].
+ */
+void rtk_tp_ring_int_enable(struct demux_info *dmx, unsigned char en)
+{
+	struct rtk_tp_reg *regs = &dmx->regs;
+	int page = (dmx->tp_id & 1) * 2;
+	int i;
+
+	for (i = page; i < page + 2; i++) {
+		write_reg32(_tp_ring_int_reg(regs, i, 0, 1),
+			    TP_RING_INT_ALL_MASK |
+			    TP_RING_FULL_INT_WRITE_DATA(en ? 1 : 0));
+		write_reg32(_tp_ring_int_reg(regs, i, 1, 1),
+			    TP_RING_INT_ALL_MASK |
+			    TP_RING_FULL_INT_WRITE_DATA(en ? 1 : 0));
 	}
 }
 
+/**
+ * rtk_tp_ring_int_pending() - Check ring interrupt status of a demux
+ * @dmx: demux to check.
+ *
+ * Safe to call from hard irq context, only status registers are read.
+ *
+ * Return: non-zero if any ring of @dmx has data above threshold or is full.
+ */
+int rtk_tp_ring_int_pending(struct demux_info *dmx)
+{
+	struct rtk_tp_reg *regs = &dmx->regs;
+	int page = (dmx->tp_id & 1) * 2;
+	unsigned int status = 0;
+	int i;
+
+	for (i = page; i < page + 2; i++) {
+		status |= read_reg32(_tp_ring_int_reg(regs, i, 0, 0));
+		status |= read_reg32(_tp_ring_int_reg(regs, i, 1, 0));
+	}
+
+	return (status & TP_RING_INT_ALL_MASK) ? 1 : 0;
+}
+
 static void _tp_framer_set_cntl(struct rtk_tp_reg *regs,
 					unsigned int cntl)
 {
@@ -622,69 +687,32 @@ static void _tp_read_data(struct filter_info *filter,
 
 	/* todo */
 	/* UpdatePCRTrackingStatus */
-	if (filter->is_buf_full) {
-		unsigned long buf_size;
-		unsigned long data_size;
-
-		_tp_buffer_get_status(regs, filter->ddr_q_id,
-						&buf_size, &data_size);
-
-		if (data_size == 0) {
-			_tp_framer_enable(regs, 1);
-			_tp_framer_reset_FSM(regs);
-			_tp_buffer_flush(filter);
-			filter->is_buf_full = 0;
-		}
-	}
-
 	_tp_buffer_get_param(regs, filter->ddr_q_id, param);
 	*length = (param->rptr > param->wptr) ? (param->limit - param->rptr) :
 						(param->wptr - param->rptr);
 	*offset = param->rptr - param->base;
 
-	if (_tp_buffer_is_full(filter)) {
-		if (!filter->is_buf_full) {
-			_tp_framer_enable(regs, 0);
-			_tp_framer_reset_FSM(regs);
-			filter->is_buf_full = 1;
-		}
+	/*
+	 * The ring stops accepting packets while it is full and resumes on
+	 * its own once the read pointer moves, so just account for the
+	 * overflow here; the status is cleared when the data is released.
+	 * A ring can stay full over several polls, count it once.
+	 */
+	if (!_tp_buffer_is_full(filter)) {
+		filter->ring_full = 0;
+		return;
 	}
-}
 
-static void _tp_buffer_filter_check(struct filter_info *filter)
-{
-       struct rtk_tp_reg *regs = &filter->dmx->regs;
-
-       if (filter->is_buf_full) {
-               _tp_framer_enable(regs, 1);
-               _tp_framer_reset_FSM(regs);
-               _tp_buffer_flush(filter);
-               filter->is_buf_full = 0;
-       }
-}
-
-void rtk_tp_reset_filters(struct demux_info *dmx, struct rtktpfei *fei)
-{
+	if (filter->ring_full)
+		return;
 
-       struct dvb_demux_feed *feed = fei->dvbdmxfeed;
-       struct dvb_demux *demux = feed->demux;
-       struct stdemux *stdemux = (struct stdemux *)demux->priv;
-       struct filter_info *filter;
-       int i;
-
-       for (i = 0; i < TP_PID_FILTER_COUNT; i++) {
-               mutex_lock(&stdemux->dmxdev.mutex);
-               if (dmx->pid_tbl_info[i].used == 1) {
-                       filter = dmx->filter_data[i];
-                       if (filter == NULL) {
-                               mutex_unlock(&stdemux->dmxdev.mutex);
-                               continue;
-                       }
-                       _tp_buffer_filter_check(filter);
-               }
-
-               mutex_unlock(&stdemux->dmxdev.mutex);
-       }
+	filter->ring_full = 1;
+	filter->ring_full_cnt++;
+	filter->dmx->ring_full_cnt++;
+	dev_warn_ratelimited(filter->dmx->fei->dev,
+			     "tp%d ring %d full (%lu)\n",
+			     filter->dmx->tp_id, filter->ddr_q_id,
+			     filter->dmx->ring_full_cnt);
 }
 
 void rtk_tp_stream_control(struct demux_info *dmx, enum TP_STREAMING_STATUS st)
@@ -951,7 +979,8 @@ struct filter_info *rtk_filter_init(struct demux_info *dmx, int i)
 
 	_tp_buffer_flush(filter);
 	filter->is_streaming = 1;
-	filter->is_buf_full = 0;
+	filter->ring_full = 0;
+	filter->ring_full_cnt = 0;
 
 	return filter;
 }
@@ -980,7 +1009,6 @@ void rtk_filter_uninit(struct filter_info *filter)
 	dmx->ring_buf_tbl[i] = 0;
 
 	filter->is_streaming = 0;
-	filter->is_buf_full = 0;
 	_tp_buffer_flush(filter);
 
 	/* TP_0: pid_table_id 0 ~ 63 to filter_data [0] ~ [63]
@@ -1274,7 +1302,7 @@ static void rtktpfe_delete(struct rtktpfe *rtktpfe)
  *
  * Return: 0 always.
  */
-int _tp_framer_enable_pid(struct rtk_tp_reg *regs, u8 onoff)
+static int _tp_framer_enable_pid(struct rtk_tp_reg *regs, u8 onoff)
 {
 	write_reg32(regs->reg_TF_CNTL, TP_TF_CNTL_PID_EN_BIT |
 		    TP_TF_CNTL_WRITE_DATA((onoff) ? 1 : 0));
@@ -1282,6 +1310,16 @@ int _tp_framer_enable_pid(struct rtk_tp_reg *regs, u8 onoff)
 	return 0;
 }
 
+/**
+ * rtk_tp_enable_pid_filtering() - Switch PID filtering of a demux
+ * @dmx: demux.
+ * @onoff: 0 to pass the entire TS to the ring of PID[0].
+ */
+void rtk_tp_enable_pid_filtering(struct demux_info *dmx, u8 onoff)
+{
+	_tp_framer_enable_pid(&dmx->regs, onoff);
+}
+
 /**
  * _rtk_set_ddrq() - Set ddr_q index
  */
@@ -1332,7 +1370,9 @@ void rtk_tp_set_pid_filter(struct filter_info *filter, u16 pid)
 			/* skip pid that already exists... */
 
 			_rtk_request_pid_filter(filter, pid);
-			_tp_framer_enable_pid(regs, 1);
+			/* keep PID filtering off while the full TS is captured */
+			_tp_framer_enable_pid(regs,
+				filter->dmx->pid_tbl_info[0].used ? 0 : 1);
 		}
 	}
 
@@ -1346,24 +1386,68 @@ int rtk_is_tp_enable(struct demux_info *dmx)
 				TP_TF_FRMCFG_FRM_EN_BIT);
 }
 
-void rtk_tp_deliver_data(struct dvb_demux_feed *feed)
+/*
+ * A plain TS feed that owns its ring alone gets the data straight through
+ * its callback. Section feeds still need dvb-core to assemble sections,
+ * a ring shared by several feeds on the same PID has to reach each of
+ * them once, and the full TS ring (PID 8192) carries every PID once other
+ * feeds share the demux, so those are run through the software demux,
+ * which only ever sees the packets that were requested.
+ */
+static unsigned long _tp_deliver_feed(struct stdemux *stdemux,
+					struct filter_info *filter,
+					const u8 *buf, unsigned long length)
 {
-	struct dvb_demux *demux = feed->demux;
-	struct stdemux *stdemux = (struct stdemux *)demux->priv;
-	struct rtktpfei *fei = stdemux->rtktpfei;
-	struct demux_info *dmx = fei->demux_data[stdemux->tsin_index];
+	struct dvb_demux_feed *feed = filter->feed;
+	u32 buf_flags = 0;
+
+	if (filter->users > 1 || !feed || feed->type == DMX_TYPE_SEC ||
+	    (feed->pid == 8192 && stdemux->running_feed_count > 1)) {
+		length -= length % 188;
+		if (length)
+			dvb_dmx_swfilter_packets(&stdemux->dvb_demux, buf,
+						 length / 188);
+		return length;
+	}
+
+	if (!feed->feed.ts.priv) {
+		pr_err("%s:feed->feed.ts NULL\n", __func__);
+		return length;
+	}
+
+	feed->cb.ts(buf, length, NULL, 0, &feed->feed.ts, &buf_flags);
+	return length;
+}
+
+/**
+ * rtk_tp_deliver_data() - Hand pending ring data of a demux to dvb core
+ * @dmx: demux to service.
+ *
+ * Every PID filter owns a ring buffer, the data of each ring is passed to
+ * the feed that requested the PID.
+ *
+ * Return: number of bytes delivered, 0 if all rings were empty.
+ */
+unsigned long rtk_tp_deliver_data(struct demux_info *dmx)
+{
+	struct stdemux *stdemux = dmx->stdemux;
+	struct rtktpfei *fei = dmx->fei;
 	struct filter_info *filter;
 	unsigned long length = 0;
 	unsigned long offset = 0;
+	unsigned long total = 0;
 	int i = 0;
 
+	if (!stdemux)
+		return 0;
+
 	for (i = 0; i < TP_PID_FILTER_COUNT; i++) {
 		mutex_lock(&stdemux->dmxdev.mutex);
 		if (dmx->pid_tbl_info[i].used == 1) {
 			struct tp_buf_param param = {0};
 
 			filter = dmx->filter_data[i];
-			if (filter == NULL ||
+			if (filter == NULL || filter->users == 0 ||
 			    IS_ERR_OR_NULL(filter->ddr_q_virt_addr)) {
 				mutex_unlock(&stdemux->dmxdev.mutex);
 				continue;
@@ -1371,31 +1455,28 @@ void rtk_tp_deliver_data(struct dvb_demux_feed *feed)
 
 			_tp_read_data(filter, &param, &length, &offset);
 
-			if (feed && length) {
-				struct dmx_ts_feed *core_feed = &feed->feed.ts;
-				if (core_feed && core_feed->priv) {
-					if (IS_ERR_OR_NULL(
-					     filter->ddr_q_virt_addr + offset)) {
-						dev_dbg(fei->dev,
-						 "invalid q_virt_addr skip it\n");
-					} else {
-						u32 buf_flags = 0;
-						feed->cb.ts(
-						 filter->ddr_q_virt_addr + offset,
-						 length, NULL, 0, &feed->feed.ts,
-						 &buf_flags);
-					}
+			if (length) {
+				if (IS_ERR_OR_NULL(
+				     filter->ddr_q_virt_addr + offset)) {
+					dev_dbg(fei->dev,
+					 "invalid q_virt_addr skip it\n");
 				} else {
-					pr_err("%s:feed->feed.ts NULL\n", __func__);
+					length = _tp_deliver_feed(stdemux,
+						 filter,
+						 filter->ddr_q_virt_addr + offset,
+						 length);
 				}
 			}
 
 			param.rptr = (param.rptr + length >= param.limit) ?
 					param.base : (param.rptr + length);
 			_tp_buffer_release_data(filter, param);
+			total += length;
 		}
 		mutex_unlock(&stdemux->dmxdev.mutex);
 	}
+
+	return total;
 }
 
 int rtk_tp_register(struct rtktpfe **rtktpfe,
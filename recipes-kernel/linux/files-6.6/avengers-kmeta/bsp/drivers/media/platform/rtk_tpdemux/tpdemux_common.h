@@ -111,8 +111,9 @@ struct filter_info {
 	int info_q_id;
 
 	unsigned char is_streaming;
-	unsigned char is_buf_full;
 	unsigned char block_size;
+	unsigned char ring_full;
+	unsigned long ring_full_cnt;
 
 #ifdef USE_ION_BUFFER
 	struct dma_buf *ddr_q_dmabuf;
@@ -125,6 +126,9 @@ struct filter_info {
 	size_t ddr_q_len;
 
 	struct demux_info *dmx;
+	struct dvb_demux_feed *feed;	/* feed that requested the PID */
+	u16 pid;
+	int users;			/* feeds sharing the PID and its ring */
 
 };
 
@@ -142,6 +146,7 @@ struct demux_info {
 
 	enum TS_IN_SEL input_sel;
 	struct rtktpfei *fei;
+	struct stdemux *stdemux;
 	struct ts_param hw_info;
 	struct rtk_tp_reg regs;
 
@@ -164,7 +169,13 @@ struct demux_info {
 	phys_addr_t mmbuf_phy_addr;
 	void *mmbuf_virt_addr;
 	size_t mmbuf_len;
-	size_t reset_cnt;
+
+	/* adaptive poller, see output_feedwork() */
+	int polling;
+	unsigned int poll_usecs;
+	unsigned int poll_idle;
+	unsigned long poll_next;
+	unsigned long ring_full_cnt;
 #if 0
 	size_t debug_cnt;
 #endif
@@ -183,7 +194,10 @@ void rtk_filter_uninit(struct filter_info *filter);
 void rtk_set_ts_input_select(struct demux_info *dmx);
 void rtk_tp_set_pid_filter(struct filter_info *ch, u16 pid);
 int rtk_is_tp_enable(struct demux_info *dmx);
-void rtk_tp_deliver_data(struct dvb_demux_feed *feed);
+unsigned long rtk_tp_deliver_data(struct demux_info *dmx);
+void rtk_tp_enable_pid_filtering(struct demux_info *dmx, u8 onoff);
+void rtk_tp_ring_int_enable(struct demux_info *dmx, unsigned char en);
+int rtk_tp_ring_int_pending(struct demux_info *dmx);
 void rtk_tp_stream_control(struct demux_info *dmx, enum TP_STREAMING_STATUS st);
 
 #endif /* _TPDEMUX_COMMON_H_ */
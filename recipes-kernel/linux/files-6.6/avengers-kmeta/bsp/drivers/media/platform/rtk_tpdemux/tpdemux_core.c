@@ -39,8 +39,16 @@
 #include "tpdemux_core.h"
 #include "tpdemux_buffer.h"
 
-#define POLL_MSECS (5)
-#define POLL_USECS (2500)
+/*
+ * Rings are polled every TP_POLL_MIN_USECS while data keeps arriving. Each
+ * empty poll doubles the interval up to TP_POLL_MAX_USECS, and after
+ * TP_POLL_IDLE_MAX empty polls the ring interrupts are unmasked so the
+ * next burst wakes the poller up again. The slow poll is kept as a backstop
+ * for streams that stay below the ring-available threshold.
+ */
+#define TP_POLL_MIN_USECS (2500)
+#define TP_POLL_MAX_USECS (40000)
+#define TP_POLL_IDLE_MAX  (8)
 
 static void rtk_tp_power_on(struct rtktpfei *fei)
 {
@@ -88,6 +96,9 @@ static int rtk_tp_resume(struct device *dev)
 {
 	struct rtktpfei *fei = dev_get_drvdata(dev);
 
+	if (fei->irq > 0)
+		enable_irq(fei->irq);
+
 	if (atomic_read(&fei->open_cnt) == 0)
 		return 0;
 
@@ -101,6 +112,9 @@ static int rtk_tp_suspend(struct device *dev)
 {
 	struct rtktpfei *fei = dev_get_drvdata(dev);
 
+	if (fei->irq > 0)
+		disable_irq(fei->irq);
+
 	if (atomic_read(&fei->open_cnt) == 0)
 		return 0;
 
@@ -158,6 +172,12 @@ static int of_count_tpm_num(struct device_node *np)
 	return num_reg / (num_a_cells + num_n_cells);
 }
 
+static void rtk_tp_poll_arm(struct rtktpfei *fei, struct demux_info *dmx)
+{
+	dmx->poll_next = jiffies + usecs_to_jiffies(dmx->poll_usecs);
+	timer_reduce(&fei->timer, dmx->poll_next);
+}
+
 #ifndef USE_KTHREAD_WORK
 static void output_feedwork(struct work_struct *work)
 #define DI_WORK_MEMBER work
@@ -169,16 +189,28 @@ static void output_feedwork(struct kthread_work *work)
 	struct demux_info *dmx = (struct demux_info *)container_of(work,
 					struct demux_info, DI_WORK_MEMBER);
 	struct rtktpfei *fei = dmx->fei;
-	struct dvb_demux_feed *dvbdmxfeed = fei->dvbdmxfeed;
+	unsigned long delivered;
 
-	if (dvbdmxfeed) {
-		rtk_tp_deliver_data(dvbdmxfeed);
+	delivered = rtk_tp_deliver_data(dmx);
+
+	if (!READ_ONCE(dmx->active))
+		return;
+
+	if (delivered) {
+		dmx->poll_idle = 0;
+		dmx->poll_usecs = TP_POLL_MIN_USECS;
 	} else {
-		pr_err("%s:%d feed NULL\n", __func__, __LINE__);
+		dmx->poll_usecs = min_t(unsigned int, dmx->poll_usecs * 2,
+						TP_POLL_MAX_USECS);
+		if (++dmx->poll_idle >= TP_POLL_IDLE_MAX &&
+		    fei->irq > 0 && READ_ONCE(dmx->polling)) {
+			WRITE_ONCE(dmx->polling, 0);
+			rtk_tp_ring_int_enable(dmx, 1);
+		}
 	}
-}
 
-extern void rtk_tp_reset_filters(struct demux_info *dmx, struct rtktpfei *fei);
+	rtk_tp_poll_arm(fei, dmx);
+}
 
 #ifndef USE_KTHREAD_WORK
 #define TPD_QUEUE_WORK(f, d) queue_work(f->wq, &d->work)
@@ -190,13 +222,6 @@ extern void rtk_tp_reset_filters(struct demux_info *dmx, struct rtktpfei *fei);
 #define TPD_CANCEL_WORK_SYNC(d) kthread_cancel_work_sync(&d->ktwork);
 #endif
 
-#define RST_TH (1)
-#if (RST_TH > 1)
-#define TPD_CHECK_RESET(c) ((c % RST_TH == (RST_TH-1)) ? 1 : 0)
-#else
-#define TPD_CHECK_RESET(c) (1)
-#endif
-
 static void rtk_tp_timer_interrupt(struct timer_list *t)
 {
 	struct rtktpfei *fei = from_timer(fei, t, timer);
@@ -206,25 +231,43 @@ static void rtk_tp_timer_interrupt(struct timer_list *t)
 	/* iterate through input block filters */
 	for (dmx_num = 0; dmx_num < fei->num_dmx; dmx_num++) {
 		dmx = fei->demux_data[dmx_num];
-		if (dmx->active && dmx->regs.base) {
-			int need_reset = 0;
-			if (rtk_is_tp_enable(dmx)) {
-				dmx->reset_cnt = 0;
-			} else {
-				need_reset = TPD_CHECK_RESET(dmx->reset_cnt);
-				dmx->reset_cnt++;
-			}
-
-			if (need_reset) {
-				rtk_tp_reset_filters(dmx, fei);
-			}
+		if (!READ_ONCE(dmx->active) || !dmx->regs.base)
+			continue;
 
+		/* the timer is shared, re-arm it for demuxes not yet due */
+		if (time_before(jiffies, dmx->poll_next))
+			timer_reduce(&fei->timer, dmx->poll_next);
+		else
 			TPD_QUEUE_WORK(fei, dmx);
-		}
 	}
+}
+
+static irqreturn_t rtk_tp_irq_handler(int irq, void *dev_id)
+{
+	struct rtktpfei *fei = dev_id;
+	struct demux_info *dmx;
+	irqreturn_t ret = IRQ_NONE;
+	int dmx_num;
 
-	if (fei->global_feed_count > 0)
-		mod_timer(&fei->timer, jiffies + usecs_to_jiffies(POLL_USECS));
+	for (dmx_num = 0; dmx_num < fei->num_dmx; dmx_num++) {
+		dmx = fei->demux_data[dmx_num];
+		if (!READ_ONCE(dmx->active) || !dmx->regs.base ||
+		    READ_ONCE(dmx->polling))
+			continue;
+
+		if (!rtk_tp_ring_int_pending(dmx))
+			continue;
+
+		/* back to polling until the rings run dry again */
+		rtk_tp_ring_int_enable(dmx, 0);
+		WRITE_ONCE(dmx->polling, 1);
+		dmx->poll_idle = 0;
+		dmx->poll_usecs = TP_POLL_MIN_USECS;
+		TPD_QUEUE_WORK(fei, dmx);
+		ret = IRQ_HANDLED;
+	}
+
+	return ret;
 }
 
 static int rtk_tp_start_feed(struct dvb_demux_feed *dvbdmxfeed)
@@ -236,10 +279,9 @@ static int rtk_tp_start_feed(struct dvb_demux_feed *dvbdmxfeed)
 	struct filter_info *filter;
 	int i, index = -1;
 
-	fei->dvbdmxfeed = dvbdmxfeed;
-
 	switch (dvbdmxfeed->type) {
 	case DMX_TYPE_TS:
+	case DMX_TYPE_SEC:
 		break;
 	default:
 		dev_err(fei->dev, "%s:%d Error bailing\n"
@@ -285,12 +327,16 @@ static int rtk_tp_start_feed(struct dvb_demux_feed *dvbdmxfeed)
 			rtk_tp_set_mmbuffer(dmx);
 
 		TPD_INIT_WORK(dmx, output_feedwork);
-		dmx->active = 1;
-	}
-
-	if (fei->global_feed_count == 0) {
-		fei->timer.expires = jiffies + msecs_to_jiffies(POLL_MSECS);
-		mod_timer(&fei->timer, fei->timer.expires);
+		dmx->stdemux = stdemux;
+
+		/* start in polling mode, interrupts are unmasked once idle */
+		rtk_tp_ring_int_enable(dmx, 0);
+		dmx->polling = 1;
+		dmx->poll_idle = 0;
+		dmx->poll_usecs = TP_POLL_MIN_USECS;
+		dmx->ring_full_cnt = 0;
+		WRITE_ONCE(dmx->active, 1);
+		rtk_tp_poll_arm(fei, dmx);
 	}
 
 	if (dvbdmxfeed->pid == 8192) {
@@ -312,6 +358,21 @@ static int rtk_tp_start_feed(struct dvb_demux_feed *dvbdmxfeed)
 			pids_start = (TP_PID_FILTER_COUNT/2)+1;
 		}
 
+		/*
+		 * A PID gets one hardware entry and one ring however many
+		 * feeds ask for it, otherwise a TS and a section feed on the
+		 * same PID would both receive every packet twice.
+		 */
+		for (i = 1; i < TP_PID_FILTER_COUNT; i++) {
+			filter = dmx->filter_data[i];
+			if (dmx->pid_tbl_info[i].used == 1 && filter &&
+			    filter->users && filter->pid == dvbdmxfeed->pid) {
+				filter->users++;
+				dvbdmxfeed->priv = filter;
+				goto out;
+			}
+		}
+
 		for (i = pids_start; i < TP_PID_FILTER_COUNT; i++) {
 			if (dmx->pid_tbl_info[i].used == 0) {
 				index = i;
@@ -329,9 +390,13 @@ static int rtk_tp_start_feed(struct dvb_demux_feed *dvbdmxfeed)
 
 	dmx->pid_tbl_info[index].used = 1;
 
+	filter->feed = dvbdmxfeed;
+	filter->pid = dvbdmxfeed->pid;
+	filter->users = 1;
 	dvbdmxfeed->priv = filter;
 	rtk_tp_set_pid_filter(filter, dvbdmxfeed->pid);
 
+out:
 	stdemux->running_feed_count++;
 	fei->global_feed_count++;
 	mutex_unlock(&fei->lock);
@@ -355,25 +420,39 @@ static int rtk_tp_stop_feed(struct dvb_demux_feed *dvbdmxfeed)
 
 	mutex_lock(&fei->lock);
 
-	if (--fei->global_feed_count == 0)
-		del_timer(&fei->timer);
-
 	if (--stdemux->running_feed_count == 0) {
 		rtk_tp_stream_control(dmx, TP_STREAMING_STOP);
 
+		WRITE_ONCE(dmx->active, 0);
+		rtk_tp_ring_int_enable(dmx, 0);
+		if (fei->irq > 0)
+			synchronize_irq(fei->irq);
+
 		mutex_unlock(&stdemux->dmxdev.mutex);
 		TPD_CANCEL_WORK_SYNC(dmx);
 		mutex_lock(&stdemux->dmxdev.mutex);
 
-
-		dmx->active = 0;
+		if (dmx->ring_full_cnt)
+			dev_info(fei->dev, "tp%d: ring full %lu times\n",
+				 dmx->tp_id, dmx->ring_full_cnt);
 	}
 
+	if (--fei->global_feed_count == 0)
+		del_timer_sync(&fei->timer);
+
 	if (fei->tpm[dmx->tp_mapping].active == 1 &&
 				stdemux->running_feed_count == 0)
 		fei->tpm[dmx->tp_mapping].active = 0;
 
-	rtk_filter_uninit(filter);
+	/* the other feeds on this PID keep the ring, through the swfilter */
+	if (--filter->users == 0)
+		rtk_filter_uninit(filter);
+	else if (filter->feed == dvbdmxfeed)
+		filter->feed = NULL;
+
+	/* the full TS is gone, the remaining PIDs are filtered by hardware */
+	if (dvbdmxfeed->pid == 8192 && stdemux->running_feed_count > 0)
+		rtk_tp_enable_pid_filtering(dmx, 1);
 
 	mutex_unlock(&fei->lock);
 
@@ -563,6 +642,24 @@ static int rtk_tp_probe(struct platform_device *pdev)
 
 	timer_setup(&fei->timer, rtk_tp_timer_interrupt, 0);
 
+	/*
+	 * Without a ring interrupt the adaptive poller runs on its own. None
+	 * of the in-tree "realtek,tp" nodes describes one yet, so they all
+	 * take this path.
+	 */
+	fei->irq = platform_get_irq_optional(pdev, 0);
+	if (fei->irq > 0) {
+		ret = devm_request_irq(dev, fei->irq, rtk_tp_irq_handler,
+				       IRQF_SHARED, dev_name(dev), fei);
+		if (ret) {
+			dev_warn(dev, "request irq %d failed (%d), polling only\n",
+				 fei->irq, ret);
+			fei->irq = 0;
+		}
+	} else {
+		fei->irq = 0;
+	}
+
 	dev_info(dev, "initialized\n");
 	return 0;
 error:
@@ -578,7 +675,10 @@ static int rtk_tp_remove(struct platform_device *pdev)
 	struct rtktpfei *fei = platform_get_drvdata(pdev);
 	int i;
 
-	del_timer(&fei->timer);
+	if (fei->irq > 0)
+		devm_free_irq(dev, fei->irq, fei);
+
+	del_timer_sync(&fei->timer);
 
 #ifndef USE_KTHREAD_WORK
 	if (fei->wq) {
@@ -57,13 +57,13 @@ struct rtktpfei {
 
 	struct rtktpfe *rtktpfe[RTKTPFEI_MAXADAPTER];
 	struct demux_info *demux_data[DMX_TP_MAX];
-	struct dvb_demux_feed *dvbdmxfeed;
 	int num_dmx;
 	atomic_t tp_init;
 	struct mutex lock;
 
-	struct timer_list timer;	/* timer interrupts for outputs */
+	struct timer_list timer;	/* adaptive ring poller */
 	int global_feed_count;
+	int irq;			/* ring interrupt, 0 if none */
 
 	struct filter_info fi[TP_PID_FILTER_COUNT];
 
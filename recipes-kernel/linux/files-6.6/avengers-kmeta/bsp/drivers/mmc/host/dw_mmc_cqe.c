@@ -52,6 +52,12 @@
 #define DW_MCI_POWEROFF		0x3220301
 #define DW_MCI_DESC_LEN		0x100000
 #define DW_MCI_MAX_SCRIPT_BLK	128
+#define DW_MCI_DMA_BOUNDARY	0x8000000
+#define DW_MCI_IC_THRESHOLD	4
+#define DW_MCI_IC_TIMEOUT_US	100
+/* CQHCI_CAP timer clock: ITCFVAL x 10^ITCFMUL kHz */
+#define DW_MCI_CQCAP_ITCFVAL(x)	((x) & 0x3ff)
+#define DW_MCI_CQCAP_ITCFMUL(x)	(((x) >> 12) & 0xf)
 #define DW_MCI_TIMEOUT_MS	3000
 #define TUNING_ERR		531
 #define DW_MCI_NOT_READY	9999
@@ -133,50 +139,110 @@ static void dw_mci_cqhci_set_tran_desc(u8 *desc,
         }
 }
 
+static u8 *dw_mci_cqhci_emit_tran_desc(struct cqhci_host *cq_host, u8 *desc,
+                                       dma_addr_t addr, u32 blk_cnt, bool last)
+{
+        u32 cur_blk_cnt;
+
+        while (blk_cnt) {
+                /*DW_MCI_MAX_SCRIPT_BLK is tha max for each descriptor record*/
+                cur_blk_cnt = min_t(u32, blk_cnt, DW_MCI_MAX_SCRIPT_BLK);
+
+                /* In Synopsys DesignWare Databook Page 84,
+                 * They mentioned the DMA 128MB restriction
+                 */
+                if ((addr ^ (addr + (cur_blk_cnt << 9) - 1)) & ~((dma_addr_t)DW_MCI_DMA_BOUNDARY - 1))
+                        cur_blk_cnt = (round_up(addr + 1, DW_MCI_DMA_BOUNDARY) - addr) >> 9;
+
+                dw_mci_cqhci_set_tran_desc(desc, addr, (cur_blk_cnt << 9),
+                                           last && cur_blk_cnt == blk_cnt, cq_host->dma64);
+
+                addr += cur_blk_cnt << 9;
+                blk_cnt -= cur_blk_cnt;
+                desc += cq_host->trans_desc_len;
+        }
+
+        return desc;
+}
+
 static void dw_mci_cqhci_setup_tran_desc(struct mmc_data *data,
                                       struct cqhci_host *cq_host,
                                       u8 *desc,
                                       int sg_count)
 {
-        int i, len;
-        bool last = false;
-        bool dma64 = cq_host->dma64;
-        dma_addr_t addr;
+        struct dw_mci_slot *slot = mmc_priv(cq_host->mmc);
+        struct dw_mci *host = slot->host;
+        struct dw_mci_cqe_stats *stats = &host->cqe_stats;
         struct scatterlist *sg;
-        u32 cur_blk_cnt, remain_blk_cnt;
-        unsigned int begin, end;
+        dma_addr_t addr, run_addr = 0;
+        u32 blk_cnt, run_blk_cnt = 0;
+        u32 depth = cq_host->qcnt + 1;
+        int i;
+
+        /*
+         * The task descriptor for this tag is already written. Let its
+         * completion go through interrupt coalescing when other tasks are
+         * in flight; a lone task still interrupts as soon as it is done.
+         */
+        if (host->cqe_ic_threshold && cq_host->qcnt) {
+                __le64 *task_desc = (__le64 __force *)(cq_host->desc_base +
+                                    data->mrq->tag * cq_host->slot_sz);
+
+                task_desc[0] &= ~cpu_to_le64(CQHCI_INT(1));
+        }
 
+        stats->tasks++;
+        stats->depth_sum += depth;
+        if (depth > stats->depth_max)
+                stats->depth_max = depth;
+
+        /*
+         * Segments are at most a page, but sequential requests are often
+         * physically contiguous: merge adjacent segments so one descriptor
+         * covers up to DW_MCI_MAX_SCRIPT_BLK blocks.
+         */
         for_each_sg(data->sg, sg, sg_count, i) {
                 addr = sg_dma_address(sg);
-                len = sg_dma_len(sg);
-                remain_blk_cnt  = len >> 9;
+                blk_cnt = sg_dma_len(sg) >> 9;
 
-                while(remain_blk_cnt) {
-                        /*DW_MCI_MAX_SCRIPT_BLK is tha max for each descriptor record*/
-                        if(remain_blk_cnt > DW_MCI_MAX_SCRIPT_BLK)
-                                cur_blk_cnt = DW_MCI_MAX_SCRIPT_BLK;
-                        else
-                                cur_blk_cnt = remain_blk_cnt;
+                if (run_blk_cnt && addr == run_addr + (run_blk_cnt << 9) &&
+                    run_blk_cnt + blk_cnt <= DW_MCI_MAX_SCRIPT_BLK) {
+                        run_blk_cnt += blk_cnt;
+                        continue;
+                }
 
-                        /* In Synopsys DesignWare Databook Page 84,
-                         * They mentioned the DMA 128MB restriction
-                         */
-                        begin = addr / 0x8000000;
-                        end = (addr + cur_blk_cnt * 512) / 0x8000000;
+                if (run_blk_cnt)
+                        desc = dw_mci_cqhci_emit_tran_desc(cq_host, desc, run_addr,
+                                                           run_blk_cnt, false);
+                run_addr = addr;
+                run_blk_cnt = blk_cnt;
+        }
 
-                        if(begin != end)
-                                cur_blk_cnt = (end * 0x8000000 - addr) / 512;
+        if (run_blk_cnt)
+                dw_mci_cqhci_emit_tran_desc(cq_host, desc, run_addr, run_blk_cnt, true);
+}
 
-                        if ((i+1) == sg_count && (remain_blk_cnt == cur_blk_cnt))
-                                last = true;
+/* Program CQHCI interrupt coalescing from the debugfs tunables */
+static void dw_mci_cqe_set_coalescing(struct dw_mci *host)
+{
+	u32 cap, khz, ticks, ic = 0;
 
-                        dw_mci_cqhci_set_tran_desc(desc, addr, (cur_blk_cnt << 9), last, dma64);
+	if (host->cqe_ic_threshold) {
+		/* the timeout counts 1024 periods of the CQE timer clock */
+		cap = cqhci_readl(host->cqe, CQHCI_CAP);
+		khz = DW_MCI_CQCAP_ITCFVAL(cap);
+		for (ticks = DW_MCI_CQCAP_ITCFMUL(cap); ticks; ticks--)
+			khz *= 10;
 
-                        addr = addr + (cur_blk_cnt << 9);
-                        remain_blk_cnt -= cur_blk_cnt;
-                        desc += cq_host->trans_desc_len;
-                }
-        }
+		ticks = khz ? DIV_ROUND_UP_ULL((u64)host->cqe_ic_timeout_us * khz, 1000 * 1024) : 0x7f;
+		ticks = clamp_t(u32, ticks, 1, 0x7f);
+
+		ic = CQHCI_IC_ENABLE | CQHCI_IC_RESET |
+		     CQHCI_IC_ICCTHWEN | CQHCI_IC_ICCTH(host->cqe_ic_threshold) |
+		     CQHCI_IC_ICTOVALWEN | CQHCI_IC_ICTOVAL(ticks);
+	}
+
+	cqhci_writel(host->cqe, ic, CQHCI_IC);
 }
 
 static void dw_mci_cqe_enable(struct mmc_host *mmc)
@@ -208,6 +274,8 @@ static void dw_mci_cqe_enable(struct mmc_host *mmc)
 			mmc_hostname(mmc));
 	}
 
+	dw_mci_cqe_set_coalescing(host);
+
 	/*cmdq interrupt mode*/
 	dw_mci_clr_signal_int(host);
 	dw_mci_en_cqe_int(host);
@@ -440,6 +508,20 @@ static void dw_mci_tasklet_func(unsigned long priv)
 	mmc_request_done(prev_mmc, mrq);
 }
 
+static void dw_mci_cqe_account_irq(struct dw_mci *host)
+{
+	struct dw_mci_cqe_stats *stats = &host->cqe_stats;
+	u32 status = cqhci_readl(host->cqe, CQHCI_IS);
+
+	stats->irqs++;
+	if (status & CQHCI_IS_TCC)
+		stats->completions += hweight32(cqhci_readl(host->cqe, CQHCI_TCN));
+	if (status & CQHCI_IS_HAC)
+		stats->halts++;
+	if (status & CQHCI_IS_RED)
+		stats->errors++;
+}
+
 static irqreturn_t dw_mci_interrupt(int irq, void *dev_id)
 {
 	struct dw_mci *host = dev_id;
@@ -470,6 +552,7 @@ static irqreturn_t dw_mci_interrupt(int irq, void *dev_id)
 			cmd_complete(host, host->error_interrupt, &cmd_error);
 			data_complete(host, host->error_interrupt, &data_error);
 		}
+		dw_mci_cqe_account_irq(host);
 		cqhci_irq(mmc, (u32)(host->normal_interrupt), cmd_error, data_error);
 		dw_mci_clr_int(host);
 
@@ -1604,6 +1687,87 @@ static void dw_mci_enable_cd(struct dw_mci *host)
 	}
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int dw_mci_cqe_ic_threshold_get(void *data, u64 *val)
+{
+	struct dw_mci *host = data;
+
+	*val = host->cqe_ic_threshold;
+	return 0;
+}
+
+static int dw_mci_cqe_ic_threshold_set(void *data, u64 val)
+{
+	struct dw_mci *host = data;
+
+	if (val > 31)
+		return -EINVAL;
+
+	host->cqe_ic_threshold = val;
+	if (host->cqe->enabled)
+		dw_mci_cqe_set_coalescing(host);
+	return 0;
+}
+DEFINE_DEBUGFS_ATTRIBUTE(dw_mci_cqe_ic_threshold_fops, dw_mci_cqe_ic_threshold_get,
+			 dw_mci_cqe_ic_threshold_set, "%llu\n");
+
+static int dw_mci_cqe_ic_timeout_get(void *data, u64 *val)
+{
+	struct dw_mci *host = data;
+
+	*val = host->cqe_ic_timeout_us;
+	return 0;
+}
+
+static int dw_mci_cqe_ic_timeout_set(void *data, u64 val)
+{
+	struct dw_mci *host = data;
+
+	if (!val || val > USEC_PER_SEC)
+		return -EINVAL;
+
+	host->cqe_ic_timeout_us = val;
+	if (host->cqe->enabled)
+		dw_mci_cqe_set_coalescing(host);
+	return 0;
+}
+DEFINE_DEBUGFS_ATTRIBUTE(dw_mci_cqe_ic_timeout_fops, dw_mci_cqe_ic_timeout_get,
+			 dw_mci_cqe_ic_timeout_set, "%llu\n");
+
+static int dw_mci_cqe_stats_show(struct seq_file *s, void *unused)
+{
+	struct dw_mci *host = s->private;
+	struct dw_mci_cqe_stats *stats = &host->cqe_stats;
+
+	seq_printf(s, "tasks: %llu\n", stats->tasks);
+	seq_printf(s, "queue depth avg: %llu/100\n",
+		   stats->tasks ? div64_u64(stats->depth_sum * 100, stats->tasks) : 0);
+	seq_printf(s, "queue depth max: %u\n", stats->depth_max);
+	seq_printf(s, "irqs: %llu\n", stats->irqs);
+	seq_printf(s, "completions: %llu\n", stats->completions);
+	seq_printf(s, "completions per irq: %llu/100\n",
+		   stats->irqs ? div64_u64(stats->completions * 100, stats->irqs) : 0);
+	seq_printf(s, "halts: %llu\n", stats->halts);
+	seq_printf(s, "errors: %llu\n", stats->errors);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(dw_mci_cqe_stats);
+
+static void dw_mci_cqe_init_debugfs(struct dw_mci *host)
+{
+	struct mmc_host *mmc = host->slot->mmc;
+	struct dentry *root;
+
+	root = debugfs_create_dir("cqe", mmc->debugfs_root);
+	debugfs_create_file("ic_threshold", 0644, root, host, &dw_mci_cqe_ic_threshold_fops);
+	debugfs_create_file("ic_timeout_us", 0644, root, host, &dw_mci_cqe_ic_timeout_fops);
+	debugfs_create_file("stats", 0444, root, host, &dw_mci_cqe_stats_fops);
+}
+#else
+static inline void dw_mci_cqe_init_debugfs(struct dw_mci *host) {}
+#endif
+
 static void dw_mci_cqhci_init(struct dw_mci *host)
 {
 	if(host->pdata && (host->pdata->caps2 & MMC_CAP2_CQE)) {
@@ -1624,6 +1788,10 @@ static void dw_mci_cqhci_init(struct dw_mci *host)
 				cqhci_init(host->cqe, host->slot->mmc, 1);
 				host->cqe->caps |= CQHCI_TASK_DESC_SZ_128;
 			}
+
+			host->cqe_ic_threshold = DW_MCI_IC_THRESHOLD;
+			host->cqe_ic_timeout_us = DW_MCI_IC_TIMEOUT_US;
+			dw_mci_cqe_init_debugfs(host);
 		}
 	}
 }
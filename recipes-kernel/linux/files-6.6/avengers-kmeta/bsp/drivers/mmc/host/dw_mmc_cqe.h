@@ -15,6 +15,17 @@
 #include <linux/reset.h>
 #include <linux/interrupt.h>
 
+/* Command queue counters, shown in debugfs */
+struct dw_mci_cqe_stats {
+	u64			tasks;
+	u64			depth_sum;	/* tasks in flight, summed at issue */
+	u32			depth_max;
+	u64			irqs;
+	u64			completions;
+	u64			halts;
+	u64			errors;
+};
+
 struct dw_mci {
 	spinlock_t              lock;
 	spinlock_t              irq_lock;
@@ -66,6 +77,10 @@ struct dw_mci {
 	u8			cqe_reenable;
 	bool			cmd_atomic;
 	struct cqhci_host       *cqe;
+
+	u32			cqe_ic_threshold;	/* 0 disables coalescing */
+	u32			cqe_ic_timeout_us;
+	struct dw_mci_cqe_stats	cqe_stats;
 };
 
 enum {
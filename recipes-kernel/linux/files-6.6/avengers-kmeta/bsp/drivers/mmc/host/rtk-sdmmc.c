@@ -53,6 +53,7 @@
 #define SD_ALLOC_LENGTH 2048
 #define MAX_PHASE 31
 #define TUNING_CNT 3
+#define RETUNE_RADIUS 8
 
 /* #define CMD25_WO_STOP_COMMAND */
 
@@ -746,7 +747,19 @@ static int rtk_sdmmc_tuning_rx_cmd(struct rtk_sdmmc_host *rtk_host, u8 sample_po
 	return 0;
 }
 
-static int rtk_sdmmc_tuning_tx(struct rtk_sdmmc_host *rtk_host)
+/* Phases within @radius of @phase, wrapping around the phase ring */
+static u32 rtk_sdmmc_phase_window(u8 phase, int radius)
+{
+	u32 mask = 0;
+	int i;
+
+	for (i = -radius ; i <= radius ; i++)
+		mask |= 1U << ((phase + i) & MAX_PHASE);
+
+	return mask;
+}
+
+static int rtk_sdmmc_tuning_tx(struct rtk_sdmmc_host *rtk_host, u32 scan_mask)
 {
 	int sample_point;
 	int ret = 0;
@@ -756,6 +769,9 @@ static int rtk_sdmmc_tuning_tx(struct rtk_sdmmc_host *rtk_host)
 	u8 final_phase = 0;
 
 	for (sample_point = 0 ; sample_point <= MAX_PHASE ; sample_point++) {
+		if (!(scan_mask & (1U << sample_point)))
+			continue;
+
 		for (i = 0 ; i < TUNING_CNT ; i++) {
 			if (!(rtk_host->rtflags & RTKCR_FCARD_DETECTED)) {
 				ret = -MMC_ERR_RMOVE;
@@ -785,6 +801,7 @@ static int rtk_sdmmc_tuning_tx(struct rtk_sdmmc_host *rtk_host)
 			goto out ;
 		}
 		rtk_sdmmc_change_tx_phase(rtk_host, final_phase);
+		rtk_host->tuning.tx_phase = final_phase;
 		ret = 0;
 		goto out ;
 	} else {
@@ -797,7 +814,7 @@ out:
 	return ret;
 }
 
-static int rtk_sdmmc_tuning_rx(struct rtk_sdmmc_host *rtk_host)
+static int rtk_sdmmc_tuning_rx(struct rtk_sdmmc_host *rtk_host, u32 scan_mask)
 {
 	int sample_point = 0;
 	int ret = 0;
@@ -814,6 +831,9 @@ static int rtk_sdmmc_tuning_rx(struct rtk_sdmmc_host *rtk_host)
 
 	sg_init_one(&sg, ssr, 512);
 	for (sample_point = 0 ; sample_point <= MAX_PHASE ; sample_point++) {
+		if (!(scan_mask & (1U << sample_point)))
+			continue;
+
 		for (i = 0 ; i < TUNING_CNT ; i++) {
 			if (!(rtk_host->rtflags & RTKCR_FCARD_DETECTED)) {
 				ret = -MMC_ERR_RMOVE;
@@ -842,6 +862,7 @@ static int rtk_sdmmc_tuning_rx(struct rtk_sdmmc_host *rtk_host)
 			goto out ;
 		}
 		rtk_sdmmc_change_rx_phase(rtk_host, final_phase);
+		rtk_host->tuning.rx_phase = final_phase;
 		ret = 0;
 		goto out ;
 	} else {
@@ -855,6 +876,37 @@ out:
 	return ret;
 }
 
+/*
+ * Check that the phases cached for this card still work at the current
+ * clock, so resume and re-detection can skip the full phase sweep.
+ */
+static int rtk_sdmmc_tuning_verify(struct rtk_sdmmc_host *rtk_host)
+{
+	struct rtk_sdmmc_tuning *tuning = &rtk_host->tuning;
+	struct scatterlist sg;
+	u8 *ssr;
+	int ret = 0;
+	int i;
+
+	if (!tuning->valid ||
+	    memcmp(tuning->cid, rtk_host->cid, sizeof(tuning->cid)) ||
+	    tuning->pll != readl(rtk_host->pll + CR_PLL_SD3))
+		return -EINVAL;
+
+	ssr = kmalloc(512, GFP_KERNEL | GFP_DMA);
+	if (!ssr)
+		return -ENOMEM;
+
+	sg_init_one(&sg, ssr, 512);
+	for (i = 0 ; i < TUNING_CNT && !ret ; i++)
+		ret = rtk_sdmmc_tuning_tx_cmd(rtk_host, tuning->tx_phase);
+	for (i = 0 ; i < TUNING_CNT && !ret ; i++)
+		ret = rtk_sdmmc_tuning_rx_cmd(rtk_host, tuning->rx_phase, &sg);
+
+	kfree(ssr);
+	return ret;
+}
+
 static int rtk_sdmmc_wait_voltage_stable_low(struct rtk_sdmmc_host *rtk_host)
 {
 	u8 status = 0;
@@ -1965,6 +2017,38 @@ static int rtk_sdmmc_stream_cmd(u16 cmdcode, struct sdmmc_cmd_pkt *cmd_info, u8
 	return ret;
 }
 
+/*
+ * Check whether a mapped scatterlist is a single run the DMA engine can
+ * reach with one start address: 8-byte aligned, below 4GB and with every
+ * segment starting where the previous one ended. This is the common case
+ * behind an IOMMU and for physically contiguous block layer pages.
+ */
+static bool rtk_sdmmc_sg_contiguous(struct scatterlist *sgl, int nents,
+				    u32 *addr, u32 *len)
+{
+	struct scatterlist *sg;
+	dma_addr_t start = sg_dma_address(sgl);
+	dma_addr_t next = start;
+	int i;
+
+	if (!IS_ALIGNED(start, 8))
+		return false;
+
+	for_each_sg(sgl, sg, nents, i) {
+		if (sg_dma_address(sg) != next)
+			return false;
+		next += sg_dma_len(sg);
+	}
+
+	if (upper_32_bits(next - 1))
+		return false;
+
+	*addr = start;
+	*len = next - start;
+
+	return true;
+}
+
 static int rtk_sdmmc_stream(struct sdmmc_cmd_pkt *cmd_info)
 {
 	u8 cmd_idx = cmd_info->cmd->opcode;
@@ -1977,6 +2061,9 @@ static int rtk_sdmmc_stream(struct sdmmc_cmd_pkt *cmd_info)
 	u32 old_arg = 0;
 	u16 cmdcode = 0;
 	u8 data_len = 0;
+	u32 direct_addr = 0;
+	u32 direct_len = 0;
+	bool bounced = false;
 
 	struct scatterlist *sg;
 	struct mmc_host *host = cmd_info->rtk_host->mmc;
@@ -1997,36 +2084,56 @@ static int rtk_sdmmc_stream(struct sdmmc_cmd_pkt *cmd_info)
 
 	cmd_info->data->bytes_xfered = 0;
 
-	if (rtk_host->sdmmc_bounce_buf_val) {
-		int buflen = 0;
-
-		for_each_sg(cmd_info->data->sg, sg, cmd_info->data->sg_len, i)
-			buflen += sg->length;
-
-		sg_init_one(rtk_host->sdmmc_bounce_sg,
-			    rtk_host->sdmmc_bounce_buf,
-			    buflen);
-
-		if (dir == DMA_TO_DEVICE)
-			sg_copy_to_buffer(cmd_info->data->sg,
-					  cmd_info->data->sg_len,
-					  rtk_host->sdmmc_bounce_buf,
-					  rtk_host->sdmmc_bounce_sg[0].length);
-
-		dma_nents = dma_map_sg(mmc_dev(host),
-				       rtk_host->sdmmc_bounce_sg,
-				       1,
-				       dir);
-
-		sg = rtk_host->sdmmc_bounce_sg;
-
-	} else {
+	if (cmd_info->data->host_cookie == RTK_SDMMC_COOKIE_PRE_MAPPED)
+		dma_nents = cmd_info->data->sg_count;
+	else
 		dma_nents = dma_map_sg(mmc_dev(host),
 				       cmd_info->data->sg,
 				       cmd_info->data->sg_len,
 				       dir);
 
-		sg = cmd_info->data->sg;
+	sg = cmd_info->data->sg;
+
+	if (rtk_host->sdmmc_bounce_buf_val) {
+		/*
+		 * The DMA engine takes one start address and a block count,
+		 * so a request can only go out as a single command if it is
+		 * one contiguous run in bus address space. Only fall back to
+		 * copying through the bounce buffer when it is not.
+		 */
+		if (dma_nents &&
+		    rtk_sdmmc_sg_contiguous(sg, dma_nents, &direct_addr, &direct_len)) {
+			dma_nents = 1;
+		} else {
+			int buflen = 0;
+
+			if (dma_nents && cmd_info->data->host_cookie != RTK_SDMMC_COOKIE_PRE_MAPPED)
+				dma_unmap_sg(mmc_dev(host),
+					     cmd_info->data->sg,
+					     cmd_info->data->sg_len,
+					     dir);
+
+			for_each_sg(cmd_info->data->sg, sg, cmd_info->data->sg_len, i)
+				buflen += sg->length;
+
+			sg_init_one(rtk_host->sdmmc_bounce_sg,
+				    rtk_host->sdmmc_bounce_buf,
+				    buflen);
+
+			if (dir == DMA_TO_DEVICE)
+				sg_copy_to_buffer(cmd_info->data->sg,
+						  cmd_info->data->sg_len,
+						  rtk_host->sdmmc_bounce_buf,
+						  rtk_host->sdmmc_bounce_sg[0].length);
+
+			dma_nents = dma_map_sg(mmc_dev(host),
+					       rtk_host->sdmmc_bounce_sg,
+					       1,
+					       dir);
+
+			sg = rtk_host->sdmmc_bounce_sg;
+			bounced = true;
+		}
 	}
 
 	old_arg = cmd_info->cmd->arg;
@@ -2034,8 +2141,13 @@ static int rtk_sdmmc_stream(struct sdmmc_cmd_pkt *cmd_info)
 	for (i = 0 ; i < dma_nents ; i++, sg++) {
 		u32 blk_cnt = 0;
 
-		dma_leng = sg_dma_len(sg);
-		dma_addr = sg_dma_address(sg);
+		if (direct_len) {
+			dma_leng = direct_len;
+			dma_addr = direct_addr;
+		} else {
+			dma_leng = sg_dma_len(sg);
+			dma_addr = sg_dma_address(sg);
+		}
 
 		pr_debug("%s: dma_addr: 0x%x, dma_leng: 0x%x\n", __func__, dma_addr, dma_leng);
 
@@ -2129,7 +2241,7 @@ static int rtk_sdmmc_stream(struct sdmmc_cmd_pkt *cmd_info)
 
 	}
 
-	if (rtk_host->sdmmc_bounce_buf_val) {
+	if (bounced) {
 		dma_unmap_sg(mmc_dev(host), rtk_host->sdmmc_bounce_sg, 1, dir);
 
 		if (dir == DMA_FROM_DEVICE)
@@ -2137,7 +2249,7 @@ static int rtk_sdmmc_stream(struct sdmmc_cmd_pkt *cmd_info)
 					    cmd_info->data->sg_len,
 					    rtk_host->sdmmc_bounce_buf,
 					    rtk_host->sdmmc_bounce_sg[0].length);
-	} else {
+	} else if (cmd_info->data->host_cookie != RTK_SDMMC_COOKIE_PRE_MAPPED) {
 		dma_unmap_sg(mmc_dev(host),
 			     cmd_info->data->sg,
 			     cmd_info->data->sg_len,
@@ -2379,6 +2491,8 @@ static void rtk_sdmmc_send_command(struct rtk_sdmmc_host *rtk_host, struct mmc_c
 		rtk_sdmmc_speed(rtk_host, SDMMC_CLOCK_6200KHZ);
 	} else if ((cmd->opcode == SD_SEND_RELATIVE_ADDR)&&((cmd->flags & (0x3 << 5)) == MMC_CMD_BCR)) {
 		sdmmc_rca = ((cmd->resp[0]) >> RCA_SHIFTER);
+	} else if (cmd->opcode == MMC_ALL_SEND_CID && !ret) {
+		memcpy(rtk_host->cid, cmd->resp, sizeof(rtk_host->cid));
 	}
 
 err_out:
@@ -2386,6 +2500,10 @@ err_out:
 		if (ret == -RTK_RMOV)
 			cmd->retries = 0;
 
+		/* Data CRC errors usually mean the sample phase has drifted */
+		if (cmd->data && (readb(rtk_host->sdmmc + SD_STATUS1) & (CRC7_STATUS | CRC16_STATUS)))
+			mmc_retune_needed(rtk_host->mmc);
+
 		if (cmd->opcode == 49 || cmd->opcode == 59 || cmd->opcode == 48|| cmd->opcode == 58) {
 			rtk_sdmmc_reset(rtk_host);
 			cmd->error  = -110;
@@ -2433,6 +2551,51 @@ done:
 		up(&cr_sd_sem);	//unplug will release semaphore, in this case we do not need to release the semaphore
 }
 
+/*
+ * Map the next request while the current one is on the bus. Requests that
+ * would have to go through the bounce buffer are left for rtk_sdmmc_stream(),
+ * since the buffer is still owned by the transfer in flight.
+ */
+static void rtk_sdmmc_pre_req(struct mmc_host *host, struct mmc_request *mrq)
+{
+	struct rtk_sdmmc_host *rtk_host = mmc_priv(host);
+	struct mmc_data *data = mrq->data;
+	enum dma_data_direction dir;
+	u32 addr, len;
+	int nents;
+
+	if (!data)
+		return;
+
+	data->host_cookie = RTK_SDMMC_COOKIE_UNMAPPED;
+
+	dir = (data->flags & MMC_DATA_READ) ? DMA_FROM_DEVICE : DMA_TO_DEVICE;
+	nents = dma_map_sg(mmc_dev(host), data->sg, data->sg_len, dir);
+	if (!nents)
+		return;
+
+	if (rtk_host->sdmmc_bounce_buf_val &&
+	    !rtk_sdmmc_sg_contiguous(data->sg, nents, &addr, &len)) {
+		dma_unmap_sg(mmc_dev(host), data->sg, data->sg_len, dir);
+		return;
+	}
+
+	data->sg_count = nents;
+	data->host_cookie = RTK_SDMMC_COOKIE_PRE_MAPPED;
+}
+
+static void rtk_sdmmc_post_req(struct mmc_host *host, struct mmc_request *mrq, int err)
+{
+	struct mmc_data *data = mrq->data;
+
+	if (!data || data->host_cookie != RTK_SDMMC_COOKIE_PRE_MAPPED)
+		return;
+
+	dma_unmap_sg(mmc_dev(host), data->sg, data->sg_len,
+		     (data->flags & MMC_DATA_READ) ? DMA_FROM_DEVICE : DMA_TO_DEVICE);
+	data->host_cookie = RTK_SDMMC_COOKIE_UNMAPPED;
+}
+
 int rtk_sdmmc_clk_cls_chk(struct mmc_host *host)
 {
 	struct rtk_sdmmc_host *rtk_host = mmc_priv(host);
@@ -2847,16 +3010,38 @@ static int rtk_sdmmc_execute_tuning(struct mmc_host *mmc, u32 opcode)
 	unsigned int reg_tmp = 0;
 	unsigned int reg_tmp2 = 0;
 	unsigned int reg_tuned3318 = 0;
+	u32 tx_mask = ~0U;
+	u32 rx_mask = ~0U;
 
 	reg_tmp2 = readl(pll_base + CR_PLL_SD2); //disable spectrum
 	writel((reg_tmp2 & 0xFFFF1FFF), pll_base + CR_PLL_SD2); //PLL_SD2 clear [15:13]
 
+	/*
+	 * Same card at the same clock: keep the cached phases if they still
+	 * pass, otherwise sweep only around them before a full re-tune.
+	 */
+	if (rtk_host->tuning.valid &&
+	    !memcmp(rtk_host->tuning.cid, rtk_host->cid, sizeof(rtk_host->cid))) {
+		ret = rtk_sdmmc_tuning_verify(rtk_host);
+		if (!ret) {
+			writel(reg_tmp2, pll_base + CR_PLL_SD2); //enable spectrum
+			pr_info("%s: reuse tx phase %d, rx phase %d\n", __func__,
+				rtk_host->tuning.tx_phase, rtk_host->tuning.rx_phase);
+			return 0;
+		}
+		tx_mask = rtk_sdmmc_phase_window(rtk_host->tuning.tx_phase, RETUNE_RADIUS);
+		rx_mask = rtk_sdmmc_phase_window(rtk_host->tuning.rx_phase, RETUNE_RADIUS);
+	}
+	rtk_host->tuning.valid = false;
+
 	/*if tune tx phase fail, down 8MHz and retry*/
 	do{
-		ret = rtk_sdmmc_tuning_tx(rtk_host);
+		ret = rtk_sdmmc_tuning_tx(rtk_host, tx_mask);
 		if (ret == -MMC_ERR_RMOVE) {
 			pr_err("%s: Tuning TX fail.\n", __func__);
 			return ret;
+		} else if (ret && tx_mask != ~0U) {
+			tx_mask = ~0U;
 		} else if (ret) {
 			reg_tmp = readl(pll_base + CR_PLL_SD3);
 			reg_tuned3318 = (reg_tmp & 0x03FF0000) >> 16;
@@ -2881,7 +3066,9 @@ static int rtk_sdmmc_execute_tuning(struct mmc_host *mmc, u32 opcode)
 		return ret;
 	}
 
-	ret = rtk_sdmmc_tuning_rx(rtk_host);
+	ret = rtk_sdmmc_tuning_rx(rtk_host, rx_mask);
+	if (ret && ret != -MMC_ERR_RMOVE && rx_mask != ~0U)
+		ret = rtk_sdmmc_tuning_rx(rtk_host, ~0U);
 	writel(reg_tmp2, pll_base + CR_PLL_SD2); //enable spectrum
 
 	if (ret) {
@@ -2889,6 +3076,10 @@ static int rtk_sdmmc_execute_tuning(struct mmc_host *mmc, u32 opcode)
 		return ret;
 	}
 
+	memcpy(rtk_host->tuning.cid, rtk_host->cid, sizeof(rtk_host->cid));
+	rtk_host->tuning.pll = readl(pll_base + CR_PLL_SD3);
+	rtk_host->tuning.valid = true;
+
 	pr_info("%s CR_PLL_SD3: %d (0x%02x)\n", __func__, (readl(pll_base + CR_PLL_SD3) >> 16), (readl(pll_base + CR_PLL_SD3) >> 16));
 	pr_info("%s CLK_GEN DVI: %d\n", __func__, 1 << (readl(sdmmc_base + CR_SD_CKGEN_CTL) & 0x03));
 
@@ -2897,6 +3088,8 @@ static int rtk_sdmmc_execute_tuning(struct mmc_host *mmc, u32 opcode)
 
 static const struct mmc_host_ops rtk_sdmmc_ops ={
 	.request = rtk_sdmmc_request,
+	.pre_req = rtk_sdmmc_pre_req,
+	.post_req = rtk_sdmmc_post_req,
 	.get_ro = rtk_sdmmc_get_ro,
 	.get_cd = rtk_sdmmc_get_cd,
 	.set_ios = rtk_sdmmc_set_ios,
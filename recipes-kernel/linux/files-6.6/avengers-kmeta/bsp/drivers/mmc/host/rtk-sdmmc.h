@@ -10,6 +10,15 @@
 
 #define BOUNCE_SIZE 0x200000
 
+/* Phases found by the last successful tuning, reused while the card stays */
+struct rtk_sdmmc_tuning {
+	u32 cid[4];
+	u32 pll;	/* CR_PLL_SD3 the phases were found at */
+	u8 tx_phase;
+	u8 rx_phase;
+	bool valid;
+};
+
 struct rtk_sdmmc_host {
 	struct mmc_host *mmc;
 	struct mmc_request *mrq;
@@ -53,6 +62,9 @@ struct rtk_sdmmc_host {
 	char *sdmmc_bounce_buf;
 	int sdmmc_bounce_buf_val;
 	struct scatterlist *sdmmc_bounce_sg;
+
+	u32 cid[4];	/* from the last CMD2 on the bus */
+	struct rtk_sdmmc_tuning tuning;
 };
 
 struct sdmmc_cmd_pkt {
@@ -198,6 +210,10 @@ static const unsigned char rtk_sdmmc_cmdcode[60][2] = {
 #define RTK_TOUT                   1 /* time out include DMA finish & cmd parser finish */
 #define RTK_SUCC                   0
 
+/* mmc_data host_cookie, who owns the scatterlist mapping */
+#define RTK_SDMMC_COOKIE_UNMAPPED   0
+#define RTK_SDMMC_COOKIE_PRE_MAPPED 1 /* by pre_req, unmapped in post_req */
+
 #define MMC_EXT_READ_SINGLE        48
 #define MMC_EXT_WRITE_SINGLE       49
 #define MMC_EXT_READ_MULTIPLE      58
@@ -60,6 +60,11 @@ struct sdhci_rtk {
 	struct pinctrl_state *pins_vsel_1v8;
 	u32 preset_pll;
 	int location;
+	/* last good phases, indexed by tx, and the card and PLL they are for */
+	u32 tuned_id[4];
+	u32 tuned_pll;
+	u8 tuned_phase[2];
+	bool tuned;
 };
 
 static const struct soc_device_attribute rtk_soc_thor[] = {
@@ -680,14 +685,60 @@ static u8 rtk_sdhci_search_final_phase(struct sdhci_host *host, u32 phase_map, i
 	return final_phase;
 }
 
-static int rtk_sdhci_tuning(struct sdhci_host *host, u32 opcode, int tx)
+static u32 rtk_sdhci_phase_window(u8 phase, int radius)
 {
+	u32 mask = 0;
+	int i;
+
+	for (i = -radius; i <= radius; i++)
+		mask |= 1U << ((phase + i + MAX_PHASE) % MAX_PHASE);
+
+	return mask;
+}
+
+/* SDIO cards have no CID, key them on the CIS vendor and device instead */
+static void rtk_sdhci_card_id(struct mmc_card *card, u32 *id)
+{
+	memset(id, 0, 4 * sizeof(u32));
+
+	if (mmc_card_sdio(card)) {
+		id[0] = card->cis.vendor;
+		id[1] = card->cis.device;
+	} else {
+		memcpy(id, card->raw_cid, 4 * sizeof(u32));
+	}
+}
+
+static int rtk_sdhci_verify_phase(struct sdhci_host *host, u32 opcode, int tx)
+{
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+	struct sdhci_rtk *rtk_host = sdhci_pltfm_priv(pltfm_host);
+	int err, i;
+
+	rtk_sdhci_change_phase(host, rtk_host->tuned_phase[tx], tx);
+
+	for (i = 0; i < TUNING_CNT; i++) {
+		err = rtk_mmc_send_tuning(host->mmc, opcode, tx);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+static int rtk_sdhci_tuning(struct sdhci_host *host, u32 opcode, int tx, u32 scan_mask)
+{
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+	struct sdhci_rtk *rtk_host = sdhci_pltfm_priv(pltfm_host);
 	struct mmc_host *mmc = host->mmc;
 	int err, i, sample_point;
 	u32 raw_phase_map[TUNING_CNT] = {0}, phase_map;
 	u8 final_phase = 0;
 
 	for (sample_point = 0; sample_point < MAX_PHASE; sample_point++) {
+		if (!(scan_mask & (1U << sample_point)))
+			continue;
+
 		for (i = 0; i < TUNING_CNT; i++) {
 			rtk_sdhci_change_phase(host, (u8) sample_point, tx);
 			err = rtk_mmc_send_tuning(mmc, opcode, tx);
@@ -709,6 +760,7 @@ static int rtk_sdhci_tuning(struct sdhci_host *host, u32 opcode, int tx)
 		err = rtk_sdhci_change_phase(host, final_phase, tx);
 		if (err < 0)
 			return err;
+		rtk_host->tuned_phase[tx] = final_phase;
 	} else {
 		pr_err("%s  fail !phase_map\n", __func__);
 		return -EINVAL;
@@ -766,7 +818,9 @@ static int rtk_sdhci_execute_tuning(struct sdhci_host *host, u32 opcode)
 	void __iomem *wrap_base = rtk_host->wrap_base;
 	u32 rtkquirks = soc_data->rtkquirks;
 	u32 reg, tx_opcode;
-	int ret = 0;
+	u32 card_id[4], pll;
+	u32 tx_mask = ~0U, rx_mask = ~0U;
+	int ret = 0, tx_ret;
 
 	pr_err("%s : Execute Clock Phase Tuning\n", __func__);
 
@@ -786,14 +840,37 @@ static int rtk_sdhci_execute_tuning(struct sdhci_host *host, u32 opcode)
 	else
 		tx_opcode = MMC_SEND_STATUS;
 
-	ret = rtk_sdhci_tuning(host, tx_opcode, 1);
-	if (ret)
+	/*
+	 * Same card at the same PLL, e.g. after resume or a CRC error: keep
+	 * the last phases if they still pass, else sweep around them first.
+	 */
+	rtk_sdhci_card_id(host->mmc->card, card_id);
+	regmap_read(crt_base, SYS_PLL_SDIO3, &pll);
+	if (rtk_host->tuned && rtk_host->tuned_pll == pll &&
+	    !memcmp(rtk_host->tuned_id, card_id, sizeof(card_id))) {
+		if (!rtk_sdhci_verify_phase(host, tx_opcode, 1) &&
+		    !rtk_sdhci_verify_phase(host, MMC_SEND_TUNING_BLOCK, 0)) {
+			dev_info(mmc_dev(host->mmc), "reuse tx phase %d, rx phase %d\n",
+				 rtk_host->tuned_phase[1], rtk_host->tuned_phase[0]);
+			goto restore_ssc;
+		}
+		tx_mask = rtk_sdhci_phase_window(rtk_host->tuned_phase[1], RETUNE_RADIUS);
+		rx_mask = rtk_sdhci_phase_window(rtk_host->tuned_phase[0], RETUNE_RADIUS);
+	}
+	rtk_host->tuned = false;
+
+	tx_ret = rtk_sdhci_tuning(host, tx_opcode, 1, tx_mask);
+	if (tx_ret && tx_mask != ~0U)
+		tx_ret = rtk_sdhci_tuning(host, tx_opcode, 1, ~0U);
+	if (tx_ret)
 		pr_err("tx tuning fail\n");
 
 	do {
-		ret = rtk_sdhci_tuning(host, MMC_SEND_TUNING_BLOCK, 0);
+		ret = rtk_sdhci_tuning(host, MMC_SEND_TUNING_BLOCK, 0, rx_mask);
 
-		if (ret) {
+		if (ret && rx_mask != ~0U) {
+			rx_mask = ~0U;
+		} else if (ret) {
 			regmap_read(crt_base, SYS_PLL_SDIO3, &reg);
 			if ((FIELD_GET(SSC_DIV_N, reg) < SSC_DIV_N_50M) ||
 			    (FIELD_GET(PLL_V2_SSC_DIV_N, reg) == PLL_V2_SSC_DIV_N_50M)) {
@@ -804,6 +881,13 @@ static int rtk_sdhci_execute_tuning(struct sdhci_host *host, u32 opcode)
 		}
 	} while (ret);
 
+	if (!tx_ret) {
+		memcpy(rtk_host->tuned_id, card_id, sizeof(card_id));
+		regmap_read(crt_base, SYS_PLL_SDIO3, &rtk_host->tuned_pll);
+		rtk_host->tuned = true;
+	}
+
+restore_ssc:
 	if (!(rtkquirks & RTKQUIRK_SSC_CLK_JITTER)) {
 		if (soc_device_match(rtk_soc_pll_v2)) {
 			regmap_read(crt_base, SYS_PLL_SDIO3, &reg);
@@ -11,6 +11,8 @@
 #define MAX_PHASE				32
 #define TUNING_CNT				3
 #define MINIMUM_CONTINUE_LENGTH			16
+/* Phases swept around the cached one before falling back to a full sweep */
+#define RETUNE_RADIUS				12
 /* Controller clock has large jitter when SSC enable */
 #define RTKQUIRK_SSC_CLK_JITTER			BIT(0)
 
@@ -154,6 +154,82 @@ static int rtk_nf_wait_down(void __iomem *regs, u64 mask, unsigned int value)
 	return 0;
 }
 
+/*
+ * Sequential reads use READ PAGE CACHE RANDOM (00h-addr-31h): the chip moves
+ * the page it has just sensed to the cache register and starts sensing the
+ * addressed one while the previous page is streamed out, so tR of page N+1
+ * overlaps the transfer of page N. The sequence stays open between reads and
+ * is closed with 3Fh before any other command goes to the chip.
+ */
+static int rtk_nf_cache_read_end(struct rtk_nf *nf)
+{
+	void __iomem *base = nf->regs;
+	int ret;
+
+	if (nf->cache_page < 0)
+		return 0;
+
+	nf->cache_page = -1;
+
+	writel(NF_ND_CMD_cmd(NAND_CMD_READCACHEEND), base + REG_ND_CMD);
+	writel(0x80, base + REG_ND_CTL);
+	if ((ret = rtk_nf_wait_down(base + REG_ND_CTL, 0x80, 0x0)) != 0)
+		return ret;
+
+	return rtk_nf_wait_down(base + REG_ND_CTL, 0x40, 0x40);
+}
+
+static int rtk_nf_cache_read_start(struct rtk_nf *nf, int page)
+{
+	void __iomem *base = nf->regs;
+	int ret;
+
+	rtk_nf_cache_read_end(nf);
+
+	writel(NF_ND_CMD_cmd(NAND_CMD_READ0), base + REG_ND_CMD);
+	writel(0x80, base + REG_ND_CTL);
+	if ((ret = rtk_nf_wait_down(base + REG_ND_CTL, 0x80, 0x0)) != 0)
+		return ret;
+
+	writel(0xff & page, base + REG_ND_PA0);
+	writel(0xff & (page >> 8), base + REG_ND_PA1);
+	writel((0x1 << 5) | (0x1f & (page >> 16)), base + REG_ND_PA2);
+	writel(((0x7 & (page >> 21)) << 5) & 0x000000E0, base + REG_ND_PA3);
+	writel(0x0, base + REG_ND_CA0);
+	writel(0x0, base + REG_ND_CA1);
+	writel(0x81, base + REG_ND_CTL);
+	if ((ret = rtk_nf_wait_down(base + REG_ND_CTL, 0x80, 0x0)) != 0)
+		return ret;
+
+	writel(NF_ND_CMD_cmd(NAND_CMD_READSTART), base + REG_ND_CMD);
+	writel(0x80, base + REG_ND_CTL);
+	if ((ret = rtk_nf_wait_down(base + REG_ND_CTL, 0x80, 0x0)) != 0)
+		return ret;
+
+	if ((ret = rtk_nf_wait_down(base + REG_ND_CTL, 0x40, 0x40)) != 0)
+		return ret;
+
+	nf->cache_page = page;
+
+	return 0;
+}
+
+/* Only whole-page ecc reads that continue a sequential run go through 31h. */
+static bool rtk_nf_cache_read_usable(struct rtk_nf *nf, int page, int mode,
+				     int phase)
+{
+	if (!nf->cache_read || mode != ECC || phase != 0)
+		return false;
+
+	return page == nf->cache_page || page == nf->last_page + 1;
+}
+
+/* Never prefetch across a block, its successor may be remapped. */
+static int rtk_nf_cache_read_next(struct rtk_nf *nf, int page)
+{
+	return ((page + 1) % nf->ppb) ? page + 1 : page;
+}
+
 int rtk_nf_get_mapping_page(struct mtd_info *mtd, int page)
 {
 #if defined(CONFIG_MTD_NAND_RTK_BBM)
@@ -519,8 +595,11 @@ static int rtk_nf_do_write_page(struct mtd_info *mtd, struct nand_chip *chip,
 				int page, const u8 *buf, int oob_on,
 				int access_mode)
 {
+	struct rtk_nf *nf = nand_get_controller_data(chip);
 	int ret = 0;
 
+	rtk_nf_cache_read_end(nf);
+
 	ret = rtk_nf_do_write_page_ecc(mtd, chip, buf, page, access_mode);
 	if (ret)
 		return ret;
@@ -747,6 +826,8 @@ static int rtk_nf_do_read_page_raw(struct mtd_info *mtd, int page, u8 *buffer,
 	remain_size = (oobonly) ? mtd->oobsize : mtd->writesize + mtd->oobsize;
 	col_addr = (oobonly) ? mtd->writesize : 0x0;
 
+	rtk_nf_cache_read_end(nf);
+
 	writel(0x0, map_base + REG_RND_EN);
 	writel(0x0, map_base + REG_ND_CMD);
 	writel(0x30, map_base + REG_CMD2);
@@ -824,6 +905,8 @@ static int rtk_nf_do_read_page_ecc(struct mtd_info *mtd, int page, u8 *buf,
 	unsigned int eccNum = 0;
 	unsigned int blank_check = 0;
 	unsigned int access_page_len = 0;
+	bool cached;
+	int next;
 	int ret;
 
 	access_page_len = (phase == 1) ? SZ_2K : mtd->writesize;
@@ -843,6 +926,15 @@ static int rtk_nf_do_read_page_ecc(struct mtd_info *mtd, int page, u8 *buf,
 
 	rtk_nf_enable_io_mode(mtd);
 
+	cached = rtk_nf_cache_read_usable(nf, page, mode, phase);
+	if (cached && page != nf->cache_page)
+		cached = !rtk_nf_cache_read_start(nf, page);
+	if (!cached)
+		rtk_nf_cache_read_end(nf);
+
+	/* with 31h the address is the page to sense next, not the one read */
+	next = cached ? rtk_nf_cache_read_next(nf, page) : page;
+
 	writel(0x1, map_base + REG_RND_EN);
 	writel(0x5, map_base + REG_RND_CMD1);
 	writel(0xe0, map_base + REG_RND_CMD2);
@@ -851,10 +943,10 @@ static int rtk_nf_do_read_page_ecc(struct mtd_info *mtd, int page, u8 *buf,
 	writel((mtd->writesize & 0xff), map_base + REG_RND_SPR_STR_COL_L);
 
 	/* set PA and CA */
-	writel(0xff & page, map_base + REG_ND_PA0);
-	writel(0xff & (page >> 8), map_base + REG_ND_PA1);
-	writel((0x1 << 5) | (0x1f & (page >> 16)), map_base + REG_ND_PA2);
-	writel(((0x7 & (page >> 21)) << 5) & 0x000000E0, map_base + REG_ND_PA3);
+	writel(0xff & next, map_base + REG_ND_PA0);
+	writel(0xff & (next >> 8), map_base + REG_ND_PA1);
+	writel((0x1 << 5) | (0x1f & (next >> 16)), map_base + REG_ND_PA2);
+	writel(((0x7 & (next >> 21)) << 5) & 0x000000E0, map_base + REG_ND_PA3);
 	writel(0x0, map_base + REG_ND_CA0);
 	writel(0x0, map_base + REG_ND_CA1);
 
@@ -885,7 +977,8 @@ static int rtk_nf_do_read_page_ecc(struct mtd_info *mtd, int page, u8 *buf,
 
 	/* set command */
 	writel(NAND_CMD_READ0, map_base + REG_ND_CMD);
-	writel(NAND_CMD_READSTART, map_base + REG_CMD2);
+	writel(cached ? NF_CMD_READ_CACHE_RND : NAND_CMD_READSTART,
+	       map_base + REG_CMD2);
 	writel(NAND_CMD_STATUS, map_base + REG_CMD3);
 
 	/* Set ECC */
@@ -904,6 +997,8 @@ static int rtk_nf_do_read_page_ecc(struct mtd_info *mtd, int page, u8 *buf,
 
 	/* Enable Auto mode */
 	writel(0x80 | (0x7 & 2), map_base + REG_AUTO_TRIG);
+	if (cached)
+		nf->cache_page = next;
 
 	if ((ret = rtk_nf_wait_down(map_base + REG_AUTO_TRIG, 0x80, 0x0)) != 0)
 		goto rtk_nf_do_read_page_ecc_exit;
@@ -953,6 +1048,8 @@ rtk_nf_do_read_page_ecc_exit:
 	writel(NF_BLANK_CHK_blank_ena(1) | NF_BLANK_CHK_read_ecc_xnor_ena(0),
 		map_base + REG_BLANK_CHK);
 
+	nf->last_page = page;
+
 	rtk_nf_disable_io_mode(mtd);
 
 	if (buf != buffer->dataBuf && !((uintptr_t)buf & 0xFFF)) {
@@ -1091,6 +1188,8 @@ static int rtk_nf_do_erase_block(struct nand_chip *chip, int page)
 	void __iomem *base = nf->regs;
 	int ret = 0;
 
+	rtk_nf_cache_read_end(nf);
+
 	writel(NF_MULTI_CHNL_MODE_no_wait_busy(1) | NF_MULTI_CHNL_MODE_edo(1),
 		base + REG_MULTI_CHNL_MODE);
 
@@ -1205,6 +1304,8 @@ static void rtk_nf_read_id(struct nand_chip *chip)
 	int ret, i;
 	int id_chain;
 
+	rtk_nf_cache_read_end(nf);
+
 	writel(6, base + REG_DATA_TL0);
 	writel(0x80, base + REG_DATA_TL1);
 
@@ -1386,7 +1487,8 @@ static int rtk_nf_hw_init(struct rtk_nf *nf)
 	writel(0x0, base + REG_MULTI_CHNL_MODE);
 	writel(0x0, base + REG_READ_BY_PP);
 
-	/* reset nand */
+	/* reset nand, this also drops any open cache read */
+	nf->cache_page = -1;
 	writel(0xff, base + REG_ND_CMD);
 	writel(0x80, base + REG_ND_CTL);
 
@@ -1483,6 +1585,18 @@ static int rtk_nf_nand_chip_init(struct device *dev, struct rtk_nf *nf,
 	nf->ppb = mtd->erasesize / mtd->writesize;
 	nf->chipsize =  nanddev_target_size(&chip->base);
 
+	/*
+	 * Cache read is not in the bootcode id table and the legacy command
+	 * path has no ONFI parameter page, so the board opts in. The Toshiba
+	 * part that needs the on-die ecc status read between pages is left out.
+	 */
+	nf->last_page = -1;
+	nf->cache_read = of_property_read_bool(np, "realtek,nand-cache-read") &&
+			 !(g_id_chain == 0x1590da98 &&
+			   (g_id_chain_2 & 0xffff) == 0x16f6);
+	if (nf->cache_read)
+		dev_info(dev, "cache read enabled\n");
+
 #if defined(CONFIG_MTD_NAND_RTK_BBM)
 	ret = rtk_nf_scan_table(mtd);
 	if (ret)
@@ -1657,6 +1771,7 @@ static int rtk_nf_suspend(struct device *dev)
 {
 	struct rtk_nf *nf = dev_get_drvdata(dev);
 
+	rtk_nf_cache_read_end(nf);
 	clk_disable_unprepare(nf->clk_nand);
 
 	return 0;
@@ -173,6 +173,9 @@
 #define NF_SPR_DDR_CTL_spare_dram_sa(value)	(0x1FFFFFFF&((value)<<0))
 #define NF_CP_LEN_cp_length(value)		(0x01FFFE00&((value)<<9))
 
+/* READ PAGE CACHE RANDOM confirm, 00h-addr-31h */
+#define NF_CMD_READ_CACHE_RND			0x31
+
 
 /* Reserve Block Area usage */
 #define BB_INIT                 0xFFFE
@@ -247,6 +250,9 @@ struct rtk_nf {
 	unsigned char t2;
 	unsigned char t3;
 	unsigned char ecc;
+	bool cache_read;	/* chip takes 00h-addr-31h cache reads */
+	int cache_page;		/* page being sensed by the open 31h, or -1 */
+	int last_page;		/* last page read with ecc */
 #if defined(CONFIG_MTD_NAND_RTK_BBM)
 	struct bb_table *bbt;
 	struct sb_table *sbt;
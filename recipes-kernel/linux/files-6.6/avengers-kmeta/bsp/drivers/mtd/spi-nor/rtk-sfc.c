@@ -14,6 +14,7 @@
 #include <linux/mtd/spi-nor.h>
 #include <linux/of.h>
 #include <linux/platform_device.h>
+#include <linux/sched/task_stack.h>
 #include <linux/slab.h>
 #include <linux/regmap.h>
 #include <linux/mfd/syscon.h>
@@ -44,6 +45,7 @@
 #define RTKSFC_OP_WRITE		0x1
 
 #define NOR_BASE_PHYS		0x88100000
+#define NOR_WINDOW_SIZE		0x2000000
 
 struct rtksfc_host {
 	struct device *dev;
@@ -183,7 +185,7 @@ static void rtk_spi_nor_init(struct rtksfc_host *host)
 {
 	rtk_spi_nor_init_setting();
 
-	host->iobase = ioremap(NOR_BASE_PHYS, 0x2000000);
+	host->iobase = ioremap(NOR_BASE_PHYS, NOR_WINDOW_SIZE);
 	host->mdbase = ioremap(MD_BASE_ADDE, 0x30);
 
 	regmap_write(host->sb2, SFC_SCK, 0x00000013);
@@ -294,16 +296,15 @@ static int rtk_spi_nor_byte_transfer(struct rtksfc_host *host, loff_t offset,
 	return len;
 }
 
-static int rtk_spi_nor_dma_transfer(struct rtksfc_host *host, loff_t offset,
-					size_t len, u8 op_type)
+static int rtk_spi_nor_dma_transfer(struct rtksfc_host *host, dma_addr_t dma,
+				    loff_t offset, size_t len, u8 op_type)
 {
 	unsigned int val;
 
 	writel(0x0a, host->mdbase + MD_FDMA_CTRL1);
 
 	/* setup MD DDR addr and flash addr */
-	writel((unsigned long)(host->dma_buffer),  
-				host->mdbase + MD_FDMA_DDR_SADDR);
+	writel((unsigned long)dma, host->mdbase + MD_FDMA_DDR_SADDR);
 	writel((unsigned long)((volatile u8*)(NOR_BASE_PHYS + offset)),  
 				host->mdbase + MD_FDMA_FL_SADDR);
 
@@ -319,18 +320,39 @@ static int rtk_spi_nor_dma_transfer(struct rtksfc_host *host, loff_t offset,
 	while (readl(host->mdbase + MD_FDMA_CTRL1) & 0x1)
 		udelay(1);
 
+	/* only a program leaves the flash busy */
+	if (op_type == RTKSFC_OP_READ)
+		return 0;
+
 	return rtk_spi_nor_read_status(host);
 }
 
+/*
+ * Length of the head of buf that the MD DMA may write into directly. The
+ * rest goes through the coherent bounce buffer. Partial cache lines are
+ * never handed to the device, so an invalidate cannot clobber neighbours.
+ */
+static size_t rtk_spi_nor_direct_len(const void *buf, size_t len)
+{
+	unsigned int align = dma_get_cache_alignment();
+
+	if (!virt_addr_valid(buf) || object_is_on_stack(buf) ||
+	    !IS_ALIGNED((uintptr_t)buf, align))
+		return 0;
+
+	return ALIGN_DOWN(len, align);
+}
+
 static ssize_t rtk_spi_nor_read(struct rtksfc_host *host, const struct spi_mem_op *op)
 {
 	loff_t from, n_from;
 	size_t len;
 	size_t n_len = 0, r_len = 0;
+	size_t direct_len, done = 0;
 	unsigned int offset;
 	u_char *read_buf = op->data.buf.in;
+	dma_addr_t dma = 0;
 	int ret;
-	int i;
 
 	from = op->addr.val;
 	len = op->data.nbytes;
@@ -348,31 +370,51 @@ static ssize_t rtk_spi_nor_read(struct rtksfc_host *host, const struct spi_mem_o
 	n_from = from + r_len;
 	n_len = len - r_len;
 
-	/* DMA stage */
+	if (!n_len)
+		return len;
+
+	/* DMA stage, straight into the caller's buffer where it is safe */
+	direct_len = rtk_spi_nor_direct_len(read_buf + offset, n_len);
+	if (direct_len) {
+		dma = dma_map_single(host->dev, read_buf + offset, direct_len,
+				     DMA_FROM_DEVICE);
+		if (dma_mapping_error(host->dev, dma))
+			direct_len = 0;
+	}
+
+	/* read status is skipped between chunks, so the mode sticks */
+	if (op->cmd.opcode == 0x3b)
+		rtk_spi_nor_dualread_mode(host);
+	else
+		rtk_spi_nor_read_mode(host);
+
 	while (n_len > 0) {
-		r_len = (n_len >= RTKSFC_DMA_MAX_LEN) ? RTKSFC_DMA_MAX_LEN : n_len;
+		bool direct = done < direct_len;
 
-		if (op->cmd.opcode == 0x3b)
-			rtk_spi_nor_dualread_mode(host);
-		else
-			rtk_spi_nor_read_mode(host);
+		r_len = (n_len >= RTKSFC_DMA_MAX_LEN) ? RTKSFC_DMA_MAX_LEN : n_len;
+		if (direct)
+			r_len = min(r_len, direct_len - done);
 
-		ret = rtk_spi_nor_dma_transfer(host, n_from, r_len,
-							RTKSFC_OP_READ);
+		ret = rtk_spi_nor_dma_transfer(host,
+					       direct ? dma + done : host->dma_buffer,
+					       n_from, r_len, RTKSFC_OP_READ);
 		if (ret) {
 			pr_err("DMA read timeout\n");
-			return ret;
+			break;
 		}
 
-		for (i = 0; i < r_len; i++)
-			*(u8 *)(read_buf + offset + i) = *(u8 *)(host->buffer + i);
+		if (!direct)
+			memcpy(read_buf + offset + done, host->buffer, r_len);
 
 		n_len -= r_len;
-		offset += r_len;
+		done += r_len;
 		n_from += r_len;
 	}
 
-	return len;
+	if (direct_len)
+		dma_unmap_single(host->dev, dma, direct_len, DMA_FROM_DEVICE);
+
+	return ret ? ret : len;
 }
 
 static ssize_t rtk_spi_nor_write(struct rtksfc_host *host, const struct spi_mem_op *op)
@@ -411,8 +453,8 @@ static ssize_t rtk_spi_nor_write(struct rtksfc_host *host, const struct spi_mem_
 
 		rtk_spi_nor_write_mode(host);
 
-		ret = rtk_spi_nor_dma_transfer(host, to + offset, w_len,
-							RTKSFC_OP_WRITE);
+		ret = rtk_spi_nor_dma_transfer(host, host->dma_buffer, to + offset,
+					       w_len, RTKSFC_OP_WRITE);
 
 		r_len = r_len - w_len;
 		offset = offset + w_len;
@@ -465,12 +507,37 @@ static bool rtk_nor_supports_op(struct spi_mem *mem,
 			return false;
 	}
 
-	if (op->data.nbytes != 0 && op->data.buswidth > 4)
+	/* the read path only knows single (0x03) and dual output (0x3b) */
+	if (op->data.nbytes != 0 && op->data.buswidth > 2)
 		return false;
 
 	return spi_mem_default_supports_op(mem, op);
 }
 
+static int rtk_nor_dirmap_create(struct spi_mem_dirmap_desc *desc)
+{
+	if (desc->info.op_tmpl.data.dir != SPI_MEM_DATA_IN)
+		return -EOPNOTSUPP;
+
+	if (desc->info.offset + desc->info.length > NOR_WINDOW_SIZE)
+		return -EINVAL;
+
+	return 0;
+}
+
+static ssize_t rtk_nor_dirmap_read(struct spi_mem_dirmap_desc *desc,
+				   u64 offs, size_t len, void *buf)
+{
+	struct rtksfc_host *host = spi_controller_get_devdata(desc->mem->spi->master);
+	struct spi_mem_op op = desc->info.op_tmpl;
+
+	op.addr.val = desc->info.offset + offs;
+	op.data.nbytes = len;
+	op.data.buf.in = buf;
+
+	return rtk_spi_nor_read(host, &op);
+}
+
 static const char *rtk_nor_get_name(struct spi_mem *mem)
 {
 	struct rtksfc_host *host = spi_controller_get_devdata(mem->spi->master);
@@ -483,6 +550,8 @@ static const struct spi_controller_mem_ops rtk_nor_mem_ops = {
 	.supports_op = rtk_nor_supports_op,
 	.exec_op = rtk_nor_exec_op,
 	.get_name = rtk_nor_get_name,
+	.dirmap_create = rtk_nor_dirmap_create,
+	.dirmap_read = rtk_nor_dirmap_read,
 };
 
 static int rtk_spi_nor_probe(struct platform_device *pdev)
@@ -495,7 +564,7 @@ static int rtk_spi_nor_probe(struct platform_device *pdev)
 	if (!ctrl)
 		return -ENOMEM;
 
-	ctrl->mode_bits = SPI_RX_DUAL | SPI_RX_QUAD | SPI_TX_DUAL | SPI_TX_QUAD;
+	ctrl->mode_bits = SPI_RX_DUAL | SPI_TX_DUAL;
 	ctrl->bus_num = -1;
 	ctrl->mem_ops = &rtk_nor_mem_ops;
 	ctrl->num_chipselect = 1;
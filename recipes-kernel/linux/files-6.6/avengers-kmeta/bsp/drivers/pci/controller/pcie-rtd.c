@@ -69,19 +69,68 @@ static struct msi_domain_info rtd_pcie_msi_domain_info = {
 	.chip	= &rtd_pcie_msi_irq_chip,
 };
 
+/*
+ * All vectors share one parent line, so the demux runs wherever that line
+ * is routed. A vector whose affinity names another CPU is acked here and
+ * handed to that CPU with an IPI; the flow handler runs there and acks a
+ * second time, which only clears an edge the handler is about to see.
+ */
+struct rtd_pcie_msi_steer {
+	call_single_data_t csd;
+	struct rtd_pcie_port *pp;
+	DECLARE_BITMAP(pending, RTK_MAX_MSI_IRQS);
+};
+
+static void rtd_pcie_msi_steer_func(void *info)
+{
+	struct rtd_pcie_msi_steer *steer = info;
+	struct rtd_pcie_port *pp = steer->pp;
+	unsigned long pending;
+	int i, bit;
+
+	for (i = 0; i < BITS_TO_LONGS(RTK_MAX_MSI_IRQS); i++) {
+		pending = xchg(&steer->pending[i], 0);
+		for_each_set_bit(bit, &pending, BITS_PER_LONG)
+			generic_handle_irq(irq_find_mapping(pp->irq_domain,
+						i * BITS_PER_LONG + bit));
+	}
+}
+
+static void rtd_pcie_msi_dispatch(struct rtd_pcie_port *pp, u32 hwirq,
+				  void __iomem *status, u32 bit)
+{
+	unsigned int cpu = READ_ONCE(pp->msi_cpu[hwirq]);
+	struct rtd_pcie_msi_steer *steer;
+
+	if (!pp->msi_steer || cpu >= nr_cpu_ids ||
+	    cpu == smp_processor_id() || !cpu_online(cpu)) {
+		generic_handle_irq(irq_find_mapping(pp->irq_domain, hwirq));
+		return;
+	}
+
+	writel(bit, status);
+
+	steer = per_cpu_ptr(pp->msi_steer, cpu);
+	set_bit(hwirq, steer->pending);
+	/* -EBUSY means a call is queued and will pick the bit up */
+	smp_call_function_single_async(cpu, &steer->csd);
+}
+
 /* MSI int handler */
 irqreturn_t rtd_handle_mac_msi_irq(struct rtd_pcie_port *pp)
 {
-	int i, pos, irq;
+	int i, pos;
 	unsigned long val;
 	u32 status, num_ctrls;
+	void __iomem *reg;
 	irqreturn_t ret = IRQ_NONE;
 
 	num_ctrls = RTK_MAX_MSI_IRQS / RTK_MAX_MSI_IRQS_PER_CTRL;
 
 	for (i = 0; i < num_ctrls; i++) {
-		status = readl(pp->ctrl_base + PCIE_MSI_INTR0_STATUS +
-					(i * RTK_MSI_REG_CTRL_BLOCK_SIZE));
+		reg = pp->ctrl_base + PCIE_MSI_INTR0_STATUS +
+					(i * RTK_MSI_REG_CTRL_BLOCK_SIZE);
+		status = readl(reg);
 		if (!status)
 			continue;
 
@@ -90,10 +139,9 @@ irqreturn_t rtd_handle_mac_msi_irq(struct rtd_pcie_port *pp)
 		pos = 0;
 		while ((pos = find_next_bit(&val, RTK_MAX_MSI_IRQS_PER_CTRL,
 					    pos)) != RTK_MAX_MSI_IRQS_PER_CTRL) {
-			irq = irq_find_mapping(pp->irq_domain,
-					       (i * RTK_MAX_MSI_IRQS_PER_CTRL) +
-					       pos);
-			generic_handle_irq(irq);
+			rtd_pcie_msi_dispatch(pp,
+					      (i * RTK_MAX_MSI_IRQS_PER_CTRL) + pos,
+					      reg, BIT(pos));
 			pos++;
 		}
 	}
@@ -140,16 +188,17 @@ irqreturn_t rtd_handle_wrapper_msi_irq(struct rtd_pcie_port *pp)
 
 irqreturn_t rtd_handle_wrapper_msix_irq(struct rtd_pcie_port *pp)
 {
-	int i, pos, irq;
+	int i, pos;
 	unsigned long val;
 	u32 status, num_ctrls;
+	void __iomem *reg;
 	irqreturn_t ret = IRQ_NONE;
 
 	num_ctrls = RTK_MSIX_DEF_NUM_VECTORS / RTK_MAX_MSIX_IRQS_PER_CTRL;
 
 	for (i = 0; i < num_ctrls; i++) {
-		status = readl(pp->ctrl_base + PCIE_MSIX_0 +
-					(i * 0x4));
+		reg = pp->ctrl_base + PCIE_MSIX_0 + (i * 0x4);
+		status = readl(reg);
 		if (!status)
 			continue;
 
@@ -158,10 +207,9 @@ irqreturn_t rtd_handle_wrapper_msix_irq(struct rtd_pcie_port *pp)
 		pos = 0;
 		while ((pos = find_next_bit(&val, RTK_MAX_MSIX_IRQS_PER_CTRL,
 					    pos)) != RTK_MAX_MSIX_IRQS_PER_CTRL) {
-			irq = irq_find_mapping(pp->irq_domain,
-					       (i * RTK_MAX_MSIX_IRQS_PER_CTRL) +
-					       pos);
-			generic_handle_irq(irq);
+			rtd_pcie_msi_dispatch(pp,
+					      (i * RTK_MAX_MSIX_IRQS_PER_CTRL) + pos,
+					      reg, BIT(pos));
 			pos++;
 		}
 	}
@@ -214,6 +262,29 @@ static int rtd_pci_msi_set_affinity(struct irq_data *d,
 		return -EINVAL;
 }
 
+/* Moves one vector only; the parent line and MSI message stay as they are. */
+static int rtd_pci_msi_steer_affinity(struct irq_data *d,
+				      const struct cpumask *mask, bool force)
+{
+	struct rtd_pcie_port *pp = irq_data_get_irq_chip_data(d);
+	unsigned int cpu;
+
+	if (!pp->msi_steer)
+		return rtd_pci_msi_set_affinity(d, mask, force);
+
+	if (force)
+		cpu = cpumask_first(mask);
+	else
+		cpu = cpumask_first_and(mask, cpu_online_mask);
+	if (cpu >= nr_cpu_ids)
+		return -EINVAL;
+
+	WRITE_ONCE(pp->msi_cpu[d->hwirq], cpu);
+	irq_data_update_effective_affinity(d, cpumask_of(cpu));
+
+	return IRQ_SET_MASK_OK_DONE;
+}
+
 static void rtd_pci_mac_bottom_mask(struct irq_data *d)
 {
 	struct rtd_pcie_port *pp = irq_data_get_irq_chip_data(d);
@@ -268,7 +339,7 @@ static struct irq_chip rtd_pci_mac_msi_bottom_irq_chip = {
 	.name = "RTD_PCI-MSI",
 	.irq_ack = rtd_pci_mac_bottom_ack,
 	.irq_compose_msi_msg = rtd_pci_setup_msi_msg,
-	.irq_set_affinity = rtd_pci_msi_set_affinity,
+	.irq_set_affinity = rtd_pci_msi_steer_affinity,
 	.irq_mask = rtd_pci_mac_bottom_mask,
 	.irq_unmask = rtd_pci_mac_bottom_unmask,
 };
@@ -375,7 +446,7 @@ static struct irq_chip rtd_pci_wrapper_msix_bottom_irq_chip = {
 	.name = "RTD_PCI-MSI",
 	.irq_ack = rtd_pci_wrapper_msix_bottom_ack,
 	.irq_compose_msi_msg = rtd_pci_setup_msix_msg,
-	.irq_set_affinity = rtd_pci_msi_set_affinity,
+	.irq_set_affinity = rtd_pci_msi_steer_affinity,
 	.irq_mask = rtd_pci_wrapper_msix_bottom_mask,
 	.irq_unmask = rtd_pci_wrapper_msix_bottom_unmask,
 };
@@ -433,6 +504,8 @@ static const struct irq_domain_ops rtd_pcie_msi_domain_ops = {
 int rtd_pcie_allocate_domains(struct rtd_pcie_port *pp)
 {
 	struct fwnode_handle *fwnode = of_node_to_fwnode(pp->dev->of_node);
+	struct rtd_pcie_msi_steer *steer;
+	int cpu;
 
 	pp->irq_domain = irq_domain_create_linear(fwnode, pp->msi_max_vector,
 					       &rtd_pcie_msi_domain_ops, pp);
@@ -452,6 +525,17 @@ int rtd_pcie_allocate_domains(struct rtd_pcie_port *pp)
 		return -ENOMEM;
 	}
 
+	/* without it every vector is demuxed on the parent's CPU as before */
+	memset(pp->msi_cpu, 0xff, sizeof(pp->msi_cpu));
+	pp->msi_steer = alloc_percpu(struct rtd_pcie_msi_steer);
+	if (pp->msi_steer) {
+		for_each_possible_cpu(cpu) {
+			steer = per_cpu_ptr(pp->msi_steer, cpu);
+			steer->pp = pp;
+			INIT_CSD(&steer->csd, rtd_pcie_msi_steer_func, steer);
+		}
+	}
+
 	return 0;
 }
 
@@ -465,6 +549,9 @@ void rtd_pcie_free_msi(struct rtd_pcie_port *pp)
 	irq_domain_remove(pp->msi_domain);
 	irq_domain_remove(pp->irq_domain);
 
+	free_percpu(pp->msi_steer);
+	pp->msi_steer = NULL;
+
 	if (pp->msi_page)
 		__free_page(pp->msi_page);
 }
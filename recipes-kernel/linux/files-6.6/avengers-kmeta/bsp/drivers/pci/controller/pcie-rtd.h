@@ -78,6 +78,8 @@ struct rtd_pcie_port {
 	struct irq_chip *msi_irq_chip;
 	raw_spinlock_t lock;
 	DECLARE_BITMAP(irq_bitmap, RTK_MAX_MSI_IRQS);
+	u16 msi_cpu[RTK_MAX_MSI_IRQS];	/* steering target per hwirq */
+	struct rtd_pcie_msi_steer __percpu *msi_steer;
 	int ca_type;
 };
 
@@ -2,6 +2,9 @@
 /*
  * Realtek uncore PMU driver for Dbus system
  *
+ * It also provides the per-client bandwidth table /dev/<pmu>_top, which
+ * only shows req/s and ack/s: the PMCs count transactions, not bytes.
+ *
  * Copyright (C) 2019-2022 Realtek Semiconductor Corporation
  * Copyright (C) 2019-2022 Ping-Hsiung Chiu <phelic@realtek.com>
  *
@@ -22,9 +25,14 @@
 #define pr_fmt(fmt)	"[RTK_PMU] " fmt
 
 #include <linux/slab.h>
+#include <linux/kref.h>
 #include <linux/of.h>
 #include <linux/of_address.h>
 #include <linux/module.h>
+#include <linux/miscdevice.h>
+#include <linux/poll.h>
+#include <linux/workqueue.h>
+#include <linux/uaccess.h>
 
 #include "rtk_uncore_pmu.h"
 #include "rtk_dbus_pmu.h"
@@ -686,6 +694,492 @@ int rtk_dbus_pmu_init(struct rtk_pmu *pmu, struct device_node *dt,
 }
 EXPORT_SYMBOL(rtk_dbus_pmu_init);
 
+/*
+ * DBUS top: a per-client breakdown of the whole bus.
+ *
+ * Only a few PMC groups exist per domain, so the clients of the SYS and SYSH
+ * domains are measured in round-robin time slices. Each slice opens kernel
+ * counters (acc_lat, max_lat, req_num, ack_num) for as many clients as there
+ * are PMC groups, and the next slice replaces them with the following
+ * clients. Every client is normalised by the time its counters ran, so the
+ * table holds per-second rates.
+ *
+ * This is the per-client bandwidth view, but the DBUS PMCs do not count
+ * bytes: the table only shows req/s and ack/s, next to the average and
+ * maximum latency.
+ *
+ * Counters are only opened while the device is open, and clients whose PMC
+ * group is taken by a perf user are skipped for that slice.
+ *
+ * /dev/<pmu>_top: read() returns the table, poll() reports a new round.
+ * Every open file holds a reference on the top struct, so it outlives an
+ * unbind; the file then sees end of file once its table is consumed.
+ */
+static unsigned int top_slice_ms = 50;
+module_param(top_slice_ms, uint, 0644);
+MODULE_PARM_DESC(top_slice_ms, "Time slice of a client group in DBUS top (ms)");
+
+#define DBUS_TOP_LINE_LEN	96
+
+struct rtk_dbus_top_client {
+	char		*name;
+	u64		config;		/* event config, usage excluded */
+	u64		val[DBUS_PMC__USAGE_NUM];
+	u64		time;		/* ns the counters ran */
+};
+
+struct rtk_dbus_top_set {
+	struct rtk_dbus_top_client *clients;
+	int		nr_clients;
+	int		cursor;		/* next client to be measured */
+	bool		wrapped;	/* all clients measured this round */
+};
+
+struct rtk_dbus_top_slot {
+	struct rtk_dbus_top_client *client;
+	struct perf_event	*events[DBUS_PMC__USAGE_NUM];
+};
+
+struct rtk_dbus_top {
+	struct rtk_pmu		*pmu;
+	struct miscdevice	misc;
+	struct kref		ref;
+	struct mutex		lock;
+	wait_queue_head_t	wq;
+	struct delayed_work	work;
+	int			users;
+	bool			dead;		/* pmu is gone */
+	u64			round;		/* completed rounds */
+
+	struct rtk_dbus_top_set	sets[PMC_SET__DBUS_CH];
+	struct rtk_dbus_top_slot *slots;
+	int			nr_slots;
+	int			max_slots;
+};
+
+struct rtk_dbus_top_file {
+	struct rtk_dbus_top	*top;
+	u64			round;		/* round in buf */
+	size_t			size;
+	size_t			len;
+	size_t			pos;		/* read position in buf */
+	char			buf[];
+};
+
+static void
+rtk_dbus_top_put_slots(struct rtk_dbus_top *top, bool record)
+{
+	struct rtk_dbus_top_slot *slot;
+	u64 val[DBUS_PMC__USAGE_NUM];
+	u64 enabled, running, time = 0;
+	int i, j;
+
+	for (i = 0; i < top->nr_slots; i++) {
+		slot = &top->slots[i];
+
+		for (j = 0; j < DBUS_PMC__USAGE_NUM; j++) {
+			val[j] = perf_event_read_value(slot->events[j],
+						       &enabled, &running);
+			time = j ? min(time, running) : running;
+			perf_event_release_kernel(slot->events[j]);
+		}
+
+		/* the PMC group was busy for the whole slice */
+		if (record && time) {
+			memcpy(slot->client->val, val, sizeof(val));
+			slot->client->time = time;
+		}
+	}
+
+	top->nr_slots = 0;
+}
+
+static int
+rtk_dbus_top_get_slot(struct rtk_dbus_top *top,
+		      struct rtk_dbus_top_client *client)
+{
+	struct rtk_dbus_top_slot *slot = &top->slots[top->nr_slots];
+	struct perf_event_attr attr = {
+		.type	= top->pmu->pmu.type,
+		.size	= sizeof(attr),
+	};
+	int cpu = cpumask_first(&top->pmu->cpus);
+	int i;
+
+	for (i = 0; i < DBUS_PMC__USAGE_NUM; i++) {
+		attr.config = client->config | ((u64)i << USAGE_OFFSET);
+		slot->events[i] = perf_event_create_kernel_counter(&attr, cpu,
+								   NULL, NULL,
+								   NULL);
+		if (IS_ERR(slot->events[i])) {
+			int ret = PTR_ERR(slot->events[i]);
+
+			while (i--)
+				perf_event_release_kernel(slot->events[i]);
+			return ret;
+		}
+	}
+
+	slot->client = client;
+	top->nr_slots++;
+
+	return 0;
+}
+
+/* open counters for the next clients of each domain */
+static void
+rtk_dbus_top_next_slice(struct rtk_dbus_top *top)
+{
+	struct rtk_dbus_top_set *ts;
+	int set, n, quota;
+
+	for (set = 0; set < ARRAY_SIZE(top->sets); set++) {
+		ts = &top->sets[set];
+		quota = min(top->pmu->pmcss[set]->meta->nr_pmcgs,
+			    ts->nr_clients);
+
+		for (n = 0; n < quota; n++) {
+			/* an unusable client keeps its last values */
+			rtk_dbus_top_get_slot(top, &ts->clients[ts->cursor]);
+
+			if (++ts->cursor == ts->nr_clients) {
+				ts->cursor = 0;
+				ts->wrapped = true;
+			}
+		}
+	}
+
+	for (set = 0; set < ARRAY_SIZE(top->sets); set++) {
+		if (top->sets[set].nr_clients && !top->sets[set].wrapped)
+			return;
+	}
+
+	for (set = 0; set < ARRAY_SIZE(top->sets); set++)
+		top->sets[set].wrapped = false;
+
+	top->round++;
+	wake_up_interruptible(&top->wq);
+}
+
+static void
+rtk_dbus_top_work(struct work_struct *work)
+{
+	struct rtk_dbus_top *top = container_of(to_delayed_work(work),
+						struct rtk_dbus_top, work);
+
+	mutex_lock(&top->lock);
+
+	if (top->users && !top->dead) {
+		rtk_dbus_top_put_slots(top, true);
+		rtk_dbus_top_next_slice(top);
+		schedule_delayed_work(&top->work,
+				      msecs_to_jiffies(max(top_slice_ms, 1U)));
+	}
+
+	mutex_unlock(&top->lock);
+}
+
+static size_t
+rtk_dbus_top_show(struct rtk_dbus_top *top, char *buf, size_t size)
+{
+	static const char * const set_name[] = {
+		[PMC_SET__DBUS_SYS] = "sys",
+		[PMC_SET__DBUS_SYSH] = "sysh",
+	};
+	struct rtk_dbus_top_client *client;
+	size_t len;
+	int set, i;
+
+	len = scnprintf(buf, size, "round %llu, slice %u ms\n%-12s %-5s %12s %12s %10s %10s\n",
+			top->round, top_slice_ms, "client", "set",
+			"req/s", "ack/s", "avg_lat", "max_lat");
+
+	for (set = 0; set < ARRAY_SIZE(top->sets); set++) {
+		for (i = 0; i < top->sets[set].nr_clients; i++) {
+			client = &top->sets[set].clients[i];
+
+			if (!client->time) {
+				len += scnprintf(buf + len, size - len,
+						 "%-12s %-5s %12s %12s %10s %10s\n",
+						 client->name, set_name[set],
+						 "-", "-", "-", "-");
+				continue;
+			}
+
+			len += scnprintf(buf + len, size - len,
+					 "%-12s %-5s %12llu %12llu %10llu %10llu\n",
+					 client->name, set_name[set],
+					 div64_u64(client->val[DBUS_PMC__REQ_NUM] * NSEC_PER_SEC,
+						   client->time),
+					 div64_u64(client->val[DBUS_PMC__ACK_NUM] * NSEC_PER_SEC,
+						   client->time),
+					 div64_u64(client->val[DBUS_PMC__ACC_LAT],
+						   max_t(u64, client->val[DBUS_PMC__REQ_NUM], 1)),
+					 client->val[DBUS_PMC__MAX_LAT]);
+		}
+	}
+
+	return len;
+}
+
+static void
+rtk_dbus_top_free(struct rtk_dbus_top *top)
+{
+	int set, i;
+
+	for (set = 0; set < ARRAY_SIZE(top->sets); set++) {
+		for (i = 0; i < top->sets[set].nr_clients; i++)
+			kfree(top->sets[set].clients[i].name);
+		kfree(top->sets[set].clients);
+	}
+
+	kfree(top->slots);
+	kfree(top->misc.name);
+	kfree(top);
+}
+
+static void
+rtk_dbus_top_kref_release(struct kref *ref)
+{
+	rtk_dbus_top_free(container_of(ref, struct rtk_dbus_top, ref));
+}
+
+static int
+rtk_dbus_top_open(struct inode *inode, struct file *file)
+{
+	struct rtk_dbus_top *top = container_of(file->private_data,
+						struct rtk_dbus_top, misc);
+	struct rtk_dbus_top_file *tf;
+	size_t size = DBUS_TOP_LINE_LEN * 2;
+	int set;
+
+	for (set = 0; set < ARRAY_SIZE(top->sets); set++)
+		size += DBUS_TOP_LINE_LEN * top->sets[set].nr_clients;
+
+	tf = kzalloc(struct_size(tf, buf, size), GFP_KERNEL);
+	if (!tf)
+		return -ENOMEM;
+
+	/* misc_open() runs under misc_mtx, so this cannot race with exit */
+	kref_get(&top->ref);
+	tf->top = top;
+	tf->size = size;
+	file->private_data = tf;
+
+	mutex_lock(&top->lock);
+	tf->round = top->round;
+	if (top->users++ == 0) {
+		rtk_dbus_top_next_slice(top);
+		mod_delayed_work(system_wq, &top->work,
+				 msecs_to_jiffies(max(top_slice_ms, 1U)));
+	}
+	mutex_unlock(&top->lock);
+
+	return stream_open(inode, file);
+}
+
+static int
+rtk_dbus_top_release(struct inode *inode, struct file *file)
+{
+	struct rtk_dbus_top_file *tf = file->private_data;
+	struct rtk_dbus_top *top = tf->top;
+
+	mutex_lock(&top->lock);
+	if (--top->users == 0 && !top->dead)
+		rtk_dbus_top_put_slots(top, false);
+	mutex_unlock(&top->lock);
+
+	kref_put(&top->ref, rtk_dbus_top_kref_release);
+	kfree(tf);
+
+	return 0;
+}
+
+static ssize_t
+rtk_dbus_top_read(struct file *file, char __user *ubuf, size_t count,
+		  loff_t *ppos)
+{
+	struct rtk_dbus_top_file *tf = file->private_data;
+	struct rtk_dbus_top *top = tf->top;
+	int ret;
+
+	/* a table per round, wait for the next one once this is consumed */
+	if (tf->pos == tf->len) {
+		if (READ_ONCE(top->round) == tf->round) {
+			if (READ_ONCE(top->dead))
+				return 0;
+			if (file->f_flags & O_NONBLOCK)
+				return -EAGAIN;
+
+			ret = wait_event_interruptible(top->wq,
+				READ_ONCE(top->round) != tf->round ||
+				READ_ONCE(top->dead));
+			if (ret)
+				return ret;
+			if (READ_ONCE(top->round) == tf->round)
+				return 0;
+		}
+
+		mutex_lock(&top->lock);
+		tf->round = top->round;
+		tf->len = rtk_dbus_top_show(top, tf->buf, tf->size);
+		tf->pos = 0;
+		mutex_unlock(&top->lock);
+	}
+
+	count = min(count, tf->len - tf->pos);
+	if (copy_to_user(ubuf, tf->buf + tf->pos, count))
+		return -EFAULT;
+
+	tf->pos += count;
+
+	return count;
+}
+
+static __poll_t
+rtk_dbus_top_poll(struct file *file, poll_table *wait)
+{
+	struct rtk_dbus_top_file *tf = file->private_data;
+	struct rtk_dbus_top *top = tf->top;
+
+	poll_wait(file, &top->wq, wait);
+
+	if (tf->pos < tf->len || READ_ONCE(top->round) != tf->round)
+		return EPOLLIN | EPOLLRDNORM;
+	if (READ_ONCE(top->dead))
+		return EPOLLHUP;
+
+	return 0;
+}
+
+static const struct file_operations rtk_dbus_top_fops = {
+	.owner		= THIS_MODULE,
+	.open		= rtk_dbus_top_open,
+	.release	= rtk_dbus_top_release,
+	.read		= rtk_dbus_top_read,
+	.poll		= rtk_dbus_top_poll,
+	.llseek		= no_llseek,
+};
+
+/* the event name without the usage suffix, e.g. "vo1" of "vo1_ack_num" */
+static char *
+rtk_dbus_top_client_name(struct rtk_pmu *pmu, u64 config, unsigned int target)
+{
+	const struct attribute_group *grp =
+		pmu->attr_groups[RTK_PMU_ATTR_GROUP__EVENT];
+	struct perf_pmu_events_attr *attr;
+	const char *name;
+	size_t len;
+	int i;
+
+	for (i = 0; grp && grp->attrs[i]; i++) {
+		attr = container_of(grp->attrs[i], struct perf_pmu_events_attr,
+				    attr.attr);
+		name = attr->attr.attr.name;
+		len = strlen(name);
+
+		if (attr->id == config && len > 8 &&
+		    !strcmp(name + len - 8, "_ack_num"))
+			return kstrndup(name, len - 8, GFP_KERNEL);
+	}
+
+	return kasprintf(GFP_KERNEL, "%#x", target);
+}
+
+static int
+rtk_dbus_top_init(struct rtk_pmu *pmu)
+{
+	const struct rtk_pmc_set_meta *meta;
+	struct rtk_dbus_top_client *client;
+	struct rtk_dbus_top *top;
+	int set, i, ret;
+
+	top = kzalloc(sizeof(*top), GFP_KERNEL);
+	if (!top)
+		return -ENOMEM;
+
+	top->pmu = pmu;
+	kref_init(&top->ref);
+	mutex_init(&top->lock);
+	init_waitqueue_head(&top->wq);
+	INIT_DELAYED_WORK(&top->work, rtk_dbus_top_work);
+
+	for (set = 0; set < ARRAY_SIZE(top->sets); set++) {
+		meta = pmu->pmcss[set]->meta;
+
+		top->sets[set].clients = kcalloc(meta->nr_clients,
+						 sizeof(*client), GFP_KERNEL);
+		if (!top->sets[set].clients) {
+			ret = -ENOMEM;
+			goto err;
+		}
+
+		for (i = 0; i < meta->nr_clients; i++) {
+			client = &top->sets[set].clients[i];
+			client->config = meta->clients[i] |
+				(set << SET_OFFSET) |
+				((set == PMC_SET__DBUS_SYSH ? DBUS_CH_AUTO : 0) <<
+				 CH_OFFSET);
+			client->name = rtk_dbus_top_client_name(pmu,
+				client->config |
+				(DBUS_PMC__ACK_NUM << USAGE_OFFSET),
+				meta->clients[i]);
+			if (!client->name) {
+				ret = -ENOMEM;
+				goto err;
+			}
+			top->sets[set].nr_clients++;
+		}
+
+		top->max_slots += meta->nr_pmcgs;
+	}
+
+	top->slots = kcalloc(top->max_slots, sizeof(*top->slots), GFP_KERNEL);
+	top->misc.name = kasprintf(GFP_KERNEL, "%s_top", pmu->name);
+	if (!top->slots || !top->misc.name) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	top->misc.minor = MISC_DYNAMIC_MINOR;
+	top->misc.fops = &rtk_dbus_top_fops;
+	top->misc.mode = 0444;
+
+	ret = misc_register(&top->misc);
+	if (ret)
+		goto err;
+
+	pmu->priv = top;
+
+	return 0;
+
+err:
+	rtk_dbus_top_free(top);
+	return ret;
+}
+
+static void
+rtk_dbus_top_exit(struct rtk_pmu *pmu)
+{
+	struct rtk_dbus_top *top = pmu->priv;
+
+	if (!top)
+		return;
+
+	misc_deregister(&top->misc);
+
+	/* files still open keep top, but must not touch the pmu any more */
+	mutex_lock(&top->lock);
+	top->dead = true;
+	rtk_dbus_top_put_slots(top, false);
+	mutex_unlock(&top->lock);
+	cancel_delayed_work_sync(&top->work);
+	wake_up_interruptible(&top->wq);
+
+	kref_put(&top->ref, rtk_dbus_top_kref_release);
+	pmu->priv = NULL;
+}
+
 static const struct of_device_id rtk_pmu_of_device_ids[] = {
 	{
 		.compatible = "realtek,rtk-16xxb-dbus-pmu",
@@ -709,12 +1203,26 @@ static const struct of_device_id rtk_pmu_of_device_ids[] = {
 static int
 rtk_dbus_pmu_probe(struct platform_device *pdev)
 {
-	return rtk_pmu_device_probe(pdev, rtk_pmu_of_device_ids);
+	struct rtk_pmu *pmu;
+	int ret;
+
+	ret = rtk_pmu_device_probe(pdev, rtk_pmu_of_device_ids);
+	if (ret)
+		return ret;
+
+	/* the PMU works without the top interface */
+	pmu = platform_get_drvdata(pdev);
+	if (rtk_dbus_top_init(pmu))
+		pr_warn("%s- no top interface\n", pmu->name);
+
+	return 0;
 }
 
 static int
 rtk_dbus_pmu_remove(struct platform_device *pdev)
 {
+	rtk_dbus_top_exit(platform_get_drvdata(pdev));
+
 	return rtk_pmu_device_remove(pdev);
 }
 
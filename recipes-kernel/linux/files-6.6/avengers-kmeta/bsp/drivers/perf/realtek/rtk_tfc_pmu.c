@@ -486,7 +486,7 @@ rtk_tfc_pmu_init(struct rtk_pmu *pmu, struct device_node *dt,
 	 * Force the corresponding flags to avoid problems when overflow
 	 * property is absent in the dts.
 	 */
-	pmu->pmu.capabilities &= ~PERF_PMU_CAP_NO_INTERRUPT;
+	pmu->flags &= ~RTK_PMU_NO_OVERFLOW_IRQ;
 	pmu->flags |= RTK_PMU_NEED_UPDATE_CTRL;
 
 	/* irq number maybe uninitialized due to missing overflow, try again */
@@ -29,6 +29,10 @@
 #include <linux/slab.h>
 #include <linux/miscdevice.h>
 #include <linux/bitops.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <asm/irq_regs.h>
+#include <soc/realtek/rtk_perf_sample.h>
 
 #include "rtk_uncore_pmu.h"
 
@@ -714,43 +718,123 @@ rtk_event_destroy(struct perf_event *event)
 	}
 }
 
+static inline void
+rtk_pmu_start_hrtimer(struct rtk_pmu *pmu)
+{
+	hrtimer_start(&pmu->hrtimer, ns_to_ktime(pmu->hrtimer_interval),
+		      HRTIMER_MODE_REL_PINNED);
+}
+
+static inline void
+rtk_pmu_stop_hrtimer(struct rtk_pmu *pmu)
+{
+	hrtimer_cancel(&pmu->hrtimer);
+}
+
+static void __rtk_pmu_stop_event(struct perf_event *event, bool sync);
+
+/*
+ * Emit a sample once the sample period of the event has elapsed. period_left
+ * keeps the count at the previous sample, and the sample's period is what
+ * the counter accumulated since then, e.g. the requests a DBUS client issued,
+ * so perf script shows the activity of each client over time.
+ */
 static void
-__ps_update_events(struct rtk_pmc_set *ps)
+rtk_pmu_sample_event(struct rtk_pmc_set *ps, struct perf_event *event,
+		     u64 now, struct pt_regs *regs)
 {
-	struct rtk_pmc_tracking *tracking = ps->tracking;
+	struct hw_perf_event *hwc = &event->hw;
+	struct perf_sample_data data;
+	u64 count;
+
+	if (hwc->state & PERF_HES_STOPPED)
+		return;
+
+	ps->read_pmc(ps, event);
+
+	if (!rtk_perf_sample_due(hwc, now, ps->pmu->hrtimer_interval))
+		return;
+
+	count = local64_read(&event->count);
+	perf_sample_data_init(&data, 0,
+			      count - local64_xchg(&hwc->period_left, count));
+
+	/* throttled, the core restarts the event when it unthrottles */
+	if (regs && perf_event_overflow(event, &data, regs))
+		__rtk_pmu_stop_event(event, false);
+}
+
+static void
+__ps_update_events(struct rtk_pmc_set *ps, u64 now, struct pt_regs *regs)
+{
+	struct rtk_pmc_tracking *tracking;
+	struct perf_event *event;
 	int idx, bit;
 
 	if (ps == NULL)
 		return;
 
+	tracking = ps->tracking;
 	for_each_set_bit(idx, &ps->used_mask, ps->meta->nr_pmcgs) {
 		for_each_set_bit(bit,
 				 &tracking[idx].used_mask,
 				 ps->meta->group_size) {
+			event = tracking[idx].events[bit];
 
-			ps->read_pmc(ps, tracking[idx].events[bit]);
+			if (is_sampling_event(event))
+				rtk_pmu_sample_event(ps, event, now, regs);
+			else if (rtk_pmu_has_no_overflow(ps->pmu))
+				ps->read_pmc(ps, event);
 		}
 	}
 }
 
-static inline void
-rtk_pmu_start_hrtimer(struct rtk_pmu *pmu)
+/*
+ * The hrtimer ticks at the shortest sample period of the running sampling
+ * events, at RTK_UNCORE_HRTIMER_INTERVAL without any. @skip is the event
+ * being stopped.
+ */
+static u64
+rtk_pmu_sample_interval(struct rtk_pmu *pmu, struct perf_event *skip)
 {
-	hrtimer_start(&pmu->hrtimer, ns_to_ktime(pmu->hrtimer_interval),
-		      HRTIMER_MODE_REL_PINNED);
-}
+	u64 interval = RTK_UNCORE_HRTIMER_INTERVAL;
+	struct rtk_pmc_tracking *tracking;
+	struct rtk_pmc_set *ps;
+	struct perf_event *event;
+	int i, idx, bit;
 
-static inline void
-rtk_pmu_stop_hrtimer(struct rtk_pmu *pmu)
-{
-	hrtimer_cancel(&pmu->hrtimer);
+	for (i = 0; i < pmu->nr_pmcss; i++) {
+		ps = pmu->pmcss[i];
+		if (ps == NULL)
+			continue;
+
+		tracking = ps->tracking;
+		for_each_set_bit(idx, &ps->used_mask, ps->meta->nr_pmcgs) {
+			for_each_set_bit(bit,
+					 &tracking[idx].used_mask,
+					 ps->meta->group_size) {
+				event = tracking[idx].events[bit];
+
+				if (event == skip || !is_sampling_event(event) ||
+				    (event->hw.state & PERF_HES_STOPPED))
+					continue;
+
+				interval = min_t(u64, interval,
+						 event->hw.sample_period);
+			}
+		}
+	}
+
+	return interval;
 }
 
 static enum hrtimer_restart
 rtk_pmu_hrtimer(struct hrtimer *hrtimer)
 {
 	struct rtk_pmu *pmu;
+	struct pt_regs *regs = get_irq_regs();
 	unsigned long flags;
+	u64 now = ktime_get_ns();
 	int i;
 
 	pmu = container_of(hrtimer, struct rtk_pmu, hrtimer);
@@ -763,19 +847,30 @@ rtk_pmu_hrtimer(struct hrtimer *hrtimer)
 	 */
 	local_irq_save(flags);
 
-	if (rtk_pmu_has_no_overflow(pmu)) {
-		for (i = 0; i < pmu->nr_pmcss; i++)
-			__ps_update_events(pmu->pmcss[i]);
-	}
+	for (i = 0; i < pmu->nr_pmcss; i++)
+		__ps_update_events(pmu->pmcss[i], now, regs);
 
 	rtk_pmu_kick_tick();
 	local_irq_restore(flags);
 
+	if (!pmu->nr_active)
+		return HRTIMER_NORESTART;
+
 	hrtimer_forward_now(hrtimer, ns_to_ktime(pmu->hrtimer_interval));
 
 	return HRTIMER_RESTART;
 }
 
+/* Sampling is driven by the PMU hrtimer, see rtk_perf_sample.h. */
+static int
+rtk_pmu_sample_init(struct perf_event *event)
+{
+	rtk_perf_sample_init(event, RTK_UNCORE_SAMPLE_MIN_INTERVAL);
+	local64_set(&event->hw.period_left, 0);
+
+	return 0;
+}
+
 static int
 rtk_pmu_event_init(struct perf_event *event)
 {
@@ -791,9 +886,9 @@ rtk_pmu_event_init(struct perf_event *event)
 
 	/*
 	 * Uncore PMU is shared by all cores. It does not support per-process
-	 * and sampling mode.
+	 * mode.
 	 */
-	if (is_sampling_event(event) || event->attach_state & PERF_ATTACH_TASK)
+	if (event->attach_state & PERF_ATTACH_TASK)
 		return -EOPNOTSUPP;
 
 	/* not yet support filter */
@@ -815,11 +910,17 @@ rtk_pmu_event_init(struct perf_event *event)
 	if (event->cpu < 0)
 		return -EINVAL;
 
+	if (is_sampling_event(event)) {
+		err = rtk_pmu_sample_init(event);
+		if (err)
+			return err;
+	}
+
 	event->destroy = rtk_event_destroy;
 	event->cpu = cpumask_first(&pmu->cpus);
 	__reset_hwc(pmu, event);
 
-	if (rtk_pmu_need_hrtimer(pmu)) {
+	if (rtk_pmu_event_need_hrtimer(pmu, event)) {
 		if (pmu->nr_active == 0)
 			pmu->cpu = event->cpu;
 
@@ -860,14 +961,32 @@ rtk_pmu_start_event(struct perf_event *event, int pmu_flags)
 	ps->start_pmc(ps, event);
 	hwc->state = 0;
 
-	if (rtk_pmu_need_hrtimer(pmu) && pmu->nr_active++ == 0)
-		rtk_pmu_start_hrtimer(pmu);
+	if (is_sampling_event(event)) {
+		local64_set(&hwc->period_left, local64_read(&event->count));
+		rtk_perf_sample_start(hwc, ktime_get_ns());
+	}
+
+	if (rtk_pmu_event_need_hrtimer(pmu, event)) {
+		u64 interval = pmu->hrtimer_interval;
+
+		/* tick at the shortest sample period of the active events */
+		if (is_sampling_event(event))
+			pmu->hrtimer_interval = min_t(u64, interval,
+						      hwc->sample_period);
+
+		if (pmu->nr_active++ == 0 || pmu->hrtimer_interval < interval)
+			rtk_pmu_start_hrtimer(pmu);
+	}
 
 	raw_spin_unlock_irqrestore(&ps->ps_lock, flags);
 }
 
+/*
+ * @sync: cancel the hrtimer once no event needs it. Not allowed from the
+ * hrtimer itself, which then stops on its next expiry instead.
+ */
 static void
-rtk_pmu_stop_event(struct perf_event *event, int pmu_flags)
+__rtk_pmu_stop_event(struct perf_event *event, bool sync)
 {
 	struct rtk_pmu *pmu = to_rtk_pmu(event->pmu);
 	struct rtk_pmc_set *ps = pmu->get_pmc_set(pmu, event);
@@ -891,8 +1010,16 @@ rtk_pmu_stop_event(struct perf_event *event, int pmu_flags)
 
 	raw_spin_lock_irqsave(&ps->ps_lock, flags);
 
-	if (rtk_pmu_need_hrtimer(pmu) && --pmu->nr_active == 0)
-		rtk_pmu_stop_hrtimer(pmu);
+	if (rtk_pmu_event_need_hrtimer(pmu, event)) {
+		if (--pmu->nr_active == 0) {
+			pmu->hrtimer_interval = RTK_UNCORE_HRTIMER_INTERVAL;
+			if (sync)
+				rtk_pmu_stop_hrtimer(pmu);
+		} else if (is_sampling_event(event)) {
+			/* slow down again, taken up at the next expiry */
+			pmu->hrtimer_interval = rtk_pmu_sample_interval(pmu, event);
+		}
+	}
 
 	ps->stop_pmc(ps, event);
 	hwc->state = PERF_HES_STOPPED | PERF_HES_UPTODATE;
@@ -900,6 +1027,12 @@ rtk_pmu_stop_event(struct perf_event *event, int pmu_flags)
 	raw_spin_unlock_irqrestore(&ps->ps_lock, flags);
 }
 
+static void
+rtk_pmu_stop_event(struct perf_event *event, int pmu_flags)
+{
+	__rtk_pmu_stop_event(event, true);
+}
+
 static inline void
 rtk_pmu_set_perf_hwc(struct rtk_pmu *pmu, union rtk_pmc_desc pmc,
 		     struct perf_event *event)
@@ -1255,7 +1388,7 @@ int rtk_uncore_pmu_init(struct rtk_pmu *pmu, struct device_node *dt,
 	    !of_property_read_u32(dt, "overflow", &value) && value > 0)
 		pmu->irq = irq_of_parse_and_map(dt, 0);
 	else
-		pmu->pmu.capabilities |= PERF_PMU_CAP_NO_INTERRUPT;
+		pmu->flags |= RTK_PMU_NO_OVERFLOW_IRQ;
 
 	return rtk_pmc_set_init(pmu, dt, meta);
 }
@@ -1341,15 +1474,11 @@ __post_init(struct rtk_pmu *rtk_pmu)
 
 	/*
 	 * Use hrtimer to poll counters to avoid overflow when overflow
-	 * interrupt is unavailable.
+	 * interrupt is unavailable, and to take samples of sampling events.
 	 */
-	if (rtk_pmu_need_hrtimer(rtk_pmu)) {
-		pr_info("%s- init hrtimer\n", rtk_pmu->name);
-		hrtimer_init(&rtk_pmu->hrtimer, CLOCK_MONOTONIC,
-			     HRTIMER_MODE_REL);
-		rtk_pmu->hrtimer.function = rtk_pmu_hrtimer;
-		rtk_pmu->hrtimer_interval = RTK_UNCORE_HRTIMER_INTERVAL;
-	}
+	hrtimer_init(&rtk_pmu->hrtimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	rtk_pmu->hrtimer.function = rtk_pmu_hrtimer;
+	rtk_pmu->hrtimer_interval = RTK_UNCORE_HRTIMER_INTERVAL;
 
 	return 0;
 }
@@ -1472,7 +1601,7 @@ rtk_pmu_device_remove(struct platform_device *pdev)
 	struct rtk_pmu *rtk_pmu = platform_get_drvdata(pdev);
 
 	/* clear the hrtimer */
-	if (rtk_pmu_need_hrtimer(rtk_pmu) && rtk_pmu->nr_active != 0)
+	if (rtk_pmu->nr_active != 0)
 		rtk_pmu_stop_hrtimer(rtk_pmu);
 
 	perf_pmu_unregister(&rtk_pmu->pmu);
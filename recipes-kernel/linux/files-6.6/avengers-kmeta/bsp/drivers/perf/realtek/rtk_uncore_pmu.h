@@ -44,6 +44,9 @@
 #define REFRESH_TH     0x00040000      /* refresh threshold, default 256us */
 
 #define RTK_UNCORE_HRTIMER_INTERVAL	(40LL * NSEC_PER_MSEC)
+
+/* shortest sample period of a sampling event, in ns */
+#define RTK_UNCORE_SAMPLE_MIN_INTERVAL	(100LL * NSEC_PER_USEC)
 #if IS_ENABLED(CONFIG_RTK_PMU_TICK_REFRESH)
 #define rtk_pmu_kick_tick()	perf_event_task_tick()
 #else
@@ -142,6 +145,8 @@ is_valid_pmc(union rtk_pmc_desc pmc)
 
 /* raise update before reading pmc */
 #define RTK_PMU_NEED_UPDATE_CTRL	0x01
+/* no overflow interrupt, counters are polled before they saturate */
+#define RTK_PMU_NO_OVERFLOW_IRQ		0x02
 
 /* Track the use of a PMC group */
 struct rtk_pmc_tracking {
@@ -281,6 +286,7 @@ struct rtk_pmu {
 	u64			hrtimer_interval;	/* hrtimer interval */
 
 	atomic_t		*drv_pmc;		/* driver statistics */
+	void			*priv;			/* PMU specific data */
 
 	/* Enable/disable PMU set */
 	void			(*enable)(struct rtk_pmu *pmu,
@@ -609,7 +615,7 @@ compensate_event(struct rtk_pmc_set *ps, struct perf_event *ev)
 static inline int
 rtk_pmu_has_no_overflow(struct rtk_pmu *pmu)
 {
-	return pmu->pmu.capabilities & PERF_PMU_CAP_NO_INTERRUPT;
+	return pmu->flags & RTK_PMU_NO_OVERFLOW_IRQ;
 }
 
 static inline int
@@ -619,6 +625,13 @@ rtk_pmu_need_hrtimer(struct rtk_pmu *pmu)
 		rtk_pmu_has_no_overflow(pmu);
 }
 
+/* the event is refreshed or sampled from the hrtimer */
+static inline int
+rtk_pmu_event_need_hrtimer(struct rtk_pmu *pmu, struct perf_event *event)
+{
+	return rtk_pmu_need_hrtimer(pmu) || is_sampling_event(event);
+}
+
 static inline int
 rtk_pmu_need_update_ctrl(struct rtk_pmu *pmu)
 {
@@ -26,6 +26,8 @@
 #include <linux/skbuff.h>
 #include <linux/of_reserved_mem.h>
 #include <linux/hwspinlock.h>
+#include <linux/hrtimer.h>
+#include <linux/irq_work.h>
 #include <linux/moduleparam.h>
 #include <linux/remoteproc.h>
 #include "rpmsg_internal.h"
@@ -82,6 +84,36 @@
 #define KR4_AGENT 600
 #define REPLYID 99
 
+/* messages dispatched per channel in one hard interrupt before deferring */
+#define RTK_RPMSG_RX_BUDGET 64
+#define RTK_RPMSG_LAT_BUCKETS 16
+
+#define RTK_RPMSG_RX_BUSY 0
+#define RTK_RPMSG_RX_PENDING 1
+
+#define RTK_RPMSG_DB_BUCKETS 8
+
+static bool threaded_irq;
+module_param(threaded_irq, bool, 0444);
+MODULE_PARM_DESC(threaded_irq, "Dispatch incoming messages from an IRQ thread");
+
+static unsigned int coalesce_us = 50;
+module_param(coalesce_us, uint, 0644);
+MODULE_PARM_DESC(coalesce_us, "Longest time a queued message waits for its doorbell");
+
+static bool loopback;
+module_param(loopback, bool, 0444);
+MODULE_PARM_DESC(loopback, "Register a software remote cpu that answers every request");
+
+static bool loopback_be = true;
+module_param(loopback_be, bool, 0444);
+MODULE_PARM_DESC(loopback_be, "Software remote cpu speaks the big endian ACPU/VCPU format");
+
+#define LOOPBACK_ID 0x7f
+#define LOOPBACK_INFO_SIZE 0x100
+#define LOOPBACK_FIFO_SIZE 0x2000
+#define LOOPBACK_SHM_SIZE (LOOPBACK_INFO_SIZE + 2 * LOOPBACK_FIFO_SIZE)
+
 #define rpc_ringbuf_phys 0x40ff000
 extern void __iomem *rpc_ringbuf_base;
 
@@ -143,8 +175,31 @@ struct rtk_rpmsg_channel {
 	spinlock_t txlock;
 	spinlock_t rxlock;
 	spinlock_t list_lock;
-	void (*handle_data)(unsigned long data);
+	struct rtk_rpmsg_endpoint *(*find_ept)(struct rtk_rpmsg_channel *channel,
+					       struct rpc_struct *rpc, char *data_buf);
+	/* rx_buf is only used by the RX_BUSY owner */
+	unsigned long rx_flags;
+	char *rx_buf;
+	int rx_buf_size;
+	/* first IRQ not yet picked up by a drain pass, in ns, 0 if none */
+	atomic64_t rx_irq_ts;
+	/* RX statistics, protected by rxlock */
+	u64 rx_msgs;
+	u64 rx_drains;
+	u32 rx_max_batch;
+	u32 rx_lat_max_us;
+	u64 rx_lat_hist[RTK_RPMSG_LAT_BUCKETS];
+	/* doorbell coalescing, protected by txlock */
+	struct hrtimer tx_timer;
+	u32 tx_queued;
+	ktime_t tx_last;
+	s64 tx_gap_avg_us;
+	u64 tx_msgs;
+	u64 tx_doorbells;
+	u32 tx_max_batch;
+	u64 tx_db_hist[RTK_RPMSG_DB_BUCKETS];
 	struct dentry *debugfs_node;
+	struct dentry *stats_node;
 	struct idr ept_ids;
 	struct mutex ept_ids_lock;
 	int use_idr;
@@ -180,6 +235,20 @@ struct rtk_rcpu {
 	int status;
 	struct rtk_rpmsg_device *rtk_rpdev;
 	struct rproc *rproc;
+	struct rtk_rpmsg_loopback *lb;
+};
+
+/*
+ * Software stand-in for a remote cpu: the shared rings live in kernel
+ * memory, remote_work plays the firmware and irq_work raises its interrupt.
+ */
+struct rtk_rpmsg_loopback {
+	struct rtk_rcpu *rcpu;
+	void *shm;
+	struct work_struct remote_work;
+	struct irq_work irq_work;
+	struct work_struct thread_work;
+	char msg[LOOPBACK_FIFO_SIZE];
 };
 
 struct rtk_rpmsg_device {
@@ -199,6 +268,14 @@ struct rtk_rpmsg_endpoint {
 #define to_rtk_rpdevice(_rpdev)	container_of(_rpdev, struct rtk_rpmsg_device, rpdev)
 #define to_rtk_ept(_ept) container_of(_ept, struct rtk_rpmsg_endpoint, ept)
 
+static void __iomem *rtk_ringbuf_phys_to_virt(struct rtk_rcpu *rcpu, u32 phys)
+{
+	if (rcpu->lb)
+		return (void __iomem *)(rcpu->lb->shm + (phys - rpc_ringbuf_phys));
+
+	return ringbuf_phys_to_virt(phys);
+}
+
 void endian_swap_32_read(void *buf, size_t size)
 {
 	unsigned int *pData = (unsigned int *) buf;
@@ -255,7 +332,11 @@ static void print_rpc_struct(struct rtk_rpmsg_channel *channel, char *buf)
 			rpc->programID, rpc->versionID, rpc->procedureID, rpc->taskID, rpc->sysTID, rpc->sysPID, rpc->parameterSize, rpc->mycontext);
 }
 
-static char *get_ring_data(struct rtk_rpmsg_channel *channel, int *retSize, struct rpc_struct *rpc)
+/*
+ * Copy the next message of the RX ring into channel->rx_buf and return its
+ * size, or -ENODATA when the ring is empty.
+ */
+static int get_ring_data(struct rtk_rpmsg_channel *channel, struct rpc_struct *rpc)
 {
 	int size;
 	int tail;
@@ -263,7 +344,7 @@ static char *get_ring_data(struct rtk_rpmsg_channel *channel, int *retSize, stru
 	volatile uint32_t *ringIn, *ringOut, *ringStart, *ringEnd;
 	int ringSize;
 	int rpc_size = sizeof(struct rpc_struct);
-	char *buf;
+	char *buf = channel->rx_buf;
 	char *tmp = (char *)rpc;
 	uint32_t ring_tmp;
 	struct rpc_shm_info *rx_info = &channel->rx_info;
@@ -286,13 +367,16 @@ static char *get_ring_data(struct rtk_rpmsg_channel *channel, int *retSize, stru
 		ringEnd = &rx_info->av->ringEnd;
 	}
 
+	if (*ringIn == *ringOut)
+		return -ENODATA;
+
 	ringSize = *ringEnd - *ringStart;
 	size = (ringSize + *ringIn - *ringOut) % ringSize;
 	out_offset = *ringOut - *ringStart;
 
 	if (size < rpc_size) {
 		dev_err(channel->rcpu->dev, "[%s] wrong rpc data size:0x%x\n", __func__, size);
-		return ERR_PTR(-EINVAL);
+		return -EINVAL;
 	}
 	tail = *ringEnd - *ringOut;
 
@@ -307,16 +391,9 @@ static char *get_ring_data(struct rtk_rpmsg_channel *channel, int *retSize, stru
 		convert_rpc_struct(rpc);
 
 	data_size = rpc_size + rpc->parameterSize;
-	*retSize = data_size;
-	buf = kmalloc(data_size, GFP_ATOMIC);
-	if (buf == NULL) {
-		dev_err(channel->rcpu->dev, "[%s]cannot allocte buf\n", __func__);
-		return ERR_PTR(-ENOMEM);
-	}
-	if (size < data_size) {
+	if (size < data_size || data_size > channel->rx_buf_size) {
 		dev_err(channel->rcpu->dev, "[%s]rpc size not match. buf_size:0x%x  data_size:0x%x parameter_size:0x%x\n", __func__, size, data_size, rpc->parameterSize);
-		kfree(buf);
-		return ERR_PTR(-EINVAL);
+		return -EINVAL;
 	}
 
 	if (tail >= data_size) {
@@ -332,246 +409,263 @@ static char *get_ring_data(struct rtk_rpmsg_channel *channel, int *retSize, stru
 		*ringOut = *ringStart + ((data_size - tail + 3) & 0xfffffffc);
 	}
 
-	return buf;
+	return data_size;
 }
 
-void handle_intr_data(unsigned long data)
+static uint32_t rpc_reply_pid(struct rtk_rpmsg_channel *channel, struct rpc_struct *rpc,
+			      char *data_buf)
 {
-	struct rtk_rpmsg_channel *channel = (struct rtk_rpmsg_channel *)data;
-	struct rtk_rpmsg_endpoint *rtk_ept = NULL;
-	struct device *dev = channel->rcpu->dev;
-	unsigned long flags;
-	int data_size = 0;
-	struct rpc_struct rpc;
-	char *buf;
-	char *data_buf;
-	uint32_t pid = 0;
-	uint32_t addr = 0;
-	struct list_head *list;
-	struct task_struct *task;
-	volatile uint32_t *ringIn, *ringOut, *ringStart, *ringEnd;
-
-	if (channel->id == HIFI_ID || channel->id == HIFI1_ID) {
-		ringIn = &channel->rx_info.hifi->ringIn;
-		ringOut = &channel->rx_info.hifi->ringOut;
-		ringStart = &channel->rx_info.hifi->ringStart;
-		ringEnd = &channel->rx_info.hifi->ringEnd;
-	} else if (channel->id == KR4_ID) {
-		ringIn = &channel->rx_info.kr4->ringIn;
-		ringOut = &channel->rx_info.kr4->ringOut;
-		ringStart = &channel->rx_info.kr4->ringStart;
-		ringEnd = &channel->rx_info.kr4->ringEnd;
-	} else {
-		ringIn = &channel->rx_info.av->ringIn;
-		ringOut = &channel->rx_info.av->ringOut;
-		ringStart = &channel->rx_info.av->ringStart;
-		ringEnd = &channel->rx_info.av->ringEnd;
-	}
-
-	spin_lock_irqsave(&channel->rxlock, flags);
-	if (*ringIn == *ringOut) {
-		spin_unlock_irqrestore(&channel->rxlock, flags);
-		return;
-	}
-	dev_dbg(dev, "[%s]before channel:%s  In:0x%x  Out:0x%x\n", __func__, channel->name, *ringIn, *ringOut);
-	buf = get_ring_data(channel, &data_size, &rpc);
-	if (IS_ERR(buf)) {
-		dev_err(dev, "[%s]cannot get ring buffer data\n", __func__);
-		spin_unlock_irqrestore(&channel->rxlock, flags);
-		return;
+	switch (rpc->programID) {
+	case AUDIO_AGENT:
+	case VIDEO_AGENT:
+	case VENC_AGENT:
+	case HIFI_AGENT:
+	case KR4_AGENT:
+		return rpc->sysPID;
+	case REPLYID:
+		if (channel->rcpu->info->big_endian)
+			return ntohl(*((uint32_t *)data_buf));
+		return *((uint32_t *)data_buf);
+	default:
+		return 0;
 	}
-	dev_dbg(dev, "[%s]after channel:%s  In:0x%x  Out:0x%x\n", __func__, channel->name, *ringIn, *ringOut);
-	spin_unlock_irqrestore(&channel->rxlock, flags);
-
-	print_rpc_struct(channel, buf);
-
-	data_buf = (buf + sizeof(struct rpc_struct));
+}
 
-	switch (rpc.programID) {
+static bool rpc_program_supported(uint32_t program_id)
+{
+	switch (program_id) {
 	case R_PROGRAM:
-		break;
 	case AUDIO_AGENT:
 	case VIDEO_AGENT:
 	case VENC_AGENT:
 	case HIFI_AGENT:
 	case KR4_AGENT:
-		pid = rpc.sysPID;
-		break;
 	case REPLYID:
-		if (channel->rcpu->info->big_endian)
-			pid = ntohl(*((uint32_t *)data_buf));
-		else
-			pid = *((uint32_t *)data_buf);
-		break;
-
+		return true;
 	default:
-		dev_err(dev, "[%s]unsupport programID:%d\n", __func__, rpc.programID);
-		goto error;
+		return false;
 	}
+}
 
-	if (rpc.programID == R_PROGRAM) {
-		spin_lock_irqsave(&channel->list_lock, flags);
-		list_for_each(list, &channel->rtk_ept_lists) {
-			rtk_ept = list_entry(list, struct rtk_rpmsg_endpoint, list);
-			if (rtk_ept->ept.priv != NULL && *(int *)rtk_ept->ept.priv == REMOTE_ALLOC) {
-				dev_dbg(dev, "[%s]find rtk_ept(remote_alloc)\n", __func__);
-				break;
-			}
+static struct rtk_rpmsg_endpoint *find_ept_by_addr(struct rtk_rpmsg_channel *channel,
+						    uint32_t addr)
+{
+	struct rtk_rpmsg_endpoint *rtk_ept;
+	unsigned long flags;
 
-			rtk_ept = NULL;
+	spin_lock_irqsave(&channel->list_lock, flags);
+	list_for_each_entry(rtk_ept, &channel->rtk_ept_lists, list) {
+		if (rtk_ept->ept.addr == addr) {
+			spin_unlock_irqrestore(&channel->list_lock, flags);
+			return rtk_ept;
 		}
-		spin_unlock_irqrestore(&channel->list_lock, flags);
+	}
+	spin_unlock_irqrestore(&channel->list_lock, flags);
 
-	} else {
-		task = pid_task(find_pid_ns(pid, &init_pid_ns), PIDTYPE_PID);
+	return NULL;
+}
 
-		if (task == NULL) {
-			dev_err(dev, "[%s]cannot find task by pid :%d\n", __func__, pid);
-			goto error;
-		}
-		addr = task->tgid;
+/* Endpoints of user space channels are keyed by the tgid of the caller. */
+static struct rtk_rpmsg_endpoint *intr_find_ept(struct rtk_rpmsg_channel *channel,
+						 struct rpc_struct *rpc, char *data_buf)
+{
+	struct rtk_rpmsg_endpoint *rtk_ept;
+	struct device *dev = channel->rcpu->dev;
+	struct task_struct *task;
+	unsigned long flags;
+	uint32_t pid;
+	uint32_t addr;
+
+	if (rpc->programID == R_PROGRAM) {
 		spin_lock_irqsave(&channel->list_lock, flags);
-		list_for_each(list, &channel->rtk_ept_lists) {
-			rtk_ept = list_entry(list, struct rtk_rpmsg_endpoint, list);
-			if (rtk_ept->ept.addr == addr) {
-				dev_dbg(dev, "[%s]find rtk_ept addr:0x%x\n", __func__, rtk_ept->ept.addr);
-				break;
+		list_for_each_entry(rtk_ept, &channel->rtk_ept_lists, list) {
+			if (rtk_ept->ept.priv != NULL && *(int *)rtk_ept->ept.priv == REMOTE_ALLOC) {
+				dev_dbg(dev, "[%s]find rtk_ept(remote_alloc)\n", __func__);
+				spin_unlock_irqrestore(&channel->list_lock, flags);
+				return rtk_ept;
 			}
-
-			rtk_ept = NULL;
 		}
 		spin_unlock_irqrestore(&channel->list_lock, flags);
+		dev_err(dev, "[%s] cannnot find remote_alloc ept\n", __func__);
+		return NULL;
 	}
 
+	pid = rpc_reply_pid(channel, rpc, data_buf);
 
+	rcu_read_lock();
+	task = pid_task(find_pid_ns(pid, &init_pid_ns), PIDTYPE_PID);
+	addr = task ? task->tgid : 0;
+	rcu_read_unlock();
 
-	if (rtk_ept == NULL) {
-		dev_err(dev, "[%s] cannnot find ept by addr 0x%x, programID=%d\n",
-			__func__, addr, rpc.programID);
-		goto error;
+	if (!task) {
+		dev_err(dev, "[%s]cannot find task by pid :%d\n", __func__, pid);
+		return NULL;
 	}
 
-	rtk_ept->ept.cb(rtk_ept->ept.rpdev, buf, data_size, rtk_ept->ept.priv, RPMSG_ADDR_ANY);
+	rtk_ept = find_ept_by_addr(channel, addr);
+	if (!rtk_ept)
+		dev_err(dev, "[%s] cannnot find ept by addr 0x%x, programID=%d\n",
+			__func__, addr, rpc->programID);
 
-	kfree(buf);
+	return rtk_ept;
+}
 
-	if (*ringIn != *ringOut)
-		tasklet_schedule(&channel->tasklet);
+/* Endpoints of kernel channels are keyed by their idr id. */
+static struct rtk_rpmsg_endpoint *kern_find_ept(struct rtk_rpmsg_channel *channel,
+						 struct rpc_struct *rpc, char *data_buf)
+{
+	struct rtk_rpmsg_endpoint *rtk_ept;
+	uint32_t addr = rpc_reply_pid(channel, rpc, data_buf);
 
-	return;
+	rtk_ept = find_ept_by_addr(channel, addr);
+	if (!rtk_ept)
+		dev_err(channel->rcpu->dev, "[%s] cannnot find ept by addr 0x%x\n", __func__, addr);
 
-error:
-	kfree(buf);
-	return;
+	return rtk_ept;
 }
 
-void handle_kern_data(unsigned long data)
+static void rtk_rpmsg_rx_account(struct rtk_rpmsg_channel *channel, ktime_t irq_ts)
 {
+	s64 us = ktime_us_delta(ktime_get(), irq_ts);
+	unsigned long flags;
+	int bucket;
 
-	struct rtk_rpmsg_channel *channel = (struct rtk_rpmsg_channel *)data;
-	struct rtk_rpmsg_endpoint *rtk_ept;
+	if (us < 0)
+		us = 0;
+
+	bucket = us ? min_t(int, ilog2(us) + 1, RTK_RPMSG_LAT_BUCKETS - 1) : 0;
+
+	spin_lock_irqsave(&channel->rxlock, flags);
+	channel->rx_lat_hist[bucket]++;
+	if (us > channel->rx_lat_max_us)
+		channel->rx_lat_max_us = min_t(s64, us, U32_MAX);
+	channel->rx_msgs++;
+	spin_unlock_irqrestore(&channel->rxlock, flags);
+}
+
+/*
+ * Dispatch up to @budget messages (all of them if @budget is 0) from the RX
+ * ring. The ring is only locked while a message is copied out, the
+ * endpoint callback runs unlocked on the channel's preallocated buffer.
+ */
+static int rtk_rpmsg_rx_drain(struct rtk_rpmsg_channel *channel, int budget)
+{
 	struct device *dev = channel->rcpu->dev;
+	struct rtk_rpmsg_endpoint *rtk_ept;
 	struct rpc_struct rpc;
-	char *buf;
-	char *data_buf;
 	unsigned long flags;
-	int data_size = 0;
-	uint32_t pid = 0;
-	uint32_t addr;
-	struct list_head *list;
-	volatile uint32_t *ringIn, *ringOut, *ringStart, *ringEnd;
+	ktime_t irq_ts;
+	s64 irq_ns;
+	int data_size;
+	int count = 0;
 
-	if (channel->id == HIFI_ID || channel->id == HIFI1_ID) {
-		ringIn = &channel->rx_info.hifi->ringIn;
-		ringOut = &channel->rx_info.hifi->ringOut;
-		ringStart = &channel->rx_info.hifi->ringStart;
-		ringEnd = &channel->rx_info.hifi->ringEnd;
-	} else if (channel->id == KR4_ID) {
-		ringIn = &channel->rx_info.kr4->ringIn;
-		ringOut = &channel->rx_info.kr4->ringOut;
-		ringStart = &channel->rx_info.kr4->ringStart;
-		ringEnd = &channel->rx_info.kr4->ringEnd;
-	} else {
-		ringIn = &channel->rx_info.av->ringIn;
-		ringOut = &channel->rx_info.av->ringOut;
-		ringStart = &channel->rx_info.av->ringStart;
-		ringEnd = &channel->rx_info.av->ringEnd;
-	}
+	/*
+	 * Latency is measured from the first IRQ since the previous pass, or
+	 * from the start of the pass when it was not triggered by one.
+	 */
+	irq_ns = atomic64_xchg(&channel->rx_irq_ts, 0);
+	irq_ts = irq_ns ? ns_to_ktime(irq_ns) : ktime_get();
 
-	spin_lock_irqsave(&channel->rxlock, flags);
-	if (*ringIn == *ringOut) {
+	while (!budget || count < budget) {
+		spin_lock_irqsave(&channel->rxlock, flags);
+		data_size = get_ring_data(channel, &rpc);
 		spin_unlock_irqrestore(&channel->rxlock, flags);
-		return;
+
+		if (data_size == -ENODATA)
+			break;
+		if (data_size < 0) {
+			dev_err(dev, "[%s]cannot get ring buffer data\n", __func__);
+			break;
+		}
+		count++;
+
+		print_rpc_struct(channel, channel->rx_buf);
+
+		if (!rpc_program_supported(rpc.programID)) {
+			dev_err(dev, "[%s]unsupport programID:%d\n", __func__, rpc.programID);
+			continue;
+		}
+
+		rtk_ept = channel->find_ept(channel, &rpc,
+					    channel->rx_buf + sizeof(struct rpc_struct));
+		if (rtk_ept)
+			rtk_ept->ept.cb(rtk_ept->ept.rpdev, channel->rx_buf, data_size,
+					rtk_ept->ept.priv, RPMSG_ADDR_ANY);
+
+		rtk_rpmsg_rx_account(channel, irq_ts);
 	}
-	dev_dbg(dev, "[%s]before channel:%s  In:0x%x  Out:0x%x\n", __func__, channel->name, *ringIn, *ringOut);
-	buf = get_ring_data(channel, &data_size, &rpc);
-	if (IS_ERR(buf)) {
-		dev_err(dev, "[%s]cannot get ring buffer data\n", __func__);
+
+	if (count) {
+		spin_lock_irqsave(&channel->rxlock, flags);
+		channel->rx_drains++;
+		if (count > channel->rx_max_batch)
+			channel->rx_max_batch = count;
 		spin_unlock_irqrestore(&channel->rxlock, flags);
-		return;
 	}
-	dev_dbg(dev, "[%s]after channel:%s  In:0x%x  Out:0x%x\n", __func__, channel->name, *ringIn, *ringOut);
-	spin_unlock_irqrestore(&channel->rxlock, flags);
-
-	print_rpc_struct(channel, buf);
 
-	data_buf = (buf + sizeof(struct rpc_struct));
-	switch (rpc.programID) {
-	case R_PROGRAM:
-		pid = 0;
-		break;
-	case AUDIO_AGENT:
-	case VIDEO_AGENT:
-	case VENC_AGENT:
-	case HIFI_AGENT:
-	case KR4_AGENT:
-		pid = rpc.sysPID;
-		break;
-	case REPLYID:
-		if (channel->rcpu->info->big_endian)
-			pid = ntohl(*((uint32_t *)data_buf));
-		else
-			pid = *((uint32_t *)data_buf);
+	return count;
+}
 
-		break;
+/*
+ * Only one context drains a channel at a time; a context that finds the
+ * channel busy leaves RX_PENDING set so the owner runs another pass.
+ */
+static void rtk_rpmsg_rx(struct rtk_rpmsg_channel *channel, int budget)
+{
+	set_bit(RTK_RPMSG_RX_PENDING, &channel->rx_flags);
 
-	default:
-		dev_err(dev, "[%s]unsupport programID:%d\n", __func__, rpc.programID);
-		goto error;
-	}
+	while (!test_and_set_bit(RTK_RPMSG_RX_BUSY, &channel->rx_flags)) {
+		int done;
 
-	addr = pid;
+		clear_bit(RTK_RPMSG_RX_PENDING, &channel->rx_flags);
+		done = rtk_rpmsg_rx_drain(channel, budget);
+		clear_bit_unlock(RTK_RPMSG_RX_BUSY, &channel->rx_flags);
 
-	spin_lock_irqsave(&channel->list_lock, flags);
-	list_for_each(list, &channel->rtk_ept_lists) {
-		rtk_ept = list_entry(list, struct rtk_rpmsg_endpoint, list);
-		if (rtk_ept->ept.addr == addr) {
-			dev_dbg(dev, "[%s]find rtk_ept addr:0x%x\n", __func__, rtk_ept->ept.addr);
-			break;
+		if (budget && done >= budget) {
+			tasklet_schedule(&channel->tasklet);
+			return;
 		}
 
-		rtk_ept = NULL;
+		smp_mb__after_atomic();
+		if (!test_bit(RTK_RPMSG_RX_PENDING, &channel->rx_flags))
+			return;
 	}
-	spin_unlock_irqrestore(&channel->list_lock, flags);
+}
 
-	if (rtk_ept == NULL) {
-		dev_err(dev, "[%s] cannnot find ept by addr 0x%x\n", __func__, addr);
-		goto error;
-	}
+static void rtk_rpmsg_rx_tasklet(unsigned long data)
+{
+	struct rtk_rpmsg_channel *channel = (struct rtk_rpmsg_channel *)data;
 
-	rtk_ept->ept.cb(rtk_ept->ept.rpdev, buf, data_size, rtk_ept->ept.priv, RPMSG_ADDR_ANY);
-	kfree(buf);
+	rtk_rpmsg_rx(channel, RTK_RPMSG_RX_BUDGET);
+}
 
-	if (*ringIn != *ringOut)
-		tasklet_schedule(&channel->tasklet);
+static irqreturn_t rtk_rcpu_handle_rx(struct rtk_rcpu *rcpu)
+{
+	struct rtk_rpmsg_channel *channel;
+	s64 now = ktime_to_ns(ktime_get());
 
-	return;
+	list_for_each_entry(channel, &rcpu->channels, list)
+		atomic64_cmpxchg(&channel->rx_irq_ts, 0, now);
 
-error:
-	kfree(buf);
-	return;
+	if (threaded_irq)
+		return IRQ_WAKE_THREAD;
+
+	list_for_each_entry(channel, &rcpu->channels, list)
+		rtk_rpmsg_rx(channel, RTK_RPMSG_RX_BUDGET);
+
+	return IRQ_HANDLED;
 }
 
+static irqreturn_t rtk_rcpu_irq_thread(int irq, void *data)
+{
+	struct rtk_rcpu *rcpu = data;
+	struct rtk_rpmsg_channel *channel;
+
+	list_for_each_entry(channel, &rcpu->channels, list)
+		rtk_rpmsg_rx(channel, 0);
+
+	return IRQ_HANDLED;
+}
 
 static int check_notify_flag(struct rtk_rcpu *rcpu)
 {
@@ -595,7 +689,6 @@ static int check_notify_flag(struct rtk_rcpu *rcpu)
 static irqreturn_t rtk_rcpu_isr(int irq, void *data)
 {
 	struct rtk_rcpu *rcpu = data;
-	struct rtk_rpmsg_channel *channel;
 	uint32_t intr_st;
 
 	regmap_read(rcpu->rcpu_intr_regmap, RPC_SB2_INT_ST, &intr_st);
@@ -607,17 +700,12 @@ static irqreturn_t rtk_rcpu_isr(int irq, void *data)
 
 	regmap_write(rcpu->rcpu_intr_regmap, RPC_SB2_INT_ST, rcpu->info->from_rcpu_intr_bit);
 
-	list_for_each_entry(channel, &rcpu->channels, list) {
-		channel->handle_data((unsigned long)channel);
-	}
-
-	return IRQ_HANDLED;
+	return rtk_rcpu_handle_rx(rcpu);
 }
 
 static irqreturn_t rtk_rcpu_ve3_isr(int irq, void *data)
 {
 	struct rtk_rcpu *rcpu = data;
-	struct rtk_rpmsg_channel *channel;
 	uint32_t intr_st;
 
 	regmap_read(rcpu->rcpu_intr_regmap, 0x88, &intr_st);
@@ -631,11 +719,7 @@ static irqreturn_t rtk_rcpu_ve3_isr(int irq, void *data)
 	regmap_write(rcpu->rcpu_intr_regmap, 0x88, intr_st & (~rcpu->info->from_rcpu_intr_bit));
 	regmap_write(rcpu->rcpu_intr_regmap, 0xe0, 0x0);
 
-	list_for_each_entry(channel, &rcpu->channels, list) {
-		channel->handle_data((unsigned long)channel);
-	}
-
-	return IRQ_HANDLED;
+	return rtk_rcpu_handle_rx(rcpu);
 }
 
 static void rtk_rcpu_release(struct device *dev)
@@ -669,8 +753,39 @@ static void rpmsg_send_ve3_interrupt(struct rtk_rcpu *rcpu)
 
 }
 
+/* Ring the doorbell for everything queued so far. Called with txlock held. */
+static void rtk_rpmsg_kick(struct rtk_rpmsg_channel *channel)
+{
+	int bucket;
+
+	if (!channel->tx_queued)
+		return;
+
+	hrtimer_try_to_cancel(&channel->tx_timer);
+	channel->rcpu->info->send_interrupt(channel->rcpu);
+
+	bucket = min_t(int, ilog2(channel->tx_queued), RTK_RPMSG_DB_BUCKETS - 1);
+	channel->tx_db_hist[bucket]++;
+	channel->tx_doorbells++;
+	if (channel->tx_queued > channel->tx_max_batch)
+		channel->tx_max_batch = channel->tx_queued;
+	channel->tx_queued = 0;
+}
+
+static enum hrtimer_restart rtk_rpmsg_tx_timer(struct hrtimer *timer)
+{
+	struct rtk_rpmsg_channel *channel = container_of(timer, struct rtk_rpmsg_channel, tx_timer);
+	unsigned long flags;
+
+	spin_lock_irqsave(&channel->txlock, flags);
+	rtk_rpmsg_kick(channel);
+	spin_unlock_irqrestore(&channel->txlock, flags);
+
+	return HRTIMER_NORESTART;
+}
+
 static int __rtk_rpmsg_send(struct rtk_rpmsg_channel *channel, const void *data,
-			   int len, bool block)
+			   int len, bool block, bool defer)
 {
 	struct rpc_shm_info *tx_info = &channel->tx_info;
 	int size = 0;
@@ -684,6 +799,7 @@ static int __rtk_rpmsg_send(struct rtk_rpmsg_channel *channel, const void *data,
 	uint32_t ring_tmp;
 	volatile uint32_t *ringIn, *ringOut, *ringStart, *ringEnd;
 	uint32_t in, out;
+	ktime_t now;
 
 	if (channel->rcpu->status == IS_DISCONNECTED) {
 		dev_err(channel->rcpu->dev, "cannot send rpc, remote cpu init failed\n");
@@ -724,6 +840,8 @@ static int __rtk_rpmsg_send(struct rtk_rpmsg_channel *channel, const void *data,
 
 	if (len > size - 1) {
 		dev_err(channel->rcpu->dev, "rpc ring buffer is full(len:0x%x  size:0x%x)\n", len, size);
+		/* let the remote cpu drain what is already queued */
+		rtk_rpmsg_kick(channel);
 		ret = -EAGAIN;
 		goto out;
 	}
@@ -748,7 +866,35 @@ static int __rtk_rpmsg_send(struct rtk_rpmsg_channel *channel, const void *data,
 		*ringIn = *ringStart + ((remain_len + 3) & 0xfffffffc);
 	}
 	ret = count;
-	channel->rcpu->info->send_interrupt(channel->rcpu);
+	channel->tx_queued++;
+	channel->tx_msgs++;
+
+	/*
+	 * A deferred message waits up to coalesce_us for company. Senders that
+	 * are further apart than that, or a ring that is half full, get their
+	 * doorbell right away since waiting would only add latency.
+	 *
+	 * A gap of coalesce_us or more starts a new burst: the average is
+	 * seeded at the threshold, so the first message is sent right away and
+	 * the ones following closely are coalesced, however long the idle time.
+	 */
+	now = ktime_get();
+	if (defer) {
+		s64 gap = ktime_us_delta(now, channel->tx_last);
+
+		if (gap >= coalesce_us)
+			channel->tx_gap_avg_us = coalesce_us;
+		else
+			channel->tx_gap_avg_us += (gap - channel->tx_gap_avg_us) / 8;
+		if (channel->tx_gap_avg_us >= coalesce_us || size - len < ring_buffer_size / 2)
+			defer = false;
+	}
+	channel->tx_last = now;
+
+	if (!defer)
+		rtk_rpmsg_kick(channel);
+	else if (!hrtimer_active(&channel->tx_timer))
+		hrtimer_start(&channel->tx_timer, us_to_ktime(coalesce_us), HRTIMER_MODE_REL);
 
 	dev_dbg(channel->rcpu->dev, "[%s]after write channel name:%s ringIn:0x%x ringOut:0x%x len:0x%x\n", __func__, channel->name, *ringIn, *ringOut, len);
 
@@ -758,6 +904,42 @@ out:
 
 }
 
+/**
+ * rtk_rpmsg_send_queued() - queue a message without ringing the doorbell
+ * @ept: the rpmsg endpoint
+ * @data: payload of message
+ * @len: length of payload
+ *
+ * The message is written to the ring right away, but the remote cpu is only
+ * interrupted by rtk_rpmsg_flush(), by the next regular send on the same
+ * channel or after coalesce_us at the latest.
+ *
+ * Return: number of bytes written on success, negative errno otherwise.
+ */
+int rtk_rpmsg_send_queued(struct rpmsg_endpoint *ept, void *data, int len)
+{
+	struct rtk_rpmsg_endpoint *rtk_ept = to_rtk_ept(ept);
+
+	return __rtk_rpmsg_send(rtk_ept->channel, data, len, false, true);
+}
+EXPORT_SYMBOL_GPL(rtk_rpmsg_send_queued);
+
+/**
+ * rtk_rpmsg_flush() - ring the doorbell for messages queued on @ept's channel
+ * @ept: the rpmsg endpoint
+ */
+void rtk_rpmsg_flush(struct rpmsg_endpoint *ept)
+{
+	struct rtk_rpmsg_endpoint *rtk_ept = to_rtk_ept(ept);
+	struct rtk_rpmsg_channel *channel = rtk_ept->channel;
+	unsigned long flags;
+
+	spin_lock_irqsave(&channel->txlock, flags);
+	rtk_rpmsg_kick(channel);
+	spin_unlock_irqrestore(&channel->txlock, flags);
+}
+EXPORT_SYMBOL_GPL(rtk_rpmsg_flush);
+
 
 void rcpu_set_flag(struct rtk_rcpu *rcpu, uint32_t flag)
 {
@@ -788,6 +970,11 @@ static int rtk_kick_rcpu(struct rtk_rcpu *rcpu)
 	int timeout = 3000;
 	uint32_t intr_en_reg;
 
+	if (rcpu->lb) {
+		rcpu->status = IS_CONNECTED;
+		return 0;
+	}
+
 	if (rcpu->info->id == VE3_ID) {
 		regmap_read(rcpu->rcpu_intr_regmap, RPC_INT_VE3_REG, &intr_en_reg);
 		regmap_write(rcpu->rcpu_intr_regmap, RPC_INT_VE3_REG, rcpu->info->intr_en | intr_en_reg);
@@ -831,7 +1018,7 @@ static int rtk_rpmsg_send(struct rpmsg_endpoint *ept, void *data, int len)
 	struct rtk_rpmsg_endpoint *rtk_ept = to_rtk_ept(ept);
 	struct rtk_rpmsg_channel *channel = rtk_ept->channel;
 
-	return __rtk_rpmsg_send(channel, data, len, false);
+	return __rtk_rpmsg_send(channel, data, len, false, false);
 }
 
 static int rtk_rpmsg_sendto(struct rpmsg_endpoint *ept, void *data, int len, u32 dst)
@@ -839,7 +1026,7 @@ static int rtk_rpmsg_sendto(struct rpmsg_endpoint *ept, void *data, int len, u32
 	struct rtk_rpmsg_endpoint *rtk_ept = to_rtk_ept(ept);
 	struct rtk_rpmsg_channel *channel = rtk_ept->channel;
 
-	return __rtk_rpmsg_send(channel, data, len, false);
+	return __rtk_rpmsg_send(channel, data, len, false, false);
 }
 
 
@@ -848,7 +1035,7 @@ static int rtk_rpmsg_trysend(struct rpmsg_endpoint *ept, void *data, int len)
 	struct rtk_rpmsg_endpoint *rtk_ept = to_rtk_ept(ept);
 	struct rtk_rpmsg_channel *channel = rtk_ept->channel;
 
-	return __rtk_rpmsg_send(channel, data, len, true);
+	return __rtk_rpmsg_send(channel, data, len, true, false);
 }
 
 static int rtk_rpmsg_trysendto(struct rpmsg_endpoint *ept, void *data, int len, u32 dst)
@@ -856,7 +1043,7 @@ static int rtk_rpmsg_trysendto(struct rpmsg_endpoint *ept, void *data, int len,
 	struct rtk_rpmsg_endpoint *rtk_ept = to_rtk_ept(ept);
 	struct rtk_rpmsg_channel *channel = rtk_ept->channel;
 
-	return __rtk_rpmsg_send(channel, data, len, true);
+	return __rtk_rpmsg_send(channel, data, len, true, false);
 }
 
 #if 0
@@ -1051,6 +1238,9 @@ static int rtk_rpc_create_deivce(struct rtk_rpmsg_channel *channel, struct devic
 		return ret;
 	}
 
+	if (!node)
+		return 0;
+
 	ret = of_platform_populate(rpdev->dev.of_node, NULL, NULL, &rpdev->dev);
 	if (ret) {
 		dev_err(rcpu->dev, "populate child device failed (channel:%s)\n", channel->name);
@@ -1168,114 +1358,157 @@ static const struct file_operations rpmsg_debug_ops = {
 	.release = single_release,
 };
 
-static struct rtk_rpmsg_channel *rtk_rpc_create_channel(struct device_node *node,
-							struct rtk_rcpu *rcpu,
-							struct dentry *rpmsg_dir)
+static int rpmsg_stats_show(struct seq_file *s, void *unused)
 {
-	struct rtk_rpmsg_channel *channel;
-	struct device *dev = rcpu->dev;
+	struct rtk_rpmsg_channel *channel = (struct rtk_rpmsg_channel *)s->private;
+	int i;
+
+	seq_printf(s, "name: %s\n", channel->name);
+	seq_printf(s, "messages: %llu\n", channel->rx_msgs);
+	seq_printf(s, "drains: %llu\n", channel->rx_drains);
+	seq_printf(s, "max batch: %u\n", channel->rx_max_batch);
+	seq_printf(s, "max latency: %u us\n", channel->rx_lat_max_us);
+
+	seq_puts(s, "\nIRQ to dispatch latency:\n");
+	for (i = 0; i < RTK_RPMSG_LAT_BUCKETS; i++) {
+		if (i == RTK_RPMSG_LAT_BUCKETS - 1)
+			seq_printf(s, ">= %6u us: %llu\n", 1U << (i - 1), channel->rx_lat_hist[i]);
+		else
+			seq_printf(s, "<  %6u us: %llu\n", 1U << i, channel->rx_lat_hist[i]);
+	}
+
+	seq_puts(s, "\ntx:\n");
+	seq_printf(s, "messages: %llu\n", channel->tx_msgs);
+	seq_printf(s, "doorbells: %llu\n", channel->tx_doorbells);
+	seq_printf(s, "max messages per doorbell: %u\n", channel->tx_max_batch);
+
+	seq_puts(s, "\nmessages per doorbell:\n");
+	for (i = 0; i < RTK_RPMSG_DB_BUCKETS; i++) {
+		if (i == RTK_RPMSG_DB_BUCKETS - 1)
+			seq_printf(s, ">= %4u: %llu\n", 1U << i, channel->tx_db_hist[i]);
+		else
+			seq_printf(s, "%4u-%-4u: %llu\n", 1U << i, (2U << i) - 1, channel->tx_db_hist[i]);
+	}
+
+	return 0;
+}
+
+static int rpmsg_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, rpmsg_stats_show, inode->i_private);
+}
+
+static ssize_t rpmsg_stats_write(struct file *file, const char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct rtk_rpmsg_channel *channel = (struct rtk_rpmsg_channel *)s->private;
+	unsigned long flags;
+
+	/* any write clears the statistics */
+	spin_lock_irqsave(&channel->rxlock, flags);
+	channel->rx_msgs = 0;
+	channel->rx_drains = 0;
+	channel->rx_max_batch = 0;
+	channel->rx_lat_max_us = 0;
+	memset(channel->rx_lat_hist, 0, sizeof(channel->rx_lat_hist));
+	spin_unlock_irqrestore(&channel->rxlock, flags);
+
+	spin_lock_irqsave(&channel->txlock, flags);
+	channel->tx_msgs = 0;
+	channel->tx_doorbells = 0;
+	channel->tx_max_batch = 0;
+	memset(channel->tx_db_hist, 0, sizeof(channel->tx_db_hist));
+	spin_unlock_irqrestore(&channel->txlock, flags);
+
+	return count;
+}
+
+static const struct file_operations rpmsg_stats_ops = {
+	.open = rpmsg_stats_open,
+	.read = seq_read,
+	.write = rpmsg_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+struct rtk_rpc_channel_desc {
 	const char *name;
-	const u32 *prop;
-	int size;
-	int ret = 0;
-	u32 tx_info, rx_info, tx_fifo, rx_fifo, tx_fifo_size, rx_fifo_size;
+	u32 tx_info;
+	u32 rx_info;
+	u32 tx_fifo;
+	u32 rx_fifo;
+	u32 tx_fifo_size;
+	u32 rx_fifo_size;
+};
+
+static struct rtk_rpmsg_channel *__rtk_rpc_create_channel(struct device_node *node,
+							  struct rtk_rcpu *rcpu,
+							  const struct rtk_rpc_channel_desc *desc,
+							  struct dentry *rpmsg_dir)
+{
+	struct rtk_rpmsg_channel *channel;
+	u32 tx_info = desc->tx_info, rx_info = desc->rx_info;
+	u32 tx_fifo = desc->tx_fifo, rx_fifo = desc->rx_fifo;
+	u32 tx_fifo_size = desc->tx_fifo_size, rx_fifo_size = desc->rx_fifo_size;
+	char stats_name[40];
 
 	channel = kzalloc(sizeof(*channel), GFP_KERNEL);
 	if (!channel)
 		return ERR_PTR(-ENOMEM);
 
-	prop = of_get_property(node, "tx-info", &size);
-	if (prop) {
-		tx_info = of_read_number(prop, 1);
-	} else {
-		dev_err(dev, "[%s]cannot get channel info tx_info\n", __func__);
-		goto free_channel;
-	}
-	prop = of_get_property(node, "rx-info", &size);
-	if (prop) {
-		rx_info = of_read_number(prop, 1);
-	} else {
-		dev_err(dev, "[%s]cannot get channel info rx_info\n", __func__);
-		goto free_channel;
-	}
-	prop = of_get_property(node, "tx-fifo", &size);
-	if (prop) {
-		tx_fifo = of_read_number(prop, 1);
-	} else {
-		dev_err(dev, "[%s]cannot get channel info tx_fifo\n", __func__);
+	/* a message can never be larger than the ring it comes through */
+	channel->rx_buf_size = rx_fifo_size;
+	channel->rx_buf = kmalloc(rx_fifo_size, GFP_KERNEL);
+	if (!channel->rx_buf)
 		goto free_channel;
-	}
-	prop = of_get_property(node, "rx-fifo", &size);
-	if (prop) {
-		rx_fifo = of_read_number(prop, 1);
-	} else {
-		dev_err(dev, "[%s]cannot get channel info rx_fifo\n", __func__);
-		goto free_channel;
-	}
-	prop = of_get_property(node, "tx-fifo-size", &size);
-	if (prop) {
-		tx_fifo_size = of_read_number(prop, 1);
-	} else {
-		dev_err(dev, "[%s]cannot get channel info tx_fifo_size\n", __func__);
-		goto free_channel;
-	}
-	prop = of_get_property(node, "rx-fifo-size", &size);
-	if (prop) {
-		rx_fifo_size = of_read_number(prop, 1);
-	} else {
-		dev_err(dev, "[%s]cannot get channel info rx_fifo_size\n", __func__);
-		goto free_channel;
-	}
-	ret = of_property_read_string(node, "name", &name);
-	if (ret < 0) {
-		dev_err(dev, "[%s]cannot get channel info name\n", __func__);
-		goto free_channel;
-	}
 
 	INIT_LIST_HEAD(&channel->rtk_ept_lists);
 	spin_lock_init(&channel->txlock);
 	spin_lock_init(&channel->rxlock);
+	hrtimer_init(&channel->tx_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	channel->tx_timer.function = rtk_rpmsg_tx_timer;
 	spin_lock_init(&channel->list_lock);
 
 	channel->id = rcpu->info->id;
-	strscpy(channel->name, name, RPMSG_NAME_SIZE);
-	channel->tx_fifo = ringbuf_phys_to_virt(tx_fifo);
-	channel->rx_fifo = ringbuf_phys_to_virt(rx_fifo);
+	strscpy(channel->name, desc->name, RPMSG_NAME_SIZE);
+	channel->tx_fifo = rtk_ringbuf_phys_to_virt(rcpu, tx_fifo);
+	channel->rx_fifo = rtk_ringbuf_phys_to_virt(rcpu, rx_fifo);
 
 	if (channel->id == HIFI_ID || channel->id == HIFI1_ID) {
-		channel->tx_info.hifi = ringbuf_phys_to_virt(tx_info);
+		channel->tx_info.hifi = rtk_ringbuf_phys_to_virt(rcpu, tx_info);
 		channel->tx_info.hifi->ringBuf = tx_fifo;
 		channel->tx_info.hifi->ringStart = tx_fifo;
 		channel->tx_info.hifi->ringIn = tx_fifo;
 		channel->tx_info.hifi->ringOut = tx_fifo;
 		channel->tx_info.hifi->ringEnd = tx_fifo + tx_fifo_size;
-		channel->rx_info.hifi = ringbuf_phys_to_virt(rx_info);
+		channel->rx_info.hifi = rtk_ringbuf_phys_to_virt(rcpu, rx_info);
 		channel->rx_info.hifi->ringBuf = rx_fifo;
 		channel->rx_info.hifi->ringStart = rx_fifo;
 		channel->rx_info.hifi->ringIn = rx_fifo;
 		channel->rx_info.hifi->ringOut = rx_fifo;
 		channel->rx_info.hifi->ringEnd = rx_fifo + rx_fifo_size;
 	} else if (channel->id == KR4_ID) {
-		channel->tx_info.kr4 = ringbuf_phys_to_virt(tx_info);
+		channel->tx_info.kr4 = rtk_ringbuf_phys_to_virt(rcpu, tx_info);
 		channel->tx_info.kr4->ringBuf = tx_fifo;
 		channel->tx_info.kr4->ringStart = tx_fifo;
 		channel->tx_info.kr4->ringIn = tx_fifo;
 		channel->tx_info.kr4->ringOut = tx_fifo;
 		channel->tx_info.kr4->ringEnd = tx_fifo + tx_fifo_size;
-		channel->rx_info.kr4 = ringbuf_phys_to_virt(rx_info);
+		channel->rx_info.kr4 = rtk_ringbuf_phys_to_virt(rcpu, rx_info);
 		channel->rx_info.kr4->ringBuf = rx_fifo;
 		channel->rx_info.kr4->ringStart = rx_fifo;
 		channel->rx_info.kr4->ringIn = rx_fifo;
 		channel->rx_info.kr4->ringOut = rx_fifo;
 		channel->rx_info.kr4->ringEnd = rx_fifo + rx_fifo_size;
 	} else {
-		channel->tx_info.av = ringbuf_phys_to_virt(tx_info);
+		channel->tx_info.av = rtk_ringbuf_phys_to_virt(rcpu, tx_info);
 		channel->tx_info.av->ringBuf = tx_fifo;
 		channel->tx_info.av->ringStart = tx_fifo;
 		channel->tx_info.av->ringIn = tx_fifo;
 		channel->tx_info.av->ringOut = tx_fifo;
 		channel->tx_info.av->ringEnd = tx_fifo + tx_fifo_size;
-		channel->rx_info.av = ringbuf_phys_to_virt(rx_info);
+		channel->rx_info.av = rtk_ringbuf_phys_to_virt(rcpu, rx_info);
 		channel->rx_info.av->ringBuf = rx_fifo;
 		channel->rx_info.av->ringStart = rx_fifo;
 		channel->rx_info.av->ringIn = rx_fifo;
@@ -1284,19 +1517,22 @@ static struct rtk_rpmsg_channel *rtk_rpc_create_channel(struct device_node *node
 	}
 
 	if (strstr(channel->name, "kernel")) {
-		channel->handle_data = &handle_kern_data;
+		channel->find_ept = &kern_find_ept;
 		channel->use_idr = 1;
 		idr_init(&channel->ept_ids);
 		mutex_init(&channel->ept_ids_lock);
 	} else {
-		channel->handle_data = &handle_intr_data;
+		channel->find_ept = &intr_find_ept;
 		channel->use_idr = 0;
 	}
 
 	channel->rcpu = rcpu;
 	channel->debugfs_node = debugfs_create_file(channel->name, 0444, rpmsg_dir,
 						    channel, &rpmsg_debug_ops);
-	tasklet_init(&channel->tasklet, channel->handle_data, (unsigned long)channel);
+	snprintf(stats_name, sizeof(stats_name), "%s-stats", channel->name);
+	channel->stats_node = debugfs_create_file(stats_name, 0644, rpmsg_dir,
+						  channel, &rpmsg_stats_ops);
+	tasklet_init(&channel->tasklet, rtk_rpmsg_rx_tasklet, (unsigned long)channel);
 	list_add(&channel->list, &rcpu->channels);
 	rtk_rpc_create_deivce(channel, node);
 
@@ -1304,7 +1540,68 @@ static struct rtk_rpmsg_channel *rtk_rpc_create_channel(struct device_node *node
 free_channel:
 	kfree(channel);
 
-	return ERR_PTR(-EPERM);
+	return ERR_PTR(-ENOMEM);
+}
+
+static struct rtk_rpmsg_channel *rtk_rpc_create_channel(struct device_node *node,
+							struct rtk_rcpu *rcpu,
+							struct dentry *rpmsg_dir)
+{
+	struct rtk_rpc_channel_desc desc;
+	struct device *dev = rcpu->dev;
+	const u32 *prop;
+	int size;
+	int ret = 0;
+
+	prop = of_get_property(node, "tx-info", &size);
+	if (prop) {
+		desc.tx_info = of_read_number(prop, 1);
+	} else {
+		dev_err(dev, "[%s]cannot get channel info tx_info\n", __func__);
+		return ERR_PTR(-EPERM);
+	}
+	prop = of_get_property(node, "rx-info", &size);
+	if (prop) {
+		desc.rx_info = of_read_number(prop, 1);
+	} else {
+		dev_err(dev, "[%s]cannot get channel info rx_info\n", __func__);
+		return ERR_PTR(-EPERM);
+	}
+	prop = of_get_property(node, "tx-fifo", &size);
+	if (prop) {
+		desc.tx_fifo = of_read_number(prop, 1);
+	} else {
+		dev_err(dev, "[%s]cannot get channel info tx_fifo\n", __func__);
+		return ERR_PTR(-EPERM);
+	}
+	prop = of_get_property(node, "rx-fifo", &size);
+	if (prop) {
+		desc.rx_fifo = of_read_number(prop, 1);
+	} else {
+		dev_err(dev, "[%s]cannot get channel info rx_fifo\n", __func__);
+		return ERR_PTR(-EPERM);
+	}
+	prop = of_get_property(node, "tx-fifo-size", &size);
+	if (prop) {
+		desc.tx_fifo_size = of_read_number(prop, 1);
+	} else {
+		dev_err(dev, "[%s]cannot get channel info tx_fifo_size\n", __func__);
+		return ERR_PTR(-EPERM);
+	}
+	prop = of_get_property(node, "rx-fifo-size", &size);
+	if (prop) {
+		desc.rx_fifo_size = of_read_number(prop, 1);
+	} else {
+		dev_err(dev, "[%s]cannot get channel info rx_fifo_size\n", __func__);
+		return ERR_PTR(-EPERM);
+	}
+	ret = of_property_read_string(node, "name", &desc.name);
+	if (ret < 0) {
+		dev_err(dev, "[%s]cannot get channel info name\n", __func__);
+		return ERR_PTR(-EPERM);
+	}
+
+	return __rtk_rpc_create_channel(node, rcpu, &desc, rpmsg_dir);
 }
 
 static int rcpu_rpmsg_init(struct rtk_rcpu *rcpu)
@@ -1370,9 +1667,9 @@ static int rcpu_rpmsg_init(struct rtk_rcpu *rcpu)
 		ret = -EINVAL;
 		goto err;
 	}
-	ret = devm_request_irq(rcpu->dev, irq,
-		rcpu->info->isr, IRQF_SHARED|IRQF_NO_SUSPEND,
-		rcpu->info->name, rcpu);
+	ret = devm_request_threaded_irq(rcpu->dev, irq,
+		rcpu->info->isr, threaded_irq ? rtk_rcpu_irq_thread : NULL,
+		IRQF_SHARED|IRQF_NO_SUSPEND, rcpu->info->name, rcpu);
 	if (ret) {
 		dev_err(rcpu->dev, "[%s]failed to request rpc irq\n", __func__);
 		goto err;
@@ -1496,6 +1793,250 @@ void rtk_dump_all_ringbuf_info(struct device *dev)
 }
 EXPORT_SYMBOL(rtk_dump_all_ringbuf_info);
 
+static u32 loopback_wire32(struct rtk_rcpu *rcpu, u32 val)
+{
+	return rcpu->info->big_endian ? be32_to_cpu((__force __be32)val) : val;
+}
+
+static void loopback_ring_copy_from(struct av_info *ring, void *fifo, u32 pos,
+				    void *buf, int len)
+{
+	int tail = ring->ringEnd - pos;
+
+	if (tail >= len) {
+		memcpy(buf, fifo + (pos - ring->ringStart), len);
+	} else {
+		memcpy(buf, fifo + (pos - ring->ringStart), tail);
+		memcpy(buf + tail, fifo, len - tail);
+	}
+}
+
+static void loopback_ring_copy_to(struct av_info *ring, void *fifo, u32 pos,
+				  const void *buf, int len)
+{
+	int tail = ring->ringEnd - pos;
+
+	if (tail >= len) {
+		memcpy(fifo + (pos - ring->ringStart), buf, len);
+	} else {
+		memcpy(fifo + (pos - ring->ringStart), buf, tail);
+		memcpy(fifo, buf + tail, len - tail);
+	}
+}
+
+/* same pointer arithmetic as __rtk_rpmsg_send() and get_ring_data() */
+static u32 loopback_ring_advance(struct av_info *ring, u32 pos, int len)
+{
+	int tail = ring->ringEnd - pos;
+
+	if (tail >= len) {
+		pos += (len + 3) & 0xfffffffc;
+		return pos == ring->ringEnd ? ring->ringStart : pos;
+	}
+
+	return ring->ringStart + ((len - tail + 3) & 0xfffffffc);
+}
+
+/* Peek at the next request the kernel queued for the remote cpu. */
+static int loopback_remote_peek(struct rtk_rpmsg_channel *channel, char *buf)
+{
+	struct av_info *ring = channel->tx_info.av;
+	void *fifo = (__force void *)channel->tx_fifo;
+	struct rpc_struct *rpc = (struct rpc_struct *)buf;
+	u32 in = READ_ONCE(ring->ringIn);
+	u32 out = ring->ringOut;
+	int ring_size = ring->ringEnd - ring->ringStart;
+	int size, len;
+
+	if (in == out)
+		return 0;
+
+	smp_rmb();
+	size = (ring_size + in - out) % ring_size;
+	if (size < sizeof(*rpc))
+		return -EINVAL;
+
+	loopback_ring_copy_from(ring, fifo, out, buf, sizeof(*rpc));
+	len = sizeof(*rpc) + loopback_wire32(channel->rcpu, rpc->parameterSize);
+	if (len > size)
+		return -EINVAL;
+
+	loopback_ring_copy_from(ring, fifo, out, buf, len);
+
+	return len;
+}
+
+static int loopback_remote_reply(struct rtk_rpmsg_channel *channel, const void *buf, int len)
+{
+	struct av_info *ring = channel->rx_info.av;
+	void *fifo = (__force void *)channel->rx_fifo;
+	u32 in = ring->ringIn;
+	u32 out = READ_ONCE(ring->ringOut);
+	int ring_size = ring->ringEnd - ring->ringStart;
+	int size = in == out ? ring_size : (ring_size + out - in) % ring_size;
+
+	if (len > size - 1)
+		return -ENOSPC;
+
+	loopback_ring_copy_to(ring, fifo, in, buf, len);
+	smp_wmb();
+	WRITE_ONCE(ring->ringIn, loopback_ring_advance(ring, in, len));
+
+	return len;
+}
+
+/*
+ * Answer like the audio/video firmware does: a request with a taskID gets a
+ * REPLYID message carrying the taskID and S_OK, everything in wire order.
+ */
+static int loopback_remote_handle(struct rtk_rpmsg_channel *channel, char *req)
+{
+	struct rtk_rcpu *rcpu = channel->rcpu;
+	struct rpc_struct *rpc = (struct rpc_struct *)req;
+	char reply[sizeof(struct rpc_struct) + 2 * sizeof(uint32_t)];
+	struct rpc_struct *rrpc = (struct rpc_struct *)reply;
+	uint32_t *param = (uint32_t *)(reply + sizeof(struct rpc_struct));
+
+	if (!rpc->taskID)
+		return 0;
+
+	memset(reply, 0, sizeof(reply));
+	rrpc->programID = loopback_wire32(rcpu, REPLYID);
+	rrpc->versionID = loopback_wire32(rcpu, REPLYID);
+	rrpc->parameterSize = loopback_wire32(rcpu, 2 * sizeof(uint32_t));
+	rrpc->mycontext = rpc->mycontext;
+	param[0] = rpc->taskID;
+	param[1] = loopback_wire32(rcpu, S_OK);
+
+	return loopback_remote_reply(channel, reply, sizeof(reply));
+}
+
+static void rtk_loopback_remote_work(struct work_struct *work)
+{
+	struct rtk_rpmsg_loopback *lb = container_of(work, struct rtk_rpmsg_loopback, remote_work);
+	struct rtk_rcpu *rcpu = lb->rcpu;
+	struct rtk_rpmsg_channel *channel;
+	bool raise = false;
+	bool stalled = false;
+	int len;
+
+	list_for_each_entry(channel, &rcpu->channels, list) {
+		struct av_info *ring = channel->tx_info.av;
+
+		while ((len = loopback_remote_peek(channel, lb->msg)) != 0) {
+			if (len < 0) {
+				dev_err(rcpu->dev, "[%s]corrupted request on %s\n", __func__, channel->name);
+				WRITE_ONCE(ring->ringOut, READ_ONCE(ring->ringIn));
+				break;
+			}
+
+			if (loopback_remote_handle(channel, lb->msg) == -ENOSPC) {
+				/* reply ring full, retry once the kernel has drained it */
+				stalled = true;
+				break;
+			}
+
+			WRITE_ONCE(ring->ringOut, loopback_ring_advance(ring, ring->ringOut, len));
+			raise = true;
+		}
+	}
+
+	if (raise || stalled)
+		irq_work_queue(&lb->irq_work);
+	if (stalled)
+		queue_work(system_highpri_wq, &lb->remote_work);
+}
+
+static void rtk_loopback_irq(struct irq_work *work)
+{
+	struct rtk_rpmsg_loopback *lb = container_of(work, struct rtk_rpmsg_loopback, irq_work);
+
+	if (rtk_rcpu_handle_rx(lb->rcpu) == IRQ_WAKE_THREAD)
+		queue_work(system_highpri_wq, &lb->thread_work);
+}
+
+static void rtk_loopback_thread_work(struct work_struct *work)
+{
+	struct rtk_rpmsg_loopback *lb = container_of(work, struct rtk_rpmsg_loopback, thread_work);
+
+	rtk_rcpu_irq_thread(0, lb->rcpu);
+}
+
+static void rpmsg_send_loopback_interrupt(struct rtk_rcpu *rcpu)
+{
+	queue_work(system_highpri_wq, &rcpu->lb->remote_work);
+}
+
+static int rcpu_loopback_init(struct rtk_rcpu *rcpu)
+{
+	struct rtk_rpc_channel_desc desc;
+	struct rtk_rpmsg_channel *channel;
+	struct rtk_rpmsg_loopback *lb;
+	struct dentry *rpmsg_dir;
+
+	lb = devm_kzalloc(rcpu->dev, sizeof(*lb), GFP_KERNEL);
+	if (!lb)
+		return -ENOMEM;
+
+	lb->shm = devm_kzalloc(rcpu->dev, LOOPBACK_SHM_SIZE, GFP_KERNEL);
+	if (!lb->shm)
+		return -ENOMEM;
+
+	lb->rcpu = rcpu;
+	INIT_WORK(&lb->remote_work, rtk_loopback_remote_work);
+	INIT_WORK(&lb->thread_work, rtk_loopback_thread_work);
+	init_irq_work(&lb->irq_work, rtk_loopback_irq);
+
+	rcpu->lb = lb;
+	rcpu->skip_handshake = true;
+	INIT_LIST_HEAD(&rcpu->channels);
+
+	rpmsg_dir = debugfs_lookup("rpmsg", NULL);
+	if (!rpmsg_dir)
+		rpmsg_dir = debugfs_create_dir("rpmsg", NULL);
+
+	desc.name = "loopback-kernel";
+	desc.tx_info = rpc_ringbuf_phys;
+	desc.rx_info = rpc_ringbuf_phys + LOOPBACK_INFO_SIZE / 2;
+	desc.tx_fifo = rpc_ringbuf_phys + LOOPBACK_INFO_SIZE;
+	desc.rx_fifo = desc.tx_fifo + LOOPBACK_FIFO_SIZE;
+	desc.tx_fifo_size = LOOPBACK_FIFO_SIZE;
+	desc.rx_fifo_size = LOOPBACK_FIFO_SIZE;
+
+	channel = __rtk_rpc_create_channel(NULL, rcpu, &desc, rpmsg_dir);
+	if (IS_ERR(channel))
+		return PTR_ERR(channel);
+
+	rcpu->status = IS_CONNECTED;
+	dev_info(rcpu->dev, "loopback %s endian remote cpu probed\n",
+		 rcpu->info->big_endian ? "big" : "little");
+
+	return 0;
+}
+
+static void rcpu_loopback_exit(struct rtk_rcpu *rcpu)
+{
+	struct rtk_rpmsg_loopback *lb = rcpu->lb;
+	struct rtk_rpmsg_channel *channel, *tmp;
+
+	list_for_each_entry(channel, &rcpu->channels, list)
+		device_unregister(&channel->rtk_rpdev->rpdev.dev);
+
+	cancel_work_sync(&lb->remote_work);
+	irq_work_sync(&lb->irq_work);
+	cancel_work_sync(&lb->thread_work);
+
+	list_for_each_entry_safe(channel, tmp, &rcpu->channels, list) {
+		hrtimer_cancel(&channel->tx_timer);
+		tasklet_kill(&channel->tasklet);
+		debugfs_remove(channel->stats_node);
+		debugfs_remove(channel->debugfs_node);
+		list_del(&channel->list);
+		kfree(channel->rx_buf);
+		kfree(channel);
+	}
+}
+
 struct rproc *check_rproc_state(struct device *dev)
 {
 	struct rproc *rproc;
@@ -1538,6 +2079,18 @@ static int rtk_rcpu_probe(struct platform_device *pdev)
 	struct rproc *rproc;
 	int ret = 0;
 
+	if (platform_get_device_id(pdev)) {
+		rcpu = devm_kzalloc(dev, sizeof(*rcpu), GFP_KERNEL);
+		if (!rcpu)
+			return -ENOMEM;
+
+		rcpu->dev = dev;
+		rcpu->info = (const struct remote_cpu_info *)platform_get_device_id(pdev)->driver_data;
+		dev_set_drvdata(dev, rcpu);
+
+		return rcpu_loopback_init(rcpu);
+	}
+
 	rproc = check_rproc_state(dev);
 	if (IS_ERR(rproc))
 		return PTR_ERR(rproc);
@@ -1565,6 +2118,11 @@ static int rtk_rcpu_remove(struct platform_device *pdev)
 {
 	struct rtk_rcpu *rcpu = platform_get_drvdata(pdev);
 
+	if (rcpu->lb) {
+		rcpu_loopback_exit(rcpu);
+		return 0;
+	}
+
 	regmap_write(rcpu->rcpu_intr_regmap, RPC_SB2_INT_EN, rcpu->info->intr_en);
 
 	return 0;
@@ -1575,7 +2133,7 @@ static int rtk_rcpu_suspend(struct device *dev)
 {
 	struct rtk_rcpu *rcpu = dev_get_drvdata(dev);
 
-	if (!rcpu->rproc)
+	if (!rcpu->rproc && !rcpu->lb)
 		regmap_write(rcpu->rcpu_intr_regmap, RPC_SB2_INT_EN, rcpu->info->intr_en);
 
 	return 0;
@@ -1586,7 +2144,7 @@ static int rtk_rcpu_resume(struct device *dev)
 
 	struct rtk_rcpu *rcpu = dev_get_drvdata(dev);
 
-	if (!rcpu->rproc)
+	if (!rcpu->rproc && !rcpu->lb)
 		regmap_write(rcpu->rcpu_intr_regmap, RPC_SB2_INT_EN, rcpu->info->intr_en | RPC_INT_WRITE_EN);
 
 	return 0;
@@ -1676,6 +2234,19 @@ static const struct remote_cpu_info kr4_info = {
 	.send_interrupt = &rpmsg_send_interrupt,
 };
 
+static const struct remote_cpu_info loopback_be_info = {
+	.name = "lb-rpc",
+	.id = LOOPBACK_ID,
+	.big_endian = 1,
+	.send_interrupt = &rpmsg_send_loopback_interrupt,
+};
+
+static const struct remote_cpu_info loopback_le_info = {
+	.name = "lb-rpc",
+	.id = LOOPBACK_ID,
+	.big_endian = 0,
+	.send_interrupt = &rpmsg_send_loopback_interrupt,
+};
 
 static const struct of_device_id rtk_rcpu_of_match[] = {
 	{ .compatible = "realtek,acpu-rpmsg", .data = &acpu_info },
@@ -1688,9 +2259,18 @@ static const struct of_device_id rtk_rcpu_of_match[] = {
 };
 MODULE_DEVICE_TABLE(of, rtk_rcpu_of_match);
 
+static const struct platform_device_id rtk_rcpu_loopback_ids[] = {
+	{ .name = "rtk-rpmsg-loopback-be", .driver_data = (kernel_ulong_t)&loopback_be_info },
+	{ .name = "rtk-rpmsg-loopback-le", .driver_data = (kernel_ulong_t)&loopback_le_info },
+	{},
+};
+
+static struct platform_device *loopback_pdev;
+
 static struct platform_driver rtk_rcpu_driver = {
 	.probe = rtk_rcpu_probe,
 	.remove = rtk_rcpu_remove,
+	.id_table = rtk_rcpu_loopback_ids,
 	.driver = {
 		.name = "rtk-rpmsg",
 		.of_match_table = rtk_rcpu_of_match,
@@ -1700,15 +2280,35 @@ static struct platform_driver rtk_rcpu_driver = {
 
 static int __init rtk_rcpu_init(void)
 {
-	return platform_driver_register(&rtk_rcpu_driver);
+	int ret;
+
+	ret = platform_driver_register(&rtk_rcpu_driver);
+	if (ret || !loopback)
+		return ret;
+
+	loopback_pdev = platform_device_register_simple(loopback_be ? "rtk-rpmsg-loopback-be" :
+							"rtk-rpmsg-loopback-le",
+							PLATFORM_DEVID_NONE, NULL, 0);
+	if (IS_ERR(loopback_pdev)) {
+		platform_driver_unregister(&rtk_rcpu_driver);
+		return PTR_ERR(loopback_pdev);
+	}
+
+	return 0;
 }
 module_init(rtk_rcpu_init);
 static void __exit rtk_rcpu_exit(void)
 {
+	if (!IS_ERR_OR_NULL(loopback_pdev))
+		platform_device_unregister(loopback_pdev);
 	platform_driver_unregister(&rtk_rcpu_driver);
 }
 module_exit(rtk_rcpu_exit);
 
+#if IS_ENABLED(CONFIG_RPMSG_RTK_KUNIT_TEST)
+#include "rpmsg_rtk_test.c"
+#endif
+
 MODULE_AUTHOR("TYChang <tychang@realtek.com>");
 MODULE_DESCRIPTION("Realtek RPMSG Driver");
 MODULE_LICENSE("GPL v2");
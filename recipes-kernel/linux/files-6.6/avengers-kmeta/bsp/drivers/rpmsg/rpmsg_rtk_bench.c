@@ -0,0 +1,241 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Realtek RPMSG round trip benchmark
+ *
+ * Binds to the loopback-kernel channel of rpmsg_rtk (load it with
+ * loopback=1) and measures request/reply latency and pipelined throughput
+ * using the kernel RPC message layout.
+ */
+
+#include <linux/completion.h>
+#include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/rpmsg.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <soc/realtek/rtk-rpmsg.h>
+
+static unsigned int iterations = 10000;
+module_param(iterations, uint, 0444);
+MODULE_PARM_DESC(iterations, "Number of requests per test");
+
+static unsigned int payload_words = 3;
+module_param(payload_words, uint, 0444);
+MODULE_PARM_DESC(payload_words, "Parameter words carried by each request");
+
+static unsigned int burst = 16;
+module_param(burst, uint, 0444);
+MODULE_PARM_DESC(burst, "Requests queued per doorbell in the throughput test");
+
+#define BENCH_MAX_PAYLOAD_WORDS 64
+
+struct rtk_rpmsg_bench {
+	struct rpmsg_device *rpdev;
+	struct rpmsg_endpoint *ept;
+	struct work_struct work;
+	struct completion done;
+	atomic_t replies;
+	int expect;
+	char *buf;
+	int len;
+};
+
+static int rtk_rpmsg_bench_cb(struct rpmsg_device *rpdev, void *data, int count,
+			      void *priv, u32 addr)
+{
+	struct rtk_rpmsg_bench *bench = priv;
+	struct rpc_struct *rpc = data;
+	uint32_t program_id = rpdev->little_endian ? rpc->programID : ntohl(rpc->programID);
+
+	if (program_id != REPLYID)
+		return 0;
+
+	if (atomic_inc_return(&bench->replies) == bench->expect)
+		complete(&bench->done);
+
+	return 0;
+}
+
+static void rtk_rpmsg_bench_prepare(struct rtk_rpmsg_bench *bench)
+{
+	struct rpc_struct *rpc = (struct rpc_struct *)bench->buf;
+	uint32_t *tmp = (uint32_t *)(bench->buf + sizeof(struct rpc_struct));
+	int i;
+
+	rpc->programID = KERNELID;
+	rpc->versionID = KERNELID;
+	rpc->procedureID = 0;
+	rpc->taskID = bench->ept->addr;
+	rpc->sysTID = bench->ept->addr;
+	rpc->sysPID = bench->ept->addr;
+	rpc->parameterSize = payload_words * sizeof(uint32_t);
+	rpc->mycontext = 0;
+	for (i = 0; i < payload_words; i++)
+		tmp[i] = i;
+
+	if (!bench->rpdev->little_endian)
+		endian_swap_32_write(bench->buf, bench->len);
+}
+
+static void rtk_rpmsg_bench_arm(struct rtk_rpmsg_bench *bench, int expect)
+{
+	atomic_set(&bench->replies, 0);
+	bench->expect = expect;
+	reinit_completion(&bench->done);
+}
+
+static int rtk_rpmsg_bench_latency(struct rtk_rpmsg_bench *bench)
+{
+	struct device *dev = &bench->rpdev->dev;
+	s64 min_ns = S64_MAX, max_ns = 0, total_ns = 0;
+	ktime_t start;
+	s64 ns;
+	int ret;
+	int i;
+
+	for (i = 0; i < iterations; i++) {
+		rtk_rpmsg_bench_arm(bench, 1);
+
+		start = ktime_get();
+		ret = rpmsg_send(bench->ept, bench->buf, bench->len);
+		if (ret < 0) {
+			dev_err(dev, "send failed: %d\n", ret);
+			return ret;
+		}
+		if (!wait_for_completion_timeout(&bench->done, RPC_TIMEOUT)) {
+			dev_err(dev, "reply %d timed out\n", i);
+			return -ETIMEDOUT;
+		}
+		ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		min_ns = min(min_ns, ns);
+		max_ns = max(max_ns, ns);
+		total_ns += ns;
+	}
+
+	dev_info(dev, "latency: %u round trips, min %lld ns avg %lld ns max %lld ns\n",
+		 iterations, min_ns, div_s64(total_ns, iterations), max_ns);
+
+	return 0;
+}
+
+static int rtk_rpmsg_bench_throughput(struct rtk_rpmsg_bench *bench)
+{
+	struct device *dev = &bench->rpdev->dev;
+	unsigned int batch = max(burst, 1U);
+	unsigned int sent = 0;
+	ktime_t start;
+	s64 ns;
+	int ret;
+	int i;
+
+	start = ktime_get();
+	while (sent < iterations) {
+		unsigned int n = min(batch, iterations - sent);
+
+		rtk_rpmsg_bench_arm(bench, n);
+
+		for (i = 0; i < n; i++) {
+			ret = rtk_rpmsg_send_queued(bench->ept, bench->buf, bench->len);
+			if (ret == -EAGAIN) {
+				/* ring full, let the remote cpu catch up */
+				usleep_range(50, 100);
+				i--;
+				continue;
+			}
+			if (ret < 0) {
+				dev_err(dev, "send failed: %d\n", ret);
+				return ret;
+			}
+		}
+		rtk_rpmsg_flush(bench->ept);
+
+		if (!wait_for_completion_timeout(&bench->done, RPC_TIMEOUT)) {
+			dev_err(dev, "burst at %u timed out (%d/%u replies)\n",
+				sent, atomic_read(&bench->replies), n);
+			return -ETIMEDOUT;
+		}
+		sent += n;
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	dev_info(dev, "throughput: %u requests in bursts of %u, %lld ns, %llu msgs/s\n",
+		 iterations, batch, ns, div64_u64((u64)iterations * NSEC_PER_SEC, max_t(s64, ns, 1)));
+
+	return 0;
+}
+
+static void rtk_rpmsg_bench_work(struct work_struct *work)
+{
+	struct rtk_rpmsg_bench *bench = container_of(work, struct rtk_rpmsg_bench, work);
+
+	if (!iterations)
+		return;
+
+	if (rtk_rpmsg_bench_latency(bench))
+		return;
+
+	rtk_rpmsg_bench_throughput(bench);
+}
+
+static int rtk_rpmsg_bench_probe(struct rpmsg_device *rpdev)
+{
+	struct rtk_rpmsg_bench *bench;
+	struct rpmsg_channel_info chinfo;
+
+	if (payload_words > BENCH_MAX_PAYLOAD_WORDS)
+		return -EINVAL;
+
+	bench = devm_kzalloc(&rpdev->dev, sizeof(*bench), GFP_KERNEL);
+	if (!bench)
+		return -ENOMEM;
+
+	bench->len = sizeof(struct rpc_struct) + payload_words * sizeof(uint32_t);
+	bench->buf = devm_kzalloc(&rpdev->dev, bench->len, GFP_KERNEL);
+	if (!bench->buf)
+		return -ENOMEM;
+
+	bench->rpdev = rpdev;
+	init_completion(&bench->done);
+	INIT_WORK(&bench->work, rtk_rpmsg_bench_work);
+
+	strscpy(chinfo.name, rpdev->id.name, sizeof(chinfo.name));
+	chinfo.src = RPMSG_ADDR_ANY;
+	chinfo.dst = RPMSG_ADDR_ANY;
+
+	bench->ept = rpmsg_create_ept(rpdev, rtk_rpmsg_bench_cb, bench, chinfo);
+	if (IS_ERR_OR_NULL(bench->ept))
+		return bench->ept ? PTR_ERR(bench->ept) : -ENOMEM;
+
+	rtk_rpmsg_bench_prepare(bench);
+	dev_set_drvdata(&rpdev->dev, bench);
+	schedule_work(&bench->work);
+
+	return 0;
+}
+
+static void rtk_rpmsg_bench_remove(struct rpmsg_device *rpdev)
+{
+	struct rtk_rpmsg_bench *bench = dev_get_drvdata(&rpdev->dev);
+
+	cancel_work_sync(&bench->work);
+	rpmsg_destroy_ept(bench->ept);
+}
+
+static const struct rpmsg_device_id rtk_rpmsg_bench_id_table[] = {
+	{ .name = "loopback-kernel" },
+	{},
+};
+MODULE_DEVICE_TABLE(rpmsg, rtk_rpmsg_bench_id_table);
+
+static struct rpmsg_driver rtk_rpmsg_bench_driver = {
+	.drv.name = "rtk-rpmsg-bench",
+	.id_table = rtk_rpmsg_bench_id_table,
+	.probe = rtk_rpmsg_bench_probe,
+	.remove = rtk_rpmsg_bench_remove,
+};
+module_rpmsg_driver(rtk_rpmsg_bench_driver);
+
+MODULE_DESCRIPTION("Realtek RPMSG Round Trip Benchmark");
+MODULE_LICENSE("GPL v2");
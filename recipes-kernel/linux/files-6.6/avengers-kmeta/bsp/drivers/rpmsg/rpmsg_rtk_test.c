@@ -0,0 +1,329 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * KUnit tests for the Realtek RPMSG rings
+ *
+ * Included by rpmsg_rtk.c. Every case sets up a loopback channel by hand
+ * and steps the software remote cpu itself, so the kernel side
+ * (__rtk_rpmsg_send() / get_ring_data()) and the remote side
+ * (loopback_remote_*) meet on the same shared rings without any workqueue
+ * or interrupt in between. The cases run in both wire orders; the big
+ * endian one covers the ACPU/VCPU byte swapping.
+ */
+
+#include <kunit/test.h>
+
+struct rtk_rpmsg_test {
+	struct rtk_rcpu rcpu;
+	struct remote_cpu_info info;
+	struct rtk_rpmsg_loopback lb;
+	struct rtk_rpmsg_channel channel;
+	struct device *dev;
+	int kicks;
+};
+
+static void rtk_rpmsg_test_kick(struct rtk_rcpu *rcpu)
+{
+	struct rtk_rpmsg_test *t = container_of(rcpu, struct rtk_rpmsg_test, rcpu);
+
+	t->kicks++;
+}
+
+static u32 rtk_rpmsg_test_wire(struct rtk_rpmsg_test *t, u32 val)
+{
+	return t->info.big_endian ? (__force u32)htonl(val) : val;
+}
+
+static void rtk_rpmsg_test_ring_init(struct av_info *ring, u32 fifo, u32 size)
+{
+	ring->ringBuf = fifo;
+	ring->ringStart = fifo;
+	ring->ringIn = fifo;
+	ring->ringOut = fifo;
+	ring->ringEnd = fifo + size;
+}
+
+/* Move both pointers of an empty ring to @pos bytes before its end. */
+static void rtk_rpmsg_test_ring_rewind(struct av_info *ring, u32 pos)
+{
+	ring->ringIn = ring->ringEnd - pos;
+	ring->ringOut = ring->ringEnd - pos;
+}
+
+/* Build a request in wire order, @words parameter words follow the header. */
+static int rtk_rpmsg_test_request(struct rtk_rpmsg_test *t, char *buf, u32 task_id,
+				  u32 context, int words)
+{
+	struct rpc_struct *rpc = (struct rpc_struct *)buf;
+	u32 *param = (u32 *)(buf + sizeof(*rpc));
+	int i;
+
+	memset(rpc, 0, sizeof(*rpc));
+	rpc->programID = rtk_rpmsg_test_wire(t, AUDIO_SYSTEM);
+	rpc->versionID = rtk_rpmsg_test_wire(t, AUDIO_SYSTEM);
+	rpc->procedureID = rtk_rpmsg_test_wire(t, 1);
+	rpc->taskID = rtk_rpmsg_test_wire(t, task_id);
+	rpc->parameterSize = rtk_rpmsg_test_wire(t, words * sizeof(u32));
+	rpc->mycontext = rtk_rpmsg_test_wire(t, context);
+
+	for (i = 0; i < words; i++)
+		param[i] = rtk_rpmsg_test_wire(t, 0x01020304 * (i + 1));
+
+	return sizeof(*rpc) + words * sizeof(u32);
+}
+
+/* One firmware step: consume the next request and answer it. */
+static int rtk_rpmsg_test_remote(struct rtk_rpmsg_test *t)
+{
+	struct rtk_rpmsg_channel *channel = &t->channel;
+	struct av_info *ring = channel->tx_info.av;
+	int len, ret;
+
+	len = loopback_remote_peek(channel, t->lb.msg);
+	if (len <= 0)
+		return len;
+
+	ret = loopback_remote_handle(channel, t->lb.msg);
+	if (ret < 0)
+		return ret;
+
+	ring->ringOut = loopback_ring_advance(ring, ring->ringOut, len);
+
+	return len;
+}
+
+static int rtk_rpmsg_test_init(struct kunit *test)
+{
+	const struct remote_cpu_info *info = &loopback_be_info;
+	struct rtk_rpmsg_channel *channel;
+	struct rtk_rpmsg_test *t;
+
+	if (test->param_value)
+		info = *(const struct remote_cpu_info **)test->param_value;
+
+	t = kunit_kzalloc(test, sizeof(*t), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, t);
+
+	channel = &t->channel;
+	hrtimer_init(&channel->tx_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	channel->tx_timer.function = rtk_rpmsg_tx_timer;
+	test->priv = t;
+
+	t->lb.shm = kunit_kzalloc(test, LOOPBACK_SHM_SIZE, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, t->lb.shm);
+
+	t->dev = root_device_register("rtk-rpmsg-test");
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, t->dev);
+
+	t->info = *info;
+	t->info.send_interrupt = rtk_rpmsg_test_kick;
+
+	t->lb.rcpu = &t->rcpu;
+	t->rcpu.dev = t->dev;
+	t->rcpu.info = &t->info;
+	t->rcpu.lb = &t->lb;
+	t->rcpu.status = IS_CONNECTED;
+	INIT_LIST_HEAD(&t->rcpu.channels);
+
+	/* same layout as rcpu_loopback_init() */
+	channel->rcpu = &t->rcpu;
+	channel->id = t->info.id;
+	spin_lock_init(&channel->txlock);
+	spin_lock_init(&channel->rxlock);
+	channel->tx_info.av = (__force void *)rtk_ringbuf_phys_to_virt(&t->rcpu, rpc_ringbuf_phys);
+	channel->rx_info.av = (__force void *)rtk_ringbuf_phys_to_virt(&t->rcpu,
+					rpc_ringbuf_phys + LOOPBACK_INFO_SIZE / 2);
+	channel->tx_fifo = rtk_ringbuf_phys_to_virt(&t->rcpu, rpc_ringbuf_phys + LOOPBACK_INFO_SIZE);
+	channel->rx_fifo = channel->tx_fifo + LOOPBACK_FIFO_SIZE;
+	rtk_rpmsg_test_ring_init(channel->tx_info.av, rpc_ringbuf_phys + LOOPBACK_INFO_SIZE,
+				 LOOPBACK_FIFO_SIZE);
+	rtk_rpmsg_test_ring_init(channel->rx_info.av,
+				 rpc_ringbuf_phys + LOOPBACK_INFO_SIZE + LOOPBACK_FIFO_SIZE,
+				 LOOPBACK_FIFO_SIZE);
+
+	channel->rx_buf_size = LOOPBACK_FIFO_SIZE;
+	channel->rx_buf = kunit_kmalloc(test, LOOPBACK_FIFO_SIZE, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, channel->rx_buf);
+
+	return 0;
+}
+
+static void rtk_rpmsg_test_exit(struct kunit *test)
+{
+	struct rtk_rpmsg_test *t = test->priv;
+
+	if (!t)
+		return;
+
+	hrtimer_cancel(&t->channel.tx_timer);
+	if (!IS_ERR_OR_NULL(t->dev))
+		root_device_unregister(t->dev);
+}
+
+/* Check the REPLYID message the remote cpu answered @task_id with. */
+static void rtk_rpmsg_test_check_reply(struct kunit *test, u32 task_id, u32 context)
+{
+	struct rtk_rpmsg_test *t = test->priv;
+	struct rtk_rpmsg_channel *channel = &t->channel;
+	char *data = channel->rx_buf + sizeof(struct rpc_struct);
+	struct rpc_struct rpc;
+	int len;
+
+	len = get_ring_data(channel, &rpc);
+	KUNIT_ASSERT_EQ(test, len, (int)(sizeof(rpc) + 2 * sizeof(u32)));
+
+	/* get_ring_data() hands the header back in cpu order */
+	KUNIT_EXPECT_EQ(test, rpc.programID, REPLYID);
+	KUNIT_EXPECT_EQ(test, rpc.versionID, REPLYID);
+	KUNIT_EXPECT_EQ(test, rpc.parameterSize, 2 * sizeof(u32));
+	KUNIT_EXPECT_EQ(test, rpc.mycontext, context);
+	KUNIT_EXPECT_EQ(test, rpc_reply_pid(channel, &rpc, data), task_id);
+	KUNIT_EXPECT_EQ(test, ((u32 *)data)[1], rtk_rpmsg_test_wire(t, S_OK));
+
+	KUNIT_EXPECT_EQ(test, get_ring_data(channel, &rpc), -ENODATA);
+}
+
+static void rtk_rpmsg_test_round_trip(struct kunit *test)
+{
+	struct rtk_rpmsg_test *t = test->priv;
+	struct av_info *tx = t->channel.tx_info.av;
+	char req[sizeof(struct rpc_struct) + 4 * sizeof(u32)];
+	int len;
+
+	len = rtk_rpmsg_test_request(t, req, 0x1234, 0xdeadbeef, 4);
+	KUNIT_ASSERT_EQ(test, __rtk_rpmsg_send(&t->channel, req, len, true, false), len);
+	KUNIT_EXPECT_EQ(test, t->kicks, 1);
+	KUNIT_EXPECT_EQ(test, tx->ringIn, tx->ringStart + len);
+
+	KUNIT_ASSERT_EQ(test, rtk_rpmsg_test_remote(t), len);
+	KUNIT_EXPECT_MEMEQ(test, t->lb.msg, req, len);
+	KUNIT_EXPECT_EQ(test, tx->ringOut, tx->ringIn);
+	KUNIT_EXPECT_EQ(test, rtk_rpmsg_test_remote(t), 0);
+
+	rtk_rpmsg_test_check_reply(test, 0x1234, 0xdeadbeef);
+}
+
+static void rtk_rpmsg_test_wrap(struct kunit *test)
+{
+	struct rtk_rpmsg_test *t = test->priv;
+	struct av_info *tx = t->channel.tx_info.av;
+	struct av_info *rx = t->channel.rx_info.av;
+	char req[sizeof(struct rpc_struct) + 8 * sizeof(u32)];
+	int len;
+
+	/* both messages straddle the end of their ring, headers included */
+	rtk_rpmsg_test_ring_rewind(tx, 12);
+	rtk_rpmsg_test_ring_rewind(rx, 12);
+
+	len = rtk_rpmsg_test_request(t, req, 0x5678, 0x600d, 8);
+	KUNIT_ASSERT_EQ(test, __rtk_rpmsg_send(&t->channel, req, len, true, false), len);
+	KUNIT_EXPECT_EQ(test, tx->ringIn, tx->ringStart + len - 12);
+
+	KUNIT_ASSERT_EQ(test, rtk_rpmsg_test_remote(t), len);
+	KUNIT_EXPECT_MEMEQ(test, t->lb.msg, req, len);
+	KUNIT_EXPECT_EQ(test, tx->ringOut, tx->ringIn);
+
+	rtk_rpmsg_test_check_reply(test, 0x5678, 0x600d);
+	KUNIT_EXPECT_EQ(test, rx->ringOut, rx->ringIn);
+	KUNIT_EXPECT_EQ(test, rx->ringIn, rx->ringStart + 28);
+}
+
+static void rtk_rpmsg_test_no_reply(struct kunit *test)
+{
+	struct rtk_rpmsg_test *t = test->priv;
+	char req[sizeof(struct rpc_struct)];
+	struct rpc_struct rpc;
+	int len;
+
+	/* requests without a taskID are one way */
+	len = rtk_rpmsg_test_request(t, req, 0, 0, 0);
+	KUNIT_ASSERT_EQ(test, __rtk_rpmsg_send(&t->channel, req, len, true, false), len);
+	KUNIT_ASSERT_EQ(test, rtk_rpmsg_test_remote(t), len);
+	KUNIT_EXPECT_EQ(test, get_ring_data(&t->channel, &rpc), -ENODATA);
+}
+
+static void rtk_rpmsg_test_tx_full(struct kunit *test)
+{
+	struct rtk_rpmsg_test *t = test->priv;
+	int words = (SZ_1K - sizeof(struct rpc_struct)) / sizeof(u32);
+	char *req;
+	int i, len;
+
+	req = kunit_kmalloc(test, SZ_1K, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, req);
+	len = rtk_rpmsg_test_request(t, req, 0, 0, words);
+
+	/* one byte always stays free so that a full ring is not mistaken for empty */
+	for (i = 0; i < LOOPBACK_FIFO_SIZE / SZ_1K - 1; i++)
+		KUNIT_ASSERT_EQ(test, __rtk_rpmsg_send(&t->channel, req, len, true, false), len);
+
+	KUNIT_EXPECT_EQ(test, __rtk_rpmsg_send(&t->channel, req, len, true, false), -EAGAIN);
+	KUNIT_EXPECT_EQ(test, t->kicks, i);
+
+	KUNIT_ASSERT_EQ(test, rtk_rpmsg_test_remote(t), len);
+	KUNIT_EXPECT_EQ(test, __rtk_rpmsg_send(&t->channel, req, len, true, false), len);
+}
+
+static void rtk_rpmsg_test_rx_full(struct kunit *test)
+{
+	struct rtk_rpmsg_test *t = test->priv;
+	struct av_info *rx = t->channel.rx_info.av;
+	char req[sizeof(struct rpc_struct)];
+	int len;
+
+	len = rtk_rpmsg_test_request(t, req, 0x42, 0, 0);
+	KUNIT_ASSERT_EQ(test, __rtk_rpmsg_send(&t->channel, req, len, true, false), len);
+
+	/* the kernel has not drained the reply ring, leave the request queued */
+	rx->ringOut = rx->ringIn + 16;
+	KUNIT_EXPECT_EQ(test, rtk_rpmsg_test_remote(t), -ENOSPC);
+	KUNIT_EXPECT_EQ(test, t->channel.tx_info.av->ringOut, t->channel.tx_info.av->ringStart);
+
+	rx->ringOut = rx->ringIn;
+	KUNIT_EXPECT_EQ(test, rtk_rpmsg_test_remote(t), len);
+	rtk_rpmsg_test_check_reply(test, 0x42, 0);
+}
+
+static void rtk_rpmsg_test_swap(struct kunit *test)
+{
+	u32 buf[3] = { 0x11223344, 0xaabbccdd, 0 };
+
+	endian_swap_32_write(buf, sizeof(buf));
+	KUNIT_EXPECT_EQ(test, buf[0], (__force u32)cpu_to_be32(0x11223344));
+	KUNIT_EXPECT_EQ(test, buf[1], (__force u32)cpu_to_be32(0xaabbccdd));
+
+	endian_swap_32_read(buf, sizeof(buf));
+	KUNIT_EXPECT_EQ(test, buf[0], 0x11223344);
+	KUNIT_EXPECT_EQ(test, buf[1], 0xaabbccdd);
+	KUNIT_EXPECT_EQ(test, buf[2], 0);
+}
+
+static const struct remote_cpu_info *rtk_rpmsg_test_infos[] = {
+	&loopback_be_info,
+	&loopback_le_info,
+};
+
+static void rtk_rpmsg_test_info_desc(const struct remote_cpu_info **info, char *desc)
+{
+	snprintf(desc, KUNIT_PARAM_DESC_SIZE, "%s endian",
+		 (*info)->big_endian ? "big" : "little");
+}
+
+KUNIT_ARRAY_PARAM(rtk_rpmsg_test, rtk_rpmsg_test_infos, rtk_rpmsg_test_info_desc);
+
+static struct kunit_case rtk_rpmsg_test_cases[] = {
+	KUNIT_CASE_PARAM(rtk_rpmsg_test_round_trip, rtk_rpmsg_test_gen_params),
+	KUNIT_CASE_PARAM(rtk_rpmsg_test_wrap, rtk_rpmsg_test_gen_params),
+	KUNIT_CASE_PARAM(rtk_rpmsg_test_no_reply, rtk_rpmsg_test_gen_params),
+	KUNIT_CASE_PARAM(rtk_rpmsg_test_tx_full, rtk_rpmsg_test_gen_params),
+	KUNIT_CASE_PARAM(rtk_rpmsg_test_rx_full, rtk_rpmsg_test_gen_params),
+	KUNIT_CASE(rtk_rpmsg_test_swap),
+	{}
+};
+
+static struct kunit_suite rtk_rpmsg_test_suite = {
+	.name = "rpmsg-rtk",
+	.init = rtk_rpmsg_test_init,
+	.exit = rtk_rpmsg_test_exit,
+	.test_cases = rtk_rpmsg_test_cases,
+};
+kunit_test_suite(rtk_rpmsg_test_suite);
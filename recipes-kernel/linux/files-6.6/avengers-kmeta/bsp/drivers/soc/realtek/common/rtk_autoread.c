@@ -22,6 +22,9 @@
 #include <linux/perf_event.h>
 #include <linux/pm_runtime.h>
 #include <linux/pm_domain.h>
+#include <linux/hrtimer.h>
+#include <asm/irq_regs.h>
+#include <soc/realtek/rtk_perf_sample.h>
 #include "rtk_autoread.h"
 
 
@@ -55,6 +58,8 @@
 #define AUTOREAD_PMU_MAX_COUNTERS	17
 #define AUTOREAD_VAL_MASK		GENMASK(31, 0)
 #define AUTOREAD_PMU_ADD_MASK		BIT(17)
+/* shortest sample period, a set of 16 INA takes about 1.5ms on the bus */
+#define AUTOREAD_PMU_MIN_INTERVAL	(1LL * NSEC_PER_MSEC)
 
 enum ina2xx_ids { ina219, ina226 };
 
@@ -113,6 +118,18 @@ struct autoread_pmu {
 	u64		counter_mask;
 	u64		counter_read_mask;
 	unsigned long	read_bitmap;
+
+	/* sampling events, taken from the latest DMA set by an hrtimer */
+	struct perf_event	*events[AUTOREAD_PMU_MAX_COUNTERS];
+	struct hrtimer	hrtimer;
+	u64		hrtimer_interval;
+	int		nr_sampling;
+};
+
+/* raw data of a sample, PERF_SAMPLE_RAW */
+struct autoread_pmu_raw {
+	u32		timestamp;	/* autoread timestamp of the DMA set */
+	u32		value;		/* raw INA reading */
 };
 
 struct rtk_autoread_data {
@@ -120,6 +137,8 @@ struct rtk_autoread_data {
 	struct kobject		kobj;
 	const struct		ina2xx_config *ina_config;
 	struct autoread_pmu	*pmu;
+	/* the DMA buffer against the PMU, which reads it from its hrtimer */
+	raw_spinlock_t	dma_lock;
 	dma_addr_t	dma_buff_addr_0;
 	dma_addr_t	dma_buff_addr_1;
 	void		*dma_buff_0;
@@ -392,20 +411,27 @@ static ssize_t auto_en_show(struct kobject *kobj,
 static int autoread_memory_setting(struct rtk_autoread_data *autoread_data)
 {
 	uint32_t dma_lsb, dma_msb;
-
-	autoread_data->dma_size =
-		(TIME_STAMP_SIZE + INA_DATA_SIZE * hweight16(devices_bitmap & 0xFFFF)) * loop_cnt;
-	autoread_data->dma_buff_0 =
-		dma_alloc_coherent(autoread_data->dev, autoread_data->dma_size * 2,
-				   &autoread_data->dma_buff_addr_0, GFP_KERNEL);
-	if (!autoread_data->dma_buff_0) {
+	unsigned long flags;
+	dma_addr_t dma_addr;
+	size_t size;
+	void *buf;
+
+	size = (TIME_STAMP_SIZE + INA_DATA_SIZE * hweight16(devices_bitmap & 0xFFFF)) * loop_cnt;
+	buf = dma_alloc_coherent(autoread_data->dev, size * 2, &dma_addr, GFP_KERNEL);
+	if (!buf) {
 		dev_err(autoread_data->dev, "Failed to allocate DMA buffer\n");
 		return -ENOMEM;
 	}
 
-	autoread_data->dma_buff_1 = autoread_data->dma_buff_0 + autoread_data->dma_size;
-	dma_lsb = (uint32_t)(autoread_data->dma_buff_addr_0 & 0xFFFFFFFF);
-	dma_msb = (uint32_t)((autoread_data->dma_buff_addr_0 >> 32) & 0xFFFFFFFF);
+	raw_spin_lock_irqsave(&autoread_data->dma_lock, flags);
+	autoread_data->dma_size = size;
+	autoread_data->dma_buff_0 = buf;
+	autoread_data->dma_buff_addr_0 = dma_addr;
+	autoread_data->dma_buff_1 = buf + size;
+	raw_spin_unlock_irqrestore(&autoread_data->dma_lock, flags);
+
+	dma_lsb = (uint32_t)(dma_addr & 0xFFFFFFFF);
+	dma_msb = (uint32_t)((dma_addr >> 32) & 0xFFFFFFFF);
 
 	AUTOREAD_WRITEL(dma_lsb, DMA_LSB);
 	AUTOREAD_WRITEL(dma_msb, DMA_MSB);
@@ -493,17 +519,30 @@ static int autoread_enable(struct rtk_autoread_data *autoread_data)
 
 	return ret;
 }
+/*
+ * The buffer is detached under dma_lock first, so a PMU read either finishes
+ * with it before it is freed or finds no buffer.
+ */
 static void autoread_disable(struct rtk_autoread_data *autoread_data)
 {
+	unsigned long flags;
+	dma_addr_t dma_addr;
+	void *buf;
+
 	AUTOREAD_WRITEL(0x2, DMA_CTRL);
 
-	if (autoread_data->dma_buff_0) {
-		dma_free_coherent(autoread_data->dev, autoread_data->dma_size * 2,
-					autoread_data->dma_buff_0,
-					autoread_data->dma_buff_addr_0);
-		autoread_data->dma_buff_0 = NULL;
+	raw_spin_lock_irqsave(&autoread_data->dma_lock, flags);
+	buf = autoread_data->dma_buff_0;
+	dma_addr = autoread_data->dma_buff_addr_0;
+	autoread_data->dma_buff_0 = NULL;
+	autoread_data->dma_buff_1 = NULL;
+	if (autoread_data->pmu)
 		autoread_data->pmu->current_read_ptr = NULL;
-	}
+	raw_spin_unlock_irqrestore(&autoread_data->dma_lock, flags);
+
+	if (buf)
+		dma_free_coherent(autoread_data->dev, autoread_data->dma_size * 2,
+				  buf, dma_addr);
 
 	pm_runtime_put_sync(autoread_data->dev);
 }
@@ -639,6 +678,17 @@ static void rtk_autoread_cleanup(struct rtk_autoread_data *autoread_data,
 	if (!autoread_data)
 		return;
 
+	/* the PMU reads the DMA buffer, so it goes first */
+	if (autoread_data->pmu) {
+		hrtimer_cancel(&autoread_data->pmu->hrtimer);
+		perf_pmu_unregister(&autoread_data->pmu->pmu);
+		cpuhp_state_remove_instance(autoread_data->pmu->cpuhp_state,
+					    &autoread_data->pmu->cpuhp);
+		cpuhp_remove_multi_state(autoread_data->pmu->cpuhp_state);
+		autoread_pmu_free(autoread_data->pmu);
+		autoread_data->pmu = NULL;
+	}
+
 	if (autoread_data->dma_buff_0)
 		dma_free_coherent(dev, autoread_data->dma_size * 2,
 				  autoread_data->dma_buff_0, autoread_data->dma_buff_addr_0);
@@ -655,15 +705,6 @@ static void rtk_autoread_cleanup(struct rtk_autoread_data *autoread_data,
 		disable_i2c_int(autoread_data);
 	}
 
-	if (autoread_data->pmu) {
-		perf_pmu_unregister(&autoread_data->pmu->pmu);
-		cpuhp_state_remove_instance(autoread_data->pmu->cpuhp_state,
-					    &autoread_data->pmu->cpuhp);
-		cpuhp_remove_multi_state(autoread_data->pmu->cpuhp_state);
-		autoread_pmu_free(autoread_data->pmu);
-		autoread_data->pmu = NULL;
-	}
-
 	devm_kfree(dev, autoread_data);
 
 	pr_info("rtk autoread cleanup\n");
@@ -685,6 +726,9 @@ static void autoread_pmu_start(struct perf_event *event, int flags)
 
 	hwc->state = 0;
 
+	if (is_sampling_event(event))
+		rtk_perf_sample_start(hwc, ktime_get_ns());
+
 	local64_set(&hwc->prev_count, 0);
 	perf_event_update_userpage(event);
 	//autoread_pmu_enable_counter(event);
@@ -723,13 +767,16 @@ static u64 __transform_raw_data(struct autoread_pmu *pmu, u64 val, int idx)
 	return val;
 }
 
-static u64 __read_dma_data(struct autoread_pmu *pmu, int idx)
+/*
+ * The DMA set counter @idx is read from: the newest set once every counter
+ * has read the current one. Called with dma_lock held and a buffer present.
+ */
+static void *__autoread_pmu_get_set(struct autoread_pmu *pmu, int idx)
 {
 	struct rtk_autoread_data *autoread_data = pmu->autoread_data;
 	void *current_read_ptr = pmu->current_read_ptr;
 	void *tmp_read_ptr;
 	void *next_set_ptr;
-	u64 val;
 	uint32_t dma_total_size = autoread_data->dma_size * 2;
 	int max_iterations = dma_total_size / SET_SIZE;
 	int read_complete = (pmu->read_bitmap & pmu->counter_read_mask) == pmu->counter_read_mask;
@@ -756,28 +803,38 @@ static u64 __read_dma_data(struct autoread_pmu *pmu, int idx)
 		pmu->read_bitmap = 0;
 	}
 
-	if (idx != 0) {
-		tmp_read_ptr = current_read_ptr + 2 * (idx-1) + 4;
-		val = *(uint16_t *)tmp_read_ptr;
-		val = __transform_raw_data(pmu, val, idx);
-	} else {
-		val = *(uint32_t *)current_read_ptr;
-	}
-
 	pmu->read_bitmap |= BIT(idx);
 	pmu->current_read_ptr = current_read_ptr;
 
-	return val;
+	return current_read_ptr;
+}
+
+/* the INA register value of counter @idx in a DMA set, the timestamp for 0 */
+static u32 __autoread_pmu_raw(void *set, int idx)
+{
+	return idx ? *(uint16_t *)(set + 2 * (idx - 1) + 4) : *(uint32_t *)set;
+}
+
+static u64 __read_dma_data(struct autoread_pmu *pmu, int idx)
+{
+	u64 val = __autoread_pmu_raw(__autoread_pmu_get_set(pmu, idx), idx);
+
+	return idx ? __transform_raw_data(pmu, val, idx) : val;
 }
 
 static u64 autoread_pmu_read_counter(struct autoread_pmu *pmu, int idx)
 {
+	struct rtk_autoread_data *autoread_data = pmu->autoread_data;
+	unsigned long flags;
 	u64 val = 0;
 
 	if (idx >= pmu->num_counters)
 		return -EINVAL;
 
-	val = __read_dma_data(pmu, idx);
+	raw_spin_lock_irqsave(&autoread_data->dma_lock, flags);
+	if (autoread_data->dma_buff_0)
+		val = __read_dma_data(pmu, idx);
+	raw_spin_unlock_irqrestore(&autoread_data->dma_lock, flags);
 
 	return val;
 }
@@ -837,6 +894,87 @@ static void autoread_pmu_event_update(struct perf_event *event)
 		local64_add(delta, &event->count);
 }
 
+static void autoread_pmu_stop(struct perf_event *event, int flags);
+
+static void autoread_pmu_sample(struct autoread_pmu *pmu,
+				struct perf_event *event,
+				u64 now, struct pt_regs *regs)
+{
+	struct rtk_autoread_data *autoread_data = pmu->autoread_data;
+	struct hw_perf_event *hwc = &event->hw;
+	struct perf_sample_data data;
+	struct autoread_pmu_raw sample;
+	struct perf_raw_record raw;
+	unsigned long flags;
+	void *set;
+	u64 val;
+
+	if (hwc->state & PERF_HES_STOPPED)
+		return;
+
+	if (!rtk_perf_sample_due(hwc, now, pmu->hrtimer_interval))
+		return;
+
+	/*
+	 * The sample period carries the converted reading, the raw data the
+	 * autoread timestamp and the INA register value, all taken from one
+	 * DMA set while the buffer cannot go away.
+	 */
+	raw_spin_lock_irqsave(&autoread_data->dma_lock, flags);
+	if (!autoread_data->dma_buff_0) {
+		raw_spin_unlock_irqrestore(&autoread_data->dma_lock, flags);
+		return;
+	}
+	set = __autoread_pmu_get_set(pmu, hwc->idx);
+	sample.timestamp = *(u32 *)set;
+	sample.value = __autoread_pmu_raw(set, hwc->idx);
+	raw_spin_unlock_irqrestore(&autoread_data->dma_lock, flags);
+
+	val = hwc->idx ? __transform_raw_data(pmu, sample.value, hwc->idx) : sample.value;
+	perf_sample_data_init(&data, 0, val);
+
+	if (event->attr.sample_type & PERF_SAMPLE_RAW) {
+		raw = (struct perf_raw_record) {
+			.frag = {
+				.size = sizeof(sample),
+				.data = &sample,
+			},
+		};
+		perf_sample_save_raw_data(&data, &raw);
+	}
+
+	if (regs && perf_event_overflow(event, &data, regs))
+		autoread_pmu_stop(event, 0);
+}
+
+static enum hrtimer_restart autoread_pmu_hrtimer(struct hrtimer *hrtimer)
+{
+	struct autoread_pmu *pmu = container_of(hrtimer, struct autoread_pmu,
+						hrtimer);
+	struct pt_regs *regs = get_irq_regs();
+	struct perf_event *event;
+	unsigned long flags;
+	u64 now = ktime_get_ns();
+	int idx;
+
+	if (!pmu->nr_sampling)
+		return HRTIMER_NORESTART;
+
+	local_irq_save(flags);
+
+	for_each_set_bit(idx, pmu->used_mask, pmu->num_counters) {
+		event = pmu->events[idx];
+		if (event && is_sampling_event(event))
+			autoread_pmu_sample(pmu, event, now, regs);
+	}
+
+	local_irq_restore(flags);
+
+	hrtimer_forward_now(hrtimer, ns_to_ktime(pmu->hrtimer_interval));
+
+	return HRTIMER_RESTART;
+}
+
 /*
  * Implementation of abstract pmu functionality required by
  * the core perf events code.
@@ -875,8 +1013,23 @@ static int autoread_pmu_add(struct perf_event *event, int flags)
 	 * sure it is disabled.
 	 */
 	hwc->idx = idx;
+	pmu->events[idx] = event;
 	//autoread_pmu_disable_counter(event);
 
+	/* tick at the shortest sample period of the sampling events */
+	if (is_sampling_event(event)) {
+		u64 interval = pmu->hrtimer_interval;
+
+		if (pmu->nr_sampling++ == 0)
+			interval = U64_MAX;
+		pmu->hrtimer_interval = min_t(u64, interval, hwc->sample_period);
+
+		if (pmu->hrtimer_interval < interval)
+			hrtimer_start(&pmu->hrtimer,
+				      ns_to_ktime(pmu->hrtimer_interval),
+				      HRTIMER_MODE_REL_PINNED);
+	}
+
 	hwc->state = PERF_HES_UPTODATE | PERF_HES_STOPPED;
 	if (flags & PERF_EF_START)
 		autoread_pmu_start(event, flags);
@@ -899,6 +1052,10 @@ static void autoread_pmu_del(struct perf_event *event, int flags)
 
 	autoread_pmu_stop(event, flags | PERF_EF_UPDATE);
 	autoread_pmu_clear_event_idx(pmu, hwc);
+	pmu->events[hwc->idx] = NULL;
+
+	if (is_sampling_event(event) && --pmu->nr_sampling == 0)
+		hrtimer_cancel(&pmu->hrtimer);
 
 	perf_event_update_userpage(event);
 
@@ -955,10 +1112,9 @@ static int autoread_pmu_event_init(struct perf_event *event)
 	if (attr->exclude_idle)
 		return -EOPNOTSUPP;
 
-	if (is_sampling_event(event)) {
-		pr_debug("Sampling not supported\n");
-		return -EOPNOTSUPP;
-	}
+	/* samples are taken by an hrtimer, see rtk_perf_sample.h */
+	if (is_sampling_event(event))
+		rtk_perf_sample_init(event, AUTOREAD_PMU_MIN_INTERVAL);
 
 	if (event->attach_state & PERF_ATTACH_TASK) {
 		pr_debug("Per-task mode not supported\n");
@@ -1013,8 +1169,7 @@ static void __pmu_init(struct autoread_pmu *pmu)
 		.stop		= autoread_pmu_stop,
 		.read		= autoread_pmu_read,
 		.attr_groups	= autoread_pmu_attr_groups,
-		.capabilities	= PERF_PMU_CAP_NO_EXCLUDE |
-				  PERF_PMU_CAP_NO_INTERRUPT,
+		.capabilities	= PERF_PMU_CAP_NO_EXCLUDE,
 	};
 }
 
@@ -1025,6 +1180,9 @@ static int __autoread_pmu_init(struct autoread_pmu *pmu)
 	pmu->counter_mask = AUTOREAD_VAL_MASK;
 	pmu->counter_read_mask = 0;
 
+	hrtimer_init(&pmu->hrtimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	pmu->hrtimer.function = autoread_pmu_hrtimer;
+
 	/* set start performance trace bit */
 	pmu->name = "rtk_1625_autoread_pmu";
 	pmu->cpuhp_name = "perf/rtk_1625_autoread_pmu:online";
@@ -1114,6 +1272,7 @@ static int rtk_autoread_probe(struct platform_device *pdev)
 		return -ENOMEM;
 
 	autoread_data->dev = dev;
+	raw_spin_lock_init(&autoread_data->dma_lock);
 
 	kobject_init(&autoread_data->kobj, &rtk_autoread_ktype);
 	ret = kobject_add(&autoread_data->kobj, kernel_kobj, "autoread");
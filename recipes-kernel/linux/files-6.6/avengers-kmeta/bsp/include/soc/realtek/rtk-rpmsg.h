@@ -36,3 +36,7 @@ void rtk_dump_all_ringbuf_info(struct device *dev);
 int check_rcpu_status(struct device *dev);
 void endian_swap_32_read(void *buf, size_t size);
 void endian_swap_32_write(void *buf, size_t size);
+
+struct rpmsg_endpoint;
+int rtk_rpmsg_send_queued(struct rpmsg_endpoint *ept, void *data, int len);
+void rtk_rpmsg_flush(struct rpmsg_endpoint *ept);
@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef __SOC_REALTEK_PERF_SAMPLE_H
+#define __SOC_REALTEK_PERF_SAMPLE_H
+
+#include <linux/math64.h>
+#include <linux/perf_event.h>
+
+/*
+ * Sampling for the Realtek PMUs without an overflow interrupt (uncore,
+ * autoread). Samples are taken from an hrtimer, so the sample period is an
+ * interval in ns. hw.freq_time_stamp holds the time the next sample is due:
+ * frequency mode is turned into a fixed interval by rtk_perf_sample_init(),
+ * so the core neither uses that field nor adjusts the period.
+ */
+
+/* set the sample period of @event in ns, at least @min_interval */
+static inline void rtk_perf_sample_init(struct perf_event *event, u64 min_interval)
+{
+	struct perf_event_attr *attr = &event->attr;
+	struct hw_perf_event *hwc = &event->hw;
+	u64 period = attr->sample_period;
+
+	if (attr->freq) {
+		period = div64_u64(NSEC_PER_SEC, attr->sample_freq);
+		attr->freq = 0;
+	}
+
+	period = max_t(u64, period, min_interval);
+	attr->sample_period = period;
+	hwc->sample_period = period;
+	hwc->last_period = period;
+}
+
+/* the first sample is due one period after @now */
+static inline void rtk_perf_sample_start(struct hw_perf_event *hwc, u64 now)
+{
+	hwc->freq_time_stamp = now + hwc->sample_period;
+}
+
+/*
+ * Called by an hrtimer ticking every @tick ns. Returns true and moves the
+ * deadline on when a sample is due at @now. The timer may fire slightly
+ * early, so half a tick is allowed; a deadline missed by a whole period
+ * restarts from @now rather than catching up.
+ */
+static inline bool rtk_perf_sample_due(struct hw_perf_event *hwc, u64 now, u64 tick)
+{
+	u64 deadline = hwc->freq_time_stamp;
+
+	if ((s64)(deadline - now) > (s64)(tick >> 1))
+		return false;
+
+	deadline += hwc->sample_period;
+	if ((s64)(deadline - now) <= 0)
+		deadline = now + hwc->sample_period;
+	hwc->freq_time_stamp = deadline;
+
+	return true;
+}
+
+#endif /* __SOC_REALTEK_PERF_SAMPLE_H */